@@ -0,0 +1,458 @@
+#include "AccessorKernels.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+
+#include <glm/gtc/packing.hpp>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define ACCESSOR_KERNELS_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define ACCESSOR_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+// MSVC compiles any intrinsic without flags, GCC and clang need the target on each function using them
+#if defined(ACCESSOR_KERNELS_X86) && !defined(_MSC_VER)
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE41
+#define TARGET_AVX2
+#endif
+
+namespace {
+	template<typename T> T readValue(const byte* p) {
+		T value;
+		std::memcpy(&value, p, sizeof(T));
+		return value;
+	}
+
+	template<AttributeValueType V> struct ComponentType;
+	template<> struct ComponentType<AttributeValueType::eInt8> { using type = int8_t; };
+	template<> struct ComponentType<AttributeValueType::eInt16> { using type = int16_t; };
+	template<> struct ComponentType<AttributeValueType::eInt32> { using type = int32_t; };
+	template<> struct ComponentType<AttributeValueType::eInt64> { using type = int64_t; };
+	template<> struct ComponentType<AttributeValueType::eUint8> { using type = uint8_t; };
+	template<> struct ComponentType<AttributeValueType::eUint16> { using type = uint16_t; };
+	template<> struct ComponentType<AttributeValueType::eUint32> { using type = uint32_t; };
+	template<> struct ComponentType<AttributeValueType::eUint64> { using type = uint64_t; };
+	template<> struct ComponentType<AttributeValueType::eHalf> { using type = uint16_t; };
+	template<> struct ComponentType<AttributeValueType::eFloat> { using type = float; };
+	template<> struct ComponentType<AttributeValueType::eDouble> { using type = double; };
+
+	// Only 8 and 16 bit integers can be normalized in glTF
+	template<typename T> constexpr bool isNormalizable = std::is_integral_v<T> && sizeof(T) <= 2;
+
+	template<AttributeValueType V> float readComponent(const byte* p, bool normalized) {
+		using T = typename ComponentType<V>::type;
+		const T value = readValue<T>(p);
+		if constexpr (V == AttributeValueType::eHalf)
+			return glm::unpackHalf1x16(value);
+		else if constexpr (isNormalizable<T>) {
+			if (!normalized)
+				return static_cast<float>(value);
+			constexpr float max = static_cast<float>(std::numeric_limits<T>::max());
+			return std::is_signed_v<T> ? std::max(value / max, -1.0f) : value / max;
+		}
+		else
+			return static_cast<float>(value);
+	}
+
+	template<AttributeValueType V> void gatherScalar(const byte* src, size_t stride, size_t count, size_t componentCount, bool normalized, glm::vec4* dst) {
+		constexpr size_t componentSize = sizeof(typename ComponentType<V>::type);
+		for (size_t i = 0; i < count; i++) {
+			for (size_t c = 0; c < componentCount; c++)
+				dst[i][c] = readComponent<V>(src + i * stride + c * componentSize, normalized);
+		}
+	}
+
+	// Vector paths load all 4 components of an element. Only the leading elements whose over-read stays inside the
+	// accessor's own data take them, the rest go through the scalar path.
+	size_t vectorSafeCount(size_t count, size_t stride, size_t componentCount, size_t componentSize) {
+		if (count == 0)
+			return 0;
+		const size_t end = (count - 1) * stride + componentCount * componentSize;
+		const size_t loadSize = 4 * componentSize;
+		if (end < loadSize)
+			return 0;
+		return std::min(count, (end - loadSize) / stride + 1);
+	}
+
+	template<typename T> void widenIndicesScalar(const byte* src, size_t count, uint32_t* dst) {
+		for (size_t i = 0; i < count; i++)
+			dst[i] = readValue<T>(src + i * sizeof(T));
+	}
+
+	void copyIndices(const byte* src, size_t count, uint32_t* dst) {
+		std::memcpy(dst, src, count * sizeof(uint32_t));
+	}
+
+	void narrowIndicesScalar(const uint32_t* src, size_t count, uint16_t* dst) {
+		for (size_t i = 0; i < count; i++)
+			dst[i] = static_cast<uint16_t>(src[i]);
+	}
+
+#ifdef ACCESSOR_KERNELS_X86
+	// Lanes at or past componentCount, which keep their default value
+	TARGET_SSE41 __m128 missingLanesSse41(size_t componentCount) {
+		return _mm_castsi128_ps(_mm_cmpgt_epi32(_mm_setr_epi32(0, 1, 2, 3), _mm_set1_epi32(static_cast<int>(componentCount) - 1)));
+	}
+
+	template<typename T> TARGET_SSE41 __m128 loadElementSse41(const byte* p) {
+		if constexpr (std::is_same_v<T, float>)
+			return _mm_loadu_ps(reinterpret_cast<const float*>(p));
+		else {
+			__m128i widened;
+			if constexpr (std::is_same_v<T, int8_t>)
+				widened = _mm_cvtepi8_epi32(_mm_cvtsi32_si128(readValue<int32_t>(p)));
+			else if constexpr (std::is_same_v<T, uint8_t>)
+				widened = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(readValue<int32_t>(p)));
+			else if constexpr (std::is_same_v<T, int16_t>)
+				widened = _mm_cvtepi16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)));
+			else
+				widened = _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)));
+			return _mm_cvtepi32_ps(widened);
+		}
+	}
+
+	template<AttributeValueType V> TARGET_SSE41 void gatherSse41(const byte* src, size_t stride, size_t count, size_t componentCount, bool normalized, glm::vec4* dst) {
+		using T = typename ComponentType<V>::type;
+		const size_t vectorCount = vectorSafeCount(count, stride, componentCount, sizeof(T));
+
+		const __m128 defaults = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+		const __m128 missing = missingLanesSse41(componentCount);
+		const bool normalize = isNormalizable<T> && normalized;
+		const __m128 divisor = _mm_set1_ps(normalize ? static_cast<float>(std::numeric_limits<T>::max()) : 1.0f);
+		const __m128 minimum = _mm_set1_ps(normalize && std::is_signed_v<T> ? -1.0f : -FLT_MAX);
+
+		for (size_t i = 0; i < vectorCount; i++) {
+			__m128 v = loadElementSse41<T>(src + i * stride);
+			if constexpr (isNormalizable<T>)
+				v = _mm_max_ps(_mm_div_ps(v, divisor), minimum);
+			_mm_storeu_ps(&dst[i].x, _mm_blendv_ps(v, defaults, missing));
+		}
+		gatherScalar<V>(src + vectorCount * stride, stride, count - vectorCount, componentCount, normalized, dst + vectorCount);
+	}
+
+	// Two elements per iteration, one in each 128 bit lane
+	template<typename T> TARGET_AVX2 __m256 loadElementPairAvx2(const byte* a, const byte* b) {
+		if constexpr (std::is_same_v<T, float>)
+			return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(reinterpret_cast<const float*>(a))), _mm_loadu_ps(reinterpret_cast<const float*>(b)), 1);
+		else {
+			__m256i widened;
+			if constexpr (sizeof(T) == 1) {
+				const __m128i packed = _mm_setr_epi32(readValue<int32_t>(a), readValue<int32_t>(b), 0, 0);
+				if constexpr (std::is_signed_v<T>)
+					widened = _mm256_cvtepi8_epi32(packed);
+				else
+					widened = _mm256_cvtepu8_epi32(packed);
+			}
+			else {
+				const __m128i packed = _mm_set_epi64x(readValue<int64_t>(b), readValue<int64_t>(a));
+				if constexpr (std::is_signed_v<T>)
+					widened = _mm256_cvtepi16_epi32(packed);
+				else
+					widened = _mm256_cvtepu16_epi32(packed);
+			}
+			return _mm256_cvtepi32_ps(widened);
+		}
+	}
+
+	template<AttributeValueType V> TARGET_AVX2 void gatherAvx2(const byte* src, size_t stride, size_t count, size_t componentCount, bool normalized, glm::vec4* dst) {
+		using T = typename ComponentType<V>::type;
+		const size_t vectorCount = vectorSafeCount(count, stride, componentCount, sizeof(T));
+
+		const __m256 defaults = _mm256_setr_ps(0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+		const __m128 missingLanes = missingLanesSse41(componentCount);
+		const __m256 missing = _mm256_insertf128_ps(_mm256_castps128_ps256(missingLanes), missingLanes, 1);
+		const bool normalize = isNormalizable<T> && normalized;
+		const __m256 divisor = _mm256_set1_ps(normalize ? static_cast<float>(std::numeric_limits<T>::max()) : 1.0f);
+		const __m256 minimum = _mm256_set1_ps(normalize && std::is_signed_v<T> ? -1.0f : -FLT_MAX);
+
+		size_t i = 0;
+		for (; i + 2 <= vectorCount; i += 2) {
+			__m256 v = loadElementPairAvx2<T>(src + i * stride, src + (i + 1) * stride);
+			if constexpr (isNormalizable<T>)
+				v = _mm256_max_ps(_mm256_div_ps(v, divisor), minimum);
+			_mm256_storeu_ps(&dst[i].x, _mm256_blendv_ps(v, defaults, missing));
+		}
+		gatherSse41<V>(src + i * stride, stride, count - i, componentCount, normalized, dst + i);
+	}
+
+	TARGET_SSE41 void widenUint8Sse41(const byte* src, size_t count, uint32_t* dst) {
+		size_t i = 0;
+		for (; i + 16 <= count; i += 16) {
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 0), _mm_cvtepu8_epi32(v));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), _mm_cvtepu8_epi32(_mm_srli_si128(v, 4)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), _mm_cvtepu8_epi32(_mm_srli_si128(v, 8)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 12), _mm_cvtepu8_epi32(_mm_srli_si128(v, 12)));
+		}
+		widenIndicesScalar<uint8_t>(src + i, count - i, dst + i);
+	}
+
+	TARGET_SSE41 void widenUint16Sse41(const byte* src, size_t count, uint32_t* dst) {
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8) {
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * sizeof(uint16_t)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 0), _mm_cvtepu16_epi32(v));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), _mm_cvtepu16_epi32(_mm_srli_si128(v, 8)));
+		}
+		widenIndicesScalar<uint16_t>(src + i * sizeof(uint16_t), count - i, dst + i);
+	}
+
+	TARGET_AVX2 void widenUint8Avx2(const byte* src, size_t count, uint32_t* dst) {
+		size_t i = 0;
+		for (; i + 16 <= count; i += 16) {
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 0), _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i + 0))));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 8), _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i + 8))));
+		}
+		widenIndicesScalar<uint8_t>(src + i, count - i, dst + i);
+	}
+
+	TARGET_AVX2 void widenUint16Avx2(const byte* src, size_t count, uint32_t* dst) {
+		size_t i = 0;
+		for (; i + 16 <= count; i += 16) {
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 0), _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + (i + 0) * sizeof(uint16_t)))));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 8), _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + (i + 8) * sizeof(uint16_t)))));
+		}
+		widenIndicesScalar<uint16_t>(src + i * sizeof(uint16_t), count - i, dst + i);
+	}
+
+	// packus saturates rather than truncates, which is the same for indices that fit
+	TARGET_SSE41 void narrowIndicesSse41(const uint32_t* src, size_t count, uint16_t* dst) {
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8) {
+			const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 0));
+			const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 4));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi32(a, b));
+		}
+		narrowIndicesScalar(src + i, count - i, dst + i);
+	}
+
+	TARGET_AVX2 void narrowIndicesAvx2(const uint32_t* src, size_t count, uint16_t* dst) {
+		size_t i = 0;
+		for (; i + 16 <= count; i += 16) {
+			const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 0));
+			const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 8));
+			// packs within 128 bit lanes, put the quarters back in order
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_permute4x64_epi64(_mm256_packus_epi32(a, b), 0xD8));
+		}
+		narrowIndicesSse41(src + i, count - i, dst + i);
+	}
+
+	AccessorKernelIsa detectIsa() {
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		const int maxLeaf = info[0];
+		__cpuid(info, 1);
+		const bool sse41 = (info[2] & (1 << 19)) != 0;
+		// AVX2 also needs the OS to save the upper halves of the ymm registers
+		const bool osAvx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+		bool avx2 = false;
+		if (maxLeaf >= 7 && osAvx) {
+			__cpuidex(info, 7, 0);
+			avx2 = (info[1] & (1 << 5)) != 0;
+		}
+#else
+		__builtin_cpu_init();
+		const bool sse41 = __builtin_cpu_supports("sse4.1");
+		const bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+		if (avx2)
+			return AccessorKernelIsa::eAvx2;
+		if (sse41)
+			return AccessorKernelIsa::eSse41;
+		return AccessorKernelIsa::eScalar;
+	}
+#elif defined(ACCESSOR_KERNELS_NEON)
+	uint32x4_t missingLanesNeon(size_t componentCount) {
+		const uint32_t lanes[4] = { 0, 1, 2, 3 };
+		return vcgtq_u32(vld1q_u32(lanes), vdupq_n_u32(static_cast<uint32_t>(componentCount) - 1));
+	}
+
+	template<typename T> float32x4_t loadElementNeon(const byte* p) {
+		if constexpr (std::is_same_v<T, float>)
+			return vld1q_f32(reinterpret_cast<const float*>(p));
+		else if constexpr (std::is_same_v<T, int8_t>)
+			return vcvtq_f32_s32(vmovl_s16(vget_low_s16(vmovl_s8(vreinterpret_s8_s32(vdup_n_s32(readValue<int32_t>(p)))))));
+		else if constexpr (std::is_same_v<T, uint8_t>)
+			return vcvtq_f32_u32(vmovl_u16(vget_low_u16(vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(readValue<uint32_t>(p)))))));
+		else if constexpr (std::is_same_v<T, int16_t>)
+			return vcvtq_f32_s32(vmovl_s16(vld1_s16(reinterpret_cast<const int16_t*>(p))));
+		else
+			return vcvtq_f32_u32(vmovl_u16(vld1_u16(reinterpret_cast<const uint16_t*>(p))));
+	}
+
+	template<AttributeValueType V> void gatherNeon(const byte* src, size_t stride, size_t count, size_t componentCount, bool normalized, glm::vec4* dst) {
+		using T = typename ComponentType<V>::type;
+		const size_t vectorCount = vectorSafeCount(count, stride, componentCount, sizeof(T));
+
+		const float defaultValues[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+		const float32x4_t defaults = vld1q_f32(defaultValues);
+		const uint32x4_t missing = missingLanesNeon(componentCount);
+		const bool normalize = isNormalizable<T> && normalized;
+		const float32x4_t divisor = vdupq_n_f32(normalize ? static_cast<float>(std::numeric_limits<T>::max()) : 1.0f);
+		const float32x4_t minimum = vdupq_n_f32(normalize && std::is_signed_v<T> ? -1.0f : -FLT_MAX);
+
+		for (size_t i = 0; i < vectorCount; i++) {
+			float32x4_t v = loadElementNeon<T>(src + i * stride);
+			if constexpr (isNormalizable<T>)
+				v = vmaxq_f32(vdivq_f32(v, divisor), minimum);
+			vst1q_f32(&dst[i].x, vbslq_f32(missing, defaults, v));
+		}
+		gatherScalar<V>(src + vectorCount * stride, stride, count - vectorCount, componentCount, normalized, dst + vectorCount);
+	}
+
+	void widenUint8Neon(const byte* src, size_t count, uint32_t* dst) {
+		size_t i = 0;
+		for (; i + 16 <= count; i += 16) {
+			const uint8x16_t v = vld1q_u8(src + i);
+			const uint16x8_t low = vmovl_u8(vget_low_u8(v));
+			const uint16x8_t high = vmovl_u8(vget_high_u8(v));
+			vst1q_u32(dst + i + 0, vmovl_u16(vget_low_u16(low)));
+			vst1q_u32(dst + i + 4, vmovl_u16(vget_high_u16(low)));
+			vst1q_u32(dst + i + 8, vmovl_u16(vget_low_u16(high)));
+			vst1q_u32(dst + i + 12, vmovl_u16(vget_high_u16(high)));
+		}
+		widenIndicesScalar<uint8_t>(src + i, count - i, dst + i);
+	}
+
+	void widenUint16Neon(const byte* src, size_t count, uint32_t* dst) {
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8) {
+			const uint16x8_t v = vreinterpretq_u16_u8(vld1q_u8(src + i * sizeof(uint16_t)));
+			vst1q_u32(dst + i + 0, vmovl_u16(vget_low_u16(v)));
+			vst1q_u32(dst + i + 4, vmovl_u16(vget_high_u16(v)));
+		}
+		widenIndicesScalar<uint16_t>(src + i * sizeof(uint16_t), count - i, dst + i);
+	}
+
+	void narrowIndicesNeon(const uint32_t* src, size_t count, uint16_t* dst) {
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+			vst1q_u16(dst + i, vcombine_u16(vmovn_u32(vld1q_u32(src + i + 0)), vmovn_u32(vld1q_u32(src + i + 4))));
+		narrowIndicesScalar(src + i, count - i, dst + i);
+	}
+
+	AccessorKernelIsa detectIsa() {
+		return AccessorKernelIsa::eNeon;
+	}
+#else
+	AccessorKernelIsa detectIsa() {
+		return AccessorKernelIsa::eScalar;
+	}
+#endif
+
+	// 8 and 16 bit integers and floats have vector paths, the other types are rare enough in vertex data to stay scalar
+	template<AttributeValueType V> AttributeGatherKernel selectGather(AccessorKernelIsa isa) {
+		using T = typename ComponentType<V>::type;
+		if constexpr (isNormalizable<T> || std::is_same_v<T, float>) {
+			if constexpr (V != AttributeValueType::eHalf) {
+#ifdef ACCESSOR_KERNELS_X86
+				if (isa == AccessorKernelIsa::eAvx2)
+					return gatherAvx2<V>;
+				if (isa == AccessorKernelIsa::eSse41)
+					return gatherSse41<V>;
+#elif defined(ACCESSOR_KERNELS_NEON)
+				if (isa == AccessorKernelIsa::eNeon)
+					return gatherNeon<V>;
+#endif
+			}
+		}
+		return gatherScalar<V>;
+	}
+}
+
+AccessorKernelIsa accessorKernelIsa() {
+	static const AccessorKernelIsa isa = detectIsa();
+	return isa;
+}
+
+AttributeGatherKernel selectAttributeGatherKernel(AttributeValueType valueType) {
+	const AccessorKernelIsa isa = accessorKernelIsa();
+	switch (valueType) {
+	case AttributeValueType::eInt8:
+		return selectGather<AttributeValueType::eInt8>(isa);
+	case AttributeValueType::eInt16:
+		return selectGather<AttributeValueType::eInt16>(isa);
+	case AttributeValueType::eInt32:
+		return selectGather<AttributeValueType::eInt32>(isa);
+	case AttributeValueType::eInt64:
+		return selectGather<AttributeValueType::eInt64>(isa);
+	case AttributeValueType::eUint8:
+		return selectGather<AttributeValueType::eUint8>(isa);
+	case AttributeValueType::eUint16:
+		return selectGather<AttributeValueType::eUint16>(isa);
+	case AttributeValueType::eUint32:
+		return selectGather<AttributeValueType::eUint32>(isa);
+	case AttributeValueType::eUint64:
+		return selectGather<AttributeValueType::eUint64>(isa);
+	case AttributeValueType::eHalf:
+		return selectGather<AttributeValueType::eHalf>(isa);
+	case AttributeValueType::eFloat:
+		return selectGather<AttributeValueType::eFloat>(isa);
+	case AttributeValueType::eDouble:
+		return selectGather<AttributeValueType::eDouble>(isa);
+	}
+	throw std::runtime_error("Unknown attribute value type");
+}
+
+IndexWidenKernel selectIndexWidenKernel(AttributeValueType indexType) {
+	[[maybe_unused]] const AccessorKernelIsa isa = accessorKernelIsa();
+	switch (indexType) {
+	case AttributeValueType::eInt8:
+	case AttributeValueType::eUint8:
+#ifdef ACCESSOR_KERNELS_X86
+		if (isa == AccessorKernelIsa::eAvx2)
+			return widenUint8Avx2;
+		if (isa == AccessorKernelIsa::eSse41)
+			return widenUint8Sse41;
+#elif defined(ACCESSOR_KERNELS_NEON)
+		if (isa == AccessorKernelIsa::eNeon)
+			return widenUint8Neon;
+#endif
+		return widenIndicesScalar<uint8_t>;
+	case AttributeValueType::eInt16:
+	case AttributeValueType::eUint16:
+#ifdef ACCESSOR_KERNELS_X86
+		if (isa == AccessorKernelIsa::eAvx2)
+			return widenUint16Avx2;
+		if (isa == AccessorKernelIsa::eSse41)
+			return widenUint16Sse41;
+#elif defined(ACCESSOR_KERNELS_NEON)
+		if (isa == AccessorKernelIsa::eNeon)
+			return widenUint16Neon;
+#endif
+		return widenIndicesScalar<uint16_t>;
+	case AttributeValueType::eInt32:
+	case AttributeValueType::eUint32:
+		return copyIndices;
+	default:
+		throw std::runtime_error("Invalid index type");
+	}
+}
+
+void narrowIndices(const uint32_t* src, size_t count, uint16_t* dst) {
+	[[maybe_unused]] const AccessorKernelIsa isa = accessorKernelIsa();
+#ifdef ACCESSOR_KERNELS_X86
+	if (isa == AccessorKernelIsa::eAvx2)
+		return narrowIndicesAvx2(src, count, dst);
+	if (isa == AccessorKernelIsa::eSse41)
+		return narrowIndicesSse41(src, count, dst);
+#elif defined(ACCESSOR_KERNELS_NEON)
+	if (isa == AccessorKernelIsa::eNeon)
+		return narrowIndicesNeon(src, count, dst);
+#endif
+	narrowIndicesScalar(src, count, dst);
+}
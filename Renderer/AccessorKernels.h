@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glm/vec4.hpp>
+
+#include "Mesh.h"
+
+typedef unsigned char byte;
+
+// Conversion loops for accessor data at import. Every kernel has SSE4.1, AVX2 and NEON versions next to the scalar
+// one, and the best one the CPU supports is picked once per accessor rather than per element.
+
+enum class AccessorKernelIsa {
+	eScalar,
+	eSse41,
+	eAvx2,
+	eNeon,
+};
+
+// Detected on first use
+AccessorKernelIsa accessorKernelIsa();
+
+// Converts count strided elements of componentCount components to floats, undoing normalization. dst must be filled
+// with 0, 0, 0, 1 beforehand, components the accessor doesn't have keep those values.
+typedef void (*AttributeGatherKernel)(const byte* src, size_t stride, size_t count, size_t componentCount, bool normalized, glm::vec4* dst);
+AttributeGatherKernel selectAttributeGatherKernel(AttributeValueType valueType);
+
+// Widens count tightly packed indices to 32 bits. Signed index types are read as their unsigned counterpart.
+typedef void (*IndexWidenKernel)(const byte* src, size_t count, uint32_t* dst);
+IndexWidenKernel selectIndexWidenKernel(AttributeValueType indexType);
+
+// Narrows indices that all fit in 16 bits
+void narrowIndices(const uint32_t* src, size_t count, uint16_t* dst);
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstring>
+
+typedef unsigned char byte;
+
+// Non-owning strided view over accessor data, usually pointing straight into a mapped file.
+// Elements are read with memcpy since glTF only guarantees 4 byte alignment for accessor data.
+template<typename T> class AccessorView
+{
+	const byte* m_data = nullptr;
+	size_t m_count = 0;
+	size_t m_stride = sizeof(T);
+
+public:
+	AccessorView() {};
+	AccessorView(const byte* data, size_t count, size_t stride) : m_data(data), m_count(count), m_stride(stride != 0 ? stride : sizeof(T)) {};
+
+	T operator[](size_t i) const {
+		T value;
+		std::memcpy(&value, this->m_data + i * this->m_stride, sizeof(T));
+		return value;
+	}
+
+	const byte* data() const { return this->m_data; }
+	size_t size() const { return this->m_count; }
+	size_t stride() const { return this->m_stride; }
+	bool empty() const { return this->m_count == 0; }
+	bool isContiguous() const { return this->m_stride == sizeof(T); }
+};
@@ -1,5 +1,7 @@
 #pragma once
 #include <stdexcept>
+#include <memory>
+#include <vector>
 
 #include <glm/common.hpp>
 #include <glm/gtx/spline.hpp>
@@ -22,6 +24,8 @@ enum class AnimationRepeatMode {
 	eMirror,
 };
 
+// Keyframe arrays are shared, so animations decoded from the same accessors don't each hold a copy. There may be more
+// values than times (cubic spline outputs), only the first keyframeTimes.size() are read.
 template<typename T>
 class Animation
 {
@@ -31,12 +35,18 @@ public:
 		std::vector<T> keyframeValues,
 		AnimationInterpolationCurve interpolation = AnimationInterpolationCurve::eLinear,
 		AnimationRepeatMode repeat = AnimationRepeatMode::eClamp
-	) : keyframeTimes(keyframeTimes), keyframes(keyframeValues), interpolationCurve(interpolation), repeatMode(repeat) {
-		assert(keyframeTimes.size() > 0);
-		assert(keyframeValues.size() == keyframeTimes.size());
+	) : Animation(std::make_shared<const std::vector<float>>(std::move(keyframeTimes)), std::make_shared<const std::vector<T>>(std::move(keyframeValues)), interpolation, repeat) {};
+	Animation(
+		std::shared_ptr<const std::vector<float>> keyframeTimes,
+		std::shared_ptr<const std::vector<T>> keyframeValues,
+		AnimationInterpolationCurve interpolation = AnimationInterpolationCurve::eLinear,
+		AnimationRepeatMode repeat = AnimationRepeatMode::eClamp
+	) : keyframeTimes(std::move(keyframeTimes)), keyframes(std::move(keyframeValues)), interpolationCurve(interpolation), repeatMode(repeat) {
+		assert(this->keyframeTimes->size() > 0);
+		assert(this->keyframes->size() >= this->keyframeTimes->size());
 
 		std::vector<std::pair<float, size_t>> keyframeIndexes{};
-		for (auto&& [i, t] : iter::enumerate(keyframeTimes) ) {
+		for (auto&& [i, t] : iter::enumerate(*this->keyframeTimes) ) {
 			keyframeIndexes.emplace_back(std::pair{ t, i });
 		}
 
@@ -60,27 +70,29 @@ private:
 	AnimationInterpolationCurve interpolationCurve = AnimationInterpolationCurve::eLinear;
 	AnimationRepeatMode repeatMode = AnimationRepeatMode::eClamp;
 	std::unique_ptr<InterpolationTree<float, size_t>> keyframeIndexTree;
-	std::vector<float> keyframeTimes;
-	std::vector<T> keyframes;
+	std::shared_ptr<const std::vector<float>> keyframeTimes;
+	std::shared_ptr<const std::vector<T>> keyframes;
 };
 
 template<typename T>
 T Animation<T>::valueAt(float t)
 {
-	if (this->keyframes.size() == 1)
-		return this->keyframes.front();
+	const std::vector<float>& keyframeTimes = *this->keyframeTimes;
+	const std::vector<T>& keyframes = *this->keyframes;
+	if (keyframeTimes.size() == 1)
+		return keyframes.front();
 
 	switch (repeatMode) {
 	case AnimationRepeatMode::eClamp:
-		t = std::clamp(t, this->keyframeTimes.front(), this->keyframeTimes.back());
+		t = std::clamp(t, keyframeTimes.front(), keyframeTimes.back());
 		break;
 	case AnimationRepeatMode::eRepeat:
-		t = std::fmodf(t, this->keyframeTimes.back()) + this->keyframeTimes.front();
+		t = std::fmodf(t, keyframeTimes.back()) + keyframeTimes.front();
 		break;
 	case AnimationRepeatMode::eMirror:
 		float nloops;
-		t = std::modff(t/this->keyframeTimes.back(), &nloops);
-		t = (static_cast<int>(nloops) % 2) ? this->keyframeTimes.back() - t : t;
+		t = std::modff(t/keyframeTimes.back(), &nloops);
+		t = (static_cast<int>(nloops) % 2) ? keyframeTimes.back() - t : t;
 	}
 
 	auto [kf0, kf1] = this->keyframeIndexTree->at(t);
@@ -90,10 +102,10 @@ T Animation<T>::valueAt(float t)
 	switch (this->interpolationCurve) {
 	case AnimationInterpolationCurve::eStep:
 	case AnimationInterpolationCurve::eCubicSpline:
-		return (t - t0 < t1 - t) ? this->keyframes[i0] : this->keyframes[i1];
+		return (t - t0 < t1 - t) ? keyframes[i0] : keyframes[i1];
 		break;
 	case AnimationInterpolationCurve::eLinear:
-		return glm::mix(this->keyframes[i0], this->keyframes[i1], t/(t1 - t0));
+		return glm::mix(keyframes[i0], keyframes[i1], t/(t1 - t0));
 		break;
 	}
 }
@@ -0,0 +1,142 @@
+#include "BlockCompression.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+
+// Block layout is a list of sequences:
+//   token (literal length << 4 | (match length - MIN_MATCH)), [literal length extension], literals,
+//   offset (uint16, little endian), [match length extension]
+// A length nibble of 15 is followed by extension bytes that are added to it, 255 meaning another byte follows.
+// The last sequence of a block only holds literals.
+
+namespace {
+	constexpr size_t MIN_MATCH = 4;
+	constexpr size_t MAX_OFFSET = 65535;
+	constexpr uint32_t HASH_BITS = 16;
+
+	uint32_t read32(const byte* p) {
+		uint32_t v;
+		std::memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	uint32_t hash32(uint32_t v) {
+		return (v * 2654435761u) >> (32 - HASH_BITS);
+	}
+
+	void writeLength(std::vector<byte>& dst, size_t length) {
+		while (length >= 255) {
+			dst.push_back(255);
+			length -= 255;
+		}
+		dst.push_back(static_cast<byte>(length));
+	}
+
+	void writeSequence(std::vector<byte>& dst, const byte* literals, size_t literalLength, size_t offset, size_t matchLength) {
+		const size_t matchCode = matchLength >= MIN_MATCH ? matchLength - MIN_MATCH : 0;
+		dst.push_back(static_cast<byte>((std::min<size_t>(literalLength, 15) << 4) | std::min<size_t>(matchCode, 15)));
+		if (literalLength >= 15)
+			writeLength(dst, literalLength - 15);
+
+		dst.insert(dst.end(), literals, literals + literalLength);
+
+		if (matchLength == 0)
+			return;
+
+		dst.push_back(static_cast<byte>(offset & 0xff));
+		dst.push_back(static_cast<byte>(offset >> 8));
+		if (matchCode >= 15)
+			writeLength(dst, matchCode - 15);
+	}
+
+	size_t readLength(const byte*& ip, const byte* end) {
+		size_t length = 0;
+		byte b;
+		do {
+			if (ip >= end)
+				throw std::runtime_error("Truncated compressed block");
+			b = *ip++;
+			length += b;
+		} while (b == 255);
+		return length;
+	}
+}
+
+size_t compressBlock(std::span<const byte> src, std::vector<byte>& dst) {
+	const size_t start = dst.size();
+	const byte* data = src.data();
+	const size_t size = src.size();
+
+	std::vector<uint32_t> table(size_t{ 1 } << HASH_BITS, UINT32_MAX);
+
+	size_t anchor = 0;
+	size_t i = 0;
+	while (i + MIN_MATCH <= size) {
+		const uint32_t sequence = read32(data + i);
+		const uint32_t h = hash32(sequence);
+		const uint32_t candidate = table[h];
+		table[h] = static_cast<uint32_t>(i);
+
+		if (candidate != UINT32_MAX && i - candidate <= MAX_OFFSET && read32(data + candidate) == sequence) {
+			size_t matchLength = MIN_MATCH;
+			while (i + matchLength < size && data[candidate + matchLength] == data[i + matchLength])
+				matchLength++;
+
+			writeSequence(dst, data + anchor, i - anchor, i - candidate, matchLength);
+			i += matchLength;
+			anchor = i;
+		}
+		else
+			i++;
+	}
+
+	writeSequence(dst, data + anchor, size - anchor, 0, 0);
+	return dst.size() - start;
+}
+
+void decompressBlock(std::span<const byte> src, std::span<byte> dst) {
+	const byte* ip = src.data();
+	const byte* const end = ip + src.size();
+	byte* op = dst.data();
+	byte* const dstEnd = op + dst.size();
+
+	while (ip < end) {
+		const byte token = *ip++;
+
+		size_t literalLength = token >> 4;
+		if (literalLength == 15)
+			literalLength += readLength(ip, end);
+		if (literalLength > static_cast<size_t>(end - ip) || literalLength > static_cast<size_t>(dstEnd - op))
+			throw std::runtime_error("Malformed compressed block");
+		std::memcpy(op, ip, literalLength);
+		ip += literalLength;
+		op += literalLength;
+
+		if (ip == end)
+			break;
+
+		if (end - ip < 2)
+			throw std::runtime_error("Truncated compressed block");
+		const size_t offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+		ip += 2;
+
+		size_t matchLength = (token & 15);
+		if (matchLength == 15)
+			matchLength += readLength(ip, end);
+		matchLength += MIN_MATCH;
+
+		if (offset == 0 || offset > static_cast<size_t>(op - dst.data()) || matchLength > static_cast<size_t>(dstEnd - op))
+			throw std::runtime_error("Malformed compressed block");
+
+		// the match may overlap the bytes being written, so copy forward one byte at a time
+		const byte* match = op - offset;
+		for (size_t i = 0; i < matchLength; i++)
+			op[i] = match[i];
+		op += matchLength;
+	}
+
+	if (op != dstEnd)
+		throw std::runtime_error("Compressed block does not match its uncompressed size");
+}
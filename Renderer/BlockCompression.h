@@ -0,0 +1,15 @@
+#pragma once
+
+#include <vector>
+#include <span>
+
+typedef unsigned char byte;
+
+// Small LZ77 block codec in the spirit of LZ4: fast to decode and good enough on vertex and index data.
+// Blocks are independent of each other so they can be compressed and decompressed in parallel.
+
+// Appends the compressed block to dst and returns the number of bytes written
+size_t compressBlock(std::span<const byte> src, std::vector<byte>& dst);
+
+// Decompresses a whole block into dst, which must be exactly the uncompressed size. Throws on malformed input.
+void decompressBlock(std::span<const byte> src, std::span<byte> dst);
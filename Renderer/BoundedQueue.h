@@ -0,0 +1,65 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <optional>
+
+// Multi-producer multi-consumer FIFO with a fixed capacity. push blocks while the queue is full and pop blocks
+// while it is empty, so producers can never run further ahead of the consumers than the capacity allows.
+template<typename T> class BoundedQueue
+{
+	std::deque<T> m_items;
+	size_t m_capacity;
+	bool m_closed = false;
+	std::mutex m_mutex;
+	std::condition_variable m_notFull;
+	std::condition_variable m_notEmpty;
+
+public:
+	explicit BoundedQueue(size_t capacity) : m_capacity(capacity > 0 ? capacity : 1) {};
+	BoundedQueue(const BoundedQueue& other) = delete;
+	BoundedQueue& operator=(const BoundedQueue& other) = delete;
+
+	// returns false if the queue was closed before the item could be pushed
+	bool push(T item) {
+		std::unique_lock lock{ this->m_mutex };
+		this->m_notFull.wait(lock, [this]() { return this->m_closed || this->m_items.size() < this->m_capacity; });
+		if (this->m_closed)
+			return false;
+
+		this->m_items.push_back(std::move(item));
+		lock.unlock();
+		this->m_notEmpty.notify_one();
+		return true;
+	}
+
+	// returns std::nullopt once the queue is closed and drained
+	std::optional<T> pop() {
+		std::unique_lock lock{ this->m_mutex };
+		this->m_notEmpty.wait(lock, [this]() { return this->m_closed || !this->m_items.empty(); });
+		if (this->m_items.empty())
+			return std::nullopt;
+
+		T item = std::move(this->m_items.front());
+		this->m_items.pop_front();
+		lock.unlock();
+		this->m_notFull.notify_one();
+		return item;
+	}
+
+	// only a snapshot, other threads may push or pop right after
+	bool empty() {
+		std::lock_guard lock{ this->m_mutex };
+		return this->m_items.empty();
+	}
+
+	void close() {
+		{
+			std::lock_guard lock{ this->m_mutex };
+			this->m_closed = true;
+		}
+		this->m_notFull.notify_all();
+		this->m_notEmpty.notify_all();
+	}
+};
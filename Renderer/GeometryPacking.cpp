@@ -0,0 +1,109 @@
+#include "GeometryPacking.h"
+
+#include <algorithm>
+#include <cstring>
+#include <tuple>
+
+namespace {
+	constexpr size_t RANGE_ALIGNMENT = 16;
+
+	struct SourceRange {
+		uint32_t buffer;
+		size_t begin;
+		size_t end;
+		size_t packedOffset = 0;
+	};
+
+	size_t attributeRangeSize(const VertexAttributeDescription& attribute) {
+		const size_t elementSize = componentCountFromAttributeContainerType(attribute.containerType) * sizeFromAttributeValueType(attribute.valueType);
+		const size_t stride = attribute.stride > 0 ? static_cast<size_t>(attribute.stride) : elementSize;
+		return attribute.count > 0 ? (attribute.count - 1) * stride + elementSize : 0;
+	}
+
+	size_t indexRangeSize(const IndexBufferDescription& indices) {
+		return indices.count * sizeFromAttributeValueType(indices.indexType);
+	}
+}
+
+void packSceneGeometry(SceneData& scene) {
+	std::vector<SourceRange> ranges;
+	for (const auto& primitives : scene.meshes) {
+		for (const auto& primitive : primitives) {
+			for (const auto& attribute : primitive.attributes)
+				ranges.push_back(SourceRange{ static_cast<uint32_t>(attribute.buffer), attribute.offset, attribute.offset + attributeRangeSize(attribute) });
+			if (primitive.isIndexed)
+				ranges.push_back(SourceRange{ static_cast<uint32_t>(primitive.indices.buffer), primitive.indices.offset, primitive.indices.offset + indexRangeSize(primitive.indices) });
+		}
+	}
+
+	std::sort(ranges.begin(), ranges.end(), [](const SourceRange& a, const SourceRange& b) { return std::tie(a.buffer, a.begin) < std::tie(b.buffer, b.begin); });
+
+	std::vector<SourceRange> merged;
+	for (const auto& range : ranges) {
+		if (!merged.empty() && merged.back().buffer == range.buffer && range.begin <= merged.back().end)
+			merged.back().end = std::max(merged.back().end, range.end);
+		else
+			merged.push_back(range);
+	}
+
+	// a range lands at the same offset modulo RANGE_ALIGNMENT it had in its source, so whatever alignment its
+	// attributes had is kept
+	size_t packedSize = 0;
+	for (auto& range : merged) {
+		const size_t alignedSize = (packedSize + RANGE_ALIGNMENT - 1) / RANGE_ALIGNMENT * RANGE_ALIGNMENT;
+		range.packedOffset = alignedSize + range.begin % RANGE_ALIGNMENT;
+		packedSize = range.packedOffset + (range.end - range.begin);
+	}
+
+	std::vector<byte> packed(packedSize, 0);
+	for (const auto& range : merged)
+		std::memcpy(packed.data() + range.packedOffset, scene.buffers[range.buffer].data() + range.begin, range.end - range.begin);
+
+	// only textures still read the source buffers once the geometry moved out
+	std::vector<int32_t> bufferRemap(scene.buffers.size(), -1);
+	std::vector<std::span<const byte>> buffers;
+	for (auto& texture : scene.textures) {
+		if (texture.buffer < 0)
+			continue;
+		if (bufferRemap[texture.buffer] < 0) {
+			bufferRemap[texture.buffer] = static_cast<int32_t>(buffers.size());
+			buffers.push_back(scene.buffers[texture.buffer]);
+		}
+		texture.buffer = bufferRemap[texture.buffer];
+	}
+
+	const Buffer packedBuffer{ static_cast<uint32_t>(buffers.size()) };
+	auto packedOffset = [&merged](Buffer buffer, size_t offset) {
+		const auto range = std::upper_bound(merged.begin(), merged.end(), std::make_pair(static_cast<uint32_t>(buffer), offset), [](const std::pair<uint32_t, size_t>& key, const SourceRange& range) {
+			return key < std::make_pair(range.buffer, range.begin);
+		}) - 1;
+		return range->packedOffset + (offset - range->begin);
+	};
+
+	for (auto& primitives : scene.meshes) {
+		for (auto& primitive : primitives) {
+			for (auto& attribute : primitive.attributes) {
+				attribute.offset = packedOffset(attribute.buffer, attribute.offset);
+				attribute.buffer = packedBuffer;
+			}
+			if (primitive.isIndexed) {
+				primitive.indices.offset = packedOffset(primitive.indices.buffer, primitive.indices.offset);
+				primitive.indices.buffer = packedBuffer;
+			}
+		}
+	}
+
+	std::vector<std::vector<byte>> ownedBuffers;
+	for (auto& owned : scene.ownedBuffers) {
+		const bool isReferenced = std::any_of(buffers.begin(), buffers.end(), [&owned](const std::span<const byte>& buffer) {
+			return buffer.data() >= owned.data() && buffer.data() < owned.data() + owned.size();
+		});
+		if (isReferenced)
+			ownedBuffers.push_back(std::move(owned));
+	}
+
+	buffers.push_back(std::span<const byte>{ packed });
+	ownedBuffers.push_back(std::move(packed));
+	scene.buffers = std::move(buffers);
+	scene.ownedBuffers = std::move(ownedBuffers);
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "SceneData.h"
+
+// Copies the byte ranges read by vertex attributes and indices into a single new buffer and points the primitives
+// at it. Overlapping ranges, like the attributes of an interleaved bufferView, are copied once, and every range keeps
+// its alignment. Buffers nothing references afterwards are dropped from the scene and their owned storage freed, so
+// embedded images and animation data no longer travel with the geometry. Buffers holding images are kept.
+void packSceneGeometry(SceneData& scene);
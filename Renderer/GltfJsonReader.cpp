@@ -0,0 +1,411 @@
+#include "GltfJsonReader.h"
+
+#include <limits>
+#include <stdexcept>
+
+namespace {
+	using json = nlohmann::json;
+
+	tinygltf::Value toValue(const json& value) {
+		switch (value.type()) {
+		case json::value_t::boolean:
+			return tinygltf::Value(value.get<bool>());
+		case json::value_t::number_integer:
+		case json::value_t::number_unsigned: {
+			// offsets into large buffers don't fit the int that tinygltf values hold
+			const int64_t integer = value.get<int64_t>();
+			if (integer >= std::numeric_limits<int>::min() && integer <= std::numeric_limits<int>::max())
+				return tinygltf::Value(static_cast<int>(integer));
+			return tinygltf::Value(static_cast<double>(integer));
+		}
+		case json::value_t::number_float:
+			return tinygltf::Value(value.get<double>());
+		case json::value_t::string:
+			return tinygltf::Value(value.get<std::string>());
+		case json::value_t::array: {
+			tinygltf::Value::Array array;
+			array.reserve(value.size());
+			for (const auto& element : value)
+				array.push_back(toValue(element));
+			return tinygltf::Value(std::move(array));
+		}
+		case json::value_t::object: {
+			tinygltf::Value::Object object;
+			for (const auto& [key, element] : value.items())
+				object.emplace(key, toValue(element));
+			return tinygltf::Value(std::move(object));
+		}
+		default:
+			return tinygltf::Value();
+		}
+	}
+
+	tinygltf::ExtensionMap readExtensions(const json& value) {
+		tinygltf::ExtensionMap extensions;
+		const auto found = value.find("extensions");
+		if (found != value.end() && found->is_object()) {
+			for (const auto& [name, extension] : found->items())
+				extensions.emplace(name, toValue(extension));
+		}
+		return extensions;
+	}
+
+	template<typename T> std::vector<T> readArray(const json& value, const char* name) {
+		const auto found = value.find(name);
+		if (found == value.end())
+			return {};
+		return found->get<std::vector<T>>();
+	}
+
+	int accessorTypeFromString(const std::string& type) {
+		if (type == "SCALAR")
+			return TINYGLTF_TYPE_SCALAR;
+		if (type == "VEC2")
+			return TINYGLTF_TYPE_VEC2;
+		if (type == "VEC3")
+			return TINYGLTF_TYPE_VEC3;
+		if (type == "VEC4")
+			return TINYGLTF_TYPE_VEC4;
+		if (type == "MAT2")
+			return TINYGLTF_TYPE_MAT2;
+		if (type == "MAT3")
+			return TINYGLTF_TYPE_MAT3;
+		if (type == "MAT4")
+			return TINYGLTF_TYPE_MAT4;
+		throw std::runtime_error("Unknown glTF accessor type " + type);
+	}
+
+	template<typename T> void readTextureInfo(const json& value, const char* name, T& textureInfo) {
+		const auto found = value.find(name);
+		if (found == value.end())
+			return;
+		textureInfo.index = found->value("index", -1);
+		textureInfo.texCoord = found->value("texCoord", 0);
+		textureInfo.extensions = readExtensions(*found);
+	}
+
+	tinygltf::Accessor readAccessor(const json& value) {
+		tinygltf::Accessor accessor;
+		accessor.bufferView = value.value("bufferView", -1);
+		accessor.byteOffset = value.value("byteOffset", size_t{ 0 });
+		accessor.componentType = value.at("componentType").get<int>();
+		accessor.normalized = value.value("normalized", false);
+		accessor.count = value.at("count").get<size_t>();
+		accessor.type = accessorTypeFromString(value.at("type").get<std::string>());
+		accessor.minValues = readArray<double>(value, "min");
+		accessor.maxValues = readArray<double>(value, "max");
+		accessor.extensions = readExtensions(value);
+		return accessor;
+	}
+
+	tinygltf::Animation readAnimation(const json& value) {
+		tinygltf::Animation animation;
+		animation.name = value.value("name", std::string{});
+		for (const auto& channelValue : value.at("channels")) {
+			tinygltf::AnimationChannel& channel = animation.channels.emplace_back();
+			channel.sampler = channelValue.at("sampler").get<int>();
+			const json& target = channelValue.at("target");
+			channel.target_node = target.value("node", -1);
+			channel.target_path = target.at("path").get<std::string>();
+		}
+		for (const auto& samplerValue : value.at("samplers")) {
+			tinygltf::AnimationSampler& sampler = animation.samplers.emplace_back();
+			sampler.input = samplerValue.at("input").get<int>();
+			sampler.output = samplerValue.at("output").get<int>();
+			sampler.interpolation = samplerValue.value("interpolation", std::string{ "LINEAR" });
+		}
+		return animation;
+	}
+
+	tinygltf::BufferView readBufferView(const json& value) {
+		tinygltf::BufferView bufferView;
+		bufferView.buffer = value.at("buffer").get<int>();
+		bufferView.byteOffset = value.value("byteOffset", size_t{ 0 });
+		bufferView.byteLength = value.at("byteLength").get<size_t>();
+		bufferView.byteStride = value.value("byteStride", size_t{ 0 });
+		bufferView.target = value.value("target", 0);
+		bufferView.extensions = readExtensions(value);
+		return bufferView;
+	}
+
+	tinygltf::Image readImage(const json& value) {
+		tinygltf::Image image;
+		image.name = value.value("name", std::string{});
+		image.uri = value.value("uri", std::string{});
+		image.bufferView = value.value("bufferView", -1);
+		image.mimeType = value.value("mimeType", std::string{});
+		image.extensions = readExtensions(value);
+		return image;
+	}
+
+	tinygltf::Material readMaterial(const json& value) {
+		tinygltf::Material material;
+		material.name = value.value("name", std::string{});
+		material.emissiveFactor = value.contains("emissiveFactor") ? readArray<double>(value, "emissiveFactor") : std::vector<double>{ 0.0, 0.0, 0.0 };
+		material.alphaMode = value.value("alphaMode", std::string{ "OPAQUE" });
+		material.alphaCutoff = value.value("alphaCutoff", 0.5);
+		material.doubleSided = value.value("doubleSided", false);
+
+		if (const auto pbr = value.find("pbrMetallicRoughness"); pbr != value.end()) {
+			if (pbr->contains("baseColorFactor"))
+				material.pbrMetallicRoughness.baseColorFactor = readArray<double>(*pbr, "baseColorFactor");
+			material.pbrMetallicRoughness.metallicFactor = pbr->value("metallicFactor", 1.0);
+			material.pbrMetallicRoughness.roughnessFactor = pbr->value("roughnessFactor", 1.0);
+			readTextureInfo(*pbr, "baseColorTexture", material.pbrMetallicRoughness.baseColorTexture);
+			readTextureInfo(*pbr, "metallicRoughnessTexture", material.pbrMetallicRoughness.metallicRoughnessTexture);
+		}
+
+		readTextureInfo(value, "normalTexture", material.normalTexture);
+		if (const auto normal = value.find("normalTexture"); normal != value.end())
+			material.normalTexture.scale = normal->value("scale", 1.0);
+		readTextureInfo(value, "occlusionTexture", material.occlusionTexture);
+		if (const auto occlusion = value.find("occlusionTexture"); occlusion != value.end())
+			material.occlusionTexture.strength = occlusion->value("strength", 1.0);
+		readTextureInfo(value, "emissiveTexture", material.emissiveTexture);
+
+		material.extensions = readExtensions(value);
+		return material;
+	}
+
+	tinygltf::Mesh readMesh(const json& value) {
+		tinygltf::Mesh mesh;
+		mesh.name = value.value("name", std::string{});
+		for (const auto& primitiveValue : value.at("primitives")) {
+			tinygltf::Primitive& primitive = mesh.primitives.emplace_back();
+			for (const auto& [name, accessor] : primitiveValue.at("attributes").items())
+				primitive.attributes.emplace(name, accessor.get<int>());
+			primitive.indices = primitiveValue.value("indices", -1);
+			primitive.material = primitiveValue.value("material", -1);
+			primitive.mode = primitiveValue.value("mode", TINYGLTF_MODE_TRIANGLES);
+			primitive.extensions = readExtensions(primitiveValue);
+		}
+		mesh.weights = readArray<double>(value, "weights");
+		return mesh;
+	}
+
+	tinygltf::Node readNode(const json& value) {
+		tinygltf::Node node;
+		node.name = value.value("name", std::string{});
+		node.mesh = value.value("mesh", -1);
+		node.skin = value.value("skin", -1);
+		node.camera = value.value("camera", -1);
+		node.children = readArray<int>(value, "children");
+		node.matrix = readArray<double>(value, "matrix");
+		node.translation = readArray<double>(value, "translation");
+		node.rotation = readArray<double>(value, "rotation");
+		node.scale = readArray<double>(value, "scale");
+		node.weights = readArray<double>(value, "weights");
+		node.extensions = readExtensions(value);
+		return node;
+	}
+
+	tinygltf::Sampler readSampler(const json& value) {
+		tinygltf::Sampler sampler;
+		sampler.magFilter = value.value("magFilter", -1);
+		sampler.minFilter = value.value("minFilter", -1);
+		sampler.wrapS = value.value("wrapS", TINYGLTF_TEXTURE_WRAP_REPEAT);
+		sampler.wrapT = value.value("wrapT", TINYGLTF_TEXTURE_WRAP_REPEAT);
+		return sampler;
+	}
+
+	tinygltf::Scene readScene(const json& value) {
+		tinygltf::Scene scene;
+		scene.name = value.value("name", std::string{});
+		scene.nodes = readArray<int>(value, "nodes");
+		return scene;
+	}
+
+	tinygltf::Texture readTexture(const json& value) {
+		tinygltf::Texture texture;
+		texture.sampler = value.value("sampler", -1);
+		texture.source = value.value("source", -1);
+		texture.extensions = readExtensions(value);
+		return texture;
+	}
+
+	// Tracks where the parser is in the document. Outside of an element nothing is kept but the name of the current
+	// top-level section. Inside one, values are added to the element under construction, which is handed to
+	// addElement and dropped when its last container closes.
+	class GltfSaxHandler : public nlohmann::json_sax<json> {
+	public:
+		GltfSaxHandler(tinygltf::Model& model, std::vector<size_t>& bufferByteLengths) : m_model(model), m_bufferByteLengths(bufferByteLengths) {}
+
+		bool null() override { return this->addValue(json{}); }
+		bool boolean(bool value) override { return this->addValue(json(value)); }
+		bool number_integer(number_integer_t value) override { return this->addValue(json(value)); }
+		bool number_unsigned(number_unsigned_t value) override { return this->addValue(json(value)); }
+		bool number_float(number_float_t value, const string_t&) override { return this->addValue(json(value)); }
+		bool string(string_t& value) override { return this->addValue(json(std::move(value))); }
+		bool binary(binary_t&) override { throw std::runtime_error("Unexpected binary value in glTF JSON"); }
+
+		bool start_object(size_t) override { return this->startContainer(json::object()); }
+		bool start_array(size_t) override { return this->startContainer(json::array()); }
+		bool end_object() override { return this->endContainer(); }
+		bool end_array() override { return this->endContainer(); }
+
+		bool key(string_t& key) override {
+			if (!this->m_open.empty())
+				this->m_key = std::move(key);
+			else
+				this->m_section = std::move(key);
+			return true;
+		}
+
+		bool parse_error(size_t position, const std::string&, const nlohmann::detail::exception& e) override {
+			throw std::runtime_error("Invalid glTF JSON at byte " + std::to_string(position) + ": " + e.what());
+		}
+
+	private:
+		tinygltf::Model& m_model;
+		std::vector<size_t>& m_bufferByteLengths;
+
+		// containers outside of any element: the root object and the array of the current section
+		size_t m_depth = 0;
+		std::string m_section;
+
+		json m_element;
+		// containers of the element that are still open, innermost last
+		std::vector<json*> m_open;
+		std::string m_key;
+
+		// elements are the values of top-level keys, or the items of top-level arrays
+		bool addValue(json&& value) {
+			if (this->m_open.empty()) {
+				if (this->m_depth >= 1)
+					this->addElement(std::move(value));
+				return true;
+			}
+
+			json& container = *this->m_open.back();
+			if (container.is_array())
+				container.push_back(std::move(value));
+			else
+				container[this->m_key] = std::move(value);
+			return true;
+		}
+
+		bool startContainer(json&& container) {
+			if (this->m_depth == 0) {
+				this->m_depth = 1;
+				return true;
+			}
+			// top-level arrays are streamed item by item
+			if (this->m_depth == 1 && this->m_open.empty() && container.is_array()) {
+				this->m_depth = 2;
+				return true;
+			}
+
+			if (this->m_open.empty()) {
+				this->m_element = std::move(container);
+				this->m_open.push_back(&this->m_element);
+				return true;
+			}
+
+			json& parent = *this->m_open.back();
+			if (parent.is_array()) {
+				parent.push_back(std::move(container));
+				this->m_open.push_back(&parent.back());
+			}
+			else
+				this->m_open.push_back(&(parent[this->m_key] = std::move(container)));
+			return true;
+		}
+
+		bool endContainer() {
+			if (this->m_open.empty()) {
+				this->m_depth--;
+				return true;
+			}
+
+			this->m_open.pop_back();
+			if (this->m_open.empty()) {
+				this->addElement(std::move(this->m_element));
+				this->m_element = json{};
+			}
+			return true;
+		}
+
+		void addElement(json&& element) {
+			const std::string& section = this->m_section;
+			tinygltf::Model& model = this->m_model;
+
+			if (section == "accessors")
+				model.accessors.push_back(readAccessor(element));
+			else if (section == "animations")
+				model.animations.push_back(readAnimation(element));
+			else if (section == "buffers") {
+				tinygltf::Buffer& buffer = model.buffers.emplace_back();
+				buffer.uri = element.value("uri", std::string{});
+				buffer.extensions = readExtensions(element);
+				this->m_bufferByteLengths.push_back(element.at("byteLength").get<size_t>());
+			}
+			else if (section == "bufferViews")
+				model.bufferViews.push_back(readBufferView(element));
+			else if (section == "images")
+				model.images.push_back(readImage(element));
+			else if (section == "materials")
+				model.materials.push_back(readMaterial(element));
+			else if (section == "meshes")
+				model.meshes.push_back(readMesh(element));
+			else if (section == "nodes")
+				model.nodes.push_back(readNode(element));
+			else if (section == "samplers")
+				model.samplers.push_back(readSampler(element));
+			else if (section == "scenes")
+				model.scenes.push_back(readScene(element));
+			else if (section == "textures")
+				model.textures.push_back(readTexture(element));
+			else if (section == "scene")
+				model.defaultScene = element.get<int>();
+			else if (section == "extensionsUsed")
+				model.extensionsUsed.push_back(element.get<std::string>());
+			else if (section == "extensionsRequired")
+				model.extensionsRequired.push_back(element.get<std::string>());
+		}
+	};
+}
+
+void readGltfJson(std::span<const byte> json, tinygltf::Model& model, std::vector<size_t>& bufferByteLengths) {
+	GltfSaxHandler handler{ model, bufferByteLengths };
+	nlohmann::json::sax_parse(json.begin(), json.end(), &handler);
+
+	if (model.scenes.empty())
+		throw std::runtime_error("glTF asset has no scenes");
+}
+
+std::vector<byte> decodeDataUri(const std::string& uri) {
+	const size_t dataStart = uri.find(";base64,");
+	if (uri.rfind("data:", 0) != 0 || dataStart == std::string::npos)
+		throw std::runtime_error("Only base64 data URIs are supported");
+
+	auto sextet = [](char c) -> int {
+		if (c >= 'A' && c <= 'Z')
+			return c - 'A';
+		if (c >= 'a' && c <= 'z')
+			return c - 'a' + 26;
+		if (c >= '0' && c <= '9')
+			return c - '0' + 52;
+		if (c == '+' || c == '-')
+			return 62;
+		if (c == '/' || c == '_')
+			return 63;
+		return -1;
+	};
+
+	std::vector<byte> data;
+	data.reserve((uri.size() - dataStart) / 4 * 3);
+	uint32_t bits = 0;
+	int bitCount = 0;
+	for (size_t i = dataStart + 8; i < uri.size() && uri[i] != '='; i++) {
+		const int value = sextet(uri[i]);
+		if (value < 0)
+			throw std::runtime_error("Invalid character in base64 data URI");
+		bits = (bits << 6) | static_cast<uint32_t>(value);
+		bitCount += 6;
+		if (bitCount >= 8) {
+			bitCount -= 8;
+			data.push_back(static_cast<byte>(bits >> bitCount));
+		}
+	}
+	return data;
+}
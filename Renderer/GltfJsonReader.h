@@ -0,0 +1,20 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <vector>
+
+#include <tiny_gltf.h>
+
+typedef unsigned char byte;
+
+// Streams the JSON of a glTF asset into a tinygltf::Model with a SAX parser, without a document of the whole file.
+// Only one element of a top-level array (a node, an accessor, a material...) is held as JSON at a time, and it is
+// converted into the model as soon as it is complete. The input can be a mapped file.
+//
+// Buffers only get their uri and extensions, bufferByteLengths receives their declared sizes. Loading buffer data is
+// up to the caller, and so is loading images.
+void readGltfJson(std::span<const byte> json, tinygltf::Model& model, std::vector<size_t>& bufferByteLengths);
+
+// Decodes a base64 data URI
+std::vector<byte> decodeDataUri(const std::string& uri);
@@ -3,6 +3,7 @@
 template <class keyT, int uniqueID> class Handle {
 	keyT m_key = ~(keyT());
 public:
+	Handle() {}
 	explicit Handle(keyT key) : m_key(key) {}
 	using key_type = keyT;
 	
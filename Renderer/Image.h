@@ -1,5 +1,9 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+
 #include "Handle.h"
 
 enum class ImageFormat {
@@ -11,6 +15,64 @@ enum class ImageFormat {
 	eR16G16B16A16Sfloat,
 	eR32G32B32Sfloat,
 	eR32G32B32A32Sfloat,
+	eBC1RGBUnorm,
+	eBC1RGBSrgb,
+	eBC1RGBAUnorm,
+	eBC1RGBASrgb,
+	eBC3Unorm,
+	eBC3Srgb,
+	eBC4Unorm,
+	eBC4Snorm,
+	eBC5Unorm,
+	eBC5Snorm,
+	eBC6HUfloat,
+	eBC6HSfloat,
+	eBC7Unorm,
+	eBC7Srgb,
+};
+
+constexpr bool isBlockCompressed(const ImageFormat imageFormat) {
+	return imageFormat >= ImageFormat::eBC1RGBUnorm && imageFormat <= ImageFormat::eBC7Srgb;
+}
+
+// Bytes a texel takes on the device, block compressed formats take a share of their 4x4 block
+constexpr float bytesPerTexel(const ImageFormat imageFormat) {
+	switch (imageFormat) {
+	case ImageFormat::eR8G8B8Unorm:
+	case ImageFormat::eR8G8B8Srgb:
+	case ImageFormat::eR8G8B8A8Unorm:
+	case ImageFormat::eR8G8B8A8Srgb:
+		return 4.0f;
+	case ImageFormat::eR16G16B16Sfloat:
+	case ImageFormat::eR16G16B16A16Sfloat:
+		return 8.0f;
+	case ImageFormat::eR32G32B32Sfloat:
+	case ImageFormat::eR32G32B32A32Sfloat:
+		return 16.0f;
+	case ImageFormat::eBC1RGBUnorm:
+	case ImageFormat::eBC1RGBSrgb:
+	case ImageFormat::eBC1RGBAUnorm:
+	case ImageFormat::eBC1RGBASrgb:
+	case ImageFormat::eBC4Unorm:
+	case ImageFormat::eBC4Snorm:
+		return 0.5f;
+	default:
+		return 1.0f;
+	}
+}
+
+// How many times an image is halved for its largest side to fit in maxSize
+constexpr uint32_t mipLevelsAbove(const uint32_t width, const uint32_t height, const uint32_t maxSize) {
+	uint32_t levels = 0;
+	while ((std::max(width, height) >> levels) > std::max(maxSize, 1u))
+		levels++;
+	return levels;
+}
+
+// A mip level stored in a buffer, levels are ordered from the largest (level 0) to the smallest
+struct ImageLevel {
+	size_t offset;
+	size_t size;
 };
 
 typedef Handle<uint32_t, __COUNTER__> Image;
@@ -0,0 +1,157 @@
+#include "Ktx2.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace {
+	constexpr byte KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+	struct Ktx2Header {
+		byte identifier[12];
+		uint32_t vkFormat;
+		uint32_t typeSize;
+		uint32_t pixelWidth;
+		uint32_t pixelHeight;
+		uint32_t pixelDepth;
+		uint32_t layerCount;
+		uint32_t faceCount;
+		uint32_t levelCount;
+		uint32_t supercompressionScheme;
+		uint32_t dfdByteOffset;
+		uint32_t dfdByteLength;
+		uint32_t kvdByteOffset;
+		uint32_t kvdByteLength;
+		uint64_t sgdByteOffset;
+		uint64_t sgdByteLength;
+	};
+	static_assert(sizeof(Ktx2Header) == 80);
+
+	struct Ktx2LevelIndex {
+		uint64_t byteOffset;
+		uint64_t byteLength;
+		uint64_t uncompressedByteLength;
+	};
+
+	// VkFormat values, so this file doesn't need the Vulkan headers
+	std::optional<ImageFormat> imageFormatFromVkFormat(const uint32_t vkFormat) {
+		switch (vkFormat) {
+		case 23: return ImageFormat::eR8G8B8Unorm;
+		case 29: return ImageFormat::eR8G8B8Srgb;
+		case 37: return ImageFormat::eR8G8B8A8Unorm;
+		case 43: return ImageFormat::eR8G8B8A8Srgb;
+		case 90: return ImageFormat::eR16G16B16Sfloat;
+		case 97: return ImageFormat::eR16G16B16A16Sfloat;
+		case 106: return ImageFormat::eR32G32B32Sfloat;
+		case 109: return ImageFormat::eR32G32B32A32Sfloat;
+		case 131: return ImageFormat::eBC1RGBUnorm;
+		case 132: return ImageFormat::eBC1RGBSrgb;
+		case 133: return ImageFormat::eBC1RGBAUnorm;
+		case 134: return ImageFormat::eBC1RGBASrgb;
+		case 137: return ImageFormat::eBC3Unorm;
+		case 138: return ImageFormat::eBC3Srgb;
+		case 139: return ImageFormat::eBC4Unorm;
+		case 140: return ImageFormat::eBC4Snorm;
+		case 141: return ImageFormat::eBC5Unorm;
+		case 142: return ImageFormat::eBC5Snorm;
+		case 143: return ImageFormat::eBC6HUfloat;
+		case 144: return ImageFormat::eBC6HSfloat;
+		case 145: return ImageFormat::eBC7Unorm;
+		case 146: return ImageFormat::eBC7Srgb;
+		default:
+			return std::nullopt;
+		}
+	}
+
+	size_t levelSize(const ImageFormat format, const uint32_t width, const uint32_t height) {
+		switch (format) {
+		case ImageFormat::eBC1RGBUnorm:
+		case ImageFormat::eBC1RGBSrgb:
+		case ImageFormat::eBC1RGBAUnorm:
+		case ImageFormat::eBC1RGBASrgb:
+		case ImageFormat::eBC4Unorm:
+		case ImageFormat::eBC4Snorm:
+			return size_t{ (width + 3) / 4 } * ((height + 3) / 4) * 8;
+		case ImageFormat::eBC3Unorm:
+		case ImageFormat::eBC3Srgb:
+		case ImageFormat::eBC5Unorm:
+		case ImageFormat::eBC5Snorm:
+		case ImageFormat::eBC6HUfloat:
+		case ImageFormat::eBC6HSfloat:
+		case ImageFormat::eBC7Unorm:
+		case ImageFormat::eBC7Srgb:
+			return size_t{ (width + 3) / 4 } * ((height + 3) / 4) * 16;
+		case ImageFormat::eR8G8B8Unorm:
+		case ImageFormat::eR8G8B8Srgb:
+			return size_t{ width } * height * 3;
+		case ImageFormat::eR8G8B8A8Unorm:
+		case ImageFormat::eR8G8B8A8Srgb:
+			return size_t{ width } * height * 4;
+		case ImageFormat::eR16G16B16Sfloat:
+			return size_t{ width } * height * 6;
+		case ImageFormat::eR16G16B16A16Sfloat:
+			return size_t{ width } * height * 8;
+		case ImageFormat::eR32G32B32Sfloat:
+			return size_t{ width } * height * 12;
+		case ImageFormat::eR32G32B32A32Sfloat:
+			return size_t{ width } * height * 16;
+		}
+		return 0;
+	}
+}
+
+bool isKtx2(std::span<const byte> data) {
+	return data.size() >= sizeof(KTX2_IDENTIFIER) && std::memcmp(data.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0;
+}
+
+bool isKtx2Uploadable(std::span<const byte> data) {
+	if (!isKtx2(data) || data.size() < sizeof(Ktx2Header))
+		return false;
+
+	Ktx2Header header;
+	std::memcpy(&header, data.data(), sizeof(header));
+	return header.supercompressionScheme == 0 && header.pixelHeight != 0 && header.pixelDepth <= 1 && header.layerCount <= 1 && header.faceCount == 1 && imageFormatFromVkFormat(header.vkFormat).has_value();
+}
+
+Ktx2Image readKtx2(std::span<const byte> data) {
+	if (!isKtx2(data) || data.size() < sizeof(Ktx2Header))
+		throw std::runtime_error("Not a KTX2 file");
+
+	Ktx2Header header;
+	std::memcpy(&header, data.data(), sizeof(header));
+
+	if (header.supercompressionScheme != 0)
+		throw std::runtime_error("Supercompressed KTX2 files are not supported");
+	if (header.pixelHeight == 0 || header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1)
+		throw std::runtime_error("Only single 2D images are supported in KTX2 files");
+
+	const std::optional<ImageFormat> format = imageFormatFromVkFormat(header.vkFormat);
+	if (!format)
+		throw std::runtime_error("Unsupported KTX2 format " + std::to_string(header.vkFormat));
+
+	Ktx2Image image{};
+	image.width = header.pixelWidth;
+	image.height = header.pixelHeight;
+	image.format = *format;
+
+	// a level count of 0 asks for the mip chain to be generated at load
+	const uint32_t levelCount = std::max(header.levelCount, 1u);
+	if (sizeof(Ktx2Header) + levelCount * sizeof(Ktx2LevelIndex) > data.size())
+		throw std::runtime_error("Truncated KTX2 level index");
+
+	image.levels.reserve(levelCount);
+	for (uint32_t i = 0; i < levelCount; i++) {
+		Ktx2LevelIndex level;
+		std::memcpy(&level, data.data() + sizeof(Ktx2Header) + i * sizeof(Ktx2LevelIndex), sizeof(level));
+
+		const uint32_t width = std::max(image.width >> i, 1u);
+		const uint32_t height = std::max(image.height >> i, 1u);
+		if (level.byteOffset + level.byteLength > data.size() || level.byteLength < levelSize(image.format, width, height))
+			throw std::runtime_error("Malformed KTX2 level " + std::to_string(i));
+
+		image.levels.push_back(ImageLevel{ static_cast<size_t>(level.byteOffset), static_cast<size_t>(level.byteLength) });
+	}
+
+	return image;
+}
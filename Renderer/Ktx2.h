@@ -0,0 +1,26 @@
+#pragma once
+
+#include <vector>
+#include <span>
+#include <optional>
+
+#include "Image.h"
+
+typedef unsigned char byte;
+
+struct Ktx2Image {
+	uint32_t width;
+	uint32_t height;
+	ImageFormat format;
+	// level offsets are relative to the start of the container
+	std::vector<ImageLevel> levels;
+};
+
+bool isKtx2(std::span<const byte> data);
+// Whether readKtx2 takes the container, from its header alone. BasisLZ and UASTC containers, which store no format
+// or are supercompressed, need transcoding and aren't taken.
+bool isKtx2Uploadable(std::span<const byte> data);
+
+// Reads the header and level index of a KTX2 container holding a single 2D image. Only containers without
+// supercompression and with a format that maps to an ImageFormat are supported, anything else throws.
+Ktx2Image readKtx2(std::span<const byte> data);
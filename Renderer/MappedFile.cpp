@@ -0,0 +1,115 @@
+#include "MappedFile.h"
+
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& path) {
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		throw std::runtime_error("Could not open file " + path);
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize)) {
+		CloseHandle(file);
+		throw std::runtime_error("Could not read size of file " + path);
+	}
+	this->m_fileHandle = file;
+	this->m_size = static_cast<size_t>(fileSize.QuadPart);
+
+	// zero-length files cannot be mapped, leave the view empty
+	if (this->m_size == 0)
+		return;
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr) {
+		this->close();
+		throw std::runtime_error("Could not map file " + path);
+	}
+	this->m_mappingHandle = mapping;
+
+	this->m_data = reinterpret_cast<const byte*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (this->m_data == nullptr) {
+		this->close();
+		throw std::runtime_error("Could not map file " + path);
+	}
+#else
+	this->m_fd = ::open(path.c_str(), O_RDONLY);
+	if (this->m_fd < 0)
+		throw std::runtime_error("Could not open file " + path);
+
+	struct stat st;
+	if (fstat(this->m_fd, &st) != 0) {
+		this->close();
+		throw std::runtime_error("Could not read size of file " + path);
+	}
+	this->m_size = static_cast<size_t>(st.st_size);
+
+	if (this->m_size == 0)
+		return;
+
+	void* p = mmap(nullptr, this->m_size, PROT_READ, MAP_PRIVATE, this->m_fd, 0);
+	if (p == MAP_FAILED) {
+		this->close();
+		throw std::runtime_error("Could not map file " + path);
+	}
+	madvise(p, this->m_size, MADV_SEQUENTIAL);
+	this->m_data = reinterpret_cast<const byte*>(p);
+#endif
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+	*this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+	if (this == &other)
+		return *this;
+
+	this->close();
+	this->m_data = std::exchange(other.m_data, nullptr);
+	this->m_size = std::exchange(other.m_size, 0);
+#ifdef _WIN32
+	this->m_fileHandle = std::exchange(other.m_fileHandle, nullptr);
+	this->m_mappingHandle = std::exchange(other.m_mappingHandle, nullptr);
+#else
+	this->m_fd = std::exchange(other.m_fd, -1);
+#endif
+	return *this;
+}
+
+MappedFile::~MappedFile() {
+	this->close();
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+	if (this->m_data != nullptr)
+		UnmapViewOfFile(this->m_data);
+	if (this->m_mappingHandle != nullptr)
+		CloseHandle(this->m_mappingHandle);
+	if (this->m_fileHandle != nullptr)
+		CloseHandle(this->m_fileHandle);
+	this->m_mappingHandle = nullptr;
+	this->m_fileHandle = nullptr;
+#else
+	if (this->m_data != nullptr)
+		munmap(const_cast<byte*>(this->m_data), this->m_size);
+	if (this->m_fd >= 0)
+		::close(this->m_fd);
+	this->m_fd = -1;
+#endif
+	this->m_data = nullptr;
+	this->m_size = 0;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <span>
+
+typedef unsigned char byte;
+
+// Read-only memory mapping of a whole file. The mapping stays valid for the lifetime of the object,
+// so views handed out by span() must not outlive it.
+class MappedFile
+{
+public:
+	MappedFile() {};
+	explicit MappedFile(const std::string& path);
+	MappedFile(const MappedFile& other) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	~MappedFile();
+
+	MappedFile& operator=(const MappedFile& other) = delete;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	const byte* data() const { return this->m_data; }
+	size_t size() const { return this->m_size; }
+	std::span<const byte> span() const { return { this->m_data, this->m_size }; }
+	bool isOpen() const { return this->m_data != nullptr; }
+
+private:
+	const byte* m_data = nullptr;
+	size_t m_size = 0;
+#ifdef _WIN32
+	void* m_fileHandle = nullptr;
+	void* m_mappingHandle = nullptr;
+#else
+	int m_fd = -1;
+#endif
+
+	void close();
+};
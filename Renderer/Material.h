@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include "Handle.h"
+#include "Texture.h"
+
+typedef Handle<uint32_t, __COUNTER__> Material;
+
+enum class AlphaMode : uint32_t {
+	eOpaque,
+	eMask,
+	eBlend,
+};
+
+// Material parameters as they come out of the importer. Textures are indices into the scene's texture table, -1 if unused.
+struct MaterialData {
+	glm::vec4 baseColorFactor{ 1.0f };
+	glm::vec3 emissiveFactor{ 0.0f };
+	float normalScale = 1.0f;
+	float metallicFactor = 1.0f;
+	float roughnessFactor = 1.0f;
+	float occlusionStrength = 1.0f;
+
+	AlphaMode alphaMode = AlphaMode::eOpaque;
+	float alphaCutoff = 0.5f;
+
+	int32_t baseColorTexture = -1;
+	int32_t metallicRoughnessTexture = -1;
+	int32_t normalTexture = -1;
+	int32_t emissiveTexture = -1;
+	int32_t occlusionTexture = -1;
+};
+
+// Renderer textures a material samples. Invalid handles are drawn with a neutral placeholder.
+struct MaterialTextures {
+	Texture baseColor{};
+	Texture metallicRoughness{};
+	Texture normal{};
+	Texture emissive{};
+	Texture occlusion{};
+};
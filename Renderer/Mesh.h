@@ -2,12 +2,19 @@
 
 #include <vector>
 #include <map>
+#include <array>
+#include <string>
+#include <functional>
+#include <memory>
+#include <limits>
 
 #include <glm/vec3.hpp>
 #include <glm/mat4x4.hpp>
+#include <glm/common.hpp>
 
 #include "Buffer.h"
 #include "Node.h"
+#include "Material.h"
 
 enum class AttributeValueType {
 	eInt8,
@@ -51,6 +58,19 @@ enum class AttributeContainerType {
 	eVec4,
 };
 
+constexpr size_t componentCountFromAttributeContainerType(const AttributeContainerType containerType) {
+	switch (containerType) {
+	case AttributeContainerType::eScalar:
+		return 1;
+	case AttributeContainerType::eVec2:
+		return 2;
+	case AttributeContainerType::eVec3:
+		return 3;
+	case AttributeContainerType::eVec4:
+		return 4;
+	}
+}
+
 enum class MeshPrimitiveMode {
 	ePoints,
 	eLines,
@@ -61,6 +81,15 @@ enum class MeshPrimitiveMode {
 	eTriangleFan
 };
 
+// How stored values map back to the attribute, on top of the value type conversion
+enum class AttributeEncoding : uint32_t {
+	eNone,
+	// unit vector as 2 octahedral coordinates, tangents store their handedness in a third component
+	eOctahedral,
+	// position as a fraction of the primitive's bounding box
+	eBoundsRelative,
+};
+
 struct VertexAttributeDescription {
 	std::string attributeName;
 	Buffer buffer;
@@ -69,8 +98,53 @@ struct VertexAttributeDescription {
 	size_t count;
 	AttributeContainerType containerType;
 	AttributeValueType valueType;
+	// integer values are read as [0, 1] or [-1, 1] instead of being converted as is
+	bool normalized = false;
+	AttributeEncoding encoding = AttributeEncoding::eNone;
 };
 
+// Shader input locations of the attributes read by the mesh shaders
+enum class VertexSlot : uint32_t {
+	ePosition,
+	eNormal,
+	eTangent,
+	eTexcoord0,
+};
+
+constexpr size_t VERTEX_SLOT_COUNT = 4;
+constexpr const char* VERTEX_SLOT_ATTRIBUTE_NAMES[VERTEX_SLOT_COUNT] = { "POSITION", "NORMAL", "TANGENT", "TEXCOORD_0" };
+
+struct VertexSlotLayout {
+	bool present = false;
+	AttributeContainerType containerType = AttributeContainerType::eVec3;
+	AttributeValueType valueType = AttributeValueType::eFloat;
+	bool normalized = false;
+	AttributeEncoding encoding = AttributeEncoding::eNone;
+	int32_t stride = 0;
+
+	bool operator==(const VertexSlotLayout&) const = default;
+};
+
+// Formats of the attributes a primitive feeds the mesh shaders. The renderer keeps one set of pipelines per layout.
+struct VertexLayout {
+	std::array<VertexSlotLayout, VERTEX_SLOT_COUNT> slots{};
+
+	bool operator==(const VertexLayout&) const = default;
+};
+
+namespace std {
+	template<> struct hash<VertexLayout> {
+		size_t operator()(const VertexLayout& layout) const {
+			size_t h = 0;
+			for (const auto& slot : layout.slots) {
+				const size_t packed = static_cast<size_t>(slot.present) | static_cast<size_t>(slot.containerType) << 1 | static_cast<size_t>(slot.valueType) << 4 | static_cast<size_t>(slot.normalized) << 8 | static_cast<size_t>(slot.encoding) << 9 | static_cast<size_t>(slot.stride) << 12;
+				h ^= std::hash<size_t>{}(packed) + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+			}
+			return h;
+		}
+	};
+}
+
 struct IndexBufferDescription {
 	Buffer buffer;
 	size_t offset;
@@ -79,12 +153,40 @@ struct IndexBufferDescription {
 	AttributeValueType indexType;
 };
 
+// Transforms of the copies of a primitive placed with EXT_mesh_gpu_instancing, relative to its node. Shared by the
+// primitives of the node.
+struct MeshInstances {
+	std::vector<glm::mat4> transforms;
+	// transforms uploaded as an instance rate vertex buffer, for passes that draw every instance
+	Buffer buffer;
+};
+
 class MeshPrimitive {
 	std::vector<VertexAttributeDescription> m_vertexBufferDescription{};
 	bool m_isIndexed = false;
 	IndexBufferDescription m_indexBufferDescription{};
 	glm::vec<3, double> m_bbMin, m_bbMax;
 	MeshPrimitiveMode m_mode = MeshPrimitiveMode::eTriangles;
+	VertexLayout m_vertexLayout{};
+	std::array<int32_t, VERTEX_SLOT_COUNT> m_slotAttributes{ -1, -1, -1, -1 };
+	std::shared_ptr<Node> m_node{};
+	Material m_material{};
+	std::shared_ptr<const MeshInstances> m_instances{};
+	glm::vec3 m_boundsMin{ 0.0f }, m_boundsMax{ 0.0f };
+
+	void buildVertexLayout() {
+		for (size_t slot = 0; slot < VERTEX_SLOT_COUNT; slot++) {
+			for (size_t i = 0; i < this->m_vertexBufferDescription.size(); i++) {
+				const auto& attribute = this->m_vertexBufferDescription[i];
+				if (attribute.attributeName != VERTEX_SLOT_ATTRIBUTE_NAMES[slot])
+					continue;
+
+				this->m_slotAttributes[slot] = static_cast<int32_t>(i);
+				this->m_vertexLayout.slots[slot] = VertexSlotLayout{ true, attribute.containerType, attribute.valueType, attribute.normalized, attribute.encoding, attribute.stride };
+				break;
+			}
+		}
+	}
 
 public:
 	MeshPrimitive() {};
@@ -93,7 +195,11 @@ public:
 		m_bbMin(_bbMin),
 		m_bbMax(_bbMax),
 		m_mode(_mode)
-	{};
+	{
+		this->buildVertexLayout();
+		this->m_boundsMin = this->bbMin();
+		this->m_boundsMax = this->bbMax();
+	};
 	MeshPrimitive(std::vector<VertexAttributeDescription> _vertexBufferDescription, IndexBufferDescription _indexBufferDescription, glm::vec3 _bbMin, glm::vec3 _bbMax, MeshPrimitiveMode _mode) :
 		m_vertexBufferDescription(_vertexBufferDescription),
 		m_isIndexed(true),
@@ -101,11 +207,71 @@ public:
 		m_bbMin(_bbMin),
 		m_bbMax(_bbMax),
 		m_mode(_mode)
-	{};
+	{
+		this->buildVertexLayout();
+		this->m_boundsMin = this->bbMin();
+		this->m_boundsMax = this->bbMax();
+	};
 
 	const std::vector<VertexAttributeDescription>& vertexBufferDescription() { return this->m_vertexBufferDescription; };
 	const IndexBufferDescription& indexBufferDescription() { return this->m_indexBufferDescription; };
 	const bool isIndexed() { return this->m_isIndexed; };
+
+	const VertexLayout& vertexLayout() const { return this->m_vertexLayout; };
+	// Attribute feeding the slot, nullptr if the primitive doesn't have it
+	const VertexAttributeDescription* slotAttribute(VertexSlot slot) const {
+		const int32_t i = this->m_slotAttributes[static_cast<size_t>(slot)];
+		return i > -1 ? &this->m_vertexBufferDescription[i] : nullptr;
+	};
+
+	// Maps the position read by the vertex shader to object space, as offset + position * scale
+	glm::vec3 positionOffset() const {
+		const auto& position = this->m_vertexLayout.slots[static_cast<size_t>(VertexSlot::ePosition)];
+		return position.encoding == AttributeEncoding::eBoundsRelative ? glm::vec3(this->m_bbMin) : glm::vec3{ 0.0f };
+	};
+	glm::vec3 positionScale() const {
+		const auto& position = this->m_vertexLayout.slots[static_cast<size_t>(VertexSlot::ePosition)];
+		return position.encoding == AttributeEncoding::eBoundsRelative ? glm::vec3(this->m_bbMax - this->m_bbMin) : glm::vec3{ 1.0f };
+	};
+
+	glm::vec3 bbMin() const { return this->m_bbMin; };
+	glm::vec3 bbMax() const { return this->m_bbMax; };
+	// Center of the bounding box, in world space once the primitive is attached to a node
+	glm::vec3 barycenter() const {
+		const glm::vec3 center = (this->m_bbMin + this->m_bbMax) * 0.5;
+		return this->m_node ? glm::vec3(this->m_node->modelMatrix() * glm::vec4{ center, 1.0f }) : center;
+	};
+
+	const std::shared_ptr<Node>& node() const { return this->m_node; };
+	void setNode(std::shared_ptr<Node> node) { this->m_node = std::move(node); };
+	Material material() const { return this->m_material; };
+	void setMaterial(Material material) { this->m_material = material; };
+
+	bool isInstanced() const { return this->m_instances != nullptr; };
+	const std::shared_ptr<const MeshInstances>& instances() const { return this->m_instances; };
+	void setInstances(std::shared_ptr<const MeshInstances> instances) {
+		this->m_instances = std::move(instances);
+		const glm::vec3 bbMin = this->bbMin();
+		const glm::vec3 bbMax = this->bbMax();
+		this->m_boundsMin = bbMin;
+		this->m_boundsMax = bbMax;
+		if (!this->m_instances || this->m_instances->transforms.empty())
+			return;
+
+		this->m_boundsMin = glm::vec3{ std::numeric_limits<float>::max() };
+		this->m_boundsMax = glm::vec3{ std::numeric_limits<float>::lowest() };
+		for (const glm::mat4& transform : this->m_instances->transforms) {
+			for (int corner = 0; corner < 8; corner++) {
+				const glm::vec3 p{ corner & 1 ? bbMax.x : bbMin.x, corner & 2 ? bbMax.y : bbMin.y, corner & 4 ? bbMax.z : bbMin.z };
+				const glm::vec3 t = glm::vec3(transform * glm::vec4{ p, 1.0f });
+				this->m_boundsMin = glm::min(this->m_boundsMin, t);
+				this->m_boundsMax = glm::max(this->m_boundsMax, t);
+			}
+		}
+	};
+	// Box around everything the primitive draws in node space: its bounding box, or those of all its instances
+	glm::vec3 boundsMin() const { return this->m_boundsMin; };
+	glm::vec3 boundsMax() const { return this->m_boundsMax; };
 };
 
 class Mesh {
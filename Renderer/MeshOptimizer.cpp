@@ -0,0 +1,288 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <numeric>
+#include <cstring>
+
+#include <glm/geometric.hpp>
+
+#include "AccessorKernels.h"
+#include "PrimitiveRewrite.h"
+
+namespace {
+	std::vector<uint32_t> readIndices(const SceneData& scene, const IndexBufferDescription& description) {
+		const byte* p = scene.buffers[static_cast<uint32_t>(description.buffer)].data() + description.offset;
+
+		std::vector<uint32_t> indices(description.count);
+		selectIndexWidenKernel(description.indexType)(p, description.count, indices.data());
+		return indices;
+	}
+
+	const VertexAttributeDescription* findAttribute(const ScenePrimitiveData& primitive, const char* attributeName) {
+		for (const auto& attribute : primitive.attributes) {
+			if (attribute.attributeName == attributeName)
+				return &attribute;
+		}
+		return nullptr;
+	}
+
+	// Vertex and index data of one optimized primitive, laid out the way it will be appended to the scene. Empty if the
+	// primitive was left as it is.
+	struct OptimizedPrimitive {
+		std::vector<byte> data;
+		std::vector<size_t> attributeOffsets;
+		size_t vertexCount = 0;
+		size_t indexOffset = 0;
+		size_t indexCount = 0;
+		AttributeValueType indexType = AttributeValueType::eUint32;
+	};
+
+	OptimizedPrimitive optimizePrimitive(const SceneData& scene, const ScenePrimitiveData& primitive) {
+		OptimizedPrimitive result{};
+
+		const VertexAttributeDescription* positionAttribute = findAttribute(primitive, "POSITION");
+		if (!primitive.isIndexed || primitive.mode != MeshPrimitiveMode::eTriangles || positionAttribute == nullptr)
+			return result;
+
+		const size_t vertexCount = positionAttribute->count;
+		std::vector<uint32_t> indices = readIndices(scene, primitive.indices);
+		indices.resize(indices.size() / 3 * 3);
+		if (indices.empty() || std::any_of(indices.begin(), indices.end(), [&](uint32_t index) { return index >= vertexCount; }))
+			return result;
+
+		std::vector<size_t> clusters{};
+		indices = optimizeVertexCache(indices, vertexCount, &clusters);
+
+		if (positionAttribute->valueType == AttributeValueType::eFloat && positionAttribute->containerType == AttributeContainerType::eVec3) {
+			const AccessorView<glm::vec3> positions{ scene.buffers[static_cast<uint32_t>(positionAttribute->buffer)].data() + positionAttribute->offset, positionAttribute->count, static_cast<size_t>(positionAttribute->stride) };
+			optimizeOverdraw(indices, clusters, positions);
+		}
+
+		const std::vector<uint32_t> remap = optimizeVertexFetch(indices, vertexCount);
+		result.vertexCount = remap.size();
+
+		// one tightly packed stream per attribute, in the new vertex order
+		for (const auto& attribute : primitive.attributes) {
+			const size_t elementSize = componentCountFromAttributeContainerType(attribute.containerType) * sizeFromAttributeValueType(attribute.valueType);
+			const size_t stride = alignUp(elementSize, VERTEX_DATA_ALIGNMENT);
+			const byte* src = scene.buffers[static_cast<uint32_t>(attribute.buffer)].data() + attribute.offset;
+			const size_t srcStride = attribute.stride > 0 ? static_cast<size_t>(attribute.stride) : elementSize;
+
+			const size_t offset = alignUp(result.data.size(), VERTEX_DATA_ALIGNMENT);
+			result.attributeOffsets.push_back(offset);
+			result.data.resize(offset + stride * remap.size(), 0);
+			for (size_t i = 0; i < remap.size(); i++)
+				std::memcpy(result.data.data() + offset + i * stride, src + remap[i] * srcStride, elementSize);
+		}
+
+		result.indexOffset = alignUp(result.data.size(), VERTEX_DATA_ALIGNMENT);
+		result.indexCount = indices.size();
+		if (remap.size() <= UINT16_MAX) {
+			result.indexType = AttributeValueType::eUint16;
+			result.data.resize(result.indexOffset + indices.size() * sizeof(uint16_t), 0);
+			narrowIndices(indices.data(), indices.size(), reinterpret_cast<uint16_t*>(result.data.data() + result.indexOffset));
+		}
+		else {
+			result.indexType = AttributeValueType::eUint32;
+			result.data.resize(result.indexOffset + indices.size() * sizeof(uint32_t), 0);
+			std::memcpy(result.data.data() + result.indexOffset, indices.data(), indices.size() * sizeof(uint32_t));
+		}
+
+		return result;
+	}
+}
+
+std::vector<uint32_t> optimizeVertexCache(std::span<const uint32_t> indices, size_t vertexCount, std::vector<size_t>* clusters, uint32_t cacheSize) {
+	const size_t triangleCount = indices.size() / 3;
+
+	// triangles adjacent to every vertex
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		adjacencyOffsets[indices[i] + 1]++;
+	std::partial_sum(adjacencyOffsets.begin(), adjacencyOffsets.end(), adjacencyOffsets.begin());
+
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (size_t t = 0; t < triangleCount; t++) {
+		for (size_t k = 0; k < 3; k++)
+			adjacency[fill[indices[t * 3 + k]]++] = static_cast<uint32_t>(t);
+	}
+
+	std::vector<uint32_t> liveTriangles(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+		liveTriangles[v] = adjacencyOffsets[v + 1] - adjacencyOffsets[v];
+
+	std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> deadEndStack{};
+	std::vector<uint32_t> candidates{};
+
+	std::vector<uint32_t> output;
+	output.reserve(triangleCount * 3);
+
+	uint32_t timestamp = cacheSize + 1;
+	size_t cursor = 0;
+	int64_t fanningVertex = 0;
+	while (fanningVertex < static_cast<int64_t>(vertexCount) && liveTriangles[fanningVertex] == 0)
+		fanningVertex++;
+	if (fanningVertex >= static_cast<int64_t>(vertexCount))
+		return output;
+
+	if (clusters != nullptr)
+		clusters->push_back(0);
+
+	while (fanningVertex >= 0) {
+		candidates.clear();
+
+		for (uint32_t a = adjacencyOffsets[fanningVertex]; a < adjacencyOffsets[fanningVertex + 1]; a++) {
+			const uint32_t t = adjacency[a];
+			if (emitted[t])
+				continue;
+
+			for (size_t k = 0; k < 3; k++) {
+				const uint32_t v = indices[t * 3 + k];
+				output.push_back(v);
+				deadEndStack.push_back(v);
+				candidates.push_back(v);
+				liveTriangles[v]--;
+				if (timestamp - cacheTimestamps[v] > cacheSize)
+					cacheTimestamps[v] = timestamp++;
+			}
+			emitted[t] = true;
+		}
+
+		// pick the candidate still in the cache after emitting all of its triangles, preferring the oldest one
+		int64_t next = -1;
+		int64_t bestPriority = -1;
+		for (const uint32_t v : candidates) {
+			if (liveTriangles[v] == 0)
+				continue;
+
+			int64_t priority = 0;
+			if (timestamp - cacheTimestamps[v] + 2 * liveTriangles[v] <= cacheSize)
+				priority = timestamp - cacheTimestamps[v];
+			if (priority > bestPriority) {
+				bestPriority = priority;
+				next = v;
+			}
+		}
+
+		if (next == -1) {
+			while (!deadEndStack.empty()) {
+				const uint32_t v = deadEndStack.back();
+				deadEndStack.pop_back();
+				if (liveTriangles[v] > 0) {
+					next = v;
+					break;
+				}
+			}
+		}
+
+		if (next == -1) {
+			while (cursor < vertexCount && liveTriangles[cursor] == 0)
+				cursor++;
+			if (cursor < vertexCount)
+				next = static_cast<int64_t>(cursor);
+
+			// nothing adjacent is left in the cache, so this starts a new cluster
+			if (next != -1 && clusters != nullptr)
+				clusters->push_back(output.size() / 3);
+		}
+
+		fanningVertex = next;
+	}
+
+	return output;
+}
+
+void optimizeOverdraw(std::vector<uint32_t>& indices, std::span<const size_t> clusters, const AccessorView<glm::vec3>& positions) {
+	const size_t triangleCount = indices.size() / 3;
+	if (clusters.size() < 2 || triangleCount == 0)
+		return;
+
+	struct ClusterInfo {
+		size_t begin;
+		size_t end;
+		glm::vec3 centroid;
+		glm::vec3 normal;
+		float sortKey;
+	};
+
+	std::vector<ClusterInfo> clusterInfos;
+	clusterInfos.reserve(clusters.size());
+
+	glm::vec3 meshCentroid{ 0.0f };
+	float meshArea = 0.0f;
+	for (size_t c = 0; c < clusters.size(); c++) {
+		ClusterInfo info{ clusters[c], c + 1 < clusters.size() ? clusters[c + 1] : triangleCount, glm::vec3{ 0.0f }, glm::vec3{ 0.0f }, 0.0f };
+
+		float clusterArea = 0.0f;
+		for (size_t t = info.begin; t < info.end; t++) {
+			const glm::vec3 p0 = positions[indices[t * 3 + 0]];
+			const glm::vec3 p1 = positions[indices[t * 3 + 1]];
+			const glm::vec3 p2 = positions[indices[t * 3 + 2]];
+
+			// the cross product length is twice the area, good enough as a weight
+			const glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+			const float area = glm::length(n);
+			info.centroid += (p0 + p1 + p2) / 3.0f * area;
+			info.normal += n;
+			clusterArea += area;
+		}
+
+		meshCentroid += info.centroid;
+		meshArea += clusterArea;
+		info.centroid = clusterArea > 0.0f ? info.centroid / clusterArea : positions[indices[info.begin * 3]];
+		clusterInfos.push_back(info);
+	}
+	if (meshArea > 0.0f)
+		meshCentroid /= meshArea;
+
+	for (auto& info : clusterInfos) {
+		const float normalLength = glm::length(info.normal);
+		info.sortKey = normalLength > 0.0f ? glm::dot(info.centroid - meshCentroid, info.normal / normalLength) : 0.0f;
+	}
+
+	std::stable_sort(clusterInfos.begin(), clusterInfos.end(), [](const ClusterInfo& a, const ClusterInfo& b) { return a.sortKey > b.sortKey; });
+
+	std::vector<uint32_t> sorted;
+	sorted.reserve(indices.size());
+	for (const auto& info : clusterInfos)
+		sorted.insert(sorted.end(), indices.begin() + info.begin * 3, indices.begin() + info.end * 3);
+	indices = std::move(sorted);
+}
+
+std::vector<uint32_t> optimizeVertexFetch(std::vector<uint32_t>& indices, size_t vertexCount) {
+	std::vector<uint32_t> newIndex(vertexCount, UINT32_MAX);
+	std::vector<uint32_t> remap;
+	remap.reserve(vertexCount);
+
+	for (uint32_t& index : indices) {
+		if (newIndex[index] == UINT32_MAX) {
+			newIndex[index] = static_cast<uint32_t>(remap.size());
+			remap.push_back(index);
+		}
+		index = newIndex[index];
+	}
+
+	return remap;
+}
+
+void optimizeSceneMeshes(SceneData& scene) {
+	rewriteScenePrimitives(scene, optimizePrimitive, [](ScenePrimitiveData& primitive, const OptimizedPrimitive& optimized, const Buffer buffer, const size_t baseOffset) {
+		for (size_t a = 0; a < primitive.attributes.size(); a++) {
+			auto& attribute = primitive.attributes[a];
+			const size_t elementSize = componentCountFromAttributeContainerType(attribute.containerType) * sizeFromAttributeValueType(attribute.valueType);
+			attribute.buffer = buffer;
+			attribute.offset = baseOffset + optimized.attributeOffsets[a];
+			attribute.stride = static_cast<int32_t>(alignUp(elementSize, VERTEX_DATA_ALIGNMENT));
+			attribute.count = optimized.vertexCount;
+		}
+
+		primitive.indices.buffer = buffer;
+		primitive.indices.offset = baseOffset + optimized.indexOffset;
+		primitive.indices.stride = static_cast<int32_t>(sizeFromAttributeValueType(optimized.indexType));
+		primitive.indices.count = optimized.indexCount;
+		primitive.indices.indexType = optimized.indexType;
+	});
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <vector>
+#include <span>
+
+#include <glm/vec3.hpp>
+
+#include "AccessorView.h"
+#include "SceneData.h"
+
+// Reorders triangles for the post-transform vertex cache using Tipsify (Sander, Nehab and Barczak 2007).
+// If clusters is given, it receives the first triangle of every run that started from a cold cache, which
+// optimizeOverdraw uses as the units it is allowed to reorder.
+std::vector<uint32_t> optimizeVertexCache(std::span<const uint32_t> indices, size_t vertexCount, std::vector<size_t>* clusters = nullptr, uint32_t cacheSize = 16);
+
+// Sorts the clusters found by optimizeVertexCache so that the ones facing away from the mesh center are drawn first,
+// which lets them occlude the rest of the mesh. Triangle order inside each cluster is kept, so is the cache efficiency.
+void optimizeOverdraw(std::vector<uint32_t>& indices, std::span<const size_t> clusters, const AccessorView<glm::vec3>& positions);
+
+// Renumbers vertices in the order the index buffer first references them and returns the old index of every new
+// vertex. Unreferenced vertices are dropped.
+std::vector<uint32_t> optimizeVertexFetch(std::vector<uint32_t>& indices, size_t vertexCount);
+
+// Runs the passes above on every indexed triangle list in the scene, then rewrites the primitive's vertex attributes
+// and indices into a new buffer, with 16 bit indices when the vertex count allows. The source buffers are left as
+// they are, since other primitives may share them.
+void optimizeSceneMeshes(SceneData& scene);
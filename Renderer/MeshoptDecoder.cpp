@@ -0,0 +1,435 @@
+#include "MeshoptDecoder.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+	constexpr byte VERTEX_HEADER = 0xa0;
+	constexpr byte INDEX_HEADER = 0xe0;
+	constexpr byte SEQUENCE_HEADER = 0xd0;
+
+	constexpr size_t VERTEX_BLOCK_SIZE_BYTES = 8192;
+	constexpr size_t VERTEX_BLOCK_MAX_SIZE = 256;
+	constexpr size_t BYTE_GROUP_SIZE = 16;
+	// a byte group never takes more than its 16 bytes plus the header bits, this keeps every group read in bounds
+	constexpr size_t BYTE_GROUP_DECODE_LIMIT = 24;
+	constexpr size_t TAIL_MAX_SIZE = 32;
+
+	size_t vertexBlockSize(size_t stride) {
+		// blocks are decoded one byte group at a time, truncate to whole groups
+		const size_t result = (VERTEX_BLOCK_SIZE_BYTES / stride) & ~(BYTE_GROUP_SIZE - 1);
+		return result < VERTEX_BLOCK_MAX_SIZE ? result : VERTEX_BLOCK_MAX_SIZE;
+	}
+
+	byte unzigzag8(byte v) {
+		return static_cast<byte>(-(v & 1) ^ (v >> 1));
+	}
+
+	// A group of 16 bytes stored in 0, 2, 4 or 8 bits each. Values that don't fit are escaped with all bits set and
+	// follow the packed bits as whole bytes.
+	const byte* decodeBytesGroup(const byte* data, byte* destination, int bitsLog2) {
+		if (bitsLog2 == 0) {
+			std::memset(destination, 0, BYTE_GROUP_SIZE);
+			return data;
+		}
+		if (bitsLog2 == 3) {
+			std::memcpy(destination, data, BYTE_GROUP_SIZE);
+			return data + BYTE_GROUP_SIZE;
+		}
+
+		const unsigned bits = 1u << bitsLog2;
+		const unsigned escape = (1u << bits) - 1;
+		const byte* escaped = data + BYTE_GROUP_SIZE * bits / 8;
+		for (size_t i = 0; i < BYTE_GROUP_SIZE; data++) {
+			unsigned packed = *data;
+			for (unsigned j = 0; j < 8 / bits; j++, i++) {
+				const unsigned value = (packed >> (8 - bits)) & escape;
+				packed <<= bits;
+				destination[i] = value == escape ? *escaped++ : static_cast<byte>(value);
+			}
+		}
+		return escaped;
+	}
+
+	const byte* decodeBytes(const byte* data, const byte* dataEnd, byte* destination, size_t size) {
+		// 2 bits of header per group
+		const byte* header = data;
+		const size_t headerSize = (size / BYTE_GROUP_SIZE + 3) / 4;
+		if (static_cast<size_t>(dataEnd - data) < headerSize)
+			return nullptr;
+		data += headerSize;
+
+		for (size_t i = 0; i < size; i += BYTE_GROUP_SIZE) {
+			if (static_cast<size_t>(dataEnd - data) < BYTE_GROUP_DECODE_LIMIT)
+				return nullptr;
+
+			const size_t group = i / BYTE_GROUP_SIZE;
+			const int bitsLog2 = (header[group / 4] >> ((group % 4) * 2)) & 3;
+			data = decodeBytesGroup(data, destination + i, bitsLog2);
+		}
+		return data;
+	}
+
+	// Vertices are delta coded against the previous one and stored transposed, byte k of every vertex in the block together
+	const byte* decodeVertexBlock(const byte* data, const byte* dataEnd, byte* destination, size_t count, size_t stride, std::array<byte, 256>& lastVertex) {
+		std::array<byte, VERTEX_BLOCK_MAX_SIZE> deltas;
+		std::array<byte, VERTEX_BLOCK_SIZE_BYTES> vertices;
+
+		const size_t alignedCount = (count + BYTE_GROUP_SIZE - 1) & ~(BYTE_GROUP_SIZE - 1);
+		for (size_t k = 0; k < stride; k++) {
+			data = decodeBytes(data, dataEnd, deltas.data(), alignedCount);
+			if (data == nullptr)
+				return nullptr;
+
+			byte previous = lastVertex[k];
+			for (size_t i = 0; i < count; i++) {
+				previous = static_cast<byte>(unzigzag8(deltas[i]) + previous);
+				vertices[i * stride + k] = previous;
+			}
+		}
+
+		std::memcpy(destination, vertices.data(), count * stride);
+		std::memcpy(lastVertex.data(), vertices.data() + (count - 1) * stride, stride);
+		return data;
+	}
+
+	uint32_t decodeVByte(const byte*& data) {
+		const byte lead = *data++;
+		if (lead < 128)
+			return lead;
+
+		// at most 4 more bytes, so malformed data can't run away
+		uint32_t result = lead & 127;
+		uint32_t shift = 7;
+		for (int i = 0; i < 4; i++) {
+			const byte group = *data++;
+			result |= static_cast<uint32_t>(group & 127) << shift;
+			shift += 7;
+			if (group < 128)
+				break;
+		}
+		return result;
+	}
+
+	uint32_t decodeIndex(const byte*& data, uint32_t last) {
+		const uint32_t v = decodeVByte(data);
+		const uint32_t delta = (v >> 1) ^ (0u - (v & 1));
+		return last + delta;
+	}
+
+	void writeIndex(std::span<byte> destination, size_t i, size_t indexSize, uint32_t index) {
+		if (indexSize == 2) {
+			const uint16_t narrow = static_cast<uint16_t>(index);
+			std::memcpy(destination.data() + i * 2, &narrow, sizeof(narrow));
+		}
+		else
+			std::memcpy(destination.data() + i * 4, &index, sizeof(index));
+	}
+
+	// Recently seen vertices and edges, both ring buffers of 16 entries indexed backwards from the write position
+	struct IndexFifos {
+		std::array<uint32_t, 16> vertices;
+		std::array<std::array<uint32_t, 2>, 16> edges;
+		size_t vertexOffset = 0;
+		size_t edgeOffset = 0;
+
+		IndexFifos() {
+			this->vertices.fill(~0u);
+			this->edges.fill({ ~0u, ~0u });
+		}
+
+		uint32_t vertex(size_t back) const { return this->vertices[(this->vertexOffset - back) & 15]; }
+		const std::array<uint32_t, 2>& edge(size_t back) const { return this->edges[(this->edgeOffset - back) & 15]; }
+
+		void pushVertex(uint32_t v, bool advance = true) {
+			this->vertices[this->vertexOffset] = v;
+			this->vertexOffset = (this->vertexOffset + (advance ? 1 : 0)) & 15;
+		}
+		void pushEdge(uint32_t a, uint32_t b) {
+			this->edges[this->edgeOffset] = { a, b };
+			this->edgeOffset = (this->edgeOffset + 1) & 15;
+		}
+	};
+
+	template<typename T> void decodeFilterOctahedral(byte* data, size_t count) {
+		const float max = static_cast<float>((1 << (sizeof(T) * 8 - 1)) - 1);
+		for (size_t i = 0; i < count; i++) {
+			T v[4];
+			std::memcpy(v, data + i * sizeof(v), sizeof(v));
+
+			// z is stored as the value that encodes 1.0, the same scale as x and y
+			float x = static_cast<float>(v[0]);
+			float y = static_cast<float>(v[1]);
+			const float z = static_cast<float>(v[2]) - std::fabs(x) - std::fabs(y);
+
+			// fold back the lower hemisphere
+			const float t = z >= 0.0f ? 0.0f : z;
+			x += x >= 0.0f ? t : -t;
+			y += y >= 0.0f ? t : -t;
+
+			const float s = max / std::sqrt(x * x + y * y + z * z);
+			v[0] = static_cast<T>(static_cast<int>(x * s + (x >= 0.0f ? 0.5f : -0.5f)));
+			v[1] = static_cast<T>(static_cast<int>(y * s + (y >= 0.0f ? 0.5f : -0.5f)));
+			v[2] = static_cast<T>(static_cast<int>(z * s + (z >= 0.0f ? 0.5f : -0.5f)));
+			std::memcpy(data + i * sizeof(v), v, sizeof(v));
+		}
+	}
+
+	void decodeFilterQuaternion(byte* data, size_t count) {
+		const float scale = 1.0f / std::sqrt(2.0f);
+		for (size_t i = 0; i < count; i++) {
+			int16_t v[4];
+			std::memcpy(v, data + i * sizeof(v), sizeof(v));
+
+			// the 4th component holds the index of the dropped (largest) component and the scale of the others
+			const float ss = scale / static_cast<float>(v[3] | 3);
+			const float x = static_cast<float>(v[0]) * ss;
+			const float y = static_cast<float>(v[1]) * ss;
+			const float z = static_cast<float>(v[2]) * ss;
+			const float ww = 1.0f - x * x - y * y - z * z;
+			const float w = std::sqrt(ww >= 0.0f ? ww : 0.0f);
+
+			const int qc = v[3] & 3;
+			int16_t q[4];
+			q[(qc + 1) & 3] = static_cast<int16_t>(static_cast<int>(x * 32767.0f + (x >= 0.0f ? 0.5f : -0.5f)));
+			q[(qc + 2) & 3] = static_cast<int16_t>(static_cast<int>(y * 32767.0f + (y >= 0.0f ? 0.5f : -0.5f)));
+			q[(qc + 3) & 3] = static_cast<int16_t>(static_cast<int>(z * 32767.0f + (z >= 0.0f ? 0.5f : -0.5f)));
+			q[qc] = static_cast<int16_t>(static_cast<int>(w * 32767.0f + 0.5f));
+			std::memcpy(data + i * sizeof(q), q, sizeof(q));
+		}
+	}
+
+	void decodeFilterExponential(byte* data, size_t count) {
+		for (size_t i = 0; i < count; i++) {
+			uint32_t v;
+			std::memcpy(&v, data + i * sizeof(v), sizeof(v));
+
+			// 24 bit signed mantissa, 8 bit signed exponent
+			const int32_t m = static_cast<int32_t>(v << 8) >> 8;
+			const int32_t e = static_cast<int32_t>(v) >> 24;
+
+			// ldexp(m, e), built from the exponent's power of two
+			const uint32_t powerBits = static_cast<uint32_t>(e + 127) << 23;
+			float power;
+			std::memcpy(&power, &powerBits, sizeof(power));
+			const float f = power * static_cast<float>(m);
+			std::memcpy(data + i * sizeof(f), &f, sizeof(f));
+		}
+	}
+}
+
+void decodeMeshoptVertexBuffer(std::span<byte> destination, size_t count, size_t stride, std::span<const byte> encoded) {
+	if (stride == 0 || stride > 256 || stride % 4 != 0)
+		throw std::runtime_error("Invalid meshopt vertex stride");
+	if (destination.size() < count * stride)
+		throw std::runtime_error("Meshopt vertex buffer destination is too small");
+	if (encoded.size() < 1 + stride)
+		throw std::runtime_error("Truncated meshopt vertex buffer");
+
+	const byte* data = encoded.data();
+	const byte* dataEnd = data + encoded.size();
+
+	const byte header = *data++;
+	if ((header & 0xf0) != VERTEX_HEADER || (header & 0x0f) > 0)
+		throw std::runtime_error("Unsupported meshopt vertex buffer version");
+
+	// the first vertex is delta coded against the one stored at the very end
+	std::array<byte, 256> lastVertex{};
+	std::memcpy(lastVertex.data(), dataEnd - stride, stride);
+
+	const size_t blockSize = vertexBlockSize(stride);
+	for (size_t offset = 0; offset < count; offset += blockSize) {
+		const size_t blockCount = std::min(blockSize, count - offset);
+		data = decodeVertexBlock(data, dataEnd, destination.data() + offset * stride, blockCount, stride, lastVertex);
+		if (data == nullptr)
+			throw std::runtime_error("Truncated meshopt vertex buffer");
+	}
+
+	const size_t tailSize = stride < TAIL_MAX_SIZE ? TAIL_MAX_SIZE : stride;
+	if (static_cast<size_t>(dataEnd - data) != tailSize)
+		throw std::runtime_error("Malformed meshopt vertex buffer");
+}
+
+void decodeMeshoptIndexBuffer(std::span<byte> destination, size_t count, size_t indexSize, std::span<const byte> encoded) {
+	if (count % 3 != 0 || (indexSize != 2 && indexSize != 4))
+		throw std::runtime_error("Invalid meshopt index buffer layout");
+	if (destination.size() < count * indexSize)
+		throw std::runtime_error("Meshopt index buffer destination is too small");
+	// header, one code per triangle and the 16 byte auxiliary code table at the end
+	if (encoded.size() < 1 + count / 3 + 16)
+		throw std::runtime_error("Truncated meshopt index buffer");
+
+	const byte* buffer = encoded.data();
+	const int version = buffer[0] & 0x0f;
+	if ((buffer[0] & 0xf0) != INDEX_HEADER || version > 1)
+		throw std::runtime_error("Unsupported meshopt index buffer version");
+
+	IndexFifos fifos{};
+	uint32_t next = 0;
+	uint32_t last = 0;
+	// version 1 spends codes 13 and 14 on small deltas from the last free index
+	const int fecMax = version >= 1 ? 13 : 15;
+
+	const byte* code = buffer + 1;
+	const byte* data = code + count / 3;
+	const byte* dataSafeEnd = buffer + encoded.size() - 16;
+	const byte* codeAuxTable = dataSafeEnd;
+
+	for (size_t i = 0; i < count; i += 3) {
+		// a triangle reads at most 16 bytes, which the code table behind dataSafeEnd covers
+		if (data > dataSafeEnd)
+			throw std::runtime_error("Truncated meshopt index buffer");
+
+		const byte codeTri = *code++;
+		uint32_t a, b, c;
+
+		if (codeTri < 0xf0) {
+			// triangle sharing an edge from the fifo
+			const auto& edge = fifos.edge(1 + (codeTri >> 4));
+			a = edge[0];
+			b = edge[1];
+
+			const int fec = codeTri & 15;
+			if (fec < fecMax) {
+				c = fec == 0 ? next++ : fifos.vertex(1 + fec);
+				fifos.pushVertex(c, fec == 0);
+			}
+			else {
+				last = c = fec != 15 ? last + (fec - (fec ^ 3)) : decodeIndex(data, last);
+				fifos.pushVertex(c);
+			}
+
+			fifos.pushEdge(c, b);
+			fifos.pushEdge(a, c);
+		}
+		else {
+			int feb, fec;
+			if (codeTri < 0xfe) {
+				const byte codeAux = codeAuxTable[codeTri & 15];
+				feb = codeAux >> 4;
+				fec = codeAux & 15;
+
+				a = next++;
+				b = feb == 0 ? next++ : fifos.vertex(feb);
+				c = fec == 0 ? next++ : fifos.vertex(fec);
+			}
+			else {
+				const byte codeAux = *data++;
+				const int fea = codeTri == 0xfe ? 0 : 15;
+				feb = codeAux >> 4;
+				fec = codeAux & 15;
+
+				// an explicit zero code restarts the vertex numbering
+				if (codeAux == 0)
+					next = 0;
+
+				a = fea == 0 ? next++ : 0;
+				b = feb == 0 ? next++ : fifos.vertex(feb);
+				c = fec == 0 ? next++ : fifos.vertex(fec);
+
+				if (fea == 15)
+					last = a = decodeIndex(data, last);
+				if (feb == 15)
+					last = b = decodeIndex(data, last);
+				if (fec == 15)
+					last = c = decodeIndex(data, last);
+			}
+
+			fifos.pushVertex(a);
+			fifos.pushVertex(b, feb == 0 || feb == 15);
+			fifos.pushVertex(c, fec == 0 || fec == 15);
+
+			fifos.pushEdge(b, a);
+			fifos.pushEdge(c, b);
+			fifos.pushEdge(a, c);
+		}
+
+		writeIndex(destination, i + 0, indexSize, a);
+		writeIndex(destination, i + 1, indexSize, b);
+		writeIndex(destination, i + 2, indexSize, c);
+	}
+
+	if (data != dataSafeEnd)
+		throw std::runtime_error("Malformed meshopt index buffer");
+}
+
+void decodeMeshoptIndexSequence(std::span<byte> destination, size_t count, size_t indexSize, std::span<const byte> encoded) {
+	if (indexSize != 2 && indexSize != 4)
+		throw std::runtime_error("Invalid meshopt index sequence layout");
+	if (destination.size() < count * indexSize)
+		throw std::runtime_error("Meshopt index sequence destination is too small");
+	// header, at least one byte per index and a 4 byte tail
+	if (encoded.size() < 1 + count + 4)
+		throw std::runtime_error("Truncated meshopt index sequence");
+
+	const byte* buffer = encoded.data();
+	if ((buffer[0] & 0xf0) != SEQUENCE_HEADER || (buffer[0] & 0x0f) > 1)
+		throw std::runtime_error("Unsupported meshopt index sequence version");
+
+	const byte* data = buffer + 1;
+	const byte* dataSafeEnd = buffer + encoded.size() - 4;
+
+	// two baselines, the low bit of every value picks the one its delta applies to
+	uint32_t last[2] = {};
+	for (size_t i = 0; i < count; i++) {
+		// an index reads at most 5 bytes, the tail covers the overrun
+		if (data >= dataSafeEnd)
+			throw std::runtime_error("Truncated meshopt index sequence");
+
+		uint32_t v = decodeVByte(data);
+		const uint32_t baseline = v & 1;
+		v >>= 1;
+		const uint32_t index = last[baseline] + ((v >> 1) ^ (0u - (v & 1)));
+		last[baseline] = index;
+
+		writeIndex(destination, i, indexSize, index);
+	}
+
+	if (data != dataSafeEnd)
+		throw std::runtime_error("Malformed meshopt index sequence");
+}
+
+void applyMeshoptFilter(std::span<byte> data, size_t count, size_t stride, MeshoptFilter filter) {
+	switch (filter) {
+	case MeshoptFilter::eNone:
+		break;
+	case MeshoptFilter::eOctahedral:
+		if (stride == 4)
+			decodeFilterOctahedral<int8_t>(data.data(), count);
+		else if (stride == 8)
+			decodeFilterOctahedral<int16_t>(data.data(), count);
+		else
+			throw std::runtime_error("Invalid stride for the meshopt octahedral filter");
+		break;
+	case MeshoptFilter::eQuaternion:
+		if (stride != 8)
+			throw std::runtime_error("Invalid stride for the meshopt quaternion filter");
+		decodeFilterQuaternion(data.data(), count);
+		break;
+	case MeshoptFilter::eExponential:
+		if (stride % 4 != 0)
+			throw std::runtime_error("Invalid stride for the meshopt exponential filter");
+		decodeFilterExponential(data.data(), count * stride / 4);
+		break;
+	}
+}
+
+void decodeMeshoptBufferView(std::span<byte> destination, std::span<const byte> encoded, size_t count, size_t stride, MeshoptMode mode, MeshoptFilter filter) {
+	switch (mode) {
+	case MeshoptMode::eAttributes:
+		decodeMeshoptVertexBuffer(destination, count, stride, encoded);
+		break;
+	case MeshoptMode::eTriangles:
+		decodeMeshoptIndexBuffer(destination, count, stride, encoded);
+		break;
+	case MeshoptMode::eIndices:
+		decodeMeshoptIndexSequence(destination, count, stride, encoded);
+		break;
+	}
+
+	applyMeshoptFilter(destination, count, stride, filter);
+}
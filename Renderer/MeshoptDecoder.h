@@ -0,0 +1,34 @@
+#pragma once
+
+#include <span>
+
+typedef unsigned char byte;
+
+// Codecs of a bufferView compressed with EXT_meshopt_compression
+enum class MeshoptMode {
+	eAttributes,
+	eTriangles,
+	eIndices,
+};
+
+enum class MeshoptFilter {
+	eNone,
+	eOctahedral,
+	eQuaternion,
+	eExponential,
+};
+
+// Decoders for the meshoptimizer bitstreams used by EXT_meshopt_compression: version 0 of the vertex codec and
+// versions 0 and 1 of the index codecs. All of them throw std::runtime_error on malformed data.
+
+// stride is the vertex size in bytes, a multiple of 4 no larger than 256
+void decodeMeshoptVertexBuffer(std::span<byte> destination, size_t count, size_t stride, std::span<const byte> encoded);
+// count is the number of indices, a multiple of 3. indexSize is 2 or 4.
+void decodeMeshoptIndexBuffer(std::span<byte> destination, size_t count, size_t indexSize, std::span<const byte> encoded);
+void decodeMeshoptIndexSequence(std::span<byte> destination, size_t count, size_t indexSize, std::span<const byte> encoded);
+
+// Undoes the filter in place on count decoded elements of stride bytes
+void applyMeshoptFilter(std::span<byte> data, size_t count, size_t stride, MeshoptFilter filter);
+
+// Decodes a whole bufferView into destination, which must hold count * stride bytes
+void decodeMeshoptBufferView(std::span<byte> destination, std::span<const byte> encoded, size_t count, size_t stride, MeshoptMode mode, MeshoptFilter filter);
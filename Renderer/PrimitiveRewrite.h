@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <execution>
+#include <numeric>
+#include <exception>
+#include <type_traits>
+
+#include "SceneData.h"
+
+// Rewritten vertex streams are aligned to this, like the strides of the attributes in them
+constexpr size_t VERTEX_DATA_ALIGNMENT = 4;
+
+constexpr size_t alignUp(size_t value, size_t alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+// Driver shared by the passes that rewrite primitives into new data. rewritePrimitive(scene, primitive) runs on
+// every primitive in parallel and returns a result whose data member holds the primitive's new data, empty if the
+// primitive is left as it is. The data of every primitive is appended to one new scene buffer, in primitive order so
+// the output doesn't depend on scheduling, and applyRewrite(primitive, result, buffer, baseOffset) then points the
+// primitive at its part of it. Exceptions from rewritePrimitive are rethrown once the parallel loop is done, the first
+// in primitive order, since they can't leave a parallel algorithm.
+template<typename RewritePrimitive, typename ApplyRewrite>
+void rewriteScenePrimitives(SceneData& scene, RewritePrimitive&& rewritePrimitive, ApplyRewrite&& applyRewrite) {
+	using Result = std::invoke_result_t<RewritePrimitive&, const SceneData&, const ScenePrimitiveData&>;
+
+	std::vector<std::pair<size_t, size_t>> primitiveIndices;
+	for (size_t m = 0; m < scene.meshes.size(); m++) {
+		for (size_t p = 0; p < scene.meshes[m].size(); p++)
+			primitiveIndices.emplace_back(m, p);
+	}
+
+	std::vector<Result> rewritten(primitiveIndices.size());
+	std::vector<std::exception_ptr> errors(primitiveIndices.size());
+	std::vector<size_t> work(primitiveIndices.size());
+	std::iota(work.begin(), work.end(), size_t{ 0 });
+	std::for_each(std::execution::par, work.begin(), work.end(), [&](const size_t i) {
+		try {
+			const auto [m, p] = primitiveIndices[i];
+			rewritten[i] = rewritePrimitive(std::as_const(scene), std::as_const(scene.meshes[m][p]));
+		}
+		catch (...) {
+			errors[i] = std::current_exception();
+		}
+	});
+	for (const auto& error : errors) {
+		if (error)
+			std::rethrow_exception(error);
+	}
+
+	std::vector<byte> data{};
+	std::vector<size_t> baseOffsets(rewritten.size(), 0);
+	for (size_t i = 0; i < rewritten.size(); i++) {
+		if (rewritten[i].data.empty())
+			continue;
+		baseOffsets[i] = alignUp(data.size(), 16);
+		data.resize(baseOffsets[i]);
+		data.insert(data.end(), rewritten[i].data.begin(), rewritten[i].data.end());
+	}
+	if (data.empty())
+		return;
+
+	const Buffer buffer{ static_cast<uint32_t>(scene.buffers.size()) };
+	for (size_t i = 0; i < rewritten.size(); i++) {
+		if (!rewritten[i].data.empty())
+			applyRewrite(scene.meshes[primitiveIndices[i].first][primitiveIndices[i].second], rewritten[i], buffer, baseOffsets[i]);
+	}
+
+	std::vector<byte>& storage = scene.ownedBuffers.emplace_back(std::move(data));
+	scene.buffers.emplace_back(storage);
+}
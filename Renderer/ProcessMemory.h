@@ -0,0 +1,6 @@
+#pragma once
+
+#include <cstddef>
+
+// Largest resident set (working set on Windows) the process has had so far, in bytes
+size_t peakResidentMemory();
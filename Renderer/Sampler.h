@@ -0,0 +1,22 @@
+#pragma once
+
+enum class SamplerFilter {
+	eNearest,
+	eLinear,
+};
+
+enum class SamplerWrap {
+	eClampToEdge,
+	eRepeat,
+	eMirror,
+};
+
+struct Sampler {
+	SamplerFilter magFilter = SamplerFilter::eLinear;
+	SamplerFilter minFilter = SamplerFilter::eLinear;
+	SamplerFilter mipmapFilter = SamplerFilter::eLinear;
+	SamplerWrap wrapU = SamplerWrap::eRepeat;
+	SamplerWrap wrapV = SamplerWrap::eRepeat;
+
+	bool operator==(const Sampler&) const = default;
+};
@@ -0,0 +1,748 @@
+#include "SceneCache.h"
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <execution>
+#include <numeric>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <array>
+
+#include "BlockCompression.h"
+
+namespace {
+	constexpr char SCENE_CACHE_MAGIC[8] = { 'R', 'S', 'C', 'A', 'C', 'H', 'E', '\0' };
+	constexpr uint32_t SCENE_CACHE_VERSION = 10;
+	constexpr uint64_t SCENE_CACHE_BLOCK_SIZE = 1 << 20;
+	constexpr uint64_t SCENE_CACHE_ALIGNMENT = 16;
+
+	// File layout: header | metadata | block table | payload. Buffers are packed into the payload at
+	// SCENE_CACHE_ALIGNMENT boundaries, and the payload is stored as SCENE_CACHE_BLOCK_SIZE blocks.
+	struct SceneCacheHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t compressed;
+		uint64_t sourceHash;
+		uint64_t metadataOffset;
+		uint64_t metadataSize;
+		uint64_t blockTableOffset;
+		uint64_t blockCount;
+		uint64_t payloadOffset;
+		uint64_t payloadSize;
+	};
+
+	struct SceneCacheBlock {
+		uint64_t offset;
+		uint32_t storedSize;
+		uint32_t size;
+	};
+
+	// serialized sizes, the structs above are written field by field
+	constexpr uint64_t SCENE_CACHE_HEADER_SIZE = 8 + 4 + 4 + 7 * 8;
+	constexpr uint64_t SCENE_CACHE_BLOCK_ENTRY_SIZE = 8 + 4 + 4;
+
+	constexpr uint64_t alignUp(uint64_t value, uint64_t alignment) {
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	class BinaryWriter {
+	public:
+		std::vector<byte> data;
+
+		template<typename T> void write(const T& value) {
+			static_assert(std::is_trivially_copyable_v<T>);
+			const byte* p = reinterpret_cast<const byte*>(&value);
+			this->data.insert(this->data.end(), p, p + sizeof(T));
+		}
+
+		template<typename T> void writeVector(const std::vector<T>& values) {
+			static_assert(std::is_trivially_copyable_v<T>);
+			this->write<uint64_t>(values.size());
+			const byte* p = reinterpret_cast<const byte*>(values.data());
+			this->data.insert(this->data.end(), p, p + values.size() * sizeof(T));
+		}
+
+		void writeString(const std::string& value) {
+			this->write<uint64_t>(value.size());
+			this->data.insert(this->data.end(), value.begin(), value.end());
+		}
+	};
+
+	class BinaryReader {
+		std::span<const byte> m_data;
+		size_t m_offset = 0;
+
+		void require(size_t size) {
+			if (size > this->m_data.size() - this->m_offset)
+				throw std::runtime_error("Truncated scene cache metadata");
+		}
+
+	public:
+		explicit BinaryReader(std::span<const byte> data) : m_data(data) {};
+
+		template<typename T> T read() {
+			static_assert(std::is_trivially_copyable_v<T>);
+			this->require(sizeof(T));
+			T value;
+			std::memcpy(&value, this->m_data.data() + this->m_offset, sizeof(T));
+			this->m_offset += sizeof(T);
+			return value;
+		}
+
+		template<typename T> std::vector<T> readVector() {
+			static_assert(std::is_trivially_copyable_v<T>);
+			const uint64_t count = this->read<uint64_t>();
+			if (count > (this->m_data.size() - this->m_offset) / sizeof(T))
+				throw std::runtime_error("Truncated scene cache metadata");
+			std::vector<T> values(count);
+			std::memcpy(values.data(), this->m_data.data() + this->m_offset, count * sizeof(T));
+			this->m_offset += count * sizeof(T);
+			return values;
+		}
+
+		std::string readString() {
+			const uint64_t size = this->read<uint64_t>();
+			this->require(size);
+			std::string value{ reinterpret_cast<const char*>(this->m_data.data() + this->m_offset), size };
+			this->m_offset += size;
+			return value;
+		}
+	};
+
+	template<typename T> void writeAnimation(BinaryWriter& writer, const std::optional<AnimationData<T>>& animation) {
+		writer.write<uint8_t>(animation.has_value());
+		if (!animation)
+			return;
+		writer.write(animation->interpolation);
+		writer.writeVector(*animation->keyframeTimes);
+		writer.writeVector(*animation->keyframes);
+	}
+
+	template<typename T> std::optional<AnimationData<T>> readAnimation(BinaryReader& reader) {
+		if (!reader.read<uint8_t>())
+			return std::nullopt;
+		AnimationData<T> animation{};
+		animation.interpolation = reader.read<AnimationInterpolationCurve>();
+		animation.keyframeTimes = std::make_shared<const std::vector<float>>(reader.readVector<float>());
+		animation.keyframes = std::make_shared<const std::vector<T>>(reader.readVector<T>());
+		return animation;
+	}
+
+	void writeHeader(BinaryWriter& writer, const SceneCacheHeader& header) {
+		writer.write(header.magic);
+		writer.write<uint32_t>(header.version);
+		writer.write<uint32_t>(header.compressed);
+		writer.write<uint64_t>(header.sourceHash);
+		writer.write<uint64_t>(header.metadataOffset);
+		writer.write<uint64_t>(header.metadataSize);
+		writer.write<uint64_t>(header.blockTableOffset);
+		writer.write<uint64_t>(header.blockCount);
+		writer.write<uint64_t>(header.payloadOffset);
+		writer.write<uint64_t>(header.payloadSize);
+	}
+
+	SceneCacheHeader readHeader(BinaryReader& reader) {
+		SceneCacheHeader header{};
+		const auto magic = reader.read<std::array<char, 8>>();
+		std::memcpy(header.magic, magic.data(), magic.size());
+		header.version = reader.read<uint32_t>();
+		header.compressed = reader.read<uint32_t>();
+		header.sourceHash = reader.read<uint64_t>();
+		header.metadataOffset = reader.read<uint64_t>();
+		header.metadataSize = reader.read<uint64_t>();
+		header.blockTableOffset = reader.read<uint64_t>();
+		header.blockCount = reader.read<uint64_t>();
+		header.payloadOffset = reader.read<uint64_t>();
+		header.payloadSize = reader.read<uint64_t>();
+		return header;
+	}
+
+	void writeMaterial(BinaryWriter& writer, const MaterialData& material) {
+		writer.write(material.baseColorFactor);
+		writer.write(material.emissiveFactor);
+		writer.write<float>(material.normalScale);
+		writer.write<float>(material.metallicFactor);
+		writer.write<float>(material.roughnessFactor);
+		writer.write<float>(material.occlusionStrength);
+		writer.write<uint32_t>(static_cast<uint32_t>(material.alphaMode));
+		writer.write<float>(material.alphaCutoff);
+		writer.write<int32_t>(material.baseColorTexture);
+		writer.write<int32_t>(material.metallicRoughnessTexture);
+		writer.write<int32_t>(material.normalTexture);
+		writer.write<int32_t>(material.emissiveTexture);
+		writer.write<int32_t>(material.occlusionTexture);
+	}
+
+	MaterialData readMaterial(BinaryReader& reader) {
+		MaterialData material{};
+		material.baseColorFactor = reader.read<glm::vec4>();
+		material.emissiveFactor = reader.read<glm::vec3>();
+		material.normalScale = reader.read<float>();
+		material.metallicFactor = reader.read<float>();
+		material.roughnessFactor = reader.read<float>();
+		material.occlusionStrength = reader.read<float>();
+		material.alphaMode = static_cast<AlphaMode>(reader.read<uint32_t>());
+		material.alphaCutoff = reader.read<float>();
+		material.baseColorTexture = reader.read<int32_t>();
+		material.metallicRoughnessTexture = reader.read<int32_t>();
+		material.normalTexture = reader.read<int32_t>();
+		material.emissiveTexture = reader.read<int32_t>();
+		material.occlusionTexture = reader.read<int32_t>();
+		return material;
+	}
+
+	void writeSampler(BinaryWriter& writer, const Sampler& sampler) {
+		writer.write<uint8_t>(static_cast<uint8_t>(sampler.magFilter));
+		writer.write<uint8_t>(static_cast<uint8_t>(sampler.minFilter));
+		writer.write<uint8_t>(static_cast<uint8_t>(sampler.mipmapFilter));
+		writer.write<uint8_t>(static_cast<uint8_t>(sampler.wrapU));
+		writer.write<uint8_t>(static_cast<uint8_t>(sampler.wrapV));
+	}
+
+	Sampler readSampler(BinaryReader& reader) {
+		Sampler sampler{};
+		sampler.magFilter = static_cast<SamplerFilter>(reader.read<uint8_t>());
+		sampler.minFilter = static_cast<SamplerFilter>(reader.read<uint8_t>());
+		sampler.mipmapFilter = static_cast<SamplerFilter>(reader.read<uint8_t>());
+		sampler.wrapU = static_cast<SamplerWrap>(reader.read<uint8_t>());
+		sampler.wrapV = static_cast<SamplerWrap>(reader.read<uint8_t>());
+		return sampler;
+	}
+
+	int64_t lastWriteTime(const std::filesystem::path& path) {
+		return static_cast<int64_t>(std::filesystem::last_write_time(path).time_since_epoch().count());
+	}
+
+	// count elements of elementSize bytes, stride apart from offset on, end within size, without overflowing
+	bool isRangeInside(uint64_t offset, uint64_t count, uint64_t stride, uint64_t elementSize, uint64_t size) {
+		if (count == 0)
+			return offset <= size;
+		if (elementSize > size || offset > size - elementSize)
+			return false;
+		return stride == 0 || count - 1 <= (size - elementSize - offset) / stride;
+	}
+
+	bool isIndexInside(int64_t index, size_t count, bool allowNone = true) {
+		return (allowNone && index == -1) || (index >= 0 && static_cast<uint64_t>(index) < count);
+	}
+
+	// Every index and byte range the metadata holds points inside the tables and buffers it describes, so a stale or
+	// corrupt entry is a cache miss instead of an out of bounds read when the scene is used
+	bool isSceneConsistent(const SceneData& scene, const std::vector<std::pair<uint64_t, uint64_t>>& bufferRanges) {
+		auto bufferSize = [&bufferRanges](uint64_t buffer) { return bufferRanges[buffer].second; };
+
+		for (const auto& primitives : scene.meshes) {
+			for (const auto& primitive : primitives) {
+				for (const auto& attribute : primitive.attributes) {
+					const uint32_t buffer = static_cast<uint32_t>(attribute.buffer);
+					if (attribute.containerType > AttributeContainerType::eVec4 || attribute.valueType > AttributeValueType::eDouble || buffer >= bufferRanges.size() || attribute.stride < 0)
+						return false;
+					const uint64_t elementSize = componentCountFromAttributeContainerType(attribute.containerType) * sizeFromAttributeValueType(attribute.valueType);
+					const uint64_t stride = attribute.stride > 0 ? static_cast<uint64_t>(attribute.stride) : elementSize;
+					if (!isRangeInside(attribute.offset, attribute.count, stride, elementSize, bufferSize(buffer)))
+						return false;
+				}
+				if (primitive.isIndexed) {
+					const uint32_t buffer = static_cast<uint32_t>(primitive.indices.buffer);
+					if (primitive.indices.indexType > AttributeValueType::eDouble || buffer >= bufferRanges.size())
+						return false;
+					const uint64_t indexSize = sizeFromAttributeValueType(primitive.indices.indexType);
+					if (!isRangeInside(primitive.indices.offset, primitive.indices.count, indexSize, indexSize, bufferSize(buffer)))
+						return false;
+				}
+				if (primitive.mode > MeshPrimitiveMode::eTriangleFan || !isIndexInside(primitive.material, scene.materials.size()))
+					return false;
+			}
+		}
+
+		for (const auto& node : scene.nodes) {
+			if (!isIndexInside(node.mesh, scene.meshes.size()))
+				return false;
+			for (const uint32_t child : node.children) {
+				if (child >= scene.nodes.size())
+					return false;
+			}
+		}
+		for (const uint32_t root : scene.rootNodes) {
+			if (root >= scene.nodes.size())
+				return false;
+		}
+
+		for (const auto& material : scene.materials) {
+			for (const int32_t texture : { material.baseColorTexture, material.metallicRoughnessTexture, material.normalTexture, material.emissiveTexture, material.occlusionTexture }) {
+				if (!isIndexInside(texture, scene.textures.size()))
+					return false;
+			}
+		}
+
+		for (const auto& texture : scene.textures) {
+			if (!isIndexInside(texture.buffer, bufferRanges.size()))
+				return false;
+			if (texture.buffer > -1 && !isRangeInside(texture.offset, texture.size, 1, 1, bufferSize(texture.buffer)))
+				return false;
+		}
+
+		for (const auto& cell : scene.cells) {
+			for (const uint32_t node : cell.nodes) {
+				if (node >= scene.nodes.size())
+					return false;
+			}
+			for (const uint32_t texture : cell.textures) {
+				if (texture >= scene.textures.size())
+					return false;
+			}
+			if (!isIndexInside(cell.buffer, bufferRanges.size()))
+				return false;
+			if (cell.buffer > -1 && !isRangeInside(cell.offset, cell.size, 1, 1, bufferSize(cell.buffer)))
+				return false;
+		}
+
+		return true;
+	}
+}
+
+SceneCache::SceneCache(const std::filesystem::path& directory, bool compress) : m_directory(directory), m_compress(compress) {
+}
+
+uint64_t SceneCache::hash(std::span<const byte> data) {
+	// four independent lanes so the multiplies pipeline, then a final avalanche
+	constexpr uint64_t PRIME1 = 0x9E3779B185EBCA87ull;
+	constexpr uint64_t PRIME2 = 0xC2B2AE3D27D4EB4Full;
+	constexpr uint64_t PRIME3 = 0x165667B19E3779F9ull;
+	const auto rotl = [](uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+	const auto round = [&](uint64_t acc, uint64_t v) { return rotl(acc + v * PRIME2, 31) * PRIME1; };
+
+	uint64_t lanes[4] = { PRIME1 + PRIME2, PRIME2, 0, 0 - PRIME1 };
+	const byte* p = data.data();
+	size_t remaining = data.size();
+	while (remaining >= 32) {
+		for (int i = 0; i < 4; i++) {
+			uint64_t v;
+			std::memcpy(&v, p + i * 8, sizeof(v));
+			lanes[i] = round(lanes[i], v);
+		}
+		p += 32;
+		remaining -= 32;
+	}
+
+	uint64_t h = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18) + data.size();
+	while (remaining > 0) {
+		h = rotl(h ^ (*p++ * PRIME3), 11) * PRIME1;
+		remaining--;
+	}
+
+	h ^= h >> 33;
+	h *= PRIME2;
+	h ^= h >> 29;
+	h *= PRIME3;
+	h ^= h >> 32;
+	return h;
+}
+
+uint64_t SceneCache::key(uint64_t sourceHash, std::span<const byte> settings) {
+	BinaryWriter writer;
+	writer.write<uint32_t>(SCENE_CACHE_VERSION);
+	writer.write<uint64_t>(sourceHash);
+	writer.data.insert(writer.data.end(), settings.begin(), settings.end());
+	return SceneCache::hash(writer.data);
+}
+
+std::filesystem::path SceneCache::entryPath(uint64_t sourceHash) const {
+	std::ostringstream name;
+	name << std::hex << std::setw(16) << std::setfill('0') << sourceHash << ".scene";
+	return this->m_directory / name.str();
+}
+
+std::filesystem::path SceneCache::stampPath(const std::filesystem::path& source) const {
+	const std::string canonical = std::filesystem::weakly_canonical(source).generic_string();
+	std::ostringstream name;
+	name << std::hex << std::setw(16) << std::setfill('0') << SceneCache::hash({ reinterpret_cast<const byte*>(canonical.data()), canonical.size() }) << ".stamp";
+	return this->m_directory / name.str();
+}
+
+uint64_t SceneCache::sourceHash(const std::filesystem::path& source) const {
+	const uint64_t size = std::filesystem::file_size(source);
+	const int64_t writeTime = lastWriteTime(source);
+	const auto path = this->stampPath(source);
+
+	if (std::filesystem::exists(path)) {
+		try {
+			MappedFile stamp{ path.string() };
+			BinaryReader reader{ stamp.span() };
+			if (reader.read<uint32_t>() == SCENE_CACHE_VERSION && reader.read<uint64_t>() == size && reader.read<int64_t>() == writeTime)
+				return reader.read<uint64_t>();
+		}
+		catch (const std::exception&) {
+		}
+	}
+
+	const uint64_t contentHash = SceneCache::hash(MappedFile{ source.string() }.span());
+
+	BinaryWriter writer;
+	writer.write<uint32_t>(SCENE_CACHE_VERSION);
+	writer.write<uint64_t>(size);
+	writer.write<int64_t>(writeTime);
+	writer.write<uint64_t>(contentHash);
+
+	// a missing stamp only costs a rehash next time
+	std::error_code error;
+	std::filesystem::create_directories(this->m_directory, error);
+	std::ofstream out{ path, std::ios::binary | std::ios::trunc };
+	out.write(reinterpret_cast<const char*>(writer.data.data()), writer.data.size());
+
+	return contentHash;
+}
+
+void SceneCache::store(uint64_t sourceHash, const SceneData& scene) const {
+	std::vector<uint64_t> bufferOffsets;
+	bufferOffsets.reserve(scene.buffers.size());
+	uint64_t payloadSize = 0;
+	for (const auto& buffer : scene.buffers) {
+		payloadSize = alignUp(payloadSize, SCENE_CACHE_ALIGNMENT);
+		bufferOffsets.push_back(payloadSize);
+		payloadSize += buffer.size();
+	}
+
+	BinaryWriter metadata;
+	metadata.write<uint64_t>(scene.buffers.size());
+	for (size_t i = 0; i < scene.buffers.size(); i++) {
+		metadata.write<uint64_t>(bufferOffsets[i]);
+		metadata.write<uint64_t>(scene.buffers[i].size());
+	}
+
+	metadata.write<uint64_t>(scene.meshes.size());
+	for (const auto& primitives : scene.meshes) {
+		metadata.write<uint64_t>(primitives.size());
+		for (const auto& primitive : primitives) {
+			metadata.write<uint64_t>(primitive.attributes.size());
+			for (const auto& attribute : primitive.attributes) {
+				metadata.writeString(attribute.attributeName);
+				metadata.write<uint32_t>(static_cast<uint32_t>(attribute.buffer));
+				metadata.write<uint64_t>(attribute.offset);
+				metadata.write<int32_t>(attribute.stride);
+				metadata.write<uint64_t>(attribute.count);
+				metadata.write(attribute.containerType);
+				metadata.write(attribute.valueType);
+				metadata.write<uint8_t>(attribute.normalized);
+				metadata.write(attribute.encoding);
+			}
+			metadata.write<uint8_t>(primitive.isIndexed);
+			metadata.write<uint32_t>(static_cast<uint32_t>(primitive.indices.buffer));
+			metadata.write<uint64_t>(primitive.indices.offset);
+			metadata.write<int32_t>(primitive.indices.stride);
+			metadata.write<uint64_t>(primitive.indices.count);
+			metadata.write(primitive.indices.indexType);
+			metadata.write(primitive.bbMin);
+			metadata.write(primitive.bbMax);
+			metadata.write(primitive.mode);
+			metadata.write<int32_t>(primitive.material);
+		}
+	}
+
+	metadata.write<uint64_t>(scene.nodes.size());
+	for (const auto& node : scene.nodes) {
+		metadata.write<uint8_t>(node.hasMatrix);
+		metadata.write(node.matrix);
+		metadata.write(node.translation);
+		metadata.write(node.rotation);
+		metadata.write(node.scale);
+		metadata.write<int32_t>(node.mesh);
+		metadata.writeVector(node.children);
+		metadata.writeVector(node.instances);
+		writeAnimation(metadata, node.translationAnimation);
+		writeAnimation(metadata, node.rotationAnimation);
+		writeAnimation(metadata, node.scaleAnimation);
+	}
+	metadata.writeVector(scene.rootNodes);
+	metadata.write<uint64_t>(scene.materials.size());
+	for (const auto& material : scene.materials)
+		writeMaterial(metadata, material);
+
+	metadata.write<uint64_t>(scene.textures.size());
+	for (const auto& texture : scene.textures) {
+		metadata.writeString(texture.path);
+		metadata.write<int32_t>(texture.buffer);
+		metadata.write<uint64_t>(texture.offset);
+		metadata.write<uint64_t>(texture.size);
+		metadata.write(texture.format);
+		writeSampler(metadata, texture.sampler);
+		metadata.write(texture.alphaCutoff);
+	}
+
+	metadata.write<uint64_t>(scene.cells.size());
+	for (const auto& cell : scene.cells) {
+		metadata.write(cell.coordinate);
+		metadata.write(cell.bbMin);
+		metadata.write(cell.bbMax);
+		metadata.writeVector(cell.nodes);
+		metadata.writeVector(cell.textures);
+		metadata.write<int32_t>(cell.buffer);
+		metadata.write<uint64_t>(cell.offset);
+		metadata.write<uint64_t>(cell.size);
+	}
+
+	metadata.write<uint64_t>(scene.dependencies.size());
+	for (const auto& dependency : scene.dependencies) {
+		metadata.writeString(dependency);
+		metadata.write<uint64_t>(std::filesystem::file_size(dependency));
+		metadata.write<int64_t>(lastWriteTime(dependency));
+	}
+
+	std::vector<byte> payload(payloadSize, 0);
+	for (size_t i = 0; i < scene.buffers.size(); i++)
+		std::memcpy(payload.data() + bufferOffsets[i], scene.buffers[i].data(), scene.buffers[i].size());
+
+	const uint64_t blockCount = (payloadSize + SCENE_CACHE_BLOCK_SIZE - 1) / SCENE_CACHE_BLOCK_SIZE;
+	std::vector<std::vector<byte>> compressedBlocks(this->m_compress ? blockCount : 0);
+	if (this->m_compress) {
+		std::vector<size_t> blockIndices(blockCount);
+		std::iota(blockIndices.begin(), blockIndices.end(), size_t{ 0 });
+		std::for_each(std::execution::par, blockIndices.begin(), blockIndices.end(), [&](const size_t i) {
+			const uint64_t offset = i * SCENE_CACHE_BLOCK_SIZE;
+			const auto block = std::span<const byte>{ payload }.subspan(offset, std::min(SCENE_CACHE_BLOCK_SIZE, payloadSize - offset));
+			compressBlock(block, compressedBlocks[i]);
+			// incompressible blocks are stored as-is
+			if (compressedBlocks[i].size() >= block.size())
+				compressedBlocks[i].clear();
+		});
+	}
+
+	SceneCacheHeader header{};
+	std::memcpy(header.magic, SCENE_CACHE_MAGIC, sizeof(header.magic));
+	header.version = SCENE_CACHE_VERSION;
+	header.compressed = this->m_compress;
+	header.sourceHash = sourceHash;
+	header.metadataOffset = SCENE_CACHE_HEADER_SIZE;
+	header.metadataSize = metadata.data.size();
+	header.blockTableOffset = alignUp(header.metadataOffset + header.metadataSize, SCENE_CACHE_ALIGNMENT);
+	header.blockCount = blockCount;
+	header.payloadOffset = alignUp(header.blockTableOffset + blockCount * SCENE_CACHE_BLOCK_ENTRY_SIZE, SCENE_CACHE_ALIGNMENT);
+	header.payloadSize = payloadSize;
+
+	std::vector<SceneCacheBlock> blocks(blockCount);
+	uint64_t fileOffset = header.payloadOffset;
+	for (uint64_t i = 0; i < blockCount; i++) {
+		const uint32_t size = static_cast<uint32_t>(std::min(SCENE_CACHE_BLOCK_SIZE, payloadSize - i * SCENE_CACHE_BLOCK_SIZE));
+		const bool isCompressed = this->m_compress && !compressedBlocks[i].empty();
+		blocks[i] = SceneCacheBlock{ fileOffset, isCompressed ? static_cast<uint32_t>(compressedBlocks[i].size()) : size, size };
+		fileOffset += blocks[i].storedSize;
+	}
+
+	BinaryWriter headerData;
+	writeHeader(headerData, header);
+	BinaryWriter blockTable;
+	for (const auto& block : blocks) {
+		blockTable.write<uint64_t>(block.offset);
+		blockTable.write<uint32_t>(block.storedSize);
+		blockTable.write<uint32_t>(block.size);
+	}
+
+	std::filesystem::create_directories(this->m_directory);
+	const auto path = this->entryPath(sourceHash);
+	auto tempPath = path;
+	tempPath += ".tmp";
+
+	{
+		std::ofstream out{ tempPath, std::ios::binary | std::ios::trunc };
+		if (!out)
+			throw std::runtime_error("Could not create scene cache file " + tempPath.string());
+
+		const auto pad = [&](uint64_t offset) {
+			static const char zeros[SCENE_CACHE_ALIGNMENT] = {};
+			out.write(zeros, offset - static_cast<uint64_t>(out.tellp()));
+		};
+
+		out.write(reinterpret_cast<const char*>(headerData.data.data()), headerData.data.size());
+		out.write(reinterpret_cast<const char*>(metadata.data.data()), metadata.data.size());
+		pad(header.blockTableOffset);
+		out.write(reinterpret_cast<const char*>(blockTable.data.data()), blockTable.data.size());
+		pad(header.payloadOffset);
+		for (uint64_t i = 0; i < blockCount; i++) {
+			if (blocks[i].storedSize != blocks[i].size)
+				out.write(reinterpret_cast<const char*>(compressedBlocks[i].data()), compressedBlocks[i].size());
+			else
+				out.write(reinterpret_cast<const char*>(payload.data() + i * SCENE_CACHE_BLOCK_SIZE), blocks[i].size);
+		}
+
+		if (!out)
+			throw std::runtime_error("Could not write scene cache file " + tempPath.string());
+	}
+
+	std::filesystem::rename(tempPath, path);
+}
+
+std::optional<SceneData> SceneCache::load(uint64_t sourceHash) const {
+	const auto path = this->entryPath(sourceHash);
+	if (!std::filesystem::exists(path))
+		return std::nullopt;
+
+	MappedFile file{ path.string() };
+	if (file.size() < SCENE_CACHE_HEADER_SIZE)
+		return std::nullopt;
+	BinaryReader headerReader{ file.span().subspan(0, SCENE_CACHE_HEADER_SIZE) };
+	const SceneCacheHeader header = readHeader(headerReader);
+
+	if (std::memcmp(header.magic, SCENE_CACHE_MAGIC, sizeof(header.magic)) != 0 || header.version != SCENE_CACHE_VERSION || header.sourceHash != sourceHash)
+		return std::nullopt;
+	if (header.metadataOffset + header.metadataSize > file.size() || header.blockTableOffset + header.blockCount * SCENE_CACHE_BLOCK_ENTRY_SIZE > file.size())
+		return std::nullopt;
+
+	SceneData scene{};
+	std::vector<std::pair<uint64_t, uint64_t>> bufferRanges;
+
+	try {
+		BinaryReader reader{ file.span().subspan(header.metadataOffset, header.metadataSize) };
+
+		bufferRanges.resize(reader.read<uint64_t>());
+		for (auto& [offset, size] : bufferRanges) {
+			offset = reader.read<uint64_t>();
+			size = reader.read<uint64_t>();
+			if (!isRangeInside(offset, size, 1, 1, header.payloadSize))
+				return std::nullopt;
+		}
+
+		scene.meshes.resize(reader.read<uint64_t>());
+		for (auto& primitives : scene.meshes) {
+			primitives.resize(reader.read<uint64_t>());
+			for (auto& primitive : primitives) {
+				primitive.attributes.resize(reader.read<uint64_t>());
+				for (auto& attribute : primitive.attributes) {
+					attribute.attributeName = reader.readString();
+					attribute.buffer = Buffer{ reader.read<uint32_t>() };
+					attribute.offset = reader.read<uint64_t>();
+					attribute.stride = reader.read<int32_t>();
+					attribute.count = reader.read<uint64_t>();
+					attribute.containerType = reader.read<AttributeContainerType>();
+					attribute.valueType = reader.read<AttributeValueType>();
+					attribute.normalized = reader.read<uint8_t>();
+					attribute.encoding = reader.read<AttributeEncoding>();
+				}
+				primitive.isIndexed = reader.read<uint8_t>();
+				primitive.indices.buffer = Buffer{ reader.read<uint32_t>() };
+				primitive.indices.offset = reader.read<uint64_t>();
+				primitive.indices.stride = reader.read<int32_t>();
+				primitive.indices.count = reader.read<uint64_t>();
+				primitive.indices.indexType = reader.read<AttributeValueType>();
+				primitive.bbMin = reader.read<glm::vec<3, double>>();
+				primitive.bbMax = reader.read<glm::vec<3, double>>();
+				primitive.mode = reader.read<MeshPrimitiveMode>();
+				primitive.material = reader.read<int32_t>();
+			}
+		}
+
+		scene.nodes.resize(reader.read<uint64_t>());
+		for (auto& node : scene.nodes) {
+			node.hasMatrix = reader.read<uint8_t>();
+			node.matrix = reader.read<glm::mat4>();
+			node.translation = reader.read<glm::vec3>();
+			node.rotation = reader.read<glm::quat>();
+			node.scale = reader.read<glm::vec3>();
+			node.mesh = reader.read<int32_t>();
+			node.children = reader.readVector<uint32_t>();
+			node.instances = reader.readVector<glm::mat4>();
+			node.translationAnimation = readAnimation<glm::vec3>(reader);
+			node.rotationAnimation = readAnimation<glm::quat>(reader);
+			node.scaleAnimation = readAnimation<glm::vec3>(reader);
+		}
+		scene.rootNodes = reader.readVector<uint32_t>();
+		scene.materials.resize(reader.read<uint64_t>());
+		for (auto& material : scene.materials)
+			material = readMaterial(reader);
+
+		scene.textures.resize(reader.read<uint64_t>());
+		for (auto& texture : scene.textures) {
+			texture.path = reader.readString();
+			texture.buffer = reader.read<int32_t>();
+			texture.offset = reader.read<uint64_t>();
+			texture.size = reader.read<uint64_t>();
+			texture.format = reader.read<ImageFormat>();
+			texture.sampler = readSampler(reader);
+			texture.alphaCutoff = reader.read<float>();
+		}
+
+		scene.cells.resize(reader.read<uint64_t>());
+		for (auto& cell : scene.cells) {
+			cell.coordinate = reader.read<glm::ivec2>();
+			cell.bbMin = reader.read<glm::vec3>();
+			cell.bbMax = reader.read<glm::vec3>();
+			cell.nodes = reader.readVector<uint32_t>();
+			cell.textures = reader.readVector<uint32_t>();
+			cell.buffer = reader.read<int32_t>();
+			cell.offset = reader.read<uint64_t>();
+			cell.size = reader.read<uint64_t>();
+		}
+
+		scene.dependencies.resize(reader.read<uint64_t>());
+		for (auto& dependency : scene.dependencies) {
+			dependency = reader.readString();
+			const uint64_t size = reader.read<uint64_t>();
+			const int64_t writeTime = reader.read<int64_t>();
+			if (!std::filesystem::exists(dependency) || std::filesystem::file_size(dependency) != size || lastWriteTime(dependency) != writeTime)
+				return std::nullopt;
+		}
+	}
+	catch (const std::exception&) {
+		return std::nullopt;
+	}
+	if (!isSceneConsistent(scene, bufferRanges))
+		return std::nullopt;
+
+	std::vector<SceneCacheBlock> blocks(header.blockCount);
+	BinaryReader blockReader{ file.span().subspan(header.blockTableOffset, header.blockCount * SCENE_CACHE_BLOCK_ENTRY_SIZE) };
+	for (auto& block : blocks) {
+		block.offset = blockReader.read<uint64_t>();
+		block.storedSize = blockReader.read<uint32_t>();
+		block.size = blockReader.read<uint32_t>();
+	}
+	for (size_t i = 0; i < blocks.size(); i++) {
+		if (blocks[i].offset + blocks[i].storedSize > file.size() || i * SCENE_CACHE_BLOCK_SIZE + blocks[i].size > header.payloadSize)
+			return std::nullopt;
+	}
+
+	std::span<const byte> payload{};
+	if (!header.compressed) {
+		if (header.payloadOffset + header.payloadSize > file.size())
+			return std::nullopt;
+		payload = file.span().subspan(header.payloadOffset, header.payloadSize);
+	}
+	else {
+		std::vector<byte>& storage = scene.ownedBuffers.emplace_back(header.payloadSize);
+
+		std::vector<size_t> blockIndices(blocks.size());
+		std::iota(blockIndices.begin(), blockIndices.end(), size_t{ 0 });
+		// exceptions must not escape a parallel algorithm, so failures are only flagged here
+		std::atomic<bool> failed = false;
+		std::for_each(std::execution::par, blockIndices.begin(), blockIndices.end(), [&](const size_t i) {
+			const auto& block = blocks[i];
+			const auto src = file.span().subspan(block.offset, block.storedSize);
+			const auto dst = std::span<byte>{ storage }.subspan(i * SCENE_CACHE_BLOCK_SIZE, block.size);
+			if (block.storedSize == block.size) {
+				std::memcpy(dst.data(), src.data(), block.size);
+				return;
+			}
+			try {
+				decompressBlock(src, dst);
+			}
+			catch (const std::exception&) {
+				failed = true;
+			}
+		});
+		if (failed)
+			return std::nullopt;
+
+		payload = storage;
+	}
+
+	scene.buffers.reserve(bufferRanges.size());
+	for (const auto& [offset, size] : bufferRanges)
+		scene.buffers.push_back(payload.subspan(offset, size));
+
+	if (!header.compressed)
+		scene.mappings.push_back(std::move(file));
+
+	return scene;
+}
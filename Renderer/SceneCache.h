@@ -0,0 +1,38 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <span>
+
+#include "SceneData.h"
+
+typedef unsigned char byte;
+
+// On-disk cache of processed scenes, one file per source, named after the hash of the source file contents.
+// Buffer payloads are stored either as-is, in which case a cached scene is read back by mapping the file and
+// pointing the buffers straight into it, or split into independently compressed blocks that are decompressed
+// in parallel.
+class SceneCache
+{
+public:
+	SceneCache(const std::filesystem::path& directory, bool compress = false);
+
+	static uint64_t hash(std::span<const byte> data);
+	// Entry key of a source processed with the settings the caller serialized, the cache version included
+	static uint64_t key(uint64_t sourceHash, std::span<const byte> settings);
+
+	// Content hash of a source file. It is remembered next to the entries along with the file's size and write time,
+	// and only recomputed when either changes, so warm starts don't read the whole source.
+	uint64_t sourceHash(const std::filesystem::path& source) const;
+
+	// Returns std::nullopt if there is no valid cache entry for the hash
+	std::optional<SceneData> load(uint64_t sourceHash) const;
+	void store(uint64_t sourceHash, const SceneData& scene) const;
+
+private:
+	std::filesystem::path m_directory;
+	bool m_compress;
+
+	std::filesystem::path entryPath(uint64_t sourceHash) const;
+	std::filesystem::path stampPath(const std::filesystem::path& source) const;
+};
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <span>
+#include <optional>
+#include <memory>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "Mesh.h"
+#include "Animation.h"
+#include "Material.h"
+#include "Image.h"
+#include "Sampler.h"
+#include "MappedFile.h"
+
+typedef unsigned char byte;
+
+// keyframe arrays are shared by every animation decoded from the same accessors
+template<typename T> struct AnimationData {
+	std::shared_ptr<const std::vector<float>> keyframeTimes;
+	std::shared_ptr<const std::vector<T>> keyframes;
+	AnimationInterpolationCurve interpolation = AnimationInterpolationCurve::eLinear;
+};
+
+struct SceneNodeData {
+	bool hasMatrix = false;
+	glm::mat4 matrix{ 1.0f };
+	glm::vec3 translation{ 0.0f };
+	glm::quat rotation{ 1.0f, 0.0f, 0.0f, 0.0f };
+	glm::vec3 scale{ 1.0f };
+
+	int32_t mesh = -1;
+	std::vector<uint32_t> children;
+	// EXT_mesh_gpu_instancing transforms relative to the node, the mesh is drawn once per entry. Empty for nodes
+	// drawing their mesh once.
+	std::vector<glm::mat4> instances;
+
+	std::optional<AnimationData<glm::vec3>> translationAnimation;
+	std::optional<AnimationData<glm::quat>> rotationAnimation;
+	std::optional<AnimationData<glm::vec3>> scaleAnimation;
+};
+
+// The buffer handles of the descriptions are indices into SceneData::buffers until the scene is uploaded
+struct ScenePrimitiveData {
+	std::vector<VertexAttributeDescription> attributes;
+	bool isIndexed = false;
+	IndexBufferDescription indices{};
+	glm::vec<3, double> bbMin{ 0.0 };
+	glm::vec<3, double> bbMax{ 0.0 };
+	MeshPrimitiveMode mode = MeshPrimitiveMode::eTriangles;
+	int32_t material = -1;
+};
+
+struct SceneTextureData {
+	// image file, empty for images embedded in one of the scene buffers
+	std::string path;
+	int32_t buffer = -1;
+	size_t offset = 0;
+	size_t size = 0;
+
+	ImageFormat format = ImageFormat::eR8G8B8A8Unorm;
+	Sampler sampler{};
+	// alpha cutoff of the masked materials using it as base color, 0 if there are none
+	float alphaCutoff = 0.0f;
+};
+
+// A square cell of the world grid and the mesh nodes centered in it, loaded and unloaded as a unit when the world
+// is streamed. Its geometry is the contiguous range [offset, offset + size) of buffers[buffer].
+struct SceneCellData {
+	// grid coordinates on the XZ plane
+	glm::ivec2 coordinate{ 0 };
+	// world space bounds of the cell's nodes, which may reach past the cell itself
+	glm::vec3 bbMin{ 0.0f };
+	glm::vec3 bbMax{ 0.0f };
+	std::vector<uint32_t> nodes;
+	// scene textures the materials of the cell's primitives sample
+	std::vector<uint32_t> textures;
+	int32_t buffer = -1;
+	size_t offset = 0;
+	size_t size = 0;
+};
+
+// Processed, renderer-ready contents of a scene file. Produced either by the glTF importer or read back from the
+// scene cache, then uploaded by the loader.
+struct SceneData {
+	std::vector<std::span<const byte>> buffers;
+	std::vector<std::vector<ScenePrimitiveData>> meshes;
+	std::vector<SceneNodeData> nodes;
+	std::vector<uint32_t> rootNodes;
+	std::vector<MaterialData> materials;
+	std::vector<SceneTextureData> textures;
+	// empty unless the scene was partitioned for world streaming
+	std::vector<SceneCellData> cells;
+
+	// external files the buffers were read from, checked when the scene is read back from the cache
+	std::vector<std::string> dependencies;
+
+	// storage behind the buffer spans
+	std::vector<MappedFile> mappings;
+	std::vector<std::vector<byte>> ownedBuffers;
+};
@@ -0,0 +1,291 @@
+#include "TangentGeneration.h"
+
+#include <algorithm>
+#include <execution>
+#include <numeric>
+#include <unordered_map>
+#include <array>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+
+#include <glm/geometric.hpp>
+
+#include "AccessorKernels.h"
+#include "PrimitiveRewrite.h"
+#include "VertexQuantization.h"
+
+namespace {
+	// triangles or vertices handed to one task of the parallel passes
+	constexpr size_t CHUNK_SIZE = 4096;
+
+	const VertexAttributeDescription* findAttribute(const ScenePrimitiveData& primitive, const char* attributeName) {
+		for (const auto& attribute : primitive.attributes) {
+			if (attribute.attributeName == attributeName)
+				return &attribute;
+		}
+		return nullptr;
+	}
+
+	// MikkTSpace's test for zero lengths and areas
+	bool notZero(const float v) {
+		return std::abs(v) > FLT_MIN;
+	}
+
+	// Removes the component along n and normalizes, zero vectors stay zero
+	glm::vec3 projectOnPlane(const glm::vec3& v, const glm::vec3& n) {
+		const glm::vec3 p = v - n * glm::dot(n, v);
+		const float length = glm::length(p);
+		return notZero(length) ? p / length : p;
+	}
+
+	// Runs fn(begin, end) over ranges of count items on the parallel algorithms thread pool
+	template<typename F> void forEachChunk(const size_t count, F&& fn) {
+		std::vector<size_t> chunks((count + CHUNK_SIZE - 1) / CHUNK_SIZE);
+		std::iota(chunks.begin(), chunks.end(), size_t{ 0 });
+		std::for_each(std::execution::par, chunks.begin(), chunks.end(), [&](const size_t chunk) {
+			fn(chunk * CHUNK_SIZE, std::min(count, (chunk + 1) * CHUNK_SIZE));
+		});
+	}
+
+	// Position, normal and texture coordinate of a vertex, compared bitwise with negative zeros folded into zeros
+	struct WeldKey {
+		std::array<float, 8> values;
+
+		bool operator==(const WeldKey& other) const {
+			return std::memcmp(this->values.data(), other.values.data(), sizeof(this->values)) == 0;
+		}
+	};
+
+	struct WeldKeyHash {
+		size_t operator()(const WeldKey& key) const {
+			uint32_t bits[8];
+			std::memcpy(bits, key.values.data(), sizeof(bits));
+			uint64_t h = 0xCBF29CE484222325ull;
+			for (const uint32_t b : bits)
+				h = (h ^ b) * 0x100000001B3ull;
+			return static_cast<size_t>(h ^ (h >> 32));
+		}
+	};
+
+	WeldKey weldKey(const glm::vec4& position, const glm::vec4& normal, const glm::vec4& texcoord) {
+		WeldKey key{ { position.x, position.y, position.z, normal.x, normal.y, normal.z, texcoord.x, texcoord.y } };
+		for (float& v : key.values)
+			v = v == 0.0f ? 0.0f : v;
+		return key;
+	}
+
+	// Empty data if the primitive got no tangents
+	struct PrimitiveTangents {
+		// the primitive's vertices were split, so its attributes and indices are part of data too
+		bool rewritten = false;
+		std::vector<byte> data;
+		std::vector<size_t> attributeOffsets;
+		size_t tangentOffset = 0;
+		size_t vertexCount = 0;
+		size_t indexOffset = 0;
+	};
+
+	PrimitiveTangents generatePrimitiveTangents(const SceneData& scene, const ScenePrimitiveData& primitive) {
+		PrimitiveTangents result{};
+		if (primitive.mode != MeshPrimitiveMode::eTriangles || findAttribute(primitive, "TANGENT"))
+			return result;
+
+		const VertexAttributeDescription* positionAttribute = findAttribute(primitive, "POSITION");
+		const VertexAttributeDescription* normalAttribute = findAttribute(primitive, "NORMAL");
+		const VertexAttributeDescription* texcoordAttribute = findAttribute(primitive, "TEXCOORD_0");
+		if (!positionAttribute || !normalAttribute || !texcoordAttribute)
+			return result;
+
+		const size_t vertexCount = positionAttribute->count;
+		const bool consistentCounts = std::all_of(primitive.attributes.begin(), primitive.attributes.end(), [vertexCount](const VertexAttributeDescription& attribute) { return attribute.count == vertexCount; });
+		if (vertexCount == 0 || !consistentCounts)
+			return result;
+
+		const std::vector<glm::vec4> positions = decodeVertexAttribute(scene, primitive, *positionAttribute);
+		const std::vector<glm::vec4> normals = decodeVertexAttribute(scene, primitive, *normalAttribute);
+		const std::vector<glm::vec4> texcoords = decodeVertexAttribute(scene, primitive, *texcoordAttribute);
+
+		std::vector<uint32_t> indices;
+		if (primitive.isIndexed) {
+			indices.resize(primitive.indices.count);
+			selectIndexWidenKernel(primitive.indices.indexType)(scene.buffers[static_cast<uint32_t>(primitive.indices.buffer)].data() + primitive.indices.offset, indices.size(), indices.data());
+			// malformed primitives are left without tangents, like optimizePrimitive leaves them unoptimized
+			if (std::any_of(indices.begin(), indices.end(), [vertexCount](const uint32_t index) { return index >= vertexCount; }))
+				return result;
+		}
+		else {
+			indices.resize(vertexCount);
+			std::iota(indices.begin(), indices.end(), uint32_t{ 0 });
+		}
+
+		const size_t triangleCount = indices.size() / 3;
+		const size_t cornerCount = triangleCount * 3;
+		if (triangleCount == 0)
+			return result;
+
+		// MikkTSpace doesn't look at the indices, vertices with the same position, normal and texture coordinate
+		// are the same vertex to it
+		std::vector<uint32_t> welded(vertexCount);
+		{
+			std::unordered_map<WeldKey, uint32_t, WeldKeyHash> firstVertex;
+			firstVertex.reserve(vertexCount);
+			for (uint32_t v = 0; v < vertexCount; v++)
+				welded[v] = firstVertex.try_emplace(weldKey(positions[v], normals[v], texcoords[v]), v).first->second;
+		}
+
+		// Direction of increasing s on every triangle, and whether the texture mapping keeps (1) or mirrors (-1) the
+		// triangle's orientation. Triangles without texture area have no say (0).
+		// glTF texture coordinates have t pointing down. MikkTSpace and the glTF reference tangents see it pointing up,
+		// which leaves the tangent as is but flips the orientation, and with it the bitangent's sign in w.
+		std::vector<glm::vec3> triangleTangents(triangleCount);
+		std::vector<int8_t> triangleOrientations(triangleCount);
+		forEachChunk(triangleCount, [&](const size_t begin, const size_t end) {
+			for (size_t t = begin; t < end; t++) {
+				const uint32_t i0 = indices[t * 3 + 0];
+				const uint32_t i1 = indices[t * 3 + 1];
+				const uint32_t i2 = indices[t * 3 + 2];
+
+				const glm::vec3 d1 = glm::vec3(positions[i1] - positions[i0]);
+				const glm::vec3 d2 = glm::vec3(positions[i2] - positions[i0]);
+				const glm::vec2 t21 = glm::vec2(texcoords[i1] - texcoords[i0]) * glm::vec2{ 1.0f, -1.0f };
+				const glm::vec2 t31 = glm::vec2(texcoords[i2] - texcoords[i0]) * glm::vec2{ 1.0f, -1.0f };
+
+				const float signedArea = t21.x * t31.y - t21.y * t31.x;
+				const glm::vec3 os = t31.y * d1 - t21.y * d2;
+				const float length = glm::length(os);
+				const float orientation = signedArea > 0.0f ? 1.0f : -1.0f;
+
+				triangleOrientations[t] = notZero(signedArea) ? static_cast<int8_t>(orientation) : 0;
+				triangleTangents[t] = notZero(signedArea) && notZero(length) ? os * (orientation / length) : glm::vec3{ 0.0f };
+			}
+		});
+
+		// every corner's share: the triangle tangent in the plane of the vertex normal, weighted by the corner angle
+		std::vector<glm::vec3> cornerTangents(cornerCount, glm::vec3{ 0.0f });
+		forEachChunk(triangleCount, [&](const size_t begin, const size_t end) {
+			for (size_t t = begin; t < end; t++) {
+				if (triangleOrientations[t] == 0)
+					continue;
+				for (size_t c = 0; c < 3; c++) {
+					const uint32_t v = indices[t * 3 + c];
+					const glm::vec3 p = glm::vec3(positions[v]);
+					const glm::vec3 n = glm::vec3(normals[v]);
+					const glm::vec3 e1 = projectOnPlane(glm::vec3(positions[indices[t * 3 + (c + 1) % 3]]) - p, n);
+					const glm::vec3 e2 = projectOnPlane(glm::vec3(positions[indices[t * 3 + (c + 2) % 3]]) - p, n);
+					const float angle = std::acos(std::clamp(glm::dot(e1, e2), -1.0f, 1.0f));
+					cornerTangents[t * 3 + c] = projectOnPlane(triangleTangents[t], n) * angle;
+				}
+			}
+		});
+
+		// Corners are grouped by welded vertex and orientation. Corners of triangles without texture area join the
+		// first orientation seen at their vertex.
+		std::vector<int8_t> vertexOrientations(vertexCount, 0);
+		for (size_t c = 0; c < cornerCount; c++) {
+			int8_t& orientation = vertexOrientations[welded[indices[c]]];
+			if (orientation == 0)
+				orientation = triangleOrientations[c / 3];
+		}
+
+		std::vector<int8_t> cornerOrientations(cornerCount);
+		std::vector<glm::vec3> groupTangents(vertexCount * 2, glm::vec3{ 0.0f });
+		for (size_t c = 0; c < cornerCount; c++) {
+			const uint32_t w = welded[indices[c]];
+			const int8_t orientation = triangleOrientations[c / 3] != 0 ? triangleOrientations[c / 3] : vertexOrientations[w] != 0 ? vertexOrientations[w] : 1;
+			cornerOrientations[c] = orientation;
+			groupTangents[w * 2 + (orientation < 0)] += cornerTangents[c];
+		}
+
+		// a vertex keeps the orientation of the first corner using it, corners with the other one get a copy of it
+		std::vector<uint32_t> sourceVertices(vertexCount);
+		std::iota(sourceVertices.begin(), sourceVertices.end(), uint32_t{ 0 });
+		std::vector<int8_t> outputOrientations(vertexCount, 0);
+		std::vector<uint32_t> mirroredCopies(vertexCount, UINT32_MAX);
+		std::vector<uint32_t> outputIndices = indices;
+		for (size_t c = 0; c < cornerCount; c++) {
+			const uint32_t v = indices[c];
+			if (outputOrientations[v] == 0)
+				outputOrientations[v] = cornerOrientations[c];
+			else if (outputOrientations[v] != cornerOrientations[c]) {
+				if (mirroredCopies[v] == UINT32_MAX) {
+					mirroredCopies[v] = static_cast<uint32_t>(sourceVertices.size());
+					sourceVertices.push_back(v);
+					outputOrientations.push_back(cornerOrientations[c]);
+				}
+				outputIndices[c] = mirroredCopies[v];
+			}
+		}
+
+		const size_t outputVertexCount = sourceVertices.size();
+		std::vector<glm::vec4> tangents(outputVertexCount);
+		forEachChunk(outputVertexCount, [&](const size_t begin, const size_t end) {
+			for (size_t vertex = begin; vertex < end; vertex++) {
+				const uint32_t v = sourceVertices[vertex];
+				const float orientation = outputOrientations[vertex] < 0 ? -1.0f : 1.0f;
+				const glm::vec3 sum = groupTangents[welded[v] * 2 + (orientation < 0.0f)];
+				const float length = glm::length(sum);
+
+				glm::vec3 tangent;
+				if (notZero(length))
+					tangent = sum / length;
+				else {
+					// no triangle with texture area touches the vertex, any direction in the normal's plane will do
+					const glm::vec3 n = glm::vec3(normals[v]);
+					tangent = glm::normalize(glm::cross(std::abs(n.x) > 0.9f ? glm::vec3{ 0.0f, 1.0f, 0.0f } : glm::vec3{ 1.0f, 0.0f, 0.0f }, n));
+				}
+				tangents[vertex] = glm::vec4{ tangent, orientation };
+			}
+		});
+
+		result.vertexCount = outputVertexCount;
+		result.rewritten = outputVertexCount != vertexCount;
+
+		if (result.rewritten) {
+			for (const auto& attribute : primitive.attributes) {
+				const size_t elementSize = componentCountFromAttributeContainerType(attribute.containerType) * sizeFromAttributeValueType(attribute.valueType);
+				const size_t srcStride = attribute.stride > 0 ? static_cast<size_t>(attribute.stride) : elementSize;
+				const size_t dstStride = alignUp(elementSize, VERTEX_DATA_ALIGNMENT);
+				const byte* src = scene.buffers[static_cast<uint32_t>(attribute.buffer)].data() + attribute.offset;
+
+				const size_t offset = alignUp(result.data.size(), 16);
+				result.data.resize(offset + dstStride * outputVertexCount, 0);
+				for (size_t i = 0; i < outputVertexCount; i++)
+					std::memcpy(result.data.data() + offset + i * dstStride, src + sourceVertices[i] * srcStride, elementSize);
+				result.attributeOffsets.push_back(offset);
+			}
+
+			result.indexOffset = alignUp(result.data.size(), 16);
+			result.data.resize(result.indexOffset + outputIndices.size() * sizeof(uint32_t));
+			std::memcpy(result.data.data() + result.indexOffset, outputIndices.data(), outputIndices.size() * sizeof(uint32_t));
+		}
+
+		result.tangentOffset = alignUp(result.data.size(), 16);
+		result.data.resize(result.tangentOffset + tangents.size() * sizeof(glm::vec4));
+		std::memcpy(result.data.data() + result.tangentOffset, tangents.data(), tangents.size() * sizeof(glm::vec4));
+
+		return result;
+	}
+}
+
+void generateSceneTangents(SceneData& scene) {
+	rewriteScenePrimitives(scene, generatePrimitiveTangents, [](ScenePrimitiveData& primitive, const PrimitiveTangents& generated, const Buffer buffer, const size_t baseOffset) {
+		if (generated.rewritten) {
+			for (size_t a = 0; a < primitive.attributes.size(); a++) {
+				auto& attribute = primitive.attributes[a];
+				const size_t elementSize = componentCountFromAttributeContainerType(attribute.containerType) * sizeFromAttributeValueType(attribute.valueType);
+				attribute.buffer = buffer;
+				attribute.offset = baseOffset + generated.attributeOffsets[a];
+				attribute.stride = static_cast<int32_t>(alignUp(elementSize, VERTEX_DATA_ALIGNMENT));
+				attribute.count = generated.vertexCount;
+			}
+
+			primitive.indices.buffer = buffer;
+			primitive.indices.offset = baseOffset + generated.indexOffset;
+			primitive.indices.stride = static_cast<int32_t>(sizeof(uint32_t));
+			primitive.indices.indexType = AttributeValueType::eUint32;
+		}
+
+		primitive.attributes.push_back(VertexAttributeDescription{ "TANGENT", buffer, baseOffset + generated.tangentOffset, static_cast<int32_t>(sizeof(glm::vec4)), generated.vertexCount, AttributeContainerType::eVec4, AttributeValueType::eFloat });
+	});
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "SceneData.h"
+
+// Adds a float TANGENT attribute to every triangle list that has normals and TEXCOORD_0 but no tangents, following
+// MikkTSpace, which is what glTF assets are authored against: per-triangle tangents from the texture mapping,
+// projected on the vertex normal and weighted by the corner angle, summed over corners sharing position, normal and
+// texture coordinate. Corners whose faces disagree on handedness, like at mirrored UV seams, get vertices of their
+// own, in which case the primitive's attributes and indices are rewritten as well.
+//
+// Primitives are processed in parallel, and so are the triangles of large primitives.
+void generateSceneTangents(SceneData& scene);
@@ -0,0 +1,225 @@
+#include "TextureImporter.h"
+
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <array>
+#include <cmath>
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+
+#include <stb_image.h>
+
+#include "BoundedQueue.h"
+#include "MappedFile.h"
+#include "Ktx2.h"
+
+namespace {
+	struct DecodedImage {
+		size_t requestIndex = 0;
+		std::unique_ptr<void, void(*)(void*)> pixels{ nullptr, stbi_image_free };
+		size_t size = 0;
+		// size of what gets uploaded, the levels above it were left out
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t fullWidth = 0;
+		uint32_t fullHeight = 0;
+		uint32_t skippedLevels = 0;
+		std::exception_ptr error = nullptr;
+
+		// KTX2 images are uploaded straight from their container
+		MappedFile file{};
+		std::span<const byte> container{};
+		ImageFormat containerFormat = ImageFormat::eR8G8B8A8Unorm;
+		std::vector<ImageLevel> levels{};
+	};
+
+	// Box filters the texels to half their size in place, every texel written only overwrites ones already read
+	template<typename T, typename ToLinear, typename FromLinear>
+	void halve(T* texels, uint32_t width, uint32_t height, ToLinear toLinear, FromLinear fromLinear) {
+		const uint32_t halfWidth = std::max(width / 2, 1u);
+		const uint32_t halfHeight = std::max(height / 2, 1u);
+		for (uint32_t y = 0; y < halfHeight; y++) {
+			const uint32_t y0 = std::min(2 * y, height - 1);
+			const uint32_t y1 = std::min(2 * y + 1, height - 1);
+			for (uint32_t x = 0; x < halfWidth; x++) {
+				const uint32_t x0 = std::min(2 * x, width - 1);
+				const uint32_t x1 = std::min(2 * x + 1, width - 1);
+				for (uint32_t c = 0; c < 4; c++) {
+					auto at = [&](uint32_t sx, uint32_t sy) { return toLinear(texels[(static_cast<size_t>(sy) * width + sx) * 4 + c], c); };
+					texels[(static_cast<size_t>(y) * halfWidth + x) * 4 + c] = fromLinear((at(x0, y0) + at(x1, y0) + at(x0, y1) + at(x1, y1)) * 0.25f, c);
+				}
+			}
+		}
+	}
+
+	// Leaves out the largest levels of decoded pixels, sRGB color is averaged as linear values
+	void skipLevels(DecodedImage& decoded, uint32_t levels, bool isFloat, bool isSrgb) {
+		std::array<float, 256> srgbToLinear;
+		for (size_t i = 0; i < srgbToLinear.size(); i++) {
+			const float c = i / 255.0f;
+			srgbToLinear[i] = isSrgb ? (c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f)) : c;
+		}
+		auto toLinear = [&](byte value, uint32_t c) { return c < 3 ? srgbToLinear[value] : value / 255.0f; };
+		auto fromLinear = [&](float value, uint32_t c) {
+			if (isSrgb && c < 3)
+				value = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+			return static_cast<byte>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+		};
+
+		for (uint32_t level = 0; level < levels; level++) {
+			if (isFloat)
+				halve(static_cast<float*>(decoded.pixels.get()), decoded.width, decoded.height, [](float value, uint32_t) { return value; }, [](float value, uint32_t) { return value; });
+			else
+				halve(static_cast<byte*>(decoded.pixels.get()), decoded.width, decoded.height, toLinear, fromLinear);
+			decoded.width = std::max(decoded.width / 2, 1u);
+			decoded.height = std::max(decoded.height / 2, 1u);
+		}
+		decoded.size = static_cast<size_t>(decoded.width) * decoded.height * 4 * (isFloat ? sizeof(float) : sizeof(byte));
+		decoded.skippedLevels = levels;
+	}
+
+	DecodedImage decodeImage(size_t requestIndex, const TextureImportRequest& request) {
+		DecodedImage decoded{ requestIndex };
+
+		MappedFile file{};
+		std::span<const byte> encoded = request.data;
+		if (encoded.empty()) {
+			file = MappedFile{ request.path };
+			encoded = file.span();
+		}
+
+		if (isKtx2(encoded)) {
+			Ktx2Image ktx2 = readKtx2(encoded);
+			// only stored levels can be left out, the container's format isn't decoded
+			decoded.skippedLevels = std::min(mipLevelsAbove(ktx2.width, ktx2.height, request.maxSize), static_cast<uint32_t>(ktx2.levels.size()) - 1);
+			decoded.fullWidth = ktx2.width;
+			decoded.fullHeight = ktx2.height;
+			decoded.width = std::max(ktx2.width >> decoded.skippedLevels, 1u);
+			decoded.height = std::max(ktx2.height >> decoded.skippedLevels, 1u);
+			decoded.containerFormat = ktx2.format;
+			decoded.levels.assign(ktx2.levels.begin() + decoded.skippedLevels, ktx2.levels.end());
+			decoded.container = encoded;
+			decoded.file = std::move(file);
+			return decoded;
+		}
+
+		const bool isFloat = request.format == ImageFormat::eR32G32B32A32Sfloat;
+		int w, h, n;
+		if (isFloat)
+			decoded.pixels.reset(stbi_loadf_from_memory(encoded.data(), static_cast<int>(encoded.size()), &w, &h, &n, 4));
+		else
+			decoded.pixels.reset(stbi_load_from_memory(encoded.data(), static_cast<int>(encoded.size()), &w, &h, &n, 4));
+
+		if (decoded.pixels == nullptr)
+			throw std::runtime_error("Could not decode image " + (request.path.empty() ? std::string{ "from buffer" } : request.path) + ": " + stbi_failure_reason());
+
+		decoded.width = decoded.fullWidth = static_cast<uint32_t>(w);
+		decoded.height = decoded.fullHeight = static_cast<uint32_t>(h);
+		decoded.size = static_cast<size_t>(w) * h * 4 * (isFloat ? sizeof(float) : sizeof(byte));
+		if (const uint32_t levels = mipLevelsAbove(decoded.width, decoded.height, request.maxSize); levels > 0)
+			skipLevels(decoded, levels, isFloat, request.format == ImageFormat::eR8G8B8A8Srgb);
+		return decoded;
+	}
+}
+
+TextureImporter::TextureImporter(VulkanRenderer& renderer, uint32_t workerCount, size_t queueCapacity) : m_renderer(renderer), m_queueCapacity(queueCapacity) {
+	// leave one core for the uploading thread
+	this->m_workerCount = workerCount != 0 ? workerCount : std::max(std::thread::hardware_concurrency(), 2u) - 1;
+}
+
+std::vector<Texture> TextureImporter::import(const std::vector<TextureImportRequest>& requests, const std::function<void(size_t, Texture)>& onTextureReady) {
+	std::vector<Texture> textures(requests.size());
+	if (!onTextureReady) {
+		const std::vector<ImportedImage> images = this->importImages(requests);
+		for (size_t i = 0; i < requests.size(); i++)
+			textures[i] = this->m_renderer.makeTexture(images[i].image, requests[i].sampler);
+		return textures;
+	}
+
+	this->importImages(requests, [&](size_t i, const ImportedImage& image) {
+		textures[i] = this->m_renderer.makeTexture(image.image, requests[i].sampler);
+		onTextureReady(i, textures[i]);
+	});
+	return textures;
+}
+
+std::vector<ImportedImage> TextureImporter::importImages(const std::vector<TextureImportRequest>& requests, const std::function<void(size_t, const ImportedImage&)>& onImageReady) {
+	std::vector<ImportedImage> images(requests.size());
+	if (requests.empty())
+		return images;
+
+	BoundedQueue<DecodedImage> decodedQueue{ this->m_queueCapacity };
+	std::atomic<size_t> nextRequest = 0;
+
+	std::vector<std::thread> workers;
+	const size_t workerCount = std::min<size_t>(this->m_workerCount, requests.size());
+	for (size_t w = 0; w < workerCount; w++) {
+		workers.emplace_back([&]() {
+			for (size_t i = nextRequest++; i < requests.size(); i = nextRequest++) {
+				DecodedImage decoded{ i };
+				try {
+					decoded = decodeImage(i, requests[i]);
+				}
+				catch (...) {
+					decoded.error = std::current_exception();
+				}
+				if (!decodedQueue.push(std::move(decoded)))
+					return;
+			}
+		});
+	}
+
+	// uploads are only waited on when the decoders fall behind or enough of them piled up, so readiness doesn't stall the pipeline
+	std::vector<size_t> unreported;
+	auto reportReady = [&]() {
+		this->m_renderer.finishUploads();
+		for (const size_t i : unreported)
+			onImageReady(i, images[i]);
+		unreported.clear();
+	};
+
+	std::exception_ptr error = nullptr;
+	for (size_t received = 0; received < requests.size(); received++) {
+		DecodedImage decoded = decodedQueue.pop().value();
+		if (decoded.error) {
+			error = decoded.error;
+			break;
+		}
+
+		const TextureImportRequest& request = requests[decoded.requestIndex];
+		ImportedImage& imported = images[decoded.requestIndex];
+		imported.width = decoded.fullWidth;
+		imported.height = decoded.fullHeight;
+		imported.skippedLevels = decoded.skippedLevels;
+		imported.format = decoded.levels.empty() ? request.format : decoded.containerFormat;
+
+		Image& image = imported.image;
+		if (decoded.levels.empty())
+			image = this->m_renderer.beginLoadImage(decoded.pixels.get(), decoded.size, decoded.width, decoded.height, request.format, UINT32_MAX, request.alphaCutoff);
+		else if (decoded.levels.size() == 1 && !isBlockCompressed(decoded.containerFormat))
+			image = this->m_renderer.beginLoadImage(decoded.container.data() + decoded.levels[0].offset, decoded.levels[0].size, decoded.width, decoded.height, decoded.containerFormat, UINT32_MAX, request.alphaCutoff);
+		else
+			image = this->m_renderer.beginLoadImageLevels(decoded.container.data(), decoded.width, decoded.height, decoded.containerFormat, decoded.levels);
+
+		if (onImageReady) {
+			unreported.push_back(decoded.requestIndex);
+			if (decodedQueue.empty() || unreported.size() >= this->m_queueCapacity)
+				reportReady();
+		}
+	}
+
+	decodedQueue.close();
+	for (auto& worker : workers)
+		worker.join();
+	this->m_renderer.finishUploads();
+
+	if (error)
+		std::rethrow_exception(error);
+
+	if (onImageReady)
+		reportReady();
+
+	return images;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <string>
+#include <span>
+#include <vector>
+#include <functional>
+
+#include "VulkanRenderer.h"
+#include "Image.h"
+#include "Sampler.h"
+#include "Texture.h"
+
+typedef unsigned char byte;
+
+struct TextureImportRequest {
+	// image file to decode, only used when data is empty
+	std::string path;
+	// encoded image bytes, e.g. a bufferView inside a mapped .glb. Must stay valid until import returns.
+	std::span<const byte> data;
+	ImageFormat format = ImageFormat::eR8G8B8A8Unorm;
+	Sampler sampler{};
+	// alpha cutoff the image is tested against, its generated mip levels keep the share of texels passing it
+	float alphaCutoff = 0.0f;
+	// largest width or height to upload, bigger images leave out their largest levels until they fit
+	uint32_t maxSize = UINT32_MAX;
+};
+
+struct ImportedImage {
+	Image image{};
+	// size of the whole image, and how many of its largest levels maxSize left out
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t skippedLevels = 0;
+	// format it was uploaded with, KTX2 images keep the one in their container
+	ImageFormat format = ImageFormat::eR8G8B8A8Unorm;
+};
+
+// Decodes images on a pool of worker threads and uploads them from the calling thread as they come out of a
+// bounded queue, so decoding, staging copies and GPU uploads of different images overlap.
+// KTX2 images skip decoding and keep the format and mip levels stored in the container. Images larger than their
+// request's maxSize upload their smaller levels only, stored ones when the container has them, or halved on the CPU.
+class TextureImporter
+{
+public:
+	TextureImporter(VulkanRenderer& renderer, uint32_t workerCount = 0, size_t queueCapacity = 4);
+
+	// Returns one image per request, in request order. If onImageReady is given, it is called on the calling
+	// thread with the request index of every image once it is safe to sample, while the rest are still loading.
+	std::vector<ImportedImage> importImages(const std::vector<TextureImportRequest>& requests, const std::function<void(size_t, const ImportedImage&)>& onImageReady = {});
+	// Same as importImages, with a texture made from every image and its request's sampler
+	std::vector<Texture> import(const std::vector<TextureImportRequest>& requests, const std::function<void(size_t, Texture)>& onTextureReady = {});
+
+private:
+	VulkanRenderer& m_renderer;
+	uint32_t m_workerCount;
+	size_t m_queueCapacity;
+};
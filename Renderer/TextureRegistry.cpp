@@ -0,0 +1,234 @@
+#include "TextureRegistry.h"
+
+#include <filesystem>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+
+#include "SceneCache.h"
+
+TextureRegistry::TextureRegistry(VulkanRenderer& renderer, const TextureStreamingSettings& streaming) : m_renderer(renderer), m_streaming(streaming) {}
+
+TextureKey TextureRegistry::key(const TextureImportRequest& request) {
+	std::ostringstream source;
+	if (request.data.empty())
+		source << "file:" << std::filesystem::weakly_canonical(request.path).string();
+	else
+		source << "data:" << std::hex << SceneCache::hash(request.data) << ':' << request.data.size();
+
+	return TextureKey{ TextureImageKey{ source.str(), request.format, request.alphaCutoff }, request.sampler };
+}
+
+Texture TextureRegistry::makeTexture(const TextureKey& key, Image image) {
+	const Texture texture = this->m_renderer.makeTexture(image, key.sampler);
+	this->m_images.at(key.image).refCount++;
+	this->m_textures.insert({ key, texture });
+	this->m_entries.insert({ texture, TextureEntry{ key, 0 } });
+	return texture;
+}
+
+std::vector<Texture> TextureRegistry::acquire(const std::vector<TextureImportRequest>& requests, const std::function<void(size_t, Texture)>& onTextureReady) {
+	std::lock_guard lock{ this->m_mutex };
+	std::vector<Texture> textures(requests.size());
+	std::vector<TextureKey> keys;
+	keys.reserve(requests.size());
+
+	std::vector<size_t> resident;
+	// one import per distinct image, with the requests waiting on it
+	std::vector<TextureImportRequest> imports;
+	std::vector<std::vector<size_t>> waiting;
+	std::unordered_map<TextureImageKey, size_t> importIndices;
+
+	for (size_t i = 0; i < requests.size(); i++) {
+		const TextureKey& key = keys.emplace_back(TextureRegistry::key(requests[i]));
+
+		if (auto texture = this->m_textures.find(key); texture != this->m_textures.end()) {
+			textures[i] = texture->second;
+			this->m_entries.at(textures[i]).refCount++;
+			resident.push_back(i);
+			continue;
+		}
+
+		// same image with another sampler, only the texture is new
+		if (auto image = this->m_images.find(key.image); image != this->m_images.end()) {
+			textures[i] = this->makeTexture(key, image->second.image);
+			this->m_entries.at(textures[i]).refCount++;
+			resident.push_back(i);
+			continue;
+		}
+
+		auto [importIndex, inserted] = importIndices.try_emplace(key.image, imports.size());
+		if (inserted) {
+			TextureImportRequest& request = imports.emplace_back(requests[i]);
+			if (this->m_streaming.enabled)
+				request.maxSize = std::min(request.maxSize, this->m_streaming.initialSize);
+			waiting.emplace_back();
+		}
+		waiting[importIndex->second].push_back(i);
+	}
+
+	if (onTextureReady) {
+		for (const size_t i : resident)
+			onTextureReady(i, textures[i]);
+	}
+
+	TextureImporter{ this->m_renderer }.importImages(imports, [&](size_t importIndex, const ImportedImage& imported) {
+		ImageEntry& image = this->m_images.insert({ keys[waiting[importIndex].front()].image, ImageEntry{ imported.image, 0, imports[importIndex], {}, imported.format, imported.width, imported.height, imported.skippedLevels, imported.skippedLevels } }).first->second;
+		image.request.data = {};
+		if (this->m_streaming.enabled && !imports[importIndex].data.empty()) {
+			image.encoded.assign(imports[importIndex].data.begin(), imports[importIndex].data.end());
+			image.request.data = image.encoded;
+		}
+
+		for (const size_t i : waiting[importIndex]) {
+			auto texture = this->m_textures.find(keys[i]);
+			textures[i] = texture != this->m_textures.end() ? texture->second : this->makeTexture(keys[i], imported.image);
+			this->m_entries.at(textures[i]).refCount++;
+			if (onTextureReady)
+				onTextureReady(i, textures[i]);
+		}
+	});
+
+	return textures;
+}
+
+void TextureRegistry::release(Texture texture) {
+	std::lock_guard lock{ this->m_mutex };
+	TextureEntry& entry = this->m_entries.at(texture);
+	if (--entry.refCount > 0)
+		return;
+
+	const TextureKey key = entry.key;
+	this->m_entries.erase(texture);
+	this->m_textures.erase(key);
+	this->m_renderer.destroyTexture(texture);
+
+	ImageEntry& image = this->m_images.at(key.image);
+	if (--image.refCount == 0) {
+		this->m_renderer.destroyImage(image.image);
+		this->m_images.erase(key.image);
+	}
+}
+
+void TextureRegistry::stream(const std::unordered_map<Texture, float>& screenSizes, size_t budget) {
+	if (!this->m_streaming.enabled)
+		return;
+
+	std::lock_guard streamLock{ this->m_streamMutex };
+
+	struct Reload {
+		TextureImageKey key;
+		ImageEntry* entry;
+		Image source;
+		uint32_t skippedLevels;
+	};
+
+	std::vector<Reload> reloads;
+	{
+		std::lock_guard lock{ this->m_mutex };
+		budget = std::min(budget, this->m_streaming.budget);
+
+		std::unordered_map<TextureImageKey, float> imageScreenSizes;
+		for (const auto& [texture, screenSize] : screenSizes) {
+			auto entry = this->m_entries.find(texture);
+			if (entry == this->m_entries.end())
+				continue;
+			float& imageScreenSize = imageScreenSizes[entry->second.key.image];
+			imageScreenSize = std::max(imageScreenSize, screenSize);
+		}
+
+		struct Candidate {
+			const TextureImageKey* key;
+			ImageEntry* entry;
+			float screenSize;
+			uint32_t skippedLevels;
+		};
+
+		// a full mip chain takes a third more than its largest level
+		auto residentBytes = [](const ImageEntry& image, uint32_t skippedLevels) {
+			const size_t width = std::max(image.width >> skippedLevels, 1u);
+			const size_t height = std::max(image.height >> skippedLevels, 1u);
+			return static_cast<size_t>(width * height * bytesPerTexel(image.format) * 4 / 3);
+		};
+
+		std::vector<Candidate> candidates;
+		size_t totalBytes = 0;
+		for (auto& [key, image] : this->m_images) {
+			auto screenSize = imageScreenSizes.find(key);
+			const float size = screenSize != imageScreenSizes.end() ? screenSize->second : 0.0f;
+			// levels that are already resident stay until the budget needs them back
+			const uint32_t skippedLevels = std::min(image.skippedLevels, mipLevelsAbove(image.width, image.height, static_cast<uint32_t>(std::ceil(size))));
+			candidates.push_back(Candidate{ &key, &image, size, skippedLevels });
+			totalBytes += residentBytes(image, skippedLevels);
+		}
+
+		// over budget, the images seen the least give up levels first, down to the size they were loaded at
+		std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.screenSize < b.screenSize; });
+		for (Candidate& candidate : candidates) {
+			while (totalBytes > budget && candidate.skippedLevels < candidate.entry->maxSkippedLevels) {
+				totalBytes -= residentBytes(*candidate.entry, candidate.skippedLevels) - residentBytes(*candidate.entry, candidate.skippedLevels + 1);
+				candidate.skippedLevels++;
+			}
+		}
+
+		// evictions go first so their memory is back before anything grows, then the images seen the most
+		for (const Candidate& candidate : candidates) {
+			if (candidate.skippedLevels > candidate.entry->skippedLevels)
+				reloads.push_back(Reload{ *candidate.key, candidate.entry, candidate.entry->image, candidate.skippedLevels });
+		}
+		for (auto candidate = candidates.rbegin(); candidate != candidates.rend(); candidate++) {
+			if (candidate->skippedLevels < candidate->entry->skippedLevels)
+				reloads.push_back(Reload{ *candidate->key, candidate->entry, candidate->entry->image, candidate->skippedLevels });
+		}
+		if (reloads.size() > this->m_streaming.maxReloads)
+			reloads.resize(this->m_streaming.maxReloads);
+
+		// the reference keeps the entry and its encoded bytes around if its textures are released meanwhile
+		for (const Reload& reload : reloads)
+			reload.entry->refCount++;
+	}
+
+	// decoding and uploading happen outside the lock, so acquire and release aren't held up by them
+	std::vector<Image> images(reloads.size());
+	std::vector<TextureImportRequest> requests;
+	std::vector<size_t> requestReloads;
+	for (size_t i = 0; i < reloads.size(); i++) {
+		const Reload& reload = reloads[i];
+		// evicted levels are dropped by copying the ones that stay out of the resident image
+		const uint32_t droppedLevels = reload.skippedLevels > reload.entry->skippedLevels ? reload.skippedLevels - reload.entry->skippedLevels : 0;
+		if (droppedLevels > 0 && droppedLevels < this->m_renderer.imageMipLevels(reload.source)) {
+			images[i] = this->m_renderer.beginCopyImageLevels(reload.source, droppedLevels);
+			continue;
+		}
+
+		TextureImportRequest& request = requests.emplace_back(reload.entry->request);
+		request.maxSize = std::max(reload.entry->width, reload.entry->height) >> reload.skippedLevels;
+		requestReloads.push_back(i);
+	}
+	this->m_renderer.finishUploads();
+
+	TextureImporter{ this->m_renderer }.importImages(requests, [&](size_t i, const ImportedImage& imported) {
+		images[requestReloads[i]] = imported.image;
+		reloads[requestReloads[i]].skippedLevels = imported.skippedLevels;
+	});
+
+	// the old images stay alive for frames still in flight, the new ones are drawn from the next frame on
+	std::lock_guard lock{ this->m_mutex };
+	for (size_t i = 0; i < reloads.size(); i++) {
+		const Reload& reload = reloads[i];
+		ImageEntry& image = *reload.entry;
+		this->m_renderer.destroyImage(image.image);
+		if (--image.refCount == 0) {
+			this->m_renderer.destroyImage(images[i]);
+			this->m_images.erase(reload.key);
+			continue;
+		}
+
+		for (const auto& [textureKey, texture] : this->m_textures) {
+			if (textureKey.image == reload.key)
+				this->m_renderer.setTextureImage(texture, images[i]);
+		}
+		image.image = images[i];
+		image.skippedLevels = reload.skippedLevels;
+	}
+}
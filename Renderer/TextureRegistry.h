@@ -0,0 +1,111 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <mutex>
+
+#include "VulkanRenderer.h"
+#include "TextureImporter.h"
+#include "Image.h"
+#include "Sampler.h"
+#include "Texture.h"
+
+// Where an image comes from: the canonical path of an image file, or a hash of the bytes of an embedded one
+struct TextureImageKey {
+	std::string source;
+	ImageFormat format;
+	// images tested against different cutoffs get different mip levels
+	float alphaCutoff;
+
+	bool operator==(const TextureImageKey&) const = default;
+};
+
+struct TextureKey {
+	TextureImageKey image;
+	Sampler sampler;
+
+	bool operator==(const TextureKey&) const = default;
+};
+
+namespace std {
+	template<> struct hash<TextureImageKey> {
+		size_t operator()(const TextureImageKey& key) const {
+			return std::hash<std::string>{}(key.source) ^ static_cast<size_t>(key.format) * 0x9E3779B97F4A7C15ull ^ std::hash<float>{}(key.alphaCutoff);
+		}
+	};
+
+	template<> struct hash<TextureKey> {
+		size_t operator()(const TextureKey& key) const {
+			const Sampler& s = key.sampler;
+			const size_t packed = static_cast<size_t>(s.magFilter) | static_cast<size_t>(s.minFilter) << 2 | static_cast<size_t>(s.mipmapFilter) << 4 | static_cast<size_t>(s.wrapU) << 6 | static_cast<size_t>(s.wrapV) << 8;
+			return std::hash<TextureImageKey>{}(key.image) ^ (packed + 0x9E3779B97F4A7C15ull);
+		}
+	};
+}
+
+struct TextureStreamingSettings {
+	// images are uploaded no larger than initialSize at first, stream brings in their larger levels once they're seen
+	bool enabled = false;
+	uint32_t initialSize = 128;
+	// device memory streamed images may take together before the least seen ones give up levels, in bytes
+	size_t budget = size_t{ 512 } << 20;
+	// images uploaded again by one stream call at most, so it keeps up with the camera
+	size_t maxReloads = 8;
+};
+
+// Refcounted set of the textures resident on the renderer. Every distinct image is decoded and uploaded once, and
+// every distinct image and sampler pair gets one texture, no matter how many materials or scenes ask for it.
+// Calls are serialized, so a streaming thread may call stream while a loading thread acquires textures. stream
+// decodes and uploads without holding the lock.
+class TextureRegistry
+{
+public:
+	explicit TextureRegistry(VulkanRenderer& renderer, const TextureStreamingSettings& streaming = {});
+
+	// Returns one texture per request, in request order, each holding a reference that is given back with release.
+	// Textures that are already resident are reported to onTextureReady right away, the others as their uploads finish.
+	std::vector<Texture> acquire(const std::vector<TextureImportRequest>& requests, const std::function<void(size_t, Texture)>& onTextureReady = {});
+	// Destroys the texture when its last reference goes, and its image when no other texture samples it
+	void release(Texture texture);
+	// Uploads images again with the levels their largest size on screen needs, one texel per pixel, and points their
+	// textures at them. Levels are only dropped to stay under the budget, from the images seen the least, by copying
+	// the resident levels that stay into a smaller image. A smaller budget than the configured one can be given, e.g.
+	// what the renderer has left for textures under memory pressure.
+	void stream(const std::unordered_map<Texture, float>& screenSizes, size_t budget = SIZE_MAX);
+
+	static TextureKey key(const TextureImportRequest& request);
+
+private:
+	struct ImageEntry {
+		Image image;
+		uint32_t refCount;
+		// what stream uploads the image again from. Embedded images keep a copy of their encoded bytes, the buffer
+		// they came from is gone by then.
+		TextureImportRequest request;
+		std::vector<byte> encoded;
+		ImageFormat format;
+		uint32_t width;
+		uint32_t height;
+		// largest levels left out of the resident image, at most as many as were left out at first
+		uint32_t skippedLevels;
+		uint32_t maxSkippedLevels;
+	};
+
+	struct TextureEntry {
+		TextureKey key;
+		uint32_t refCount;
+	};
+
+	VulkanRenderer& m_renderer;
+	TextureStreamingSettings m_streaming;
+	std::mutex m_mutex;
+	// one stream call at a time, m_mutex is only held while it plans and swaps images
+	std::mutex m_streamMutex;
+	std::unordered_map<TextureImageKey, ImageEntry> m_images;
+	std::unordered_map<TextureKey, Texture> m_textures;
+	std::unordered_map<Texture, TextureEntry> m_entries;
+
+	Texture makeTexture(const TextureKey& key, Image image);
+};
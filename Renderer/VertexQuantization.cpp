@@ -0,0 +1,281 @@
+#include "VertexQuantization.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include "AccessorKernels.h"
+#include "PrimitiveRewrite.h"
+
+namespace {
+	// texture coordinates beyond this are kept as floats, half precision gets too coarse to address texels
+	constexpr float MAX_HALF_TEXCOORD = 2.0f;
+
+	const VertexAttributeDescription* findAttribute(const ScenePrimitiveData& primitive, const std::string& attributeName) {
+		for (const auto& attribute : primitive.attributes) {
+			if (attribute.attributeName == attributeName)
+				return &attribute;
+		}
+		return nullptr;
+	}
+
+	bool isFloatAttribute(const VertexAttributeDescription& attribute, const AttributeContainerType containerType) {
+		return attribute.valueType == AttributeValueType::eFloat && attribute.containerType == containerType && attribute.encoding == AttributeEncoding::eNone;
+	}
+
+	int16_t quantizeSnorm16(const float v) {
+		return static_cast<int16_t>(std::lround(std::clamp(v, -1.0f, 1.0f) * 32767.0f));
+	}
+
+	int8_t quantizeSnorm8(const float v) {
+		return static_cast<int8_t>(std::lround(std::clamp(v, -1.0f, 1.0f) * 127.0f));
+	}
+
+	uint16_t quantizeUnorm16(const float v) {
+		return static_cast<uint16_t>(std::lround(std::clamp(v, 0.0f, 1.0f) * 65535.0f));
+	}
+
+	struct QuantizedAttribute {
+		size_t attributeIndex;
+		size_t offset;
+		int32_t stride;
+		AttributeContainerType containerType;
+		AttributeValueType valueType;
+		bool normalized;
+		AttributeEncoding encoding;
+	};
+
+	struct QuantizedPrimitive {
+		std::vector<byte> data;
+		std::vector<QuantizedAttribute> attributes;
+		glm::dvec3 bbMin{ 0.0 };
+		glm::dvec3 bbMax{ 0.0 };
+	};
+
+	// Appends a stream of count elements of elementSize bytes and returns its offset
+	size_t appendStream(std::vector<byte>& data, const size_t count, const size_t elementSize) {
+		const size_t offset = alignUp(data.size(), VERTEX_DATA_ALIGNMENT);
+		data.resize(offset + count * elementSize, 0);
+		return offset;
+	}
+
+	QuantizedPrimitive quantizePrimitive(const SceneData& scene, const ScenePrimitiveData& primitive) {
+		QuantizedPrimitive result{ {}, {}, primitive.bbMin, primitive.bbMax };
+
+		for (size_t a = 0; a < primitive.attributes.size(); a++) {
+			const VertexAttributeDescription& attribute = primitive.attributes[a];
+			const size_t count = attribute.count;
+
+			if (attribute.attributeName == "POSITION" && isFloatAttribute(attribute, AttributeContainerType::eVec3)) {
+				const std::vector<glm::vec4> positions = decodeVertexAttribute(scene, primitive, attribute);
+				if (positions.empty())
+					continue;
+
+				// accessor bounds are optional and may be loose, the quantization grid uses the actual ones
+				glm::vec3 bbMin = positions[0], bbMax = positions[0];
+				for (const auto& p : positions) {
+					bbMin = glm::min(bbMin, glm::vec3(p));
+					bbMax = glm::max(bbMax, glm::vec3(p));
+				}
+				const glm::vec3 extent = bbMax - bbMin;
+				const glm::vec3 invExtent = glm::vec3{
+					extent.x > 0.0f ? 1.0f / extent.x : 0.0f,
+					extent.y > 0.0f ? 1.0f / extent.y : 0.0f,
+					extent.z > 0.0f ? 1.0f / extent.z : 0.0f,
+				};
+
+				const size_t offset = appendStream(result.data, count, 4 * sizeof(uint16_t));
+				uint16_t* dst = reinterpret_cast<uint16_t*>(result.data.data() + offset);
+				for (size_t i = 0; i < count; i++) {
+					const glm::vec3 t = (glm::vec3(positions[i]) - bbMin) * invExtent;
+					dst[i * 4 + 0] = quantizeUnorm16(t.x);
+					dst[i * 4 + 1] = quantizeUnorm16(t.y);
+					dst[i * 4 + 2] = quantizeUnorm16(t.z);
+				}
+
+				result.bbMin = bbMin;
+				result.bbMax = bbMax;
+				result.attributes.push_back(QuantizedAttribute{ a, offset, 4 * sizeof(uint16_t), AttributeContainerType::eVec4, AttributeValueType::eUint16, true, AttributeEncoding::eBoundsRelative });
+			}
+			else if (attribute.attributeName == "NORMAL" && isFloatAttribute(attribute, AttributeContainerType::eVec3)) {
+				const std::vector<glm::vec4> normals = decodeVertexAttribute(scene, primitive, attribute);
+
+				const size_t offset = appendStream(result.data, count, 2 * sizeof(int16_t));
+				int16_t* dst = reinterpret_cast<int16_t*>(result.data.data() + offset);
+				for (size_t i = 0; i < count; i++) {
+					const glm::vec2 e = encodeOctahedral(glm::vec3(normals[i]));
+					dst[i * 2 + 0] = quantizeSnorm16(e.x);
+					dst[i * 2 + 1] = quantizeSnorm16(e.y);
+				}
+
+				result.attributes.push_back(QuantizedAttribute{ a, offset, 2 * sizeof(int16_t), AttributeContainerType::eVec2, AttributeValueType::eInt16, true, AttributeEncoding::eOctahedral });
+			}
+			else if (attribute.attributeName == "TANGENT" && isFloatAttribute(attribute, AttributeContainerType::eVec4)) {
+				const std::vector<glm::vec4> tangents = decodeVertexAttribute(scene, primitive, attribute);
+
+				const size_t offset = appendStream(result.data, count, 4 * sizeof(int8_t));
+				int8_t* dst = reinterpret_cast<int8_t*>(result.data.data() + offset);
+				for (size_t i = 0; i < count; i++) {
+					const glm::vec2 e = encodeOctahedral(glm::vec3(tangents[i]));
+					dst[i * 4 + 0] = quantizeSnorm8(e.x);
+					dst[i * 4 + 1] = quantizeSnorm8(e.y);
+					dst[i * 4 + 2] = tangents[i].w < 0.0f ? -127 : 127;
+				}
+
+				result.attributes.push_back(QuantizedAttribute{ a, offset, 4 * sizeof(int8_t), AttributeContainerType::eVec4, AttributeValueType::eInt8, true, AttributeEncoding::eOctahedral });
+			}
+			else if (attribute.attributeName.starts_with("TEXCOORD_") && isFloatAttribute(attribute, AttributeContainerType::eVec2)) {
+				const std::vector<glm::vec4> uvs = decodeVertexAttribute(scene, primitive, attribute);
+
+				bool inUnitRange = true;
+				float maxMagnitude = 0.0f;
+				for (const auto& uv : uvs) {
+					inUnitRange = inUnitRange && uv.x >= 0.0f && uv.x <= 1.0f && uv.y >= 0.0f && uv.y <= 1.0f;
+					maxMagnitude = std::max({ maxMagnitude, std::abs(uv.x), std::abs(uv.y) });
+				}
+
+				if (inUnitRange) {
+					const size_t offset = appendStream(result.data, count, 2 * sizeof(uint16_t));
+					uint16_t* dst = reinterpret_cast<uint16_t*>(result.data.data() + offset);
+					for (size_t i = 0; i < count; i++) {
+						dst[i * 2 + 0] = quantizeUnorm16(uvs[i].x);
+						dst[i * 2 + 1] = quantizeUnorm16(uvs[i].y);
+					}
+					result.attributes.push_back(QuantizedAttribute{ a, offset, 2 * sizeof(uint16_t), AttributeContainerType::eVec2, AttributeValueType::eUint16, true, AttributeEncoding::eNone });
+				}
+				else if (maxMagnitude <= MAX_HALF_TEXCOORD) {
+					const size_t offset = appendStream(result.data, count, 2 * sizeof(uint16_t));
+					uint16_t* dst = reinterpret_cast<uint16_t*>(result.data.data() + offset);
+					for (size_t i = 0; i < count; i++) {
+						dst[i * 2 + 0] = glm::packHalf1x16(uvs[i].x);
+						dst[i * 2 + 1] = glm::packHalf1x16(uvs[i].y);
+					}
+					result.attributes.push_back(QuantizedAttribute{ a, offset, 2 * sizeof(uint16_t), AttributeContainerType::eVec2, AttributeValueType::eHalf, true, AttributeEncoding::eNone });
+				}
+			}
+		}
+
+		return result;
+	}
+
+	bool isNarrowVec3Attribute(const VertexAttributeDescription& attribute) {
+		if (attribute.containerType != AttributeContainerType::eVec3)
+			return false;
+		switch (attribute.valueType) {
+		case AttributeValueType::eInt8:
+		case AttributeValueType::eUint8:
+		case AttributeValueType::eInt16:
+		case AttributeValueType::eUint16:
+		case AttributeValueType::eHalf:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	QuantizedPrimitive padPrimitive(const SceneData& scene, const ScenePrimitiveData& primitive) {
+		QuantizedPrimitive result{ {}, {}, primitive.bbMin, primitive.bbMax };
+
+		for (size_t a = 0; a < primitive.attributes.size(); a++) {
+			const VertexAttributeDescription& attribute = primitive.attributes[a];
+			if (!isNarrowVec3Attribute(attribute))
+				continue;
+
+			const size_t componentSize = sizeFromAttributeValueType(attribute.valueType);
+			const size_t stride = attribute.stride > 0 ? static_cast<size_t>(attribute.stride) : 3 * componentSize;
+			const byte* src = scene.buffers[static_cast<uint32_t>(attribute.buffer)].data() + attribute.offset;
+
+			// w is left 0, the shaders only read xyz
+			const size_t offset = appendStream(result.data, attribute.count, 4 * componentSize);
+			byte* dst = result.data.data() + offset;
+			for (size_t i = 0; i < attribute.count; i++)
+				std::memcpy(dst + i * 4 * componentSize, src + i * stride, 3 * componentSize);
+
+			result.attributes.push_back(QuantizedAttribute{ a, offset, static_cast<int32_t>(4 * componentSize), AttributeContainerType::eVec4, attribute.valueType, attribute.normalized, attribute.encoding });
+		}
+
+		return result;
+	}
+
+	// Points the attributes the primitive's rewrite covered at their new data
+	void applyQuantizedPrimitive(ScenePrimitiveData& primitive, const QuantizedPrimitive& rewritten, const Buffer buffer, const size_t baseOffset) {
+		for (const auto& q : rewritten.attributes) {
+			VertexAttributeDescription& attribute = primitive.attributes[q.attributeIndex];
+			attribute.buffer = buffer;
+			attribute.offset = baseOffset + q.offset;
+			attribute.stride = q.stride;
+			attribute.containerType = q.containerType;
+			attribute.valueType = q.valueType;
+			attribute.normalized = q.normalized;
+			attribute.encoding = q.encoding;
+		}
+		primitive.bbMin = rewritten.bbMin;
+		primitive.bbMax = rewritten.bbMax;
+	}
+}
+
+glm::vec2 encodeOctahedral(const glm::vec3& v) {
+	const float l1 = std::abs(v.x) + std::abs(v.y) + std::abs(v.z);
+	if (l1 == 0.0f)
+		return glm::vec2{ 0.0f };
+
+	glm::vec2 p = glm::vec2{ v.x, v.y } / l1;
+	if (v.z < 0.0f) {
+		p = glm::vec2{
+			(1.0f - std::abs(p.y)) * (p.x >= 0.0f ? 1.0f : -1.0f),
+			(1.0f - std::abs(p.x)) * (p.y >= 0.0f ? 1.0f : -1.0f),
+		};
+	}
+	return p;
+}
+
+glm::vec3 decodeOctahedral(const glm::vec2& e) {
+	glm::vec3 v{ e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y) };
+	if (v.z < 0.0f) {
+		v.x = (1.0f - std::abs(e.y)) * (e.x >= 0.0f ? 1.0f : -1.0f);
+		v.y = (1.0f - std::abs(e.x)) * (e.y >= 0.0f ? 1.0f : -1.0f);
+	}
+	return glm::normalize(v);
+}
+
+std::vector<glm::vec4> decodeVertexAttribute(const SceneData& scene, const ScenePrimitiveData& primitive, const VertexAttributeDescription& attribute) {
+	const size_t componentCount = componentCountFromAttributeContainerType(attribute.containerType);
+	const size_t componentSize = sizeFromAttributeValueType(attribute.valueType);
+	const size_t stride = attribute.stride > 0 ? static_cast<size_t>(attribute.stride) : componentCount * componentSize;
+	const byte* src = scene.buffers[static_cast<uint32_t>(attribute.buffer)].data() + attribute.offset;
+
+	std::vector<glm::vec4> values(attribute.count, glm::vec4{ 0.0f, 0.0f, 0.0f, 1.0f });
+	selectAttributeGatherKernel(attribute.valueType)(src, stride, attribute.count, componentCount, attribute.normalized, values.data());
+
+	switch (attribute.encoding) {
+	case AttributeEncoding::eOctahedral:
+		for (auto& v : values) {
+			const float handedness = componentCount > 2 ? (v.z < 0.0f ? -1.0f : 1.0f) : 1.0f;
+			v = glm::vec4{ decodeOctahedral(glm::vec2{ v.x, v.y }), handedness };
+		}
+		break;
+	case AttributeEncoding::eBoundsRelative: {
+		const glm::vec3 offset = primitive.bbMin;
+		const glm::vec3 scale = primitive.bbMax - primitive.bbMin;
+		for (auto& v : values)
+			v = glm::vec4{ offset + glm::vec3(v) * scale, 1.0f };
+		break;
+	}
+	default:
+		break;
+	}
+
+	return values;
+}
+
+void quantizeSceneMeshes(SceneData& scene) {
+	rewriteScenePrimitives(scene, quantizePrimitive, applyQuantizedPrimitive);
+}
+
+void padSceneVertexAttributes(SceneData& scene) {
+	rewriteScenePrimitives(scene, padPrimitive, applyQuantizedPrimitive);
+}
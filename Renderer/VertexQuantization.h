@@ -0,0 +1,26 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include "SceneData.h"
+
+// Octahedral mapping of unit vectors (Cigolle et al. 2014), both coordinates in [-1, 1]
+glm::vec2 encodeOctahedral(const glm::vec3& v);
+glm::vec3 decodeOctahedral(const glm::vec2& e);
+
+// Reads every element of the attribute back as floats, undoing normalization and the attribute's encoding.
+// Components the attribute doesn't have are 0, except w which is 1.
+std::vector<glm::vec4> decodeVertexAttribute(const SceneData& scene, const ScenePrimitiveData& primitive, const VertexAttributeDescription& attribute);
+
+// Rewrites float positions, normals, tangents and texture coordinates into compact formats: positions as unorm16
+// relative to the primitive's bounding box, normals and tangents octahedral and texture coordinates as unorm16 or
+// half. Attributes that are already integer, e.g. from KHR_mesh_quantization, are left as they are.
+void quantizeSceneMeshes(SceneData& scene);
+
+// Widens 8 and 16 bit three component attributes to four components. Vertex buffer support for the three component
+// formats is optional, the four component ones are required.
+void padSceneVertexAttributes(SceneData& scene);
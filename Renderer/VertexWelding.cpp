@@ -0,0 +1,200 @@
+#include "VertexWelding.h"
+
+#include <algorithm>
+#include <execution>
+#include <numeric>
+#include <unordered_map>
+#include <string_view>
+#include <cstring>
+#include <cmath>
+
+#include "AccessorKernels.h"
+#include "PrimitiveRewrite.h"
+
+namespace {
+	// vertices handed to one task when building the keys
+	constexpr size_t CHUNK_SIZE = 4096;
+
+	size_t elementSize(const VertexAttributeDescription& attribute) {
+		return componentCountFromAttributeContainerType(attribute.containerType) * sizeFromAttributeValueType(attribute.valueType);
+	}
+
+	// Empty data if the primitive was left as it is
+	struct WeldedPrimitive {
+		// the vertices were merged or reordered, so the attributes are part of data too
+		bool rewritten = false;
+		std::vector<byte> data;
+		std::vector<size_t> attributeOffsets;
+		size_t vertexCount = 0;
+		size_t indexOffset = 0;
+		size_t indexCount = 0;
+		AttributeValueType indexType = AttributeValueType::eUint32;
+	};
+
+	// Vertices of every triangle in list order, following the glTF rules for strips and fans
+	std::vector<uint32_t> triangleCorners(MeshPrimitiveMode mode, uint32_t vertexCount) {
+		std::vector<uint32_t> corners;
+		switch (mode) {
+		case MeshPrimitiveMode::eTriangles:
+			corners.resize(vertexCount / 3 * 3);
+			std::iota(corners.begin(), corners.end(), uint32_t{ 0 });
+			break;
+		case MeshPrimitiveMode::eTriangleStrip:
+			for (uint32_t i = 0; i + 2 < vertexCount; i++)
+				corners.insert(corners.end(), { i, i + 1 + i % 2, i + 2 - i % 2 });
+			break;
+		case MeshPrimitiveMode::eTriangleFan:
+			for (uint32_t i = 0; i + 2 < vertexCount; i++)
+				corners.insert(corners.end(), { i + 1, i + 2, 0 });
+			break;
+		default:
+			break;
+		}
+		return corners;
+	}
+
+	WeldedPrimitive weldPrimitive(const SceneData& scene, const ScenePrimitiveData& primitive, const float epsilon) {
+		WeldedPrimitive result{};
+		if (primitive.isIndexed || primitive.attributes.empty())
+			return result;
+		if (primitive.mode != MeshPrimitiveMode::eTriangles && primitive.mode != MeshPrimitiveMode::eTriangleStrip && primitive.mode != MeshPrimitiveMode::eTriangleFan)
+			return result;
+
+		const size_t vertexCount = primitive.attributes.front().count;
+		const bool consistentCounts = std::all_of(primitive.attributes.begin(), primitive.attributes.end(), [vertexCount](const VertexAttributeDescription& attribute) { return attribute.count == vertexCount; });
+		if (vertexCount == 0 || vertexCount > UINT32_MAX || !consistentCounts)
+			return result;
+
+		size_t keySize = 0;
+		for (const auto& attribute : primitive.attributes)
+			keySize += elementSize(attribute);
+
+		// the attribute bytes of every vertex back to back, which is what vertices are compared on
+		std::vector<byte> keys(vertexCount * keySize);
+		std::vector<size_t> chunks((vertexCount + CHUNK_SIZE - 1) / CHUNK_SIZE);
+		std::iota(chunks.begin(), chunks.end(), size_t{ 0 });
+		std::for_each(std::execution::par, chunks.begin(), chunks.end(), [&](const size_t chunk) {
+			const size_t end = std::min(vertexCount, (chunk + 1) * CHUNK_SIZE);
+			size_t keyOffset = 0;
+			for (const auto& attribute : primitive.attributes) {
+				const size_t size = elementSize(attribute);
+				const size_t stride = attribute.stride > 0 ? static_cast<size_t>(attribute.stride) : size;
+				const byte* src = scene.buffers[static_cast<uint32_t>(attribute.buffer)].data() + attribute.offset;
+				const bool isFloat = attribute.valueType == AttributeValueType::eFloat;
+
+				for (size_t v = chunk * CHUNK_SIZE; v < end; v++) {
+					byte* key = keys.data() + v * keySize + keyOffset;
+					std::memcpy(key, src + v * stride, size);
+					if (!isFloat)
+						continue;
+
+					for (size_t c = 0; c < size / sizeof(float); c++) {
+						float value;
+						std::memcpy(&value, key + c * sizeof(float), sizeof(float));
+						if (epsilon > 0.0f)
+							value = std::round(value / epsilon) * epsilon;
+						// -0 and 0 are the same value but not the same bytes
+						value = value == 0.0f ? 0.0f : value;
+						std::memcpy(key + c * sizeof(float), &value, sizeof(float));
+					}
+				}
+				keyOffset += size;
+			}
+		});
+
+		// every vertex's first vertex with the same key
+		std::vector<uint32_t> representatives(vertexCount);
+		{
+			std::unordered_map<std::string_view, uint32_t> firstVertex;
+			firstVertex.reserve(vertexCount);
+			for (uint32_t v = 0; v < vertexCount; v++) {
+				const std::string_view key{ reinterpret_cast<const char*>(keys.data() + v * keySize), keySize };
+				representatives[v] = firstVertex.try_emplace(key, v).first->second;
+			}
+		}
+
+		const std::vector<uint32_t> corners = triangleCorners(primitive.mode, static_cast<uint32_t>(vertexCount));
+		std::vector<uint32_t> newIndex(vertexCount, UINT32_MAX);
+		std::vector<uint32_t> sourceVertices;
+		std::vector<uint32_t> indices;
+		indices.reserve(corners.size());
+		for (size_t t = 0; t < corners.size() / 3; t++) {
+			const uint32_t r0 = representatives[corners[t * 3 + 0]];
+			const uint32_t r1 = representatives[corners[t * 3 + 1]];
+			const uint32_t r2 = representatives[corners[t * 3 + 2]];
+			if (r0 == r1 || r1 == r2 || r2 == r0)
+				continue;
+
+			for (const uint32_t r : { r0, r1, r2 }) {
+				if (newIndex[r] == UINT32_MAX) {
+					newIndex[r] = static_cast<uint32_t>(sourceVertices.size());
+					sourceVertices.push_back(r);
+				}
+				indices.push_back(newIndex[r]);
+			}
+		}
+		if (indices.empty())
+			return result;
+
+		result.vertexCount = sourceVertices.size();
+		result.indexCount = indices.size();
+
+		bool isIdentity = sourceVertices.size() == vertexCount;
+		for (size_t i = 0; i < sourceVertices.size() && isIdentity; i++)
+			isIdentity = sourceVertices[i] == i;
+		result.rewritten = !isIdentity;
+
+		if (result.rewritten) {
+			for (const auto& attribute : primitive.attributes) {
+				const size_t size = elementSize(attribute);
+				const size_t srcStride = attribute.stride > 0 ? static_cast<size_t>(attribute.stride) : size;
+				const size_t dstStride = alignUp(size, VERTEX_DATA_ALIGNMENT);
+				const byte* src = scene.buffers[static_cast<uint32_t>(attribute.buffer)].data() + attribute.offset;
+
+				const size_t offset = alignUp(result.data.size(), VERTEX_DATA_ALIGNMENT);
+				result.attributeOffsets.push_back(offset);
+				result.data.resize(offset + dstStride * sourceVertices.size(), 0);
+				for (size_t i = 0; i < sourceVertices.size(); i++)
+					std::memcpy(result.data.data() + offset + i * dstStride, src + sourceVertices[i] * srcStride, size);
+			}
+		}
+
+		result.indexOffset = alignUp(result.data.size(), VERTEX_DATA_ALIGNMENT);
+		if (sourceVertices.size() <= UINT16_MAX) {
+			result.indexType = AttributeValueType::eUint16;
+			result.data.resize(result.indexOffset + indices.size() * sizeof(uint16_t), 0);
+			narrowIndices(indices.data(), indices.size(), reinterpret_cast<uint16_t*>(result.data.data() + result.indexOffset));
+		}
+		else {
+			result.indexType = AttributeValueType::eUint32;
+			result.data.resize(result.indexOffset + indices.size() * sizeof(uint32_t), 0);
+			std::memcpy(result.data.data() + result.indexOffset, indices.data(), indices.size() * sizeof(uint32_t));
+		}
+
+		return result;
+	}
+}
+
+void weldSceneMeshes(SceneData& scene, const float epsilon) {
+	rewriteScenePrimitives(scene, [epsilon](const SceneData& source, const ScenePrimitiveData& primitive) {
+		return weldPrimitive(source, primitive, epsilon);
+	}, [](ScenePrimitiveData& primitive, const WeldedPrimitive& welded, const Buffer buffer, const size_t baseOffset) {
+		if (welded.rewritten) {
+			for (size_t a = 0; a < primitive.attributes.size(); a++) {
+				auto& attribute = primitive.attributes[a];
+				attribute.buffer = buffer;
+				attribute.offset = baseOffset + welded.attributeOffsets[a];
+				attribute.stride = static_cast<int32_t>(alignUp(elementSize(attribute), VERTEX_DATA_ALIGNMENT));
+				attribute.count = welded.vertexCount;
+			}
+		}
+
+		primitive.isIndexed = true;
+		primitive.mode = MeshPrimitiveMode::eTriangles;
+		primitive.indices.buffer = buffer;
+		primitive.indices.offset = baseOffset + welded.indexOffset;
+		primitive.indices.stride = static_cast<int32_t>(sizeFromAttributeValueType(welded.indexType));
+		primitive.indices.count = welded.indexCount;
+		primitive.indices.indexType = welded.indexType;
+	});
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "SceneData.h"
+
+// Gives every non-indexed triangle list, strip and fan an index buffer. Vertices whose attributes are identical are
+// merged, compared on the bytes of every attribute at once. With epsilon above 0, float components are snapped to
+// multiples of it first, so vertices closer than that merge as well and keep the values of the first of them.
+// Strips and fans become lists, degenerate triangles are dropped and vertices are renumbered in first use order.
+void weldSceneMeshes(SceneData& scene, float epsilon = 0.0f);
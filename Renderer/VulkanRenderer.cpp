@@ -1,5 +1,6 @@
 #include <fstream>
 #include <chrono>
+#include <string_view>
 
 #include <cppitertools/enumerate.hpp>
 #include <cppitertools/chain.hpp>
@@ -69,6 +70,15 @@ VulkanRenderer::VulkanRenderer(const vkfw::Window window, const RendererSettings
 	this->recordBloomCommandBuffers();
 
 	this->createTonemapPipeline();
+	this->createMipGenerationPipeline();
+
+	const std::array<float, 4> emptyVertex{};
+	this->emptyVertexBuffer = this->loadBuffer(emptyVertex.data(), sizeof(emptyVertex));
+	this->createInstanceResources();
+	// every draw binds these, they have to land before the first frame
+	this->finishUploads();
+
+	this->createMaterialResources();
 
 	for (size_t i = 0; i < FRAMES_IN_FLIGHT; i++) {
 		this->frameFences[i] = this->device.createFence(vk::FenceCreateInfo{vk::FenceCreateFlagBits::eSignaled});
@@ -84,6 +94,10 @@ VulkanRenderer::~VulkanRenderer() {
 	this->running = false;
 	this->renderThread.join();
 	this->device.waitForFences(this->frameFences, true, UINT64_MAX);
+	this->destroyUploadResources();
+	this->destroyRetiredTextures(true);
+	this->destroyRetiredBuffers(true);
+	this->destroyInstanceResources();
 
 	for (size_t i = 0; i < FRAMES_IN_FLIGHT; i++) {
 		this->device.destroyFence(this->frameFences[i]);
@@ -91,12 +105,15 @@ VulkanRenderer::~VulkanRenderer() {
 		this->device.destroySemaphore(this->mainRenderPassFinishedSemaphores[i]);
 		this->device.destroySemaphore(this->shadowPassFinishedSemaphores[i]);
 	}
-	this->device.destroyPipeline(this->opaquePipeline);
-	this->device.destroyPipeline(this->blendPipeline);
+	for (const auto& [layout, pipelines] : this->meshPipelines) {
+		for (const auto& pipeline : pipelines) {
+			if (pipeline)
+				this->device.destroyPipeline(pipeline);
+		}
+	}
 	this->device.destroyPipeline(this->tonemapPipeline);
-	this->device.destroyPipeline(this->wireframePipeline);
 	this->device.destroyPipeline(this->envPipeline);
-	this->device.destroyPipeline(this->shadowMapPipeline);
+	this->destroyMipGenerationPipeline();
 	
 	this->device.destroyPipelineCache(this->pipelineCache);
 
@@ -112,15 +129,9 @@ VulkanRenderer::~VulkanRenderer() {
 	
 	this->device.destroyFramebuffer(this->mainFramebuffer);
 
-	for (auto& fb : this->pointShadowMapFramebuffers) {
-		this->device.destroyFramebuffer(fb);
-	}
-	this->pointShadowMapFramebuffers = {};
-
-	for (auto& fb : this->staticPointShadowMapFramebuffers) {
-		this->device.destroyFramebuffer(fb);
-	}
-	this->staticPointShadowMapFramebuffers = {};
+	this->destroyShadowMapTargets();
+	if (this->staticPointShadowMapsImage)
+		this->destroyStaticShadowMapImage();
 
 	this->device.destroyRenderPass(this->renderPass);
 	this->device.destroyRenderPass(this->shadowMapRenderPass);
@@ -131,17 +142,6 @@ VulkanRenderer::~VulkanRenderer() {
 	}
 	this->swapchainImageViews = {};
 
-	for (auto& iv : this->pointShadowMapFaceImageViews) {
-		this->device.destroyImageView(iv);
-	}
-	this->pointShadowMapFaceImageViews = {};
-	this->device.destroyImageView(this->pointShadowMapCubeArrayImageView);
-
-	for (auto& iv : this->staticPointShadowMapFaceImageViews) {
-		this->device.destroyImageView(iv);
-	}
-	this->staticPointShadowMapFaceImageViews = {};
-
 	this->device.destroyImageView(this->envMapImageView);
 	this->device.destroyImageView(this->envMapDiffuseImageView);
 	this->device.destroyImageView(this->envMapSpecularImageView);
@@ -149,15 +149,26 @@ VulkanRenderer::~VulkanRenderer() {
 	this->device.destroyImageView(this->depthImageView);
 	this->device.destroyImageView(this->colorImageMSView);
 
-	this->allocator.destroyImage(this->pointShadowMapsImage, this->pointShadowMapsImageAllocation);
-	this->allocator.destroyImage(this->staticPointShadowMapsImage, this->pointStaticShadowMapsImageAllocation);
+	if (this->envMapAllocation) {
+		this->untrackAllocation(MemoryCategory::eEnvironment, this->envMapAllocation);
+		this->untrackAllocation(MemoryCategory::eEnvironment, this->envMapDiffuseAllocation);
+		this->untrackAllocation(MemoryCategory::eEnvironment, this->envMapSpecularAllocation);
+	}
 	this->allocator.destroyImage(this->envMapImage, this->envMapAllocation);
 	this->allocator.destroyImage(this->envMapDiffuseImage, this->envMapDiffuseAllocation);
 	this->allocator.destroyImage(this->envMapSpecularImage, this->envMapSpecularAllocation);
+	this->untrackAllocation(MemoryCategory::eAttachments, this->colorImageAllocation);
+	this->untrackAllocation(MemoryCategory::eAttachments, this->depthImageAllocation);
+	if (this->colorImageMSAllocation)
+		this->untrackAllocation(MemoryCategory::eAttachments, this->colorImageMSAllocation);
 	this->allocator.destroyImage(this->colorImage, this->colorImageAllocation);
 	this->allocator.destroyImage(this->depthImage, this->depthImageAllocation);
 	this->allocator.destroyImage(this->colorImageMS, this->colorImageMSAllocation);
 
+	if (this->lightsBufferAllocation) {
+		this->untrackAllocation(MemoryCategory::eBuffers, this->lightsBufferAllocation);
+		this->untrackAllocation(MemoryCategory::eBuffers, this->lightsStagingBufferAllocation);
+	}
 	this->allocator.destroyBuffer(this->lightsBuffer, this->lightsBufferAllocation);
 	this->allocator.destroyBuffer(this->lightsStagingBuffer, this->lightsStagingBufferAllocation);
 
@@ -175,6 +186,7 @@ VulkanRenderer::~VulkanRenderer() {
 	this->device.destroyDescriptorSetLayout(this->perFrameInFlightDescriptorSetLayout);
 	this->device.destroyDescriptorSetLayout(this->tonemapDescriptorSetLayout);
 
+	this->destroyMaterialResources();
 	this->device.destroyDescriptorPool(this->descriptorPool);
 
 	this->device.destroySampler(this->shadowMapSampler);
@@ -222,6 +234,8 @@ void VulkanRenderer::setLights(const std::vector<PointLight>& pointLights, const
 
 	std::tie(this->lightsBuffer, this->lightsBufferAllocation) = this->allocator.createBuffer(vk::BufferCreateInfo{ {}, bufferSize, vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::SharingMode::eExclusive }, vma::AllocationCreateInfo{ {}, vma::MemoryUsage::eGpuOnly });
 	std::tie(this->lightsStagingBuffer, this->lightsStagingBufferAllocation) = this->allocator.createBuffer(vk::BufferCreateInfo{ {}, bufferSize, vk::BufferUsageFlagBits::eTransferSrc, vk::SharingMode::eExclusive }, vma::AllocationCreateInfo{ {}, vma::MemoryUsage::eCpuOnly });
+	this->trackAllocation(MemoryCategory::eBuffers, this->lightsBufferAllocation);
+	this->trackAllocation(MemoryCategory::eBuffers, this->lightsStagingBufferAllocation);
 
 	vk::CommandBuffer cb = this->device.allocateCommandBuffers(vk::CommandBufferAllocateInfo{ this->commandPool, vk::CommandBufferLevel::ePrimary, 1 })[0];
 	cb.begin(vk::CommandBufferBeginInfo{ vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
@@ -266,35 +280,27 @@ void VulkanRenderer::recordUpdateLightsBufferCommands(const vk::CommandBuffer& c
 	cb.copyBuffer(lightsStagingBuffer, this->lightsBuffer, vk::BufferCopy{0, 0, bufferSize});
 }
 
-void VulkanRenderer::setRootNodes(const std::vector<Node*>& nodes) {
+void VulkanRenderer::setRootNodes(const std::vector<std::shared_ptr<Node>>& nodes) {
+	std::lock_guard lock{ this->pendingMeshesMutex };
 	this->rootNodes = nodes;
 }
 
 Buffer VulkanRenderer::loadBuffer(const void* _ptr, size_t size) {
-	vk::CommandBuffer cb = this->device.allocateCommandBuffers(vk::CommandBufferAllocateInfo{ this->commandPool, vk::CommandBufferLevel::ePrimary, 1 })[0];
-	cb.begin(vk::CommandBufferBeginInfo{ vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
-
-	auto [deviceBuffer, deviceAllocation] = this->allocator.createBuffer(vk::BufferCreateInfo{ {}, size, vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::SharingMode::eExclusive }, vma::AllocationCreateInfo{ {}, vma::MemoryUsage::eGpuOnly });
-
-	auto [stagingBuffer, SBAllocation] = this->allocator.createBuffer(vk::BufferCreateInfo{ {}, size, vk::BufferUsageFlagBits::eTransferSrc, vk::SharingMode::eExclusive }, vma::AllocationCreateInfo{ vma::AllocationCreateFlagBits::eHostAccessSequentialWrite, vma::MemoryUsage::eAuto });
-
-	unsigned char* stagingData = reinterpret_cast<unsigned char*>(this->allocator.mapMemory(SBAllocation));
-	std::memcpy(stagingData, _ptr, size);
-
-	cb.copyBuffer(stagingBuffer, deviceBuffer, vk::BufferCopy{0, 0, size});
-
-	cb.end();
-
-	vk::Fence fence = this->device.createFence(vk::FenceCreateInfo{});
-	this->graphicsQueue.submit(vk::SubmitInfo{ {}, {}, cb, {} }, fence);
-	this->device.waitForFences(fence, true, UINT64_MAX);
-	this->allocator.destroyBuffer(stagingBuffer, SBAllocation);
-	this->device.freeCommandBuffers(this->commandPool, cb);
-	this->device.destroyFence(fence);
-	this->allocator.unmapMemory(SBAllocation);
-
+	const vk::SharingMode sharingMode = this->uploadQueueFamilyIndices.size() > 1 ? vk::SharingMode::eConcurrent : vk::SharingMode::eExclusive;
+	auto [deviceBuffer, deviceAllocation] = this->allocator.createBuffer(vk::BufferCreateInfo{ {}, size, vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst, sharingMode, this->uploadQueueFamilyIndices }, vma::AllocationCreateInfo{ {}, vma::MemoryUsage::eGpuOnly });
+	this->trackAllocation(MemoryCategory::eGeometry, deviceAllocation);
+
+	UploadStream& stream = this->uploadStream(UploadQueue::eTransfer);
+	const StagingRange staging = this->stage(stream, _ptr, size);
+	vk::CommandBuffer cb = this->beginUpload(stream);
+	cb.copyBuffer(staging.buffer, deviceBuffer, vk::BufferCopy{staging.offset, 0, size});
+	const UploadTicket ticket = this->endUpload(stream);
+
+	// the render loop reads the table while recording
+	std::unique_lock lock{ this->vertexBufferMutex };
 	bufferTable.insert({ this->nextBufferId, deviceBuffer });
 	bufferAllocationTable.insert({ this->nextBufferId, deviceAllocation });
+	bufferUploadTable.insert({ this->nextBufferId, ticket });
 	return this->nextBufferId++;
 }
 
@@ -302,11 +308,19 @@ void VulkanRenderer::addMesh(const Mesh& mesh) {
 	this->meshes.push_back(mesh);
 }
 
-Buffer VulkanRenderer::loadImage(const void* ptr, size_t size, uint32_t width, uint32_t height, ImageFormat imageFormat, uint32_t maxMipLevels = UINT32_MAX) {
-	auto [stagingBuffer, stagingBufferAllocation] = allocator.createBuffer(vk::BufferCreateInfo{ {}, size, vk::BufferUsageFlagBits::eTransferSrc, vk::SharingMode::eExclusive }, vma::AllocationCreateInfo{ vma::AllocationCreateFlagBits::eHostAccessSequentialWrite, vma::MemoryUsage::eAuto });
-	void* sbData = allocator.mapMemory(stagingBufferAllocation);
-	std::memcpy(sbData, ptr, size);
-	allocator.unmapMemory(stagingBufferAllocation);
+Image VulkanRenderer::loadImage(const void* ptr, size_t size, uint32_t width, uint32_t height, ImageFormat imageFormat, uint32_t maxMipLevels, float alphaCutoff) {
+	Image image = this->beginLoadImage(ptr, size, width, height, imageFormat, maxMipLevels, alphaCutoff);
+	this->finishUploads();
+	return image;
+}
+
+Image VulkanRenderer::beginLoadImage(const void* ptr, size_t size, uint32_t width, uint32_t height, ImageFormat imageFormat, uint32_t maxMipLevels, float alphaCutoff) {
+	// block compressed images can't be blitted, they only get the level they come with
+	if (isBlockCompressed(imageFormat))
+		return this->beginLoadImageLevels(ptr, width, height, imageFormat, { ImageLevel{ 0, size } });
+
+	UploadStream& stream = this->uploadStream(UploadQueue::eGraphics);
+	const StagingRange staging = this->stage(stream, ptr, size);
 
 	uint32_t mipLevels = 1u;
 	uint32_t maxDim = std::max(width, height);
@@ -315,21 +329,32 @@ Buffer VulkanRenderer::loadImage(const void* ptr, size_t size, uint32_t width, u
 	mipLevels = std::min(mipLevels, maxMipLevels);
 
 	vk::Format format = vkFormatFromImageFormat(imageFormat);
-	
+
+	// levels are built by the mip generation shader when it supports the image, which stores them through UNORM views
+	const bool generateMips = mipLevels > 1 && this->canGenerateMips(format, width, height);
+	vk::ImageCreateFlags imageFlags{};
+	vk::ImageUsageFlags imageUsage = vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled;
+	if (generateMips) {
+		imageFlags = vk::ImageCreateFlagBits::eMutableFormat | vk::ImageCreateFlagBits::eExtendedUsage;
+		imageUsage = vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eStorage;
+	}
+
 	auto && [image, imageAllocation] = allocator.createImage(
-		vk::ImageCreateInfo{ {}, vk::ImageType::e2D, format, vk::Extent3D{width, height, 1}, mipLevels, 1, vk::SampleCountFlagBits::e1, vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled, vk::SharingMode::eExclusive },
+		vk::ImageCreateInfo{ imageFlags, vk::ImageType::e2D, format, vk::Extent3D{width, height, 1}, mipLevels, 1, vk::SampleCountFlagBits::e1, vk::ImageTiling::eOptimal, imageUsage, vk::SharingMode::eExclusive },
 		vma::AllocationCreateInfo{ {}, vma::MemoryUsage::eGpuOnly }
 	);
+	this->trackAllocation(MemoryCategory::eTextures, imageAllocation);
 
-	auto cmdBuffers = device.allocateCommandBuffers(vk::CommandBufferAllocateInfo{ commandPool, vk::CommandBufferLevel::ePrimary, 1 });
-	vk::CommandBuffer cb = cmdBuffers[0];
-
-	cb.begin(vk::CommandBufferBeginInfo{ vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+	vk::CommandBuffer cb = this->beginUpload(stream);
 	cb.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, vk::ImageMemoryBarrier{ {}, vk::AccessFlagBits::eTransferWrite, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, image, vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, 0, mipLevels, 0, 1} });
-	std::vector<vk::BufferImageCopy> copyRegions = { vk::BufferImageCopy{0, 0, 0, vk::ImageSubresourceLayers{vk::ImageAspectFlagBits::eColor, 0, 0, 1}, {0, 0, 0}, {width, height, 1}  } };
-	cb.copyBufferToImage(stagingBuffer, image, vk::ImageLayout::eTransferDstOptimal, copyRegions);
+	std::vector<vk::BufferImageCopy> copyRegions = { vk::BufferImageCopy{staging.offset, 0, 0, vk::ImageSubresourceLayers{vk::ImageAspectFlagBits::eColor, 0, 0, 1}, {0, 0, 0}, {width, height, 1}  } };
+	cb.copyBufferToImage(staging.buffer, image, vk::ImageLayout::eTransferDstOptimal, copyRegions);
 
-	if (mipLevels > 1) {
+	if (generateMips) {
+		// built along with the other images of the batch once it's submitted
+		stream.mipGenerationJobs.push_back(MipGenerationJob{ image, format, width, height, mipLevels, alphaCutoff });
+	}
+	else if (mipLevels > 1) {
 		for (uint32_t i = 1; i < mipLevels; i++) {
 			//transition prev miplevel
 			cb.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, vk::ImageMemoryBarrier{ vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eTransferRead, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eTransferSrcOptimal, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, image, vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, i - 1, 1, 0, 1} });
@@ -345,23 +370,70 @@ Buffer VulkanRenderer::loadImage(const void* ptr, size_t size, uint32_t width, u
 	else
 		cb.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, {}, {}, {}, vk::ImageMemoryBarrier{ vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, image, vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1} });
 
-	cb.end();
+	this->endUpload(stream);
 
-	vk::Fence fence = device.createFence(vk::FenceCreateInfo{});
-	this->graphicsQueue.submit(vk::SubmitInfo{ {}, {}, cb, {} }, fence);
-	device.waitForFences(fence, true, UINT64_MAX);
-	allocator.destroyBuffer(stagingBuffer, stagingBufferAllocation);
-	device.freeCommandBuffers(commandPool, cb);
-	device.destroyFence(fence);
+	// the render loop reaps retired images from the tables
+	std::unique_lock lock{ this->materialMutex };
+	imageTable.insert({ this->nextImageId, image });
+	imageAllocationTable.insert({ this->nextImageId, imageAllocation });
+	imageFormatTable.insert({ this->nextImageId, format });
+	imageExtentTable.insert({ this->nextImageId, vk::Extent2D{ width, height } });
+	imageMipLevelsTable.insert({ this->nextImageId, mipLevels });
+	return this->nextImageId++;
+}
 
+Image VulkanRenderer::beginLoadImageLevels(const void* ptr, uint32_t width, uint32_t height, ImageFormat imageFormat, const std::vector<ImageLevel>& levels) {
+	// levels can be stored in any order, stage the smallest range that covers all of them
+	size_t begin = SIZE_MAX, end = 0;
+	for (const auto& level : levels) {
+		begin = std::min(begin, level.offset);
+		end = std::max(end, level.offset + level.size);
+	}
+	const size_t size = end - begin;
+
+	UploadStream& stream = this->uploadStream(UploadQueue::eGraphics);
+	const StagingRange staging = this->stage(stream, reinterpret_cast<const byte*>(ptr) + begin, size);
+
+	const uint32_t mipLevels = static_cast<uint32_t>(levels.size());
+	vk::Format format = vkFormatFromImageFormat(imageFormat);
+
+	auto&& [image, imageAllocation] = allocator.createImage(
+		vk::ImageCreateInfo{ {}, vk::ImageType::e2D, format, vk::Extent3D{width, height, 1}, mipLevels, 1, vk::SampleCountFlagBits::e1, vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled, vk::SharingMode::eExclusive },
+		vma::AllocationCreateInfo{ {}, vma::MemoryUsage::eGpuOnly }
+	);
+	this->trackAllocation(MemoryCategory::eTextures, imageAllocation);
+
+	vk::CommandBuffer cb = this->beginUpload(stream);
+	cb.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, vk::ImageMemoryBarrier{ {}, vk::AccessFlagBits::eTransferWrite, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, image, vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, 0, mipLevels, 0, 1} });
+
+	// stored levels are copied as-is, one region per level
+	std::vector<vk::BufferImageCopy> copyRegions;
+	copyRegions.reserve(mipLevels);
+	for (uint32_t i = 0; i < mipLevels; i++) {
+		copyRegions.push_back(vk::BufferImageCopy{ staging.offset + levels[i].offset - begin, 0, 0, vk::ImageSubresourceLayers{vk::ImageAspectFlagBits::eColor, i, 0, 1}, {0, 0, 0}, {std::max(width >> i, 1u), std::max(height >> i, 1u), 1} });
+	}
+	cb.copyBufferToImage(staging.buffer, image, vk::ImageLayout::eTransferDstOptimal, copyRegions);
+
+	cb.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, {}, {}, {}, vk::ImageMemoryBarrier{ vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, image, vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, 0, mipLevels, 0, 1} });
+	this->endUpload(stream);
+
+	// the render loop reaps retired images from the tables
+	std::unique_lock lock{ this->materialMutex };
 	imageTable.insert({ this->nextImageId, image });
 	imageAllocationTable.insert({ this->nextImageId, imageAllocation });
 	imageFormatTable.insert({ this->nextImageId, format });
+	imageExtentTable.insert({ this->nextImageId, vk::Extent2D{ width, height } });
+	imageMipLevelsTable.insert({ this->nextImageId, mipLevels });
 	return this->nextImageId++;
 }
 
+vk::ImageView VulkanRenderer::makeTextureImageView(Image imageId) {
+	std::shared_lock lock{ this->materialMutex };
+	return device.createImageView(vk::ImageViewCreateInfo{ {}, this->imageTable[imageId], vk::ImageViewType::e2D, this->imageFormatTable[imageId], vk::ComponentMapping{}, vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, 0, VK_REMAINING_MIP_LEVELS, 0, 1 } });
+}
+
 Texture VulkanRenderer::makeTexture(Image imageId, Sampler samplerData) {
-	vk::ImageView imageView = device.createImageView(vk::ImageViewCreateInfo{ {}, this->imageTable[imageId], vk::ImageViewType::e2D, this->imageFormatTable[imageId], vk::ComponentMapping{}, vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, 0, VK_REMAINING_MIP_LEVELS, 0, 1 } });
+	vk::ImageView imageView = this->makeTextureImageView(imageId);
 
 	vk::Sampler sampler = device.createSampler(vk::SamplerCreateInfo{ {},
 		samplerData.magFilter == SamplerFilter::eLinear ? vk::Filter::eLinear : vk::Filter::eNearest,
@@ -379,119 +451,81 @@ Texture VulkanRenderer::makeTexture(Image imageId, Sampler samplerData) {
 		VK_LOD_CLAMP_NONE 
 	});
 
-	textureImageViewTable.insert({ this->nextImageId, imageView });
-	textureSamplerTable.insert({ this->nextImageId, sampler });
-	return this->nextImageId++;
+	std::unique_lock lock{ this->materialMutex };
+	textureImageViewTable.insert({ this->nextTextureId, imageView });
+	textureSamplerTable.insert({ this->nextTextureId, sampler });
+	return this->nextTextureId++;
 }
 
-void VulkanRenderer::setMeshes(const std::vector<Mesh>& meshes) {
-	this->destroyVertexBuffer();
-	
-	for (const Mesh& mesh : meshes) {
-		auto meshPtr = std::make_shared<MeshPrimitive>(mesh);
-		switch (mesh.alphaInfo.alphaMode) {
-		case AlphaMode::eOpaque:
-			this->opaqueMeshes.push_back(meshPtr);
-			break;
-		case AlphaMode::eMask:
-			this->alphaMaskMeshes.push_back(meshPtr);
-			this->nonOpaqueMeshes.push_back(meshPtr);
-			break;
-		case AlphaMode::eBlend:
-			this->alphaBlendMeshes.push_back(meshPtr);
-			this->nonOpaqueMeshes.push_back(meshPtr);
-			break;
-		}
-		if (mesh.node->isStatic())
-			this->staticMeshes.push_back(meshPtr);
-		else
-			this->dynamicMeshes.push_back(meshPtr);
-		this->meshes.push_back(meshPtr);
-		this->boundingBoxMeshes.push_back(std::make_shared<MeshPrimitive>(mesh.boundingBoxAsMesh()));
-	}
+// retired resources are reaped by the render loop once no frame in flight uses them
+void VulkanRenderer::destroyTexture(Texture texture) {
+	std::unique_lock lock{ this->materialMutex };
+	this->retiredTextures.push_back({ this->frameCount.load(), texture });
+}
 
-	vk::DeviceSize minBufferAlignment = this->physicalDevice.getProperties().limits.minUniformBufferOffsetAlignment;
-	vk::DeviceSize pbrAlignment = (sizeof(PBRInfo) / minBufferAlignment + (sizeof(PBRInfo) % minBufferAlignment ? 1 : 0)) * minBufferAlignment;
-	vk::DeviceSize alphaAlignment = (sizeof(AlphaInfo) / minBufferAlignment + (sizeof(AlphaInfo) % minBufferAlignment ? 1 : 0)) * minBufferAlignment;
-
-	size_t pbrBufferSize = meshes.size() * pbrAlignment;
-	this->allocator.destroyBuffer(this->pbrBuffer, this->pbrBufferAllocation);
-	auto [pbrStagingBuffer, pbrStagingBufferAllocation] = this->allocator.createBuffer(vk::BufferCreateInfo{ {}, pbrBufferSize , vk::BufferUsageFlagBits::eTransferSrc, vk::SharingMode::eExclusive }, vma::AllocationCreateInfo{ {}, vma::MemoryUsage::eCpuOnly });
-	std::tie(this->pbrBuffer, this->pbrBufferAllocation) = this->allocator.createBuffer(vk::BufferCreateInfo{ {}, pbrBufferSize, vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::SharingMode::eExclusive }, vma::AllocationCreateInfo{ {}, vma::MemoryUsage::eGpuOnly });
-
-	size_t alphaBufferSize = (1 + alphaMaskMeshes.size()) * alphaAlignment;
-	auto [alphaStagingBuffer, alphaStagingBufferAllocation] = this->allocator.createBuffer(vk::BufferCreateInfo{ {}, alphaBufferSize , vk::BufferUsageFlagBits::eTransferSrc, vk::SharingMode::eExclusive }, vma::AllocationCreateInfo{ {}, vma::MemoryUsage::eCpuOnly });
-	std::tie(this->alphaBuffer, this->alphaBufferAllocation) = this->allocator.createBuffer(vk::BufferCreateInfo{ {}, alphaBufferSize, vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::SharingMode::eExclusive }, vma::AllocationCreateInfo{ {}, vma::MemoryUsage::eGpuOnly });
-
-	unsigned char* pbrSBData = reinterpret_cast<unsigned char*>(this->allocator.mapMemory(pbrStagingBufferAllocation));
-	unsigned char* alphaSBData = reinterpret_cast<unsigned char*>(this->allocator.mapMemory(alphaStagingBufferAllocation));
-
-	for (const auto& [i, mesh] : iter::enumerate(this->meshes)) {
-		mesh->albedoTexture.loadToDevice(this->device, this->allocator, this->graphicsQueue, this->commandPool);
-		mesh->normalTexture.loadToDevice(this->device, this->allocator, this->graphicsQueue, this->commandPool);
-		mesh->metalRoughnessTexture.loadToDevice(this->device, this->allocator, this->graphicsQueue, this->commandPool);
-		mesh->emissiveTexture.loadToDevice(this->device, this->allocator, this->graphicsQueue, this->commandPool);
-		mesh->aoTexture.loadToDevice(this->device, this->allocator, this->graphicsQueue, this->commandPool);
-
-		mesh->descriptorSet = this->device.allocateDescriptorSets(vk::DescriptorSetAllocateInfo{ this->descriptorPool, this->pbrDescriptorSetLayout })[0];
-		mesh->hasDescriptorSet = true;
-		
-		*reinterpret_cast<PBRInfo*>(pbrSBData + i * pbrAlignment) = mesh->materialInfo;
-
-		std::vector<vk::DescriptorBufferInfo> pbrBufferInfos = { vk::DescriptorBufferInfo{this->pbrBuffer, i * pbrAlignment, sizeof(PBRInfo) } };
-		std::vector<vk::DescriptorImageInfo> albedoImageInfos = { vk::DescriptorImageInfo{this->textureSampler, mesh->albedoTexture.imageView(), vk::ImageLayout::eShaderReadOnlyOptimal } };
-		std::vector<vk::DescriptorImageInfo> normalImageInfos = { vk::DescriptorImageInfo{this->textureSampler, mesh->normalTexture.imageView(), vk::ImageLayout::eShaderReadOnlyOptimal } };
-		std::vector<vk::DescriptorImageInfo> metallicRoughnessImageInfos = { vk::DescriptorImageInfo{this->textureSampler, mesh->metalRoughnessTexture.imageView(), vk::ImageLayout::eShaderReadOnlyOptimal } };
-		std::vector<vk::DescriptorImageInfo> aoImageInfos = { vk::DescriptorImageInfo{this->textureSampler, mesh->aoTexture.imageView(), vk::ImageLayout::eShaderReadOnlyOptimal } };
-		std::vector<vk::DescriptorImageInfo> emissiveImageInfos = { vk::DescriptorImageInfo{this->textureSampler, mesh->emissiveTexture.imageView(), vk::ImageLayout::eShaderReadOnlyOptimal } };
-		std::vector<vk::DescriptorBufferInfo> alphaBufferInfos = { vk::DescriptorBufferInfo{this->alphaBuffer, 0, sizeof(AlphaInfo) } };
-
-		std::vector<vk::WriteDescriptorSet> writeDescriptorSets = {
-			vk::WriteDescriptorSet{ mesh->descriptorSet, 0, 0, vk::DescriptorType::eUniformBuffer, {}, pbrBufferInfos},
-			vk::WriteDescriptorSet{ mesh->descriptorSet, 1, 0, vk::DescriptorType::eCombinedImageSampler, albedoImageInfos },
-			vk::WriteDescriptorSet{ mesh->descriptorSet, 2, 0, vk::DescriptorType::eCombinedImageSampler, normalImageInfos },
-			vk::WriteDescriptorSet{ mesh->descriptorSet, 3, 0, vk::DescriptorType::eCombinedImageSampler, metallicRoughnessImageInfos },
-			vk::WriteDescriptorSet{ mesh->descriptorSet, 4, 0, vk::DescriptorType::eCombinedImageSampler, aoImageInfos },
-			vk::WriteDescriptorSet{ mesh->descriptorSet, 5, 0, vk::DescriptorType::eCombinedImageSampler, emissiveImageInfos },
-			vk::WriteDescriptorSet{ mesh->descriptorSet, 6, 0, vk::DescriptorType::eUniformBuffer, {}, alphaBufferInfos },
-		};
-		this->device.updateDescriptorSets(writeDescriptorSets, {});
-	}
+void VulkanRenderer::destroyImage(Image image) {
+	std::unique_lock lock{ this->materialMutex };
+	this->retiredImages.push_back({ this->frameCount.load(), image });
+}
 
-	reinterpret_cast<AlphaInfo*>(alphaSBData)[0] = AlphaInfo{ AlphaMode::eOpaque, 0.0f };
-	for (const auto& [i, mesh] : iter::enumerate(this->alphaMaskMeshes)) {
-		*reinterpret_cast<AlphaInfo*>(alphaSBData + (1 + i) * alphaAlignment) = mesh->alphaInfo;
+void VulkanRenderer::destroyBuffer(Buffer buffer) {
+	std::unique_lock lock{ this->vertexBufferMutex };
+	this->retiredBuffers.push_back({ this->frameCount.load(), buffer });
+}
 
-		std::vector<vk::DescriptorBufferInfo> alphaBufferInfos = { vk::DescriptorBufferInfo{this->alphaBuffer, (1 + i) * alphaAlignment, sizeof(AlphaInfo) } };
-		std::vector<vk::WriteDescriptorSet> writeDescriptorSets = {
-			vk::WriteDescriptorSet{ mesh->descriptorSet, 6, 0, vk::DescriptorType::eUniformBuffer, {}, alphaBufferInfos },
-		};
-		this->device.updateDescriptorSets(writeDescriptorSets, {});
+void VulkanRenderer::destroyRetiredTextures(bool all) {
+	const uint64_t frame = this->frameCount.load();
+
+	// material descriptor sets are made from the view table, also by loading threads while the texture streamer runs
+	std::unique_lock materialLock{ this->materialMutex };
+	while (!this->retiredTextures.empty() && (all || this->retiredTextures.front().first + FRAMES_IN_FLIGHT <= frame)) {
+		const Texture texture = this->retiredTextures.front().second;
+		this->device.destroyImageView(this->textureImageViewTable.at(texture));
+		this->device.destroySampler(this->textureSamplerTable.at(texture));
+		this->textureImageViewTable.erase(texture);
+		this->textureSamplerTable.erase(texture);
+		this->retiredTextures.pop_front();
 	}
 
-	this->allocator.unmapMemory(pbrStagingBufferAllocation);
-	this->allocator.unmapMemory(alphaStagingBufferAllocation);
-
-	auto cmdBuffers = device.allocateCommandBuffers(vk::CommandBufferAllocateInfo{ commandPool, vk::CommandBufferLevel::ePrimary, 1 });
-	vk::CommandBuffer cb = cmdBuffers[0];
+	while (!this->retiredImageViews.empty() && (all || this->retiredImageViews.front().first + FRAMES_IN_FLIGHT <= frame)) {
+		this->device.destroyImageView(this->retiredImageViews.front().second);
+		this->retiredImageViews.pop_front();
+	}
 
-	cb.begin(vk::CommandBufferBeginInfo{ vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
-	cb.copyBuffer(pbrStagingBuffer, this->pbrBuffer, vk::BufferCopy{0, 0, pbrBufferSize});
-	cb.copyBuffer(alphaStagingBuffer, this->alphaBuffer, vk::BufferCopy{0, 0, alphaBufferSize});
-	cb.end();
+	while (!this->retiredImages.empty() && (all || this->retiredImages.front().first + FRAMES_IN_FLIGHT <= frame)) {
+		const Image image = this->retiredImages.front().second;
+		this->untrackAllocation(MemoryCategory::eTextures, this->imageAllocationTable.at(image));
+		this->allocator.destroyImage(this->imageTable.at(image), this->imageAllocationTable.at(image));
+		this->imageTable.erase(image);
+		this->imageAllocationTable.erase(image);
+		this->imageFormatTable.erase(image);
+		this->imageExtentTable.erase(image);
+		this->imageMipLevelsTable.erase(image);
+		this->retiredImages.pop_front();
+	}
+}
 
-	vk::Fence fence = this->device.createFence(vk::FenceCreateInfo{});
-	this->graphicsQueue.submit(vk::SubmitInfo{ {}, {}, cb, {} }, fence);
-	this->device.waitForFences(fence, true, UINT64_MAX);
-	this->allocator.destroyBuffer(pbrStagingBuffer, pbrStagingBufferAllocation);
-	this->allocator.destroyBuffer(alphaStagingBuffer, alphaStagingBufferAllocation);
-	this->device.freeCommandBuffers(commandPool, cb);
-	this->device.destroyFence(fence);
+void VulkanRenderer::destroyRetiredBuffers(bool all) {
+	const uint64_t frame = this->frameCount.load();
 
-	this->createVertexBuffer();
+	// the render loop reads the table while recording
+	std::unique_lock lock{ this->vertexBufferMutex };
+	// a buffer whose upload is still in flight is kept until the copy is done
+	auto isUploaded = [this](Buffer buffer) {
+		const auto ticket = this->bufferUploadTable.find(buffer);
+		return ticket == this->bufferUploadTable.end() || this->isUploadComplete(ticket->second);
+	};
+	while (!this->retiredBuffers.empty() && (all || (this->retiredBuffers.front().first + FRAMES_IN_FLIGHT <= frame && isUploaded(this->retiredBuffers.front().second)))) {
+		const Buffer buffer = this->retiredBuffers.front().second;
+		this->untrackAllocation(MemoryCategory::eGeometry, this->bufferAllocationTable.at(buffer));
+		this->allocator.destroyBuffer(this->bufferTable.at(buffer), this->bufferAllocationTable.at(buffer));
+		this->bufferTable.erase(buffer);
+		this->bufferAllocationTable.erase(buffer);
+		this->bufferUploadTable.erase(buffer);
+		this->retiredBuffers.pop_front();
+	}
 }
 
-
 void VulkanRenderer::start() {
 	this->running = true;
 	this->renderThread = std::thread([this] { this->renderLoop(); });
@@ -509,6 +543,19 @@ void VulkanRenderer::setPhysicalDevice(vk::PhysicalDevice physicalDevice) {
 		}
 	}
 
+	// a family that only does transfers is usually a copy engine that runs beside the graphics queue
+	this->transferQueueFamilyIndex = this->graphicsQueueFamilyIndex;
+	for (uint32_t i = 0; i < queueFamilies.size(); i++) {
+		const vk::QueueFlags queueFlags = queueFamilies[i].queueFlags;
+		if ((queueFlags & vk::QueueFlagBits::eTransfer) && !(queueFlags & (vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute))) {
+			this->transferQueueFamilyIndex = i;
+			break;
+		}
+	}
+	this->uploadQueueFamilyIndices = { this->graphicsQueueFamilyIndex };
+	if (this->transferQueueFamilyIndex != this->graphicsQueueFamilyIndex)
+		this->uploadQueueFamilyIndices.push_back(this->transferQueueFamilyIndex);
+
 	physicalDevice.getSurfaceSupportKHR(this->graphicsQueueFamilyIndex, this->surface);
 
 	if (this->device != vk::Device()) {
@@ -525,14 +572,28 @@ void VulkanRenderer::setPhysicalDevice(vk::PhysicalDevice physicalDevice) {
 	}
 
 	std::vector<float> queuePriorities = { 1.0f };
-	vk::DeviceQueueCreateInfo queueCreateInfo = vk::DeviceQueueCreateInfo{{}, this->graphicsQueueFamilyIndex, queuePriorities};
+	std::vector<vk::DeviceQueueCreateInfo> queueCreateInfos;
+	for (const uint32_t queueFamilyIndex : this->uploadQueueFamilyIndices)
+		queueCreateInfos.push_back(vk::DeviceQueueCreateInfo{ {}, queueFamilyIndex, queuePriorities });
 	std::vector<const char*> deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME, VK_KHR_16BIT_STORAGE_EXTENSION_NAME, VK_KHR_8BIT_STORAGE_EXTENSION_NAME };
 
+	// lets VMA report the budget the driver gives the process instead of guessing from heap sizes
+	bool memoryBudgetSupported = false;
+	for (const auto& extension : this->physicalDevice.enumerateDeviceExtensionProperties()) {
+		if (std::string_view{ extension.extensionName.data() } == VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)
+			memoryBudgetSupported = true;
+	}
+	if (memoryBudgetSupported)
+		deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
 	vk::PhysicalDevice16BitStorageFeaturesKHR device16BitStorageFeatures{};
 	device16BitStorageFeatures.uniformAndStorageBuffer16BitAccess = true;
 	device16BitStorageFeatures.storageBuffer16BitAccess = true;
+	vk::PhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures{};
+	timelineSemaphoreFeatures.pNext = &device16BitStorageFeatures;
+	timelineSemaphoreFeatures.timelineSemaphore = true;
 	vk::PhysicalDevice8BitStorageFeaturesKHR device8BitStorageFeatures{};
-	device8BitStorageFeatures.pNext = &device16BitStorageFeatures;
+	device8BitStorageFeatures.pNext = &timelineSemaphoreFeatures;
 	device8BitStorageFeatures.uniformAndStorageBuffer8BitAccess = true;
 	device8BitStorageFeatures.storageBuffer8BitAccess = true;
 	vk::PhysicalDeviceFeatures2 deviceFeatures2{};
@@ -540,17 +601,22 @@ void VulkanRenderer::setPhysicalDevice(vk::PhysicalDevice physicalDevice) {
 	deviceFeatures2.features.fillModeNonSolid = true;
 	deviceFeatures2.features.samplerAnisotropy = true;
 	deviceFeatures2.features.imageCubeArray = true;
+	this->mipGenerationSupported = this->physicalDevice.getFeatures().shaderStorageImageArrayDynamicIndexing;
+	deviceFeatures2.features.shaderStorageImageArrayDynamicIndexing = this->mipGenerationSupported;
 
-	vk::DeviceCreateInfo deviceCreateInfo{ {}, queueCreateInfo, {}, deviceExtensions, nullptr };
+	vk::DeviceCreateInfo deviceCreateInfo{ {}, queueCreateInfos, {}, deviceExtensions, nullptr };
 	deviceCreateInfo.pNext = &deviceFeatures2;
 
 	this->device = this->physicalDevice.createDevice(deviceCreateInfo);
 	this->graphicsQueue = this->device.getQueue(this->graphicsQueueFamilyIndex, 0);
+	this->transferQueue = this->device.getQueue(this->transferQueueFamilyIndex, 0);
 
 	this->commandPool = this->device.createCommandPool(vk::CommandPoolCreateInfo{{vk::CommandPoolCreateFlagBits::eResetCommandBuffer}, this->graphicsQueueFamilyIndex});
 	vma::AllocatorCreateInfo allocatorInfo{ {}, this->physicalDevice, this->device, };
 	allocatorInfo.instance = this->vulkanInstance;
 	allocatorInfo.vulkanApiVersion = VK_API_VERSION_1_1;
+	if (memoryBudgetSupported)
+		allocatorInfo.flags = vma::AllocatorCreateFlagBits::eExtMemoryBudget;
 	this->allocator = vma::createAllocator(allocatorInfo);
 
 	std::array<vk::Format, 4> colorFormatCandidates = {
@@ -710,17 +776,21 @@ void VulkanRenderer::createSwapchainAndAttachmentImages() {
 	}
 
 	std::tie(this->depthImage, this->depthImageAllocation) = this->allocator.createImage(vk::ImageCreateInfo{ {}, vk::ImageType::e2D, this->depthAttachmentFormat, vk::Extent3D{this->swapchainExtent, 1}, 1, 1, static_cast<vk::SampleCountFlagBits>(this->_settings.msaa), vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eDepthStencilAttachment, vk::SharingMode::eExclusive, {} }, vma::AllocationCreateInfo{ {}, vma::MemoryUsage::eGpuOnly });
+	this->trackAllocation(MemoryCategory::eAttachments, this->depthImageAllocation);
 	this->depthImageView = this->device.createImageView(vk::ImageViewCreateInfo{ {}, this->depthImage, vk::ImageViewType::e2D, this->depthAttachmentFormat, vk::ComponentMapping{}, { vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1 } });
 	
 	std::tie(this->colorImage, this->colorImageAllocation) = this->allocator.createImage(vk::ImageCreateInfo{ {}, vk::ImageType::e2D, this->colorAttachmentFormat, vk::Extent3D{this->swapchainExtent, 1}, 1, 1, vk::SampleCountFlagBits::e1, vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eSampled, vk::SharingMode::eExclusive, {} }, vma::AllocationCreateInfo{ {}, vma::MemoryUsage::eGpuOnly });
+	this->trackAllocation(MemoryCategory::eAttachments, this->colorImageAllocation);
 	this->colorImageView = this->device.createImageView(vk::ImageViewCreateInfo{ {}, this->colorImage, vk::ImageViewType::e2D, this->colorAttachmentFormat, vk::ComponentMapping{}, { vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 } });
 
 	if (this->_settings.msaa != SampleCount::e1) {
 		std::tie(this->colorImageMS, this->colorImageMSAllocation) = this->allocator.createImage(vk::ImageCreateInfo{ {}, vk::ImageType::e2D, this->colorAttachmentFormat, vk::Extent3D{this->swapchainExtent, 1}, 1, 1, static_cast<vk::SampleCountFlagBits>(this->_settings.msaa), vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eColorAttachment, vk::SharingMode::eExclusive, {} }, vma::AllocationCreateInfo{ {}, vma::MemoryUsage::eGpuOnly });
+		this->trackAllocation(MemoryCategory::eAttachments, this->colorImageMSAllocation);
 		this->colorImageMSView = this->device.createImageView(vk::ImageViewCreateInfo{ {}, this->colorImageMS, vk::ImageViewType::e2D, this->colorAttachmentFormat, vk::ComponentMapping{}, { vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 } });
 	}
 
 	std::tie(this->luminanceImage, this->luminanceImageAllocation) = this->allocator.createImage(vk::ImageCreateInfo{ {}, vk::ImageType::e2D, vk::Format::eR32Sfloat, vk::Extent3D{this->swapchainExtent, 1}, 1, 1, vk::SampleCountFlagBits::e1, vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eTransferSrc, vk::SharingMode::eExclusive, {} }, vma::AllocationCreateInfo{ {}, vma::MemoryUsage::eGpuOnly });
+	this->trackAllocation(MemoryCategory::eAttachments, this->luminanceImageAllocation);
 	this->luminanceImageView = this->device.createImageView(vk::ImageViewCreateInfo{ {}, this->luminanceImage, vk::ImageViewType::e2D, vk::Format::eR32Sfloat, vk::ComponentMapping{}, { vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1 } });
 
 	auto buffers = this->device.allocateCommandBuffers(vk::CommandBufferAllocateInfo{ this->commandPool, vk::CommandBufferLevel::ePrimary, FRAMES_IN_FLIGHT });
@@ -819,58 +889,13 @@ void VulkanRenderer::createDescriptorPool() {
 
 void VulkanRenderer::createPipeline() {
 
-	vk::ShaderModule vertexModule = loadShader("./shaders/basic.vert.spv");
-	vk::PipelineShaderStageCreateInfo vertexStageInfo = vk::PipelineShaderStageCreateInfo{{}, vk::ShaderStageFlagBits::eVertex, vertexModule, "main"};
+	// the vertex input state depends on the meshes, pipelines are made per vertex layout by meshPipeline
+	this->meshVertexShaderModule = loadShader("./shaders/basic.vert.spv");
+	this->pbrFragmentShaderModule = loadShader("./shaders/pbr.frag.spv");
+	this->solidFragmentShaderModule = loadShader("./shaders/solid.frag.spv");
+	this->shaderModules = { this->meshVertexShaderModule, this->pbrFragmentShaderModule, this->solidFragmentShaderModule };
 
-	vk::ShaderModule pbrFragModule = loadShader("./shaders/pbr.frag.spv");
-	vk::PipelineShaderStageCreateInfo pbrFragStageInfo = vk::PipelineShaderStageCreateInfo{{}, vk::ShaderStageFlagBits::eFragment, pbrFragModule, "main"};
-
-	vk::ShaderModule solidFragModule = loadShader("./shaders/solid.frag.spv");
-	vk::PipelineShaderStageCreateInfo solidFragStageInfo = vk::PipelineShaderStageCreateInfo{ {}, vk::ShaderStageFlagBits::eFragment, solidFragModule, "main" };
-
-	this->shaderModules = { vertexModule, pbrFragModule, solidFragModule };
-
-	std::vector<vk::PipelineShaderStageCreateInfo> shaderStagesInfo = { vertexStageInfo, pbrFragStageInfo };
-	std::vector<vk::PipelineShaderStageCreateInfo> wireframeShaderStagesInfo = { vertexStageInfo, solidFragStageInfo };
-	
-	vk::VertexInputBindingDescription vertexBindingDescription(0, sizeof(Vertex), vk::VertexInputRate::eVertex);
-	std::vector<vk::VertexInputAttributeDescription> vertexAttributeDescriptions = {
-		vk::VertexInputAttributeDescription{ 0, 0, vk::Format::eR32G32B32Sfloat, offsetof(Vertex, pos) },
-		vk::VertexInputAttributeDescription{ 1, 0, vk::Format::eR32G32B32Sfloat, offsetof(Vertex, normal) },
-		vk::VertexInputAttributeDescription{ 2, 0, vk::Format::eR32G32B32Sfloat, offsetof(Vertex, tangent) },
-		vk::VertexInputAttributeDescription{ 3, 0, vk::Format::eR32G32B32Sfloat, offsetof(Vertex, bitangent) },
-		vk::VertexInputAttributeDescription{ 4, 0, vk::Format::eR32G32Sfloat, offsetof(Vertex, uv) }
-	};
-
-	vk::PipelineVertexInputStateCreateInfo vertexInputInfo{{}, vertexBindingDescription, vertexAttributeDescriptions};
-
-	vk::PipelineInputAssemblyStateCreateInfo inputAssemblyInfo{{}, vk::PrimitiveTopology::eTriangleList, false};
-
-	std::vector<vk::Viewport> viewports = { vk::Viewport{ 0.0f, 0.0f, static_cast<float>(this->swapchainExtent.width), static_cast<float>(this->swapchainExtent.height), 0.0f, 1.0f  } };
-	std::vector<vk::Rect2D> scissors = { vk::Rect2D({0, 0}, this->swapchainExtent) };
-
-	vk::PipelineViewportStateCreateInfo viewportInfo{{}, viewports, scissors};
-
-	vk::PipelineRasterizationStateCreateInfo rasterizationInfo{ {}, false, false, vk::PolygonMode::eFill, vk::CullModeFlagBits::eBack, vk::FrontFace::eCounterClockwise, false, 0.0f, 0.0f, 0.0f, 1.0f };
-	vk::PipelineRasterizationStateCreateInfo wireframeRasterizationInfo{ {}, false, false, vk::PolygonMode::eLine, vk::CullModeFlagBits::eNone, vk::FrontFace::eCounterClockwise, false, 0.0f, 0.0f, 0.0f, 1.0f };
-
-	vk::PipelineDepthStencilStateCreateInfo depthStencilInfo{ {}, true, true, vk::CompareOp::eLess };
-	vk::PipelineDepthStencilStateCreateInfo wireframeDepthStencilInfo{ {}, false, false, vk::CompareOp::eAlways };
-
-	vk::PipelineMultisampleStateCreateInfo multisampleInfo{ {}, static_cast<vk::SampleCountFlagBits>(this->_settings.msaa) };
-
-	vk::PipelineColorBlendAttachmentState opaqueColorBlendAttachment(false, vk::BlendFactor::eOne, vk::BlendFactor::eZero, vk::BlendOp::eAdd, vk::BlendFactor::eOne, vk::BlendFactor::eZero, vk::BlendOp::eAdd, vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA);
-	vk::PipelineColorBlendStateCreateInfo opaqueColorBlendInfo{ {}, false, vk::LogicOp::eCopy, opaqueColorBlendAttachment };
-
-	vk::PipelineColorBlendAttachmentState blendColorBlendAttachment(true, vk::BlendFactor::eSrcAlpha, vk::BlendFactor::eOneMinusSrcAlpha, vk::BlendOp::eAdd, vk::BlendFactor::eOne, vk::BlendFactor::eZero, vk::BlendOp::eSubtract, vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA);
-	vk::PipelineColorBlendStateCreateInfo blendColorBlendInfo{ {}, false, vk::LogicOp::eCopy, blendColorBlendAttachment };
-	
-	//std::vector<vk::DynamicState> dynamicStates = { vk::DynamicState::eViewport, vk::DynamicState::eLineWidth };
-	std::vector<vk::DynamicState> dynamicStates = { };
-	vk::PipelineDynamicStateCreateInfo dynamicStateInfo{{}, dynamicStates};
-
-
-	std::vector<vk::PushConstantRange> pushConstantRanges = { vk::PushConstantRange{ vk::ShaderStageFlagBits::eVertex, 0, sizeof(glm::mat4) * 2 }, };
+	std::vector<vk::PushConstantRange> pushConstantRanges = { vk::PushConstantRange{ vk::ShaderStageFlagBits::eVertex, 0, sizeof(MeshPushConstants) }, };
 
 	std::vector<vk::DescriptorSetLayoutBinding> pbrSetBindings = {
 		vk::DescriptorSetLayoutBinding{0, vk::DescriptorType::eUniformBuffer, 1, vk::ShaderStageFlagBits::eFragment},
@@ -913,13 +938,9 @@ void VulkanRenderer::createPipeline() {
 
 	this->pipelineLayout = this->device.createPipelineLayout(vk::PipelineLayoutCreateInfo{ {}, setLayouts, pushConstantRanges });
 
-	vk::Result r;
-	std::tie(r, this->opaquePipeline) = this->device.createGraphicsPipeline(this->pipelineCache, vk::GraphicsPipelineCreateInfo{ {}, shaderStagesInfo, &vertexInputInfo, &inputAssemblyInfo, nullptr, &viewportInfo, &rasterizationInfo, &multisampleInfo, &depthStencilInfo, &opaqueColorBlendInfo, &dynamicStateInfo, this->pipelineLayout, this->renderPass, 0 });
-	std::tie(r, this->blendPipeline) = this->device.createGraphicsPipeline(this->pipelineCache, vk::GraphicsPipelineCreateInfo{ {}, shaderStagesInfo, &vertexInputInfo, &inputAssemblyInfo, nullptr, &viewportInfo, &rasterizationInfo, &multisampleInfo, &depthStencilInfo, &blendColorBlendInfo, &dynamicStateInfo, this->pipelineLayout, this->renderPass, 0 });
-	std::tie(r, this->wireframePipeline) = this->device.createGraphicsPipeline(this->pipelineCache, vk::GraphicsPipelineCreateInfo{ {}, wireframeShaderStagesInfo, &vertexInputInfo, &inputAssemblyInfo, nullptr, &viewportInfo, &wireframeRasterizationInfo, &multisampleInfo, &wireframeDepthStencilInfo, &opaqueColorBlendInfo, &dynamicStateInfo, this->pipelineLayout, this->renderPass, 0 });
-	
 	for (uint32_t i = 0; i < FRAMES_IN_FLIGHT; i++) {
 		std::tie(this->cameraBuffers[i], this->cameraBufferAllocations[i]) = this->allocator.createBuffer(vk::BufferCreateInfo{ {}, sizeof(CameraShaderData), vk::BufferUsageFlagBits::eUniformBuffer, vk::SharingMode::eExclusive }, vma::AllocationCreateInfo{ {}, vma::MemoryUsage::eCpuToGpu, vk::MemoryPropertyFlagBits::eHostCoherent });
+		this->trackAllocation(MemoryCategory::eBuffers, this->cameraBufferAllocations[i]);
 
 		std::vector<vk::DescriptorBufferInfo> bufferInfos = { vk::DescriptorBufferInfo{this->cameraBuffers[i], 0, sizeof(CameraShaderData)} };
 		this->device.updateDescriptorSets(vk::WriteDescriptorSet{ this->perFrameInFlightDescriptorSets[i], 0, 0, vk::DescriptorType::eUniformBuffer, {}, bufferInfos }, {});
@@ -927,25 +948,28 @@ void VulkanRenderer::createPipeline() {
 }
 
 bool VulkanRenderer::shouldCullMesh(const MeshPrimitive& mesh, const Node& node, const Camera& pov) {
-	const auto& planes = pov.getFrustumPlanesLocalSpace(node.modelMatrix()); //planes pointing inside frustum
-
-	for (auto& plane : planes) {
-		glm::vec3 nVertex = mesh.bbMin();
-
-		if (plane.x >= 0.0f) nVertex.x = mesh.bbMax().x;
-		if (plane.y >= 0.0f) nVertex.y = mesh.bbMax().y;
-		if (plane.z >= 0.0f) nVertex.z = mesh.bbMax().z;
+	// the bounds cover every instance of instanced primitives, which are culled one by one later
+	return isBoxOutsidePlanes(mesh.boundsMin(), mesh.boundsMax(), pov.getFrustumPlanesLocalSpace(node.modelMatrix()));
+}
 
-		if (glm::dot(nVertex, glm::vec3(plane)) + plane.w < 0.0f) //negative halfspace (plane equation)
-			return true;
-	}
-	return false;
+float VulkanRenderer::projectedScreenSize(const MeshPrimitive& mesh, const Node& node, const glm::vec3& cameraPos) {
+	const glm::mat4 model = node.modelMatrix();
+	const glm::vec3 center = glm::vec3{ model * glm::vec4{ (mesh.boundsMin() + mesh.boundsMax()) * 0.5f, 1.0f } };
+	const float scale = glm::max(glm::length(glm::vec3{ model[0] }), glm::max(glm::length(glm::vec3{ model[1] }), glm::length(glm::vec3{ model[2] })));
+	const float radius = glm::length(mesh.boundsMax() - mesh.boundsMin()) * 0.5f * scale;
+
+	// the camera is inside the sphere, the primitive may cover the whole screen
+	const float screenSize = static_cast<float>(std::max(this->swapchainExtent.width, this->swapchainExtent.height));
+	const float distance = glm::distance(center, cameraPos);
+	if (distance <= radius)
+		return screenSize;
+	return std::min(radius / (distance * glm::tan(this->_camera.vfov() * 0.5f)) * this->swapchainExtent.height, screenSize);
 }
 
-void VulkanRenderer::drawMeshes(const std::vector<std::shared_ptr<MeshPrimitive>>& meshes, const vk::CommandBuffer& cb, uint32_t frameIndex, const glm::mat4& viewproj, const glm::vec3& cameraPos, bool frustumCull, MeshSortingMode sortingMode) {
+void VulkanRenderer::drawMeshes(const std::vector<std::shared_ptr<MeshPrimitive>>& meshes, const vk::CommandBuffer& cb, uint32_t frameIndex, const glm::vec3& cameraPos, MeshPipelineKind pipelineKind, bool frustumCull, MeshSortingMode sortingMode) {
 
-	auto culledMeshes = iter::filter([this](const std::shared_ptr<MeshPrimitive> mesh) {
-		return !this->shouldCullMesh(*mesh);
+	auto culledMeshes = iter::filter([this, frustumCull](const std::shared_ptr<MeshPrimitive> mesh) {
+		return !frustumCull || !this->shouldCullMesh(*mesh, *mesh->node(), this->_camera);
 		}, meshes);
 
 	std::vector<std::shared_ptr<MeshPrimitive>> sortedMeshes;
@@ -964,37 +988,41 @@ void VulkanRenderer::drawMeshes(const std::vector<std::shared_ptr<MeshPrimitive>
 		break;
 	}
 
+	vk::Pipeline boundPipeline{};
 	for (auto& mesh : sortedMeshes) {
-		std::vector descriptorSets = { this->globalDescriptorSet };
-		if (mesh->hasDescriptorSet)
-			descriptorSets.push_back(mesh->descriptorSet);
-		descriptorSets.push_back(this->perFrameInFlightDescriptorSets[frameIndex]);
+		const vk::Pipeline pipeline = this->meshPipeline(pipelineKind, mesh->vertexLayout());
+		if (pipeline != boundPipeline) {
+			cb.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+			boundPipeline = pipeline;
+		}
+
+		std::vector descriptorSets = { this->globalDescriptorSet, this->materialTable.at(mesh->material()).descriptorSet, this->perFrameInFlightDescriptorSets[frameIndex] };
 
 		cb.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, this->pipelineLayout, 0, descriptorSets, {});
 
-		const glm::mat4 model = mesh->node->modelMatrix();
-		const glm::mat4 modelviewproj = viewproj * model;
+		const glm::mat4 model = mesh->node()->modelMatrix();
 
-		std::vector<glm::mat4> pushConstants = { modelviewproj, model };
+		const MeshPushConstants pushConstants{ model, glm::vec4{ mesh->positionOffset(), 0.0f }, glm::vec4{ mesh->positionScale(), 0.0f } };
 
-		cb.pushConstants<glm::mat4x4>(this->pipelineLayout, vk::ShaderStageFlagBits::eVertex, 0, pushConstants);
+		cb.pushConstants<MeshPushConstants>(this->pipelineLayout, vk::ShaderStageFlagBits::eVertex, 0, pushConstants);
 
-		std::vector<vk::Buffer> vertexBuffers{};
-		std::vector<size_t> vertexBufferOffsets{};
+		this->bindMeshVertexBuffers(cb, *mesh);
+		const uint32_t instanceCount = this->bindMeshInstances(cb, *mesh, frameIndex, frustumCull ? &this->_camera : nullptr);
+		if (instanceCount == 0)
+			continue;
 
-		for (auto& attr : mesh->vertexBufferDescription()) {
-			vertexBuffers.push_back(std::get<0>(this->bufferTable[attr.buffer.id]));
-			vertexBufferOffsets.push_back(attr.offset);
+		// only the camera's own pass culls against its frustum, the texture streamer wants to know what it sees
+		if (frustumCull) {
+			float& screenSize = this->recordingMaterialScreenSizes[mesh->material()];
+			screenSize = std::max(screenSize, this->projectedScreenSize(*mesh, *mesh->node(), cameraPos));
 		}
 
-		cb.bindVertexBuffers(0, vertexBuffers, vertexBufferOffsets);
-
 		if (mesh->isIndexed()) {
-			cb.bindIndexBuffer(std::get<0>(this->bufferTable[mesh->indexBufferDescription().buffer.id]), mesh->indexBufferDescription().offset, vkIndexTypeFromAttributeValueType(mesh->indexBufferDescription().indexType));
-			cb.drawIndexed(static_cast<uint32_t>(mesh->indexBufferDescription().count), 1, 0, 0, 0);
+			cb.bindIndexBuffer(this->bufferTable.at(mesh->indexBufferDescription().buffer), mesh->indexBufferDescription().offset, vkIndexTypeFromAttributeValueType(mesh->indexBufferDescription().indexType));
+			cb.drawIndexed(static_cast<uint32_t>(mesh->indexBufferDescription().count), instanceCount, 0, 0, 0);
 		}
 		else
-			cb.draw(static_cast<uint32_t>(mesh->vertexBufferDescription()[0].count), 1, 0, 0);
+			cb.draw(static_cast<uint32_t>(mesh->vertexBufferDescription()[0].count), instanceCount, 0, 0);
 	}
 }
 
@@ -1014,8 +1042,17 @@ void VulkanRenderer::renderLoop() {
 		frameIndex = (frameIndex + 1) % FRAMES_IN_FLIGHT;
 
 		this->device.waitForFences(this->frameFences[frameIndex], true, UINT64_MAX);
+		this->updateMemoryGovernor();
 		this->device.resetFences(this->frameFences[frameIndex]);
 
+		this->frameCount++;
+		this->collectStreamedResources();
+		this->resetFrameInstances(static_cast<uint32_t>(frameIndex));
+
+		// loading threads add buffers and swap material descriptor sets, they wait while the frame is being recorded
+		std::shared_lock bufferLock{ this->vertexBufferMutex };
+		std::shared_lock materialLock{ this->materialMutex };
+
 		auto newFrameTime = std::chrono::high_resolution_clock::now();
 		// time since last frame in nanoseconds
 		double deltaTime = std::chrono::duration<double>(newFrameTime - frameTime).count();
@@ -1047,8 +1084,7 @@ void VulkanRenderer::renderLoop() {
 		cb.beginRenderPass(vk::RenderPassBeginInfo{ this->renderPass, this->mainFramebuffer, vk::Rect2D({ 0, 0 }, this->swapchainExtent), clearValues }, vk::SubpassContents::eInline);
 
 		if (!this->opaqueMeshes.empty()) {
-			cb.bindPipeline(vk::PipelineBindPoint::eGraphics, this->opaquePipeline);
-			this->drawMeshes(this->opaqueMeshes, cb, frameIndex, viewproj, cameraPos, true, MeshSortingMode::eFrontToBack);
+			this->drawMeshes(this->opaqueMeshes, cb, frameIndex, cameraPos, MeshPipelineKind::eOpaque, true, MeshSortingMode::eFrontToBack);
 		}
 
 		std::vector<vk::DescriptorSet> envDescriptorSets = { this->envDescriptorSet, this->perFrameInFlightDescriptorSets[frameIndex] };
@@ -1057,20 +1093,31 @@ void VulkanRenderer::renderLoop() {
 		cb.draw(6, 1, 0, 0);
 
 		if (!this->nonOpaqueMeshes.empty()) {
-			cb.bindPipeline(vk::PipelineBindPoint::eGraphics, this->blendPipeline);
-			this->drawMeshes(this->nonOpaqueMeshes, cb, frameIndex, viewproj, cameraPos, true, MeshSortingMode::eBackToFront);
+			this->drawMeshes(this->nonOpaqueMeshes, cb, frameIndex, cameraPos, MeshPipelineKind::eBlend, true, MeshSortingMode::eBackToFront);
 		}
 		
 		cb.endRenderPass();
 		cb.end();
 
-		std::array<vk::Semaphore, 1> mainAwaitSemaphores = { this->shadowPassFinishedSemaphores[frameIndex] };
-		std::array<vk::PipelineStageFlags, 1> mainWaitStageFlags = { vk::PipelineStageFlagBits::eFragmentShader };
-		this->graphicsQueue.submit(vk::SubmitInfo{ mainAwaitSemaphores, mainWaitStageFlags, this->mainCommandBuffers[frameIndex], this->mainRenderPassFinishedSemaphores[frameIndex] });
+		{
+			std::lock_guard lock{ this->materialScreenSizesMutex };
+			std::swap(this->materialScreenSizes, this->recordingMaterialScreenSizes);
+		}
+		this->recordingMaterialScreenSizes.clear();
+
+		bufferLock.unlock();
+		materialLock.unlock();
+
+		std::unique_lock queueLock{ this->queueMutex };
+
+		// the shadow pass waited on the uploads too, but only the main pass's vertex input is ordered after it by its own waits
+		this->submitFrameCommands(this->mainCommandBuffers[frameIndex], { this->shadowPassFinishedSemaphores[frameIndex] }, { vk::PipelineStageFlagBits::eFragmentShader }, this->mainRenderPassFinishedSemaphores[frameIndex]);
+		this->frameUploadWaits.clear();
 		
 		std::array<vk::Semaphore, 1> bloomAwaitSemaphores = { this->mainRenderPassFinishedSemaphores[frameIndex] };
 		std::array<vk::PipelineStageFlags, 1> bloomWaitStageFlags = { vk::PipelineStageFlagBits::eComputeShader };
 		this->graphicsQueue.submit(vk::SubmitInfo{ bloomAwaitSemaphores, bloomWaitStageFlags, this->bloomCommandBuffers[frameIndex], this->bloomPassFinishedSemaphores[frameIndex] });
+		queueLock.unlock();
 
 		float avgLogLuminance = *reinterpret_cast<float*>(this->allocator.mapMemory(this->averageLuminanceHostBufferAllocation));
 		avgLogLuminance = std::min(avgLogLuminance, 10.0f); // needed to prevent temporalLuminance from diverging
@@ -1102,6 +1149,7 @@ void VulkanRenderer::renderLoop() {
 
 		std::array<vk::Semaphore, 2> tonemapAwaitSemaphores = { this->imageAcquiredSemaphores[frameIndex], this->bloomPassFinishedSemaphores[frameIndex] };
 		std::array<vk::PipelineStageFlags, 2> tonemapWaitStageFlags = { vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eComputeShader };
+		queueLock.lock();
 		this->graphicsQueue.submit(vk::SubmitInfo{ tonemapAwaitSemaphores, tonemapWaitStageFlags, cb, this->compositionPassFinishedSemaphores[frameIndex] });
 
 		this->graphicsQueue.presentKHR(vk::PresentInfoKHR(this->compositionPassFinishedSemaphores[frameIndex], this->swapchain, imageIndex));
@@ -1133,6 +1181,10 @@ void VulkanRenderer::createAverageLuminanceImages() {
 	std::tie(this->averageLuminance16Image, this->averageLuminance16ImageAllocation) = this->allocator.createImage(vk::ImageCreateInfo{ {}, vk::ImageType::e2D, this->averageLuminanceFormat, vk::Extent3D{16, 16, 1}, 1, 1, vk::SampleCountFlagBits::e1, vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled, vk::SharingMode::eExclusive, {} }, vma::AllocationCreateInfo{ {}, vma::MemoryUsage::eGpuOnly });
 	std::tie(this->averageLuminance1Image, this->averageLuminance1ImageAllocation) = this->allocator.createImage(vk::ImageCreateInfo{ {}, vk::ImageType::e2D, this->averageLuminanceFormat, vk::Extent3D{1, 1, 1}, 1, 1, vk::SampleCountFlagBits::e1, vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eTransferSrc, vk::SharingMode::eExclusive, {} }, vma::AllocationCreateInfo{ {}, vma::MemoryUsage::eGpuOnly });
 	std::tie(this->averageLuminanceHostBuffer, this->averageLuminanceHostBufferAllocation) = this->allocator.createBuffer(vk::BufferCreateInfo{ {}, 4, vk::BufferUsageFlagBits::eTransferDst, vk::SharingMode::eExclusive, {} }, vma::AllocationCreateInfo{ {}, vma::MemoryUsage::eGpuToCpu });
+	this->trackAllocation(MemoryCategory::eAttachments, this->averageLuminance256ImageAllocation);
+	this->trackAllocation(MemoryCategory::eAttachments, this->averageLuminance16ImageAllocation);
+	this->trackAllocation(MemoryCategory::eAttachments, this->averageLuminance1ImageAllocation);
+	this->trackAllocation(MemoryCategory::eBuffers, this->averageLuminanceHostBufferAllocation);
 
 	this->averageLuminance256ImageView = this->device.createImageView(vk::ImageViewCreateInfo{ {}, this->averageLuminance256Image, vk::ImageViewType::e2D, this->averageLuminanceFormat, vk::ComponentMapping{}, vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1} });
 	this->averageLuminance16ImageView = this->device.createImageView(vk::ImageViewCreateInfo{ {}, this->averageLuminance16Image, vk::ImageViewType::e2D, this->averageLuminanceFormat, vk::ComponentMapping{}, vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1} });
@@ -1,9 +1,14 @@
 #pragma once
 
 #include <thread>
+#include <mutex>
 #include <shared_mutex>
+#include <atomic>
 #include <tuple>
 #include <array>
+#include <deque>
+#include <optional>
+#include <unordered_map>
 
 #include <vulkan/vulkan.hpp>
 #include <vkfw/vkfw.hpp>
@@ -20,10 +25,27 @@
 #include "Buffer.h"
 #include "Image.h"
 #include "Sampler.h"
+#include "Material.h"
 
 typedef unsigned char byte;
 
 const uint32_t FRAMES_IN_FLIGHT = 2;
+// submitted upload batches a thread may have in flight per queue before it waits on the oldest
+const size_t MAX_PENDING_UPLOADS = 4;
+// staging bytes a thread's upload batch collects before it is submitted on its own. Larger uploads get a staging
+// buffer of their own instead of a range of the staging ring.
+const size_t UPLOAD_BATCH_SIZE = 8 << 20;
+// persistently mapped staging memory of every upload stream, holds the batches in flight
+const size_t STAGING_RING_SIZE = MAX_PENDING_UPLOADS * UPLOAD_BATCH_SIZE;
+// levels below level 0 the mip generation shader builds in one dispatch
+const uint32_t MAX_GENERATED_MIP_LEVELS = 12;
+// descriptor sets reserved for materials, including the replaced sets not yet retired
+const uint32_t MAX_MATERIAL_DESCRIPTOR_SETS = 4096;
+// frames the memory governor waits after changing quality before it looks at the budget again, so the change shows
+const uint64_t MEMORY_GOVERNOR_COOLDOWN_FRAMES = 120;
+// smallest shadow maps the governor shrinks point and directional shadow maps to
+const uint32_t MIN_POINT_SHADOW_MAP_RESOLUTION = 128;
+const uint32_t MIN_DIRECTIONAL_SHADOW_MAP_RESOLUTION = 512;
 
 struct TextureInfo {
 	std::vector<byte> data = {0xff, 0xff, 0xff, 0xff};
@@ -56,6 +78,47 @@ struct RendererSettings {
 	float gamma = 2.2f;
 
 	SampleCount msaa = SampleCount::e4;
+
+	// share of the device memory budget the memory governor keeps usage under, giving up quality past it
+	float memoryHighWatermark = 0.9f;
+	// share of the budget usage has to fall under for the governor to take back the last quality it gave up
+	float memoryLowWatermark = 0.75f;
+};
+
+// What the renderer's device memory goes to
+enum class MemoryCategory {
+	eGeometry,
+	eTextures,
+	eShadowMaps,
+	eEnvironment,
+	eAttachments,
+	// uniform, storage, staging and scratch buffers
+	eBuffers,
+};
+const size_t MEMORY_CATEGORY_COUNT = 6;
+
+// Quality the memory governor gave up to stay under the device memory budget, each step keeps the ones before it
+enum class MemoryDownshift {
+	eNone,
+	// the texture budget shrinks to what's left under the low watermark, the streamer drops levels of the least seen textures
+	eTextureMips,
+	// point and directional shadow maps are made again at half their resolution
+	eShadowResolution,
+	// static shadow casters are drawn into point shadow maps every frame instead of being cached in a map of their own
+	eStaticShadowCache,
+};
+
+struct MemoryStatus {
+	// device local memory the process uses and what the driver lets it use, from VK_EXT_memory_budget when available
+	vk::DeviceSize usage = 0;
+	vk::DeviceSize budget = 0;
+	// memory the renderer allocated, host visible buffers included, indexed by MemoryCategory
+	std::array<vk::DeviceSize, MEMORY_CATEGORY_COUNT> categoryUsage{};
+	MemoryDownshift downshift = MemoryDownshift::eNone;
+	// what textures may take for usage to stay under the governor's watermark
+	vk::DeviceSize textureBudget = 0;
+
+	vk::DeviceSize headroom() const { return usage < budget ? budget - usage : 0; }
 };
 
 class VulkanRenderer
@@ -90,6 +153,77 @@ class VulkanRenderer
 		eBackToFront
 	};
 
+	// Passes that draw meshes, each has one pipeline per vertex layout
+	enum class MeshPipelineKind {
+		eOpaque,
+		eBlend,
+		eWireframe,
+		eShadowMap,
+	};
+	static constexpr size_t MESH_PIPELINE_KIND_COUNT = 4;
+	// vertex binding, and first of the four locations, of the per-instance transform after the vertex slots
+	static constexpr uint32_t INSTANCE_BINDING = static_cast<uint32_t>(VERTEX_SLOT_COUNT);
+	static constexpr size_t INITIAL_FRAME_INSTANCE_CAPACITY = 4096;
+
+	// Host visible, persistently mapped buffer the instances surviving culling are written to, one per frame in flight
+	struct FrameInstanceBuffer {
+		vk::Buffer buffer;
+		vma::Allocation allocation;
+		glm::mat4* data = nullptr;
+		size_t capacity = 0;
+		size_t used = 0;
+	};
+
+	// the camera's viewproj comes from its uniform buffer
+	struct MeshPushConstants {
+		glm::mat4 model;
+		// maps quantized positions back to object space
+		glm::vec4 positionOffset;
+		glm::vec4 positionScale;
+	};
+
+	struct ShadowPushConstants {
+		glm::mat4 modelViewProj;
+		glm::vec4 positionOffset;
+		glm::vec4 positionScale;
+	};
+
+	// 128 bytes is all maxPushConstantsSize is guaranteed to be
+	static_assert(sizeof(MeshPushConstants) <= 128 && sizeof(ShadowPushConstants) <= 128);
+
+	// set 1 uniform blocks of pbr.frag
+	struct MaterialShaderData {
+		glm::vec4 baseColorFactor;
+		glm::vec4 emissiveFactor;
+		float normalScale;
+		float metallicFactor;
+		float roughnessFactor;
+		float aoFactor;
+	};
+
+	struct AlphaShaderData {
+		AlphaMode alphaMode;
+		float alphaCutoff;
+	};
+
+	// Point at which an upload is done: once the timeline semaphore of the stream it was recorded on reaches value.
+	// A null semaphore means there's nothing to wait for.
+	struct UploadTicket {
+		vk::Semaphore semaphore;
+		uint64_t value = 0;
+	};
+
+	struct MaterialEntry {
+		MaterialData data;
+		vk::Buffer uniformBuffer;
+		vma::Allocation uniformBufferAllocation;
+		vk::DeviceSize alphaOffset;
+		vk::DescriptorSet descriptorSet;
+		MaterialTextures textures;
+		// set by destroyMaterial, the entry only stays around until frames in flight are done with it
+		bool destroyed = false;
+	};
+
 public:
 	VulkanRenderer(const vkfw::Window window, const RendererSettings& rendererSettings);
 	VulkanRenderer(const VulkanRenderer& other) = delete;
@@ -97,17 +231,65 @@ public:
 	~VulkanRenderer();
 	void start();
 
-	void setRootNodes(const std::vector<Node*>& nodes);
+	void setRootNodes(const std::vector<std::shared_ptr<Node>>& nodes);
 	void setEnvironmentMap(const std::array<TextureInfo, 6>& textureInfos);
 	void setLights(const std::vector<PointLight>& pointLights, const DirectionalLight& directionalLight);
+	// The copy is recorded into the calling thread's current upload batch and the call returns right away. Primitives
+	// reading the buffer are only drawn once it has landed, flushUploads makes sure it gets submitted.
 	Buffer loadBuffer(const void* ptr, size_t size);
 	void addMesh(const Mesh& mesh);
-	Image loadImage(const void* ptr, size_t size, uint32_t width, uint32_t height, ImageFormat imageFormat, uint32_t maxMipLevels = UINT32_MAX);
+	// Alpha tested images pass the cutoff of their material, their smaller levels keep the share of texels passing it.
+	Image loadImage(const void* ptr, size_t size, uint32_t width, uint32_t height, ImageFormat imageFormat, uint32_t maxMipLevels = UINT32_MAX, float alphaCutoff = 0.0f);
+	// Like loadImage, but returns as soon as the data is copied to staging and the upload is submitted.
+	// The image must not be sampled before finishUploads is called.
+	Image beginLoadImage(const void* ptr, size_t size, uint32_t width, uint32_t height, ImageFormat imageFormat, uint32_t maxMipLevels = UINT32_MAX, float alphaCutoff = 0.0f);
+	// Uploads an image with a precomputed mip chain, e.g. a block compressed image read from a KTX2 file.
+	// Level offsets are relative to ptr. Same completion rules as beginLoadImage.
+	Image beginLoadImageLevels(const void* ptr, uint32_t width, uint32_t height, ImageFormat imageFormat, const std::vector<ImageLevel>& levels);
+	// Makes an image of the levels of source from firstLevel on, copied on the GPU, e.g. to drop the largest levels of
+	// a streamed image without decoding it again. Same completion rules as beginLoadImage.
+	Image beginCopyImageLevels(Image source, uint32_t firstLevel);
+	uint32_t imageMipLevels(Image image);
+	// Submits the uploads the calling thread recorded so far, without waiting for them
+	void flushUploads();
+	// Submits the uploads the calling thread recorded so far and waits for all of them
+	void finishUploads();
 	Texture makeTexture(Image image, Sampler sampler);
+	// The objects are destroyed once frames in flight are done with them, nothing may use them after the call
+	void destroyTexture(Texture texture);
+	void destroyImage(Image image);
+	void destroyBuffer(Buffer buffer);
+
+	// The calls below may come from a loading thread while the render loop is running, so a scene can be drawn
+	// while the rest of it is still being uploaded.
+	Material makeMaterial(const MaterialData& materialData, const MaterialTextures& textures);
+	// Points the material at new textures, e.g. when one it was waiting on finishes loading. Frames already in flight
+	// keep drawing with the previous ones.
+	void updateMaterialTextures(Material material, const MaterialTextures& textures);
+	// Points the texture at another image with the same contents, e.g. with more or fewer of its levels resident, and
+	// the materials sampling it along with it. Frames already in flight keep the previous image. Like the other image
+	// and texture calls, it must come from the thread loading textures.
+	void setTextureImage(Texture texture, Image image);
+	// Largest size in pixels the primitives sampling each texture took on screen in the last frame drawn. Textures
+	// that weren't drawn are left out.
+	std::unordered_map<Texture, float> textureScreenSizes();
+	// Like destroyTexture, the material is destroyed once frames in flight are done with it
+	void destroyMaterial(Material material);
+	// The primitive is drawn from the next frame on. Its buffers and material must already be loaded.
+	void addPrimitive(std::shared_ptr<MeshPrimitive> primitive);
+	// The primitives are no longer drawn from the next frame on. Their buffers may be destroyed right after the call.
+	void removePrimitives(const std::vector<std::shared_ptr<MeshPrimitive>>& primitives);
+	// Replaces everything drawn with another scene, whose resources must all be loaded and their uploads finished,
+	// between two frames. Primitives
+	// added before the call and not drawn yet go away with the old scene, whose resources may be destroyed right after
+	// the call.
+	void replaceScene(const std::vector<std::shared_ptr<Node>>& rootNodes, std::vector<std::shared_ptr<MeshPrimitive>> primitives);
 
 	Camera& camera() { return this->_camera; };
 
 	RendererSettings& settings() { return this->_settings; }
+	// Safe to call from any thread
+	MemoryStatus memoryStatus();
 
 private:
 	bool running = false;
@@ -123,6 +305,11 @@ private:
 	vk::Device device;
 	uint32_t graphicsQueueFamilyIndex;
 	vk::Queue graphicsQueue;
+	// a transfer only family if the device has one, the graphics family otherwise
+	uint32_t transferQueueFamilyIndex;
+	vk::Queue transferQueue;
+	// families buffers written by the transfer queue are shared between, so they don't need an ownership transfer
+	std::vector<uint32_t> uploadQueueFamilyIndices;
 	vma::Allocator allocator;
 
 	vk::Format swapchainFormat;
@@ -156,14 +343,24 @@ private:
 	vk::Framebuffer mainFramebuffer;
 
 	vk::CommandPool commandPool;
+	// guards submissions to the graphics and transfer queues
+	std::mutex queueMutex;
 	std::array<vk::CommandBuffer, FRAMES_IN_FLIGHT> mainCommandBuffers;
 
 	vk::RenderPass renderPass;
 	vk::PipelineCache pipelineCache;
 	vk::PipelineLayout pipelineLayout;
-	vk::Pipeline opaquePipeline;
-	vk::Pipeline blendPipeline;
-	vk::Pipeline wireframePipeline;
+	vk::ShaderModule meshVertexShaderModule;
+	vk::ShaderModule pbrFragmentShaderModule;
+	vk::ShaderModule solidFragmentShaderModule;
+	std::unordered_map<VertexLayout, std::array<vk::Pipeline, MESH_PIPELINE_KIND_COUNT>> meshPipelines;
+	// bound in place of the attributes a primitive doesn't have
+	Buffer emptyVertexBuffer;
+	// instance buffer of primitives drawn once, a single identity transform
+	Buffer identityInstanceBuffer;
+	std::array<FrameInstanceBuffer, FRAMES_IN_FLIGHT> frameInstanceBuffers;
+	// outgrown frame instance buffers with the frame they were last written in
+	std::deque<std::pair<uint64_t, FrameInstanceBuffer>> retiredInstanceBuffers;
 	vk::PipelineLayout tonemapPipelineLayout;
 	vk::Pipeline tonemapPipeline;
 	vk::Sampler tonemapSampler;
@@ -188,9 +385,134 @@ private:
 	std::unordered_map<Image, vk::Image> imageTable;
 	std::unordered_map<Image, vma::Allocation> imageAllocationTable;
 	std::unordered_map<Image, vk::Format> imageFormatTable;
+	std::unordered_map<Image, vk::Extent2D> imageExtentTable;
+	std::unordered_map<Image, uint32_t> imageMipLevelsTable;
 	Texture nextTextureId{0U};
 	std::unordered_map<Texture, vk::ImageView> textureImageViewTable;
 	std::unordered_map<Texture, vk::Sampler> textureSamplerTable;
+	Material nextMaterialId{0U};
+	std::unordered_map<Material, MaterialEntry> materialTable;
+	std::shared_mutex materialMutex;
+	vk::DescriptorPool materialDescriptorPool;
+	// descriptor sets replaced by updateMaterialTextures with the frame they were replaced in
+	std::deque<std::pair<uint64_t, vk::DescriptorSet>> retiredMaterialDescriptorSets;
+	std::deque<std::pair<uint64_t, Material>> retiredMaterials;
+	// guarded by materialMutex like the image and texture tables, reaped every frame by collectStreamedResources
+	std::deque<std::pair<uint64_t, Texture>> retiredTextures;
+	std::deque<std::pair<uint64_t, Image>> retiredImages;
+	// image views replaced by setTextureImage
+	std::deque<std::pair<uint64_t, vk::ImageView>> retiredImageViews;
+	vk::ImageView makeTextureImageView(Image image);
+	void destroyRetiredTextures(bool all);
+	// guarded by vertexBufferMutex like the buffer tables
+	std::deque<std::pair<uint64_t, Buffer>> retiredBuffers;
+	void destroyRetiredBuffers(bool all);
+	Texture whiteTexture;
+	Texture blackTexture;
+	Texture flatNormalTexture;
+
+	// buffers go through the transfer queue, images through the graphics queue, which can build their mip chains
+	enum class UploadQueue {
+		eTransfer,
+		eGraphics,
+	};
+	// An image whose levels the mip generation shader builds from level 0 once its batch is submitted
+	struct MipGenerationJob {
+		vk::Image image;
+		vk::Format format;
+		uint32_t width;
+		uint32_t height;
+		uint32_t mipLevels;
+		float alphaCutoff;
+	};
+	// What the mip generation of a batch needs until the batch is done
+	struct MipGenerationResources {
+		vk::DescriptorPool descriptorPool;
+		std::vector<vk::ImageView> imageViews;
+		vk::Buffer scratchBuffer;
+		vma::Allocation scratchAllocation;
+	};
+	struct SubmittedUpload {
+		uint64_t value;
+		vk::CommandBuffer commandBuffer;
+		std::vector<std::pair<vk::Buffer, vma::Allocation>> stagingBuffers;
+		size_t ringBytes;
+		MipGenerationResources mipGeneration;
+	};
+	// The uploads one thread records for one queue: the batch being recorded and the ones submitted, each signalling
+	// the next value of the stream's timeline semaphore. Batches take their staging ranges from the stream's ring in
+	// order and give them back in the same order once they're done.
+	struct UploadStream {
+		vk::Queue queue;
+		vk::CommandPool commandPool;
+		vk::Semaphore timeline;
+		uint64_t submittedValue = 0;
+		vk::CommandBuffer commandBuffer;
+		std::vector<std::pair<vk::Buffer, vma::Allocation>> stagingBuffers;
+		size_t stagingSize = 0;
+		std::deque<SubmittedUpload> submitted;
+
+		vk::Buffer ringBuffer;
+		vma::Allocation ringAllocation;
+		byte* ringData = nullptr;
+		size_t ringHead = 0;
+		// bytes from the oldest range still in use up to ringHead, wrapping around
+		size_t ringUsed = 0;
+		// bytes the open batch took from the ring
+		size_t ringBatchBytes = 0;
+
+		std::vector<MipGenerationJob> mipGenerationJobs;
+	};
+	struct UploadContext {
+		std::array<UploadStream, 2> streams;
+	};
+	// Every thread that uploads gets its own command pools and staging rings. finishUploads hands them to the next
+	// thread that needs them, so they don't pile up as loading threads come and go.
+	std::unordered_map<std::thread::id, std::unique_ptr<UploadContext>> uploadContexts;
+	std::vector<std::unique_ptr<UploadContext>> idleUploadContexts;
+	std::mutex uploadContextsMutex;
+	struct StagingRange {
+		vk::Buffer buffer;
+		vk::DeviceSize offset;
+	};
+	// tickets of the buffers loadBuffer created, guarded by vertexBufferMutex like the buffer table
+	std::unordered_map<Buffer, UploadTicket> bufferUploadTable;
+	UploadStream& uploadStream(UploadQueue queue);
+	// Copies the data into staging memory that stays valid until the stream's open batch is done, waiting on batches in
+	// flight if the ring is full. Must be called before beginUpload.
+	StagingRange stage(UploadStream& stream, const void* data, size_t size);
+	// Returns the stream's open command buffer to record an upload into
+	vk::CommandBuffer beginUpload(UploadStream& stream);
+	// Returns the ticket of the upload just recorded, submitting the batch if it got large enough
+	UploadTicket endUpload(UploadStream& stream);
+	void submitUploads(UploadStream& stream);
+	void retireUploads(UploadStream& stream, size_t maxPending);
+	bool isUploadComplete(const UploadTicket& ticket);
+	// Whether every buffer the primitive reads has landed, with vertexBufferMutex held
+	bool isPrimitiveUploaded(MeshPrimitive& primitive);
+	// upload batches the primitives added this frame were written by. Checking them on the host doesn't make the writes
+	// visible to the graphics queue, so the frame's submits wait on them before reading vertices.
+	std::vector<std::pair<vk::Semaphore, uint64_t>> frameUploadWaits;
+	// Adds the batches the primitive's buffers came from to frameUploadWaits, with vertexBufferMutex held
+	void addPrimitiveUploadWaits(MeshPrimitive& primitive);
+	// Submits the command buffer after the given semaphores and the frame's upload waits
+	void submitFrameCommands(vk::CommandBuffer cb, const std::vector<vk::Semaphore>& waitSemaphores, const std::vector<vk::PipelineStageFlags>& waitStages, vk::Semaphore signalSemaphore);
+	void destroyUploadResources();
+
+	vk::DescriptorSetLayout mipGenerationDescriptorSetLayout;
+	vk::PipelineLayout mipGenerationPipelineLayout;
+	vk::Pipeline mipGenerationPipeline;
+	vk::Sampler mipGenerationSampler;
+	// the shader indexes its storage image array with the level, devices without the feature blit mips instead
+	bool mipGenerationSupported = false;
+	void createMipGenerationPipeline();
+	void destroyMipGenerationPipeline();
+	// Whether the mip generation shader can build the levels of an image, images it can't are blitted level by level
+	bool canGenerateMips(vk::Format format, uint32_t width, uint32_t height);
+	// Builds the levels of every image in one dispatch each, between a single barrier handing all of them to the
+	// shader and one handing them to the fragment shader
+	MipGenerationResources recordMipGeneration(vk::CommandBuffer cb, const std::vector<MipGenerationJob>& jobs);
+	void destroyMipGenerationResources(MipGenerationResources& resources);
 
 
 	std::array <vk::Buffer, FRAMES_IN_FLIGHT> cameraBuffers;
@@ -204,12 +526,6 @@ private:
 	vk::Buffer lightsStagingBuffer;
 	vma::Allocation lightsStagingBufferAllocation;
 
-	vk::Buffer pbrBuffer;
-	vma::Allocation pbrBufferAllocation;
-	vk::Buffer alphaBuffer;
-	vma::Allocation alphaBufferAllocation;
-
-
 	vk::Pipeline envPipeline;
 	vk::PipelineLayout envPipelineLayout;
 
@@ -253,16 +569,28 @@ private:
 	std::vector<std::shared_ptr<MeshPrimitive>> boundingBoxMeshes;
 	std::vector<std::shared_ptr<MeshPrimitive>> staticMeshes;
 	std::vector<std::shared_ptr<MeshPrimitive>> dynamicMeshes;
+	// added by addPrimitive, moved into the lists above at the start of a frame
+	std::vector<std::shared_ptr<MeshPrimitive>> pendingMeshes;
+	// removed by removePrimitives, taken out of the lists above at the start of a frame
+	std::vector<std::shared_ptr<MeshPrimitive>> removedMeshes;
+	// set by replaceScene, takes the place of all the lists above at the start of a frame
+	struct PendingScene {
+		std::vector<std::shared_ptr<Node>> rootNodes;
+		std::vector<std::shared_ptr<MeshPrimitive>> primitives;
+	};
+	std::optional<PendingScene> pendingScene;
+	std::mutex pendingMeshesMutex;
+	std::atomic<uint64_t> frameCount = 0;
 
 	std::vector<Mesh> meshes;
 
-	std::vector<Node*> rootNodes;
+	std::vector<std::shared_ptr<Node>> rootNodes;
 
 	vk::RenderPass shadowMapRenderPass;
 	vk::RenderPass staticShadowMapRenderPass;
 	std::array<vk::CommandBuffer, FRAMES_IN_FLIGHT> shadowPassCommandBuffers;
 	vk::PipelineLayout shadowMapPipelineLayout;
-	vk::Pipeline shadowMapPipeline;
+	vk::ShaderModule shadowMapVertexShaderModule;
 	vk::Sampler shadowMapSampler;
 	vk::Image pointShadowMapsImage;
 	vk::Image staticPointShadowMapsImage;
@@ -345,15 +673,37 @@ private:
 	void recordBloomCommandBuffers();
 
 	void createShadowMapImage();
+	// the shadow maps themselves, at the resolutions in the settings. Made again when the memory governor changes them.
+	void createShadowMapTargets();
+	void destroyShadowMapTargets();
 	void createStaticShadowMapImage();
+	void destroyStaticShadowMapImage();
 	void createShadowMapRenderPass();
 	void createDirectionalShadowMapRenderPass();
 	void createStaticShadowMapRenderPass();
 	void createShadowMapPipeline();
+	void drawShadowCaster(const vk::CommandBuffer& cb, MeshPrimitive& mesh, const glm::mat4& viewproj, vk::Pipeline& boundPipeline);
 	void renderShadowMaps(uint32_t frameIndex, const glm::vec3& cameraPos);
 	void recordPointShadowMapsCommands(vk::CommandBuffer cb, uint32_t frameIndex, const glm::vec3& cameraPos);
 	void recordDirectionalShadowMapsCommands(vk::CommandBuffer cb, uint32_t frameIndex);
 
+	std::array<std::atomic<vk::DeviceSize>, MEMORY_CATEGORY_COUNT> memoryCategoryUsage{};
+	std::atomic<MemoryDownshift> memoryDownshift = MemoryDownshift::eNone;
+	uint64_t memoryDownshiftFrame = 0;
+	// shadow map resolutions asked for in the settings, before the governor shrinks them
+	uint32_t fullPointShadowMapResolution;
+	uint32_t fullDirectionalShadowMapResolution;
+	// every allocator.create* is tracked and every destroy untracked, except for what lives until the device goes
+	void trackAllocation(MemoryCategory category, vma::Allocation allocation);
+	void untrackAllocation(MemoryCategory category, vma::Allocation allocation);
+	// usage and budget summed over the device local heaps
+	std::pair<vk::DeviceSize, vk::DeviceSize> deviceMemoryUsage();
+	// Called by the render loop between waiting on a frame's fence and resetting it
+	void updateMemoryGovernor();
+	void setMemoryDownshift(MemoryDownshift downshift);
+	// device memory taking back the step would need
+	vk::DeviceSize memoryDownshiftCost(MemoryDownshift downshift);
+
 	void makeDiffuseEnvMap();
 	std::tuple<vk::Pipeline, vk::PipelineLayout> createEnvMapDiffuseBakePipeline(vk::RenderPass renderPass);
 	std::tuple<vk::RenderPass, std::array<vk::ImageView, 6>, std::array<vk::Framebuffer, 6>> createEnvMapDiffuseBakeRenderPass();
@@ -363,10 +713,33 @@ private:
 
 	void recordUpdateLightsBufferCommands(const vk::CommandBuffer& cb);
 
+	void createMaterialResources();
+	void destroyMaterialResources();
+	vk::DescriptorSet makeMaterialDescriptorSet(const MaterialEntry& material, const MaterialTextures& textures);
+	void collectStreamedResources();
+
 	void renderLoop();
-	void drawMeshes(const std::vector<std::shared_ptr<MeshPrimitive>>& meshes, const vk::CommandBuffer& cb, uint32_t frameIndex, const glm::mat4& viewproj, const glm::vec3& cameraPos, bool frustumCull = false, MeshSortingMode sortingMode = MeshSortingMode::eNone);
+	vk::Pipeline meshPipeline(MeshPipelineKind kind, const VertexLayout& layout);
+	vk::Pipeline createMeshPipeline(MeshPipelineKind kind, const VertexLayout& layout);
+	void bindMeshVertexBuffers(const vk::CommandBuffer& cb, const MeshPrimitive& mesh);
+
+	void createInstanceResources();
+	void destroyInstanceResources();
+	FrameInstanceBuffer createFrameInstanceBuffer(size_t capacity);
+	// Called at the start of a frame, once its fence has been waited on
+	void resetFrameInstances(uint32_t frameIndex);
+	// Binds the instances of the primitive and returns how many to draw: the ones inside pov's frustum, compacted
+	// into the frame's instance buffer, all of them when pov is null, or 1 for primitives that aren't instanced.
+	uint32_t bindMeshInstances(const vk::CommandBuffer& cb, const MeshPrimitive& mesh, uint32_t frameIndex, const Camera* pov);
+	void drawMeshes(const std::vector<std::shared_ptr<MeshPrimitive>>& meshes, const vk::CommandBuffer& cb, uint32_t frameIndex, const glm::vec3& cameraPos, MeshPipelineKind pipelineKind, bool frustumCull = false, MeshSortingMode sortingMode = MeshSortingMode::eNone);
 	
 	bool shouldCullMesh(const MeshPrimitive& mesh, const Node& node, const Camera& pov);
+	// Diameter in pixels of the primitive's bounding sphere seen from the camera
+	float projectedScreenSize(const MeshPrimitive& mesh, const Node& node, const glm::vec3& cameraPos);
+	// filled in by the main pass while a frame is recorded, and handed over to textureScreenSizes once it's done
+	std::unordered_map<Material, float> recordingMaterialScreenSizes;
+	std::unordered_map<Material, float> materialScreenSizes;
+	std::mutex materialScreenSizesMutex;
 
 	std::tuple<vk::Image, vk::ImageView, vma::Allocation> createImageFromTextureInfo(TextureInfo& textureInfo);
 };
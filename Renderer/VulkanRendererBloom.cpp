@@ -29,6 +29,7 @@ void VulkanRenderer::createBloomPipelines() {
 
 void VulkanRenderer::createBloomImage() {
 	std::tie(this->bloomImage, this->bloomImageAllocation) = this->allocator.createImage(vk::ImageCreateInfo{ {}, vk::ImageType::e2D, this->bloomAttachmentFormat, vk::Extent3D{this->swapchainExtent, 1 }, this->bloomMipLevels, 1, vk::SampleCountFlagBits::e1, vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst, vk::SharingMode::eExclusive, this->graphicsQueueFamilyIndex }, vma::AllocationCreateInfo{ {}, vma::MemoryUsage::eGpuOnly });
+	this->trackAllocation(MemoryCategory::eAttachments, this->bloomImageAllocation);
 
 	this->bloomDownsampleSampler = this->device.createSampler(vk::SamplerCreateInfo{ {}, vk::Filter::eLinear, vk::Filter::eLinear, vk::SamplerMipmapMode::eNearest, vk::SamplerAddressMode::eClampToEdge, vk::SamplerAddressMode::eClampToEdge, vk::SamplerAddressMode::eClampToEdge, {}, false, {}, false, {}, {}, {}, {}, true });
 	this->bloomUpsampleSampler = this->device.createSampler(vk::SamplerCreateInfo{ {}, vk::Filter::eNearest, vk::Filter::eNearest, vk::SamplerMipmapMode::eNearest, vk::SamplerAddressMode::eClampToEdge, vk::SamplerAddressMode::eClampToEdge, vk::SamplerAddressMode::eClampToEdge, {}, false, {}, false, {}, {}, {}, {}, true });
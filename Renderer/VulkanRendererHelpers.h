@@ -1,7 +1,11 @@
 #pragma once
 
+#include <array>
+
 #include <vulkan/vulkan.hpp>
 
+#include <glm/geometric.hpp>
+
 #include "Mesh.h"
 #include "Image.h"
 
@@ -36,7 +40,79 @@ constexpr vk::Format vkFormatFromImageFormat(const ImageFormat imageFormat) {
 			return vk::Format::eR32G32B32Sfloat;
 		case ImageFormat::eR32G32B32A32Sfloat:
 			return vk::Format::eR32G32B32A32Sfloat;
+		case ImageFormat::eBC1RGBUnorm:
+			return vk::Format::eBc1RgbUnormBlock;
+		case ImageFormat::eBC1RGBSrgb:
+			return vk::Format::eBc1RgbSrgbBlock;
+		case ImageFormat::eBC1RGBAUnorm:
+			return vk::Format::eBc1RgbaUnormBlock;
+		case ImageFormat::eBC1RGBASrgb:
+			return vk::Format::eBc1RgbaSrgbBlock;
+		case ImageFormat::eBC3Unorm:
+			return vk::Format::eBc3UnormBlock;
+		case ImageFormat::eBC3Srgb:
+			return vk::Format::eBc3SrgbBlock;
+		case ImageFormat::eBC4Unorm:
+			return vk::Format::eBc4UnormBlock;
+		case ImageFormat::eBC4Snorm:
+			return vk::Format::eBc4SnormBlock;
+		case ImageFormat::eBC5Unorm:
+			return vk::Format::eBc5UnormBlock;
+		case ImageFormat::eBC5Snorm:
+			return vk::Format::eBc5SnormBlock;
+		case ImageFormat::eBC6HUfloat:
+			return vk::Format::eBc6HUfloatBlock;
+		case ImageFormat::eBC6HSfloat:
+			return vk::Format::eBc6HSfloatBlock;
+		case ImageFormat::eBC7Unorm:
+			return vk::Format::eBc7UnormBlock;
+		case ImageFormat::eBC7Srgb:
+			return vk::Format::eBc7SrgbBlock;
 		default:
 			return vk::Format::eUndefined;
 	}
-}
\ No newline at end of file
+}
+// Vertex input format of an attribute. Integers that aren't normalized use the scaled formats, so the mesh shaders
+// always read floats whatever the attribute is stored as.
+constexpr vk::Format vkFormatFromVertexSlotLayout(const VertexSlotLayout& slot) {
+	const size_t n = componentCountFromAttributeContainerType(slot.containerType);
+	const auto pick = [n](vk::Format f1, vk::Format f2, vk::Format f3, vk::Format f4) {
+		return n == 1 ? f1 : n == 2 ? f2 : n == 3 ? f3 : f4;
+	};
+
+	switch (slot.valueType) {
+	case AttributeValueType::eInt8:
+		return slot.normalized
+			? pick(vk::Format::eR8Snorm, vk::Format::eR8G8Snorm, vk::Format::eR8G8B8Snorm, vk::Format::eR8G8B8A8Snorm)
+			: pick(vk::Format::eR8Sscaled, vk::Format::eR8G8Sscaled, vk::Format::eR8G8B8Sscaled, vk::Format::eR8G8B8A8Sscaled);
+	case AttributeValueType::eUint8:
+		return slot.normalized
+			? pick(vk::Format::eR8Unorm, vk::Format::eR8G8Unorm, vk::Format::eR8G8B8Unorm, vk::Format::eR8G8B8A8Unorm)
+			: pick(vk::Format::eR8Uscaled, vk::Format::eR8G8Uscaled, vk::Format::eR8G8B8Uscaled, vk::Format::eR8G8B8A8Uscaled);
+	case AttributeValueType::eInt16:
+		return slot.normalized
+			? pick(vk::Format::eR16Snorm, vk::Format::eR16G16Snorm, vk::Format::eR16G16B16Snorm, vk::Format::eR16G16B16A16Snorm)
+			: pick(vk::Format::eR16Sscaled, vk::Format::eR16G16Sscaled, vk::Format::eR16G16B16Sscaled, vk::Format::eR16G16B16A16Sscaled);
+	case AttributeValueType::eUint16:
+		return slot.normalized
+			? pick(vk::Format::eR16Unorm, vk::Format::eR16G16Unorm, vk::Format::eR16G16B16Unorm, vk::Format::eR16G16B16A16Unorm)
+			: pick(vk::Format::eR16Uscaled, vk::Format::eR16G16Uscaled, vk::Format::eR16G16B16Uscaled, vk::Format::eR16G16B16A16Uscaled);
+	case AttributeValueType::eHalf:
+		return pick(vk::Format::eR16Sfloat, vk::Format::eR16G16Sfloat, vk::Format::eR16G16B16Sfloat, vk::Format::eR16G16B16A16Sfloat);
+	case AttributeValueType::eFloat:
+		return pick(vk::Format::eR32Sfloat, vk::Format::eR32G32Sfloat, vk::Format::eR32G32B32Sfloat, vk::Format::eR32G32B32A32Sfloat);
+	default:
+		return vk::Format::eUndefined;
+	}
+}
+
+// True if the box is entirely on the negative side of one of the planes, whose normals point into the frustum
+inline bool isBoxOutsidePlanes(const glm::vec3& bbMin, const glm::vec3& bbMax, const std::array<glm::vec4, 6>& planes) {
+	for (const auto& plane : planes) {
+		// the corner furthest along the plane normal
+		const glm::vec3 pVertex{ plane.x >= 0.0f ? bbMax.x : bbMin.x, plane.y >= 0.0f ? bbMax.y : bbMin.y, plane.z >= 0.0f ? bbMax.z : bbMin.z };
+		if (glm::dot(pVertex, glm::vec3(plane)) + plane.w < 0.0f)
+			return true;
+	}
+	return false;
+}
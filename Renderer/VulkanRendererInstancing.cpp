@@ -0,0 +1,89 @@
+#include "VulkanRenderer.h"
+#include "VulkanRendererHelpers.h"
+
+#include <algorithm>
+
+void VulkanRenderer::createInstanceResources() {
+	const glm::mat4 identity{ 1.0f };
+	this->identityInstanceBuffer = this->loadBuffer(&identity, sizeof(identity));
+
+	for (auto& instances : this->frameInstanceBuffers)
+		instances = this->createFrameInstanceBuffer(INITIAL_FRAME_INSTANCE_CAPACITY);
+}
+
+void VulkanRenderer::destroyInstanceResources() {
+	auto destroy = [this](FrameInstanceBuffer& instances) {
+		this->untrackAllocation(MemoryCategory::eGeometry, instances.allocation);
+		this->allocator.unmapMemory(instances.allocation);
+		this->allocator.destroyBuffer(instances.buffer, instances.allocation);
+	};
+
+	for (auto& instances : this->frameInstanceBuffers)
+		destroy(instances);
+	for (auto& [frame, instances] : this->retiredInstanceBuffers)
+		destroy(instances);
+	this->retiredInstanceBuffers.clear();
+}
+
+VulkanRenderer::FrameInstanceBuffer VulkanRenderer::createFrameInstanceBuffer(size_t capacity) {
+	FrameInstanceBuffer instances{};
+	std::tie(instances.buffer, instances.allocation) = this->allocator.createBuffer(vk::BufferCreateInfo{ {}, capacity * sizeof(glm::mat4), vk::BufferUsageFlagBits::eVertexBuffer, vk::SharingMode::eExclusive }, vma::AllocationCreateInfo{ {}, vma::MemoryUsage::eCpuToGpu, vk::MemoryPropertyFlagBits::eHostCoherent });
+	this->trackAllocation(MemoryCategory::eGeometry, instances.allocation);
+	instances.data = reinterpret_cast<glm::mat4*>(this->allocator.mapMemory(instances.allocation));
+	instances.capacity = capacity;
+	return instances;
+}
+
+void VulkanRenderer::resetFrameInstances(uint32_t frameIndex) {
+	this->frameInstanceBuffers[frameIndex].used = 0;
+
+	// a buffer outgrown during frame n may still be read by frames up to n
+	const uint64_t frame = this->frameCount.load();
+	while (!this->retiredInstanceBuffers.empty() && this->retiredInstanceBuffers.front().first + FRAMES_IN_FLIGHT <= frame) {
+		FrameInstanceBuffer& instances = this->retiredInstanceBuffers.front().second;
+		this->untrackAllocation(MemoryCategory::eGeometry, instances.allocation);
+		this->allocator.unmapMemory(instances.allocation);
+		this->allocator.destroyBuffer(instances.buffer, instances.allocation);
+		this->retiredInstanceBuffers.pop_front();
+	}
+}
+
+uint32_t VulkanRenderer::bindMeshInstances(const vk::CommandBuffer& cb, const MeshPrimitive& mesh, uint32_t frameIndex, const Camera* pov) {
+	if (!mesh.isInstanced()) {
+		cb.bindVertexBuffers(INSTANCE_BINDING, this->bufferTable.at(this->identityInstanceBuffer), vk::DeviceSize{ 0 });
+		return 1;
+	}
+
+	const MeshInstances& meshInstances = *mesh.instances();
+	if (pov == nullptr) {
+		cb.bindVertexBuffers(INSTANCE_BINDING, this->bufferTable.at(meshInstances.buffer), vk::DeviceSize{ 0 });
+		return static_cast<uint32_t>(meshInstances.transforms.size());
+	}
+
+	FrameInstanceBuffer& instances = this->frameInstanceBuffers[frameIndex];
+	if (instances.used + meshInstances.transforms.size() > instances.capacity) {
+		// draws already recorded this frame keep reading the old buffer, so it is retired rather than destroyed
+		this->retiredInstanceBuffers.emplace_back(this->frameCount.load(), instances);
+		instances = this->createFrameInstanceBuffer(std::max(instances.capacity * 2, meshInstances.transforms.size()));
+	}
+
+	// a plane in node space moves to the space of an instance as plane * transform
+	const std::array<glm::vec4, 6> nodePlanes = pov->getFrustumPlanesLocalSpace(mesh.node()->modelMatrix());
+	const glm::vec3 bbMin = mesh.bbMin();
+	const glm::vec3 bbMax = mesh.bbMax();
+
+	const size_t first = instances.used;
+	for (const glm::mat4& transform : meshInstances.transforms) {
+		std::array<glm::vec4, 6> planes;
+		for (size_t i = 0; i < planes.size(); i++)
+			planes[i] = nodePlanes[i] * transform;
+
+		if (!isBoxOutsidePlanes(bbMin, bbMax, planes))
+			instances.data[instances.used++] = transform;
+	}
+
+	const uint32_t visibleCount = static_cast<uint32_t>(instances.used - first);
+	if (visibleCount > 0)
+		cb.bindVertexBuffers(INSTANCE_BINDING, instances.buffer, vk::DeviceSize{ first * sizeof(glm::mat4) });
+	return visibleCount;
+}
@@ -0,0 +1,113 @@
+#include "VulkanRenderer.h"
+
+#include <algorithm>
+
+void VulkanRenderer::trackAllocation(MemoryCategory category, vma::Allocation allocation) {
+	this->memoryCategoryUsage[static_cast<size_t>(category)] += this->allocator.getAllocationInfo(allocation).size;
+}
+
+void VulkanRenderer::untrackAllocation(MemoryCategory category, vma::Allocation allocation) {
+	this->memoryCategoryUsage[static_cast<size_t>(category)] -= this->allocator.getAllocationInfo(allocation).size;
+}
+
+std::pair<vk::DeviceSize, vk::DeviceSize> VulkanRenderer::deviceMemoryUsage() {
+	const vk::PhysicalDeviceMemoryProperties* memoryProperties = this->allocator.getMemoryProperties();
+	const std::vector<vma::Budget> budgets = this->allocator.getHeapBudgets();
+
+	vk::DeviceSize usage = 0;
+	vk::DeviceSize budget = 0;
+	for (uint32_t i = 0; i < memoryProperties->memoryHeapCount; i++) {
+		if (!(memoryProperties->memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal))
+			continue;
+		usage += budgets[i].usage;
+		budget += budgets[i].budget;
+	}
+	return { usage, budget };
+}
+
+MemoryStatus VulkanRenderer::memoryStatus() {
+	MemoryStatus status{};
+	std::tie(status.usage, status.budget) = this->deviceMemoryUsage();
+	for (size_t i = 0; i < MEMORY_CATEGORY_COUNT; i++)
+		status.categoryUsage[i] = this->memoryCategoryUsage[i].load();
+	status.downshift = this->memoryDownshift.load();
+
+	// textures grow into what's left under the high watermark, and shrink under the low one once they're given up
+	const float watermark = status.downshift >= MemoryDownshift::eTextureMips ? this->_settings.memoryLowWatermark : this->_settings.memoryHighWatermark;
+	const vk::DeviceSize target = static_cast<vk::DeviceSize>(status.budget * static_cast<double>(watermark));
+	const vk::DeviceSize textures = status.categoryUsage[static_cast<size_t>(MemoryCategory::eTextures)];
+	status.textureBudget = textures + target > status.usage ? textures + target - status.usage : 0;
+	return status;
+}
+
+vk::DeviceSize VulkanRenderer::memoryDownshiftCost(MemoryDownshift downshift) {
+	switch (downshift) {
+	case MemoryDownshift::eShadowResolution:
+		// full resolution maps take four times the halved ones
+		return 3 * this->memoryCategoryUsage[static_cast<size_t>(MemoryCategory::eShadowMaps)].load();
+	case MemoryDownshift::eStaticShadowCache:
+		// the cache is as large as the point shadow maps
+		return this->_settings.pointShadowMapCount > 0 ? this->allocator.getAllocationInfo(this->pointShadowMapsImageAllocation).size : 0;
+	default:
+		// the texture streamer takes levels back on its own as the texture budget grows
+		return 0;
+	}
+}
+
+void VulkanRenderer::updateMemoryGovernor() {
+	const uint64_t frame = this->frameCount.load();
+	// VMA refreshes the budget it got from the driver when the frame index changes
+	this->allocator.setCurrentFrameIndex(static_cast<uint32_t>(frame));
+	if (frame < this->memoryDownshiftFrame + MEMORY_GOVERNOR_COOLDOWN_FRAMES)
+		return;
+
+	const auto [usage, budget] = this->deviceMemoryUsage();
+	if (budget == 0)
+		return;
+
+	const MemoryDownshift downshift = this->memoryDownshift.load();
+	const double highWatermark = budget * static_cast<double>(this->_settings.memoryHighWatermark);
+	const double lowWatermark = budget * static_cast<double>(this->_settings.memoryLowWatermark);
+	if (usage > highWatermark && downshift != MemoryDownshift::eStaticShadowCache)
+		this->setMemoryDownshift(static_cast<MemoryDownshift>(static_cast<int>(downshift) + 1));
+	else if (downshift != MemoryDownshift::eNone && usage < lowWatermark && usage + this->memoryDownshiftCost(downshift) < highWatermark)
+		this->setMemoryDownshift(static_cast<MemoryDownshift>(static_cast<int>(downshift) - 1));
+	else
+		return;
+
+	this->memoryDownshiftFrame = frame;
+}
+
+void VulkanRenderer::setMemoryDownshift(MemoryDownshift downshift) {
+	const bool halveShadowMaps = downshift >= MemoryDownshift::eShadowResolution;
+	const uint32_t pointResolution = halveShadowMaps ? std::max(this->fullPointShadowMapResolution / 2, MIN_POINT_SHADOW_MAP_RESOLUTION) : this->fullPointShadowMapResolution;
+	const uint32_t directionalResolution = halveShadowMaps ? std::max(this->fullDirectionalShadowMapResolution / 2, MIN_DIRECTIONAL_SHADOW_MAP_RESOLUTION) : this->fullDirectionalShadowMapResolution;
+	const bool resize = pointResolution != this->_settings.pointShadowMapResolution || directionalResolution != this->_settings.directionalShadowMapResolution;
+
+	const bool cacheStaticShadows = downshift < MemoryDownshift::eStaticShadowCache && this->_settings.pointShadowMapCount > 0;
+	const bool hasStaticShadowCache = static_cast<bool>(this->staticPointShadowMapsImage);
+
+	this->memoryDownshift = downshift;
+	if (!resize && cacheStaticShadows == hasStaticShadowCache)
+		return;
+
+	// the shadow maps are only made again once no frame in flight reads them
+	this->device.waitForFences(this->frameFences, true, UINT64_MAX);
+
+	if (resize) {
+		if (hasStaticShadowCache)
+			this->destroyStaticShadowMapImage();
+		this->destroyShadowMapTargets();
+		this->_settings.pointShadowMapResolution = pointResolution;
+		this->_settings.directionalShadowMapResolution = directionalResolution;
+		this->createShadowMapTargets();
+	}
+	if (cacheStaticShadows && !this->staticPointShadowMapsImage)
+		this->createStaticShadowMapImage();
+	else if (!cacheStaticShadows && this->staticPointShadowMapsImage)
+		this->destroyStaticShadowMapImage();
+
+	// whatever was cached is gone or at the wrong size
+	for (const auto& light : this->shadowCastingPointLights)
+		light->flags &= ~PointLightFlagBits::eStaticShadowMapRendered;
+}
@@ -0,0 +1,118 @@
+#include "VulkanRenderer.h"
+#include "VulkanRendererHelpers.h"
+
+#include "Mesh.h"
+
+vk::Pipeline VulkanRenderer::meshPipeline(MeshPipelineKind kind, const VertexLayout& layout) {
+	auto it = this->meshPipelines.find(layout);
+	if (it == this->meshPipelines.end())
+		it = this->meshPipelines.emplace(layout, std::array<vk::Pipeline, MESH_PIPELINE_KIND_COUNT>{}).first;
+
+	vk::Pipeline& pipeline = it->second[static_cast<size_t>(kind)];
+	if (!pipeline)
+		pipeline = this->createMeshPipeline(kind, layout);
+	return pipeline;
+}
+
+vk::Pipeline VulkanRenderer::createMeshPipeline(MeshPipelineKind kind, const VertexLayout& layout) {
+	const bool isShadowMap = kind == MeshPipelineKind::eShadowMap;
+
+	// one binding per slot, missing attributes read a zero from emptyVertexBuffer
+	std::vector<vk::VertexInputBindingDescription> vertexBindingDescriptions;
+	std::vector<vk::VertexInputAttributeDescription> vertexAttributeDescriptions;
+	const uint32_t slotCount = isShadowMap ? 1 : static_cast<uint32_t>(VERTEX_SLOT_COUNT);
+	for (uint32_t i = 0; i < slotCount; i++) {
+		const VertexSlotLayout& slot = layout.slots[i];
+		if (slot.present) {
+			const uint32_t elementSize = static_cast<uint32_t>(componentCountFromAttributeContainerType(slot.containerType) * sizeFromAttributeValueType(slot.valueType));
+			vertexBindingDescriptions.push_back(vk::VertexInputBindingDescription{ i, slot.stride > 0 ? static_cast<uint32_t>(slot.stride) : elementSize, vk::VertexInputRate::eVertex });
+			vertexAttributeDescriptions.push_back(vk::VertexInputAttributeDescription{ i, i, vkFormatFromVertexSlotLayout(slot), 0 });
+		}
+		else {
+			vertexBindingDescriptions.push_back(vk::VertexInputBindingDescription{ i, 0, vk::VertexInputRate::eVertex });
+			vertexAttributeDescriptions.push_back(vk::VertexInputAttributeDescription{ i, i, vk::Format::eR32G32B32A32Sfloat, 0 });
+		}
+	}
+	// the instance transform, a mat4 taking four locations, identity for primitives that aren't instanced
+	vertexBindingDescriptions.push_back(vk::VertexInputBindingDescription{ INSTANCE_BINDING, sizeof(glm::mat4), vk::VertexInputRate::eInstance });
+	for (uint32_t column = 0; column < 4; column++)
+		vertexAttributeDescriptions.push_back(vk::VertexInputAttributeDescription{ INSTANCE_BINDING + column, INSTANCE_BINDING, vk::Format::eR32G32B32A32Sfloat, static_cast<uint32_t>(column * sizeof(glm::vec4)) });
+	vk::PipelineVertexInputStateCreateInfo vertexInputInfo{ {}, vertexBindingDescriptions, vertexAttributeDescriptions };
+
+	const std::array<vk::Bool32, 3> specializationData = {
+		layout.slots[static_cast<size_t>(VertexSlot::eNormal)].encoding == AttributeEncoding::eOctahedral,
+		layout.slots[static_cast<size_t>(VertexSlot::eTangent)].encoding == AttributeEncoding::eOctahedral,
+		layout.slots[static_cast<size_t>(VertexSlot::eTangent)].present,
+	};
+	const std::array<vk::SpecializationMapEntry, 3> specializationEntries = {
+		vk::SpecializationMapEntry{ 0, 0 * sizeof(vk::Bool32), sizeof(vk::Bool32) },
+		vk::SpecializationMapEntry{ 1, 1 * sizeof(vk::Bool32), sizeof(vk::Bool32) },
+		vk::SpecializationMapEntry{ 2, 2 * sizeof(vk::Bool32), sizeof(vk::Bool32) },
+	};
+	vk::SpecializationInfo specializationInfo{ static_cast<uint32_t>(specializationEntries.size()), specializationEntries.data(), sizeof(specializationData), specializationData.data() };
+
+	std::vector<vk::PipelineShaderStageCreateInfo> shaderStagesInfo;
+	if (isShadowMap) {
+		shaderStagesInfo.push_back(vk::PipelineShaderStageCreateInfo{ {}, vk::ShaderStageFlagBits::eVertex, this->shadowMapVertexShaderModule, "main" });
+	}
+	else {
+		shaderStagesInfo.push_back(vk::PipelineShaderStageCreateInfo{ {}, vk::ShaderStageFlagBits::eVertex, this->meshVertexShaderModule, "main", &specializationInfo });
+		shaderStagesInfo.push_back(vk::PipelineShaderStageCreateInfo{ {}, vk::ShaderStageFlagBits::eFragment, kind == MeshPipelineKind::eWireframe ? this->solidFragmentShaderModule : this->pbrFragmentShaderModule, "main" });
+	}
+
+	vk::PipelineInputAssemblyStateCreateInfo inputAssemblyInfo{ {}, vk::PrimitiveTopology::eTriangleList, false };
+
+	const vk::Extent2D extent = isShadowMap ? vk::Extent2D{ this->_settings.pointShadowMapResolution, this->_settings.pointShadowMapResolution } : this->swapchainExtent;
+	std::vector<vk::Viewport> viewports = { vk::Viewport{ 0.0f, 0.0f, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f } };
+	std::vector<vk::Rect2D> scissors = { vk::Rect2D({0, 0}, extent) };
+	vk::PipelineViewportStateCreateInfo viewportInfo{ {}, viewports, scissors };
+
+	vk::PipelineRasterizationStateCreateInfo rasterizationInfo;
+	switch (kind) {
+	case MeshPipelineKind::eWireframe:
+		rasterizationInfo = vk::PipelineRasterizationStateCreateInfo{ {}, false, false, vk::PolygonMode::eLine, vk::CullModeFlagBits::eNone, vk::FrontFace::eCounterClockwise, false, 0.0f, 0.0f, 0.0f, 1.0f };
+		break;
+	case MeshPipelineKind::eShadowMap:
+		rasterizationInfo = vk::PipelineRasterizationStateCreateInfo{ {}, false, false, vk::PolygonMode::eFill, vk::CullModeFlagBits::eFront, vk::FrontFace::eCounterClockwise, false, 0.0f, 0.0f, 0.0f, 1.0f };
+		break;
+	default:
+		rasterizationInfo = vk::PipelineRasterizationStateCreateInfo{ {}, false, false, vk::PolygonMode::eFill, vk::CullModeFlagBits::eBack, vk::FrontFace::eCounterClockwise, false, 0.0f, 0.0f, 0.0f, 1.0f };
+		break;
+	}
+
+	vk::PipelineDepthStencilStateCreateInfo depthStencilInfo = kind == MeshPipelineKind::eWireframe
+		? vk::PipelineDepthStencilStateCreateInfo{ {}, false, false, vk::CompareOp::eAlways }
+		: vk::PipelineDepthStencilStateCreateInfo{ {}, true, true, vk::CompareOp::eLess };
+
+	vk::PipelineMultisampleStateCreateInfo multisampleInfo = isShadowMap ? vk::PipelineMultisampleStateCreateInfo{} : vk::PipelineMultisampleStateCreateInfo{ {}, static_cast<vk::SampleCountFlagBits>(this->_settings.msaa) };
+
+	vk::PipelineColorBlendAttachmentState opaqueColorBlendAttachment(false, vk::BlendFactor::eOne, vk::BlendFactor::eZero, vk::BlendOp::eAdd, vk::BlendFactor::eOne, vk::BlendFactor::eZero, vk::BlendOp::eAdd, vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA);
+	vk::PipelineColorBlendAttachmentState blendColorBlendAttachment(true, vk::BlendFactor::eSrcAlpha, vk::BlendFactor::eOneMinusSrcAlpha, vk::BlendOp::eAdd, vk::BlendFactor::eOne, vk::BlendFactor::eZero, vk::BlendOp::eSubtract, vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA);
+	vk::PipelineColorBlendStateCreateInfo colorBlendInfo{ {}, false, vk::LogicOp::eCopy, kind == MeshPipelineKind::eBlend ? blendColorBlendAttachment : opaqueColorBlendAttachment };
+
+	std::vector<vk::DynamicState> dynamicStates{};
+	if (isShadowMap)
+		dynamicStates = { vk::DynamicState::eViewport, vk::DynamicState::eScissor };
+	vk::PipelineDynamicStateCreateInfo dynamicStateInfo{ {}, dynamicStates };
+
+	const vk::PipelineLayout pipelineLayout = isShadowMap ? this->shadowMapPipelineLayout : this->pipelineLayout;
+	const vk::RenderPass renderPass = isShadowMap ? this->shadowMapRenderPass : this->renderPass;
+
+	auto [r, pipeline] = this->device.createGraphicsPipeline(this->pipelineCache, vk::GraphicsPipelineCreateInfo{ {}, shaderStagesInfo, &vertexInputInfo, &inputAssemblyInfo, nullptr, &viewportInfo, &rasterizationInfo, &multisampleInfo, &depthStencilInfo, &colorBlendInfo, &dynamicStateInfo, pipelineLayout, renderPass, 0 });
+	if (r != vk::Result::eSuccess)
+		throw std::runtime_error("Could not create mesh pipeline");
+	return pipeline;
+}
+
+void VulkanRenderer::bindMeshVertexBuffers(const vk::CommandBuffer& cb, const MeshPrimitive& mesh) {
+	std::array<vk::Buffer, VERTEX_SLOT_COUNT> vertexBuffers{};
+	std::array<vk::DeviceSize, VERTEX_SLOT_COUNT> vertexBufferOffsets{};
+
+	for (size_t i = 0; i < VERTEX_SLOT_COUNT; i++) {
+		const VertexAttributeDescription* attribute = mesh.slotAttribute(static_cast<VertexSlot>(i));
+		vertexBuffers[i] = this->bufferTable.at(attribute != nullptr ? attribute->buffer : this->emptyVertexBuffer);
+		vertexBufferOffsets[i] = attribute != nullptr ? attribute->offset : 0;
+	}
+
+	cb.bindVertexBuffers(0, vertexBuffers, vertexBufferOffsets);
+}
@@ -0,0 +1,154 @@
+#include "VulkanRenderer.h"
+
+#include <algorithm>
+
+namespace {
+	// level 0 texels a workgroup of the mip generation shader reduces along each axis, down to one texel of level 6
+	constexpr uint32_t MIP_GENERATION_TILE_SIZE = 64;
+	// the finished workgroup counter ahead of the copy of level 6, and the size of one of its texels
+	constexpr vk::DeviceSize MIP_GENERATION_COUNTER_SIZE = 16;
+	constexpr vk::DeviceSize MIP_GENERATION_TEXEL_SIZE = 32;
+
+	struct MipGenerationParameters {
+		glm::ivec2 size;
+		uint32_t mipCount;
+		uint32_t isSrgb;
+		float alphaCutoff;
+	};
+
+	vk::Extent2D mipGenerationWorkGroups(uint32_t width, uint32_t height) {
+		return vk::Extent2D{ (width + MIP_GENERATION_TILE_SIZE - 1) / MIP_GENERATION_TILE_SIZE, (height + MIP_GENERATION_TILE_SIZE - 1) / MIP_GENERATION_TILE_SIZE };
+	}
+}
+
+void VulkanRenderer::createMipGenerationPipeline() {
+	if (!this->mipGenerationSupported)
+		return;
+
+	std::vector<vk::DescriptorSetLayoutBinding> setLayoutBindings = {
+		vk::DescriptorSetLayoutBinding{0, vk::DescriptorType::eCombinedImageSampler, 1, vk::ShaderStageFlagBits::eCompute},
+		vk::DescriptorSetLayoutBinding{1, vk::DescriptorType::eStorageImage, MAX_GENERATED_MIP_LEVELS, vk::ShaderStageFlagBits::eCompute},
+		vk::DescriptorSetLayoutBinding{2, vk::DescriptorType::eStorageBuffer, 1, vk::ShaderStageFlagBits::eCompute},
+	};
+	this->mipGenerationDescriptorSetLayout = this->device.createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo{ {}, setLayoutBindings });
+
+	std::vector<vk::PushConstantRange> pushConstantRanges = { vk::PushConstantRange{ vk::ShaderStageFlagBits::eCompute, 0, sizeof(MipGenerationParameters) }, };
+	this->mipGenerationPipelineLayout = this->device.createPipelineLayout(vk::PipelineLayoutCreateInfo{ {}, this->mipGenerationDescriptorSetLayout, pushConstantRanges });
+
+	vk::ShaderModule computeModule = loadShader("./shaders/generateMips.comp.spv");
+	vk::PipelineShaderStageCreateInfo computeStageInfo = vk::PipelineShaderStageCreateInfo{ {}, vk::ShaderStageFlagBits::eCompute, computeModule, "main" };
+
+	vk::Result r;
+	std::tie(r, this->mipGenerationPipeline) = this->device.createComputePipeline(this->pipelineCache, vk::ComputePipelineCreateInfo{ {}, computeStageInfo, this->mipGenerationPipelineLayout });
+
+	// the shader only fetches texels, the sampler is there because the source is bound as a combined image sampler
+	this->mipGenerationSampler = this->device.createSampler(vk::SamplerCreateInfo{ {}, vk::Filter::eNearest, vk::Filter::eNearest, vk::SamplerMipmapMode::eNearest, vk::SamplerAddressMode::eClampToEdge, vk::SamplerAddressMode::eClampToEdge, vk::SamplerAddressMode::eClampToEdge, 0.0f, false, 0, false, vk::CompareOp::eNever, 0.0f, 0.0f });
+}
+
+void VulkanRenderer::destroyMipGenerationPipeline() {
+	this->device.destroyPipeline(this->mipGenerationPipeline);
+	this->device.destroyPipelineLayout(this->mipGenerationPipelineLayout);
+	this->device.destroyDescriptorSetLayout(this->mipGenerationDescriptorSetLayout);
+	this->device.destroySampler(this->mipGenerationSampler);
+}
+
+bool VulkanRenderer::canGenerateMips(vk::Format format, uint32_t width, uint32_t height) {
+	// the last workgroup reduces all of level 6 as a single tile
+	const bool isSupportedFormat = format == vk::Format::eR8G8B8A8Unorm || format == vk::Format::eR8G8B8A8Srgb;
+	return this->mipGenerationSupported && isSupportedFormat && std::max(width, height) <= MIP_GENERATION_TILE_SIZE << 6;
+}
+
+VulkanRenderer::MipGenerationResources VulkanRenderer::recordMipGeneration(vk::CommandBuffer cb, const std::vector<MipGenerationJob>& jobs) {
+	MipGenerationResources resources{};
+
+	// every image gets its own counter and copy of level 6, at offsets storage buffers can be bound at
+	const vk::DeviceSize alignment = this->physicalDevice.getProperties().limits.minStorageBufferOffsetAlignment;
+	std::vector<vk::DeviceSize> scratchOffsets;
+	scratchOffsets.reserve(jobs.size());
+	vk::DeviceSize scratchSize = 0;
+	for (const auto& job : jobs) {
+		const vk::Extent2D workGroups = mipGenerationWorkGroups(job.width, job.height);
+		scratchOffsets.push_back(scratchSize);
+		scratchSize += (MIP_GENERATION_COUNTER_SIZE + workGroups.width * workGroups.height * MIP_GENERATION_TEXEL_SIZE + alignment - 1) / alignment * alignment;
+	}
+	std::tie(resources.scratchBuffer, resources.scratchAllocation) = this->allocator.createBuffer(vk::BufferCreateInfo{ {}, scratchSize, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst, vk::SharingMode::eExclusive }, vma::AllocationCreateInfo{ {}, vma::MemoryUsage::eGpuOnly });
+	this->trackAllocation(MemoryCategory::eBuffers, resources.scratchAllocation);
+
+	const uint32_t jobCount = static_cast<uint32_t>(jobs.size());
+	std::vector<vk::DescriptorPoolSize> poolSizes = {
+		vk::DescriptorPoolSize{ vk::DescriptorType::eCombinedImageSampler, jobCount },
+		vk::DescriptorPoolSize{ vk::DescriptorType::eStorageImage, jobCount * MAX_GENERATED_MIP_LEVELS },
+		vk::DescriptorPoolSize{ vk::DescriptorType::eStorageBuffer, jobCount },
+	};
+	resources.descriptorPool = this->device.createDescriptorPool(vk::DescriptorPoolCreateInfo{ {}, jobCount, poolSizes });
+	const std::vector<vk::DescriptorSetLayout> setLayouts(jobs.size(), this->mipGenerationDescriptorSetLayout);
+	const std::vector<vk::DescriptorSet> descriptorSets = this->device.allocateDescriptorSets(vk::DescriptorSetAllocateInfo{ resources.descriptorPool, setLayouts });
+
+	cb.fillBuffer(resources.scratchBuffer, 0, VK_WHOLE_SIZE, 0);
+
+	std::vector<vk::ImageMemoryBarrier> barriers;
+	for (const auto& job : jobs) {
+		barriers.push_back(vk::ImageMemoryBarrier{ vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, job.image, vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1} });
+		barriers.push_back(vk::ImageMemoryBarrier{ {}, vk::AccessFlagBits::eShaderWrite, vk::ImageLayout::eUndefined, vk::ImageLayout::eGeneral, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, job.image, vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, 1, job.mipLevels - 1, 0, 1} });
+	}
+	cb.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eComputeShader, {}, vk::MemoryBarrier{ vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite }, {}, barriers);
+
+	cb.bindPipeline(vk::PipelineBindPoint::eCompute, this->mipGenerationPipeline);
+	for (size_t i = 0; i < jobs.size(); i++) {
+		const MipGenerationJob& job = jobs[i];
+		const bool isSrgb = job.format == vk::Format::eR8G8B8A8Srgb;
+
+		// level 0 is read through a view of the image's own format so sRGB texels come out linear. The image can only
+		// be stored to through a UNORM view, that view is restricted to sampling.
+		vk::ImageViewUsageCreateInfo sourceUsageInfo{ vk::ImageUsageFlagBits::eSampled };
+		vk::ImageViewCreateInfo sourceViewInfo{ {}, job.image, vk::ImageViewType::e2D, job.format, vk::ComponentMapping{}, vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1} };
+		sourceViewInfo.pNext = &sourceUsageInfo;
+		const vk::ImageView sourceView = this->device.createImageView(sourceViewInfo);
+		resources.imageViews.push_back(sourceView);
+
+		// levels the image doesn't have are never stored to, they repeat its smallest one to keep the array valid
+		std::vector<vk::DescriptorImageInfo> levelInfos;
+		for (uint32_t level = 1; level < job.mipLevels; level++) {
+			const vk::ImageView levelView = this->device.createImageView(vk::ImageViewCreateInfo{ {}, job.image, vk::ImageViewType::e2D, vk::Format::eR8G8B8A8Unorm, vk::ComponentMapping{}, vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, level, 1, 0, 1} });
+			resources.imageViews.push_back(levelView);
+			levelInfos.push_back(vk::DescriptorImageInfo{ {}, levelView, vk::ImageLayout::eGeneral });
+		}
+		const vk::DescriptorImageInfo smallestLevelInfo = levelInfos.back();
+		levelInfos.resize(MAX_GENERATED_MIP_LEVELS, smallestLevelInfo);
+
+		const vk::Extent2D workGroups = mipGenerationWorkGroups(job.width, job.height);
+		const vk::DescriptorImageInfo sourceInfo{ this->mipGenerationSampler, sourceView, vk::ImageLayout::eShaderReadOnlyOptimal };
+		const vk::DescriptorBufferInfo scratchInfo{ resources.scratchBuffer, scratchOffsets[i], MIP_GENERATION_COUNTER_SIZE + workGroups.width * workGroups.height * MIP_GENERATION_TEXEL_SIZE };
+		std::vector<vk::WriteDescriptorSet> writeDescriptorSets = {
+			vk::WriteDescriptorSet{ descriptorSets[i], 0, 0, vk::DescriptorType::eCombinedImageSampler, sourceInfo },
+			vk::WriteDescriptorSet{ descriptorSets[i], 1, 0, vk::DescriptorType::eStorageImage, levelInfos },
+			vk::WriteDescriptorSet{ descriptorSets[i], 2, 0, vk::DescriptorType::eStorageBuffer, {}, scratchInfo },
+		};
+		this->device.updateDescriptorSets(writeDescriptorSets, {});
+
+		const MipGenerationParameters parameters{ glm::ivec2{ job.width, job.height }, job.mipLevels - 1, isSrgb ? 1u : 0u, job.alphaCutoff };
+		cb.bindDescriptorSets(vk::PipelineBindPoint::eCompute, this->mipGenerationPipelineLayout, 0, descriptorSets[i], {});
+		cb.pushConstants<MipGenerationParameters>(this->mipGenerationPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0, parameters);
+		cb.dispatch(workGroups.width, workGroups.height, 1);
+	}
+
+	// level 0 is already in its final layout, the copy into it reaches the fragment shader through both barriers
+	barriers.clear();
+	for (const auto& job : jobs)
+		barriers.push_back(vk::ImageMemoryBarrier{ vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead, vk::ImageLayout::eGeneral, vk::ImageLayout::eShaderReadOnlyOptimal, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, job.image, vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eColor, 1, job.mipLevels - 1, 0, 1} });
+	cb.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader, vk::PipelineStageFlagBits::eFragmentShader, {}, vk::MemoryBarrier{ vk::AccessFlagBits::eShaderWrite, vk::AccessFlagBits::eShaderRead }, {}, barriers);
+
+	return resources;
+}
+
+void VulkanRenderer::destroyMipGenerationResources(MipGenerationResources& resources) {
+	for (const auto& imageView : resources.imageViews)
+		this->device.destroyImageView(imageView);
+	if (resources.descriptorPool)
+		this->device.destroyDescriptorPool(resources.descriptorPool);
+	if (resources.scratchBuffer) {
+		this->untrackAllocation(MemoryCategory::eBuffers, resources.scratchAllocation);
+		this->allocator.destroyBuffer(resources.scratchBuffer, resources.scratchAllocation);
+	}
+	resources = {};
+}
@@ -7,6 +7,7 @@
 #include <cppitertools/sorted.hpp>
 
 #include "VulkanRenderer.h"
+#include "VulkanRendererHelpers.h"
 
 #include <glm/gtx/normal.hpp>
 
@@ -72,57 +73,72 @@ void VulkanRenderer::createDirectionalShadowMapRenderPass() {
 void VulkanRenderer::createShadowMapPipeline() {
 	this->shadowMapSampler = this->device.createSampler(vk::SamplerCreateInfo{ {}, vk::Filter::eLinear, vk::Filter::eLinear, vk::SamplerMipmapMode::eLinear, vk::SamplerAddressMode::eClampToBorder, vk::SamplerAddressMode::eClampToBorder, vk::SamplerAddressMode::eClampToBorder, 0.0f, false, 0, true, vk::CompareOp::eLessOrEqual, 0.0f, VK_LOD_CLAMP_NONE, vk::BorderColor::eFloatOpaqueWhite });
 
-	vk::ShaderModule vertexModule = this->loadShader("./shaders/shadowmap.vert.spv");
-	vk::PipelineShaderStageCreateInfo vertexStageInfo = vk::PipelineShaderStageCreateInfo{ {}, vk::ShaderStageFlagBits::eVertex, vertexModule, "main" };
-	this->shaderModules.push_back(vertexModule);
+	// pipelines are made per vertex layout by meshPipeline
+	this->shadowMapVertexShaderModule = this->loadShader("./shaders/shadowmap.vert.spv");
+	this->shaderModules.push_back(this->shadowMapVertexShaderModule);
 
-	std::vector<vk::PipelineShaderStageCreateInfo> shaderStagesInfo = { vertexStageInfo };
+	std::vector<vk::PushConstantRange> pushConstantRanges = { vk::PushConstantRange{ vk::ShaderStageFlagBits::eVertex, 0, sizeof(ShadowPushConstants) }, };
 
-	vk::VertexInputBindingDescription vertexBindingDescription(0, sizeof(Vertex), vk::VertexInputRate::eVertex);
-	std::vector<vk::VertexInputAttributeDescription> vertexAttributeDescriptions = {
-		vk::VertexInputAttributeDescription{ 0, 0, vk::Format::eR32G32B32Sfloat, offsetof(Vertex, pos) },
-	};
-
-	vk::PipelineVertexInputStateCreateInfo vertexInputInfo{ {}, vertexBindingDescription, vertexAttributeDescriptions };
-
-	vk::PipelineInputAssemblyStateCreateInfo inputAssemblyInfo{ {}, vk::PrimitiveTopology::eTriangleList, false };
+	std::vector<vk::DescriptorSetLayout> setLayouts = { };
 
-	std::vector<vk::Viewport> viewports = { vk::Viewport{ 0.0f, 0.0f, static_cast<float>(this->_settings.pointShadowMapResolution), static_cast<float>(this->_settings.pointShadowMapResolution), 0.0f, 1.0f } };
-	std::vector<vk::Rect2D> scissors = { vk::Rect2D({0, 0}, vk::Extent2D{ this->_settings.pointShadowMapResolution, this->_settings.pointShadowMapResolution}) };
+	this->shadowMapPipelineLayout = this->device.createPipelineLayout(vk::PipelineLayoutCreateInfo{ {}, setLayouts, pushConstantRanges });
+}
 
-	vk::PipelineViewportStateCreateInfo viewportInfo{ {}, viewports, scissors };
+void VulkanRenderer::createShadowMapImage() {
+	this->fullPointShadowMapResolution = this->_settings.pointShadowMapResolution;
+	this->fullDirectionalShadowMapResolution = this->_settings.directionalShadowMapResolution;
 
+	// parallel cascade split: https://developer.nvidia.com/gpugems/gpugems3/part-ii-light-and-shadows/chapter-10-parallel-split-shadow-maps-programmable-gpus
+	this->directionalShadowCascadeDepths.push_back(this->_camera.near());
+	this->directionalShadowCascadeCameraSpaceDepths.push_back(0.0f);
 
-	vk::PipelineRasterizationStateCreateInfo rasterizationInfo{ {}, false, false, vk::PolygonMode::eFill, vk::CullModeFlagBits::eFront, vk::FrontFace::eCounterClockwise, false, 0.0f, 0.0f, 0.0f, 1.0f };
+	{
+		const float f = this->_camera.far();
+		const float n = this->_camera.near();
 
-	vk::PipelineDepthStencilStateCreateInfo depthStencilInfo{ {}, true, true, vk::CompareOp::eLess };
+		for (int i = 1; i < this->_settings.directionalShadowCascadeLevels; i++) {
+			const float& n = this->_camera.near();
+			const float& f = this->_camera.far();
+			const float N = static_cast<float>(this->_settings.directionalShadowCascadeLevels);
 
-	vk::PipelineMultisampleStateCreateInfo multisampleInfo;
+			const float Cuni = n + (f - n) * i / N;
+			const float Clog = n * std::pow(f / n, i / N);
 
-	vk::PipelineColorBlendAttachmentState colorBlendAttachment(false, vk::BlendFactor::eOne, vk::BlendFactor::eZero, vk::BlendOp::eAdd, vk::BlendFactor::eOne, vk::BlendFactor::eZero, vk::BlendOp::eAdd, vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA);
-	vk::PipelineColorBlendStateCreateInfo colorBlendInfo{ {}, false, vk::LogicOp::eCopy, colorBlendAttachment };
+			const float lambda = 0.9f;
 
+			float d = lambda * Clog + (1 - lambda) * Cuni;
 
-	std::vector<vk::DynamicState> dynamicStates = { vk::DynamicState::eViewport, vk::DynamicState::eScissor };
-	vk::PipelineDynamicStateCreateInfo dynamicStateInfo{ {}, dynamicStates };
+			this->directionalShadowCascadeDepths.push_back(d);
+			this->directionalShadowCascadeCameraSpaceDepths.push_back((f - f * n / d) / (f - n));
+		}
+	}
 
+	size_t csmBufferSize = this->_settings.directionalShadowCascadeLevels * sizeof(CSMSplitShaderData);
+	for (uint8_t i = 0; i < FRAMES_IN_FLIGHT; i++) {
+		std::tie(this->directionalShadowCascadeSplitDataBuffers[i], this->directionalShadowCascadeSplitDataBufferAllocations[i]) = this->allocator.createBuffer(vk::BufferCreateInfo{ {}, csmBufferSize, vk::BufferUsageFlagBits::eStorageBuffer, vk::SharingMode::eExclusive, {} }, vma::AllocationCreateInfo{ {}, vma::MemoryUsage::eCpuToGpu });
+		this->trackAllocation(MemoryCategory::eBuffers, this->directionalShadowCascadeSplitDataBufferAllocations[i]);
+	}
 
-	std::vector<vk::PushConstantRange> pushConstantRanges = { vk::PushConstantRange{ vk::ShaderStageFlagBits::eVertex, 0, sizeof(glm::mat4) * 2 }, };
+	std::vector<vk::WriteDescriptorSet> writeDescriptorSets;
+	std::array<std::vector<vk::DescriptorBufferInfo>, FRAMES_IN_FLIGHT> csmBufferInfos;
 
-	std::vector<vk::DescriptorSetLayout> setLayouts = { };
+	for (size_t i = 0; i < FRAMES_IN_FLIGHT; i++) {
+		csmBufferInfos[i] = { vk::DescriptorBufferInfo{ this->directionalShadowCascadeSplitDataBuffers[i], 0, csmBufferSize } };
+		writeDescriptorSets.push_back(vk::WriteDescriptorSet{ this->perFrameInFlightDescriptorSets[i], 1, 0, vk::DescriptorType::eStorageBuffer, {}, csmBufferInfos[i] });
+	}
 
-	this->shadowMapPipelineLayout = this->device.createPipelineLayout(vk::PipelineLayoutCreateInfo{ {}, setLayouts, pushConstantRanges });
+	this->device.updateDescriptorSets(writeDescriptorSets, {});
 
-	auto [r, pipeline] = this->device.createGraphicsPipeline(this->pipelineCache, vk::GraphicsPipelineCreateInfo{ {}, shaderStagesInfo, & vertexInputInfo, & inputAssemblyInfo, nullptr, & viewportInfo, & rasterizationInfo, & multisampleInfo, & depthStencilInfo, & colorBlendInfo, & dynamicStateInfo, this->shadowMapPipelineLayout, this->shadowMapRenderPass, 0 });
-	this->shadowMapPipeline = pipeline;
+	this->createShadowMapTargets();
 }
 
-void VulkanRenderer::createShadowMapImage() {
+void VulkanRenderer::createShadowMapTargets() {
 	if (this->_settings.pointShadowMapCount > 0) {
 		std::tie(this->pointShadowMapsImage, this->pointShadowMapsImageAllocation) = this->allocator.createImage(
 			vk::ImageCreateInfo{ {vk::ImageCreateFlagBits::eCubeCompatible}, vk::ImageType::e2D, this->depthAttachmentFormat, vk::Extent3D{this->_settings.pointShadowMapResolution, this->_settings.pointShadowMapResolution, 1}, 1, static_cast<uint32_t>(this->_settings.pointShadowMapCount * 6), vk::SampleCountFlagBits::e1, vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst, vk::SharingMode::eExclusive },
 			vma::AllocationCreateInfo{ {}, vma::MemoryUsage::eGpuOnly }
 		);
+		this->trackAllocation(MemoryCategory::eShadowMaps, this->pointShadowMapsImageAllocation);
 
 		this->pointShadowMapFaceImageViews.reserve(this->_settings.pointShadowMapCount * 6);
 		this->pointShadowMapFramebuffers.reserve(this->_settings.pointShadowMapCount * 6);
@@ -143,41 +159,18 @@ void VulkanRenderer::createShadowMapImage() {
 		cb.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eFragmentShader, vk::DependencyFlagBits::eByRegion, {}, {}, vk::ImageMemoryBarrier{ {}, vk::AccessFlagBits::eShaderRead, vk::ImageLayout::eUndefined, vk::ImageLayout::eShaderReadOnlyOptimal, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, this->pointShadowMapsImage, vk::ImageSubresourceRange{ vk::ImageAspectFlagBits::eDepth, 0, 1, 0, static_cast<uint32_t>(this->_settings.pointShadowMapCount * 6)} });
 		cb.end();
 		vk::Fence fence = this->device.createFence(vk::FenceCreateInfo{});
+		std::lock_guard queueLock{ this->queueMutex };
 		this->graphicsQueue.submit(vk::SubmitInfo{ {}, {}, cb, {} }, fence);
 		this->device.waitForFences(fence, true, UINT64_MAX);
 		this->device.destroyFence(fence);
 		this->device.freeCommandBuffers(commandPool, cb);
 	}
 
-	// parallel cascade split: https://developer.nvidia.com/gpugems/gpugems3/part-ii-light-and-shadows/chapter-10-parallel-split-shadow-maps-programmable-gpus
-	this->directionalShadowCascadeDepths.push_back(this->_camera.near());
-	this->directionalShadowCascadeCameraSpaceDepths.push_back(0.0f);
-
-	{
-		const float f = this->_camera.far();
-		const float n = this->_camera.near();
-
-		for (int i = 1; i < this->_settings.directionalShadowCascadeLevels; i++) {
-			const float& n = this->_camera.near();
-			const float& f = this->_camera.far();
-			const float N = static_cast<float>(this->_settings.directionalShadowCascadeLevels);
-
-			const float Cuni = n + (f - n) * i / N;
-			const float Clog = n * std::pow(f / n, i / N);
-
-			const float lambda = 0.9f;
-
-			float d = lambda * Clog + (1 - lambda) * Cuni;
-
-			this->directionalShadowCascadeDepths.push_back(d);
-			this->directionalShadowCascadeCameraSpaceDepths.push_back((f - f * n / d) / (f - n));
-		}
-	}
-
 	std::tie(this->directionalCascadedShadowMapsImage, this->directionalCascadedShadowMapsImageAllocation) = this->allocator.createImage(
 		vk::ImageCreateInfo{ {}, vk::ImageType::e2D, this->depthAttachmentFormat, vk::Extent3D{this->_settings.directionalShadowMapResolution, this->_settings.directionalShadowMapResolution, 1}, 1, this->_settings.directionalShadowCascadeLevels, vk::SampleCountFlagBits::e1, vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferDst, vk::SharingMode::eExclusive },
 		vma::AllocationCreateInfo{ {}, vma::MemoryUsage::eGpuOnly }
 	);
+	this->trackAllocation(MemoryCategory::eShadowMaps, this->directionalCascadedShadowMapsImageAllocation);
 
 	for (uint32_t i = 0; i < this->_settings.directionalShadowCascadeLevels; i++) {
 		vk::ImageView iv = this->device.createImageView(vk::ImageViewCreateInfo{ {}, this->directionalCascadedShadowMapsImage, vk::ImageViewType::e2D, this->depthAttachmentFormat, vk::ComponentMapping{}, vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eDepth, 0, 1, i, 1 } });
@@ -189,11 +182,6 @@ void VulkanRenderer::createShadowMapImage() {
 
 	this->directionalShadowMapArrayImageView = this->device.createImageView(vk::ImageViewCreateInfo{ {}, this->directionalCascadedShadowMapsImage, vk::ImageViewType::e2DArray, this->depthAttachmentFormat, vk::ComponentMapping{}, vk::ImageSubresourceRange{vk::ImageAspectFlagBits::eDepth, 0, 1, 0, VK_REMAINING_ARRAY_LAYERS} });
 
-	size_t csmBufferSize = this->_settings.directionalShadowCascadeLevels * sizeof(CSMSplitShaderData);
-	for (uint8_t i = 0; i < FRAMES_IN_FLIGHT; i++) {
-		std::tie(this->directionalShadowCascadeSplitDataBuffers[i], this->directionalShadowCascadeSplitDataBufferAllocations[i]) = this->allocator.createBuffer(vk::BufferCreateInfo{ {}, csmBufferSize, vk::BufferUsageFlagBits::eStorageBuffer, vk::SharingMode::eExclusive, {} }, vma::AllocationCreateInfo{ {}, vma::MemoryUsage::eCpuToGpu });
-	}
-
 	std::vector<vk::DescriptorImageInfo> pointImageInfos = { vk::DescriptorImageInfo{this->shadowMapSampler, this->pointShadowMapCubeArrayImageView, vk::ImageLayout::eShaderReadOnlyOptimal } };
 	std::vector<vk::DescriptorImageInfo> directionalImageInfos = { vk::DescriptorImageInfo{this->shadowMapSampler, this->directionalShadowMapArrayImageView, vk::ImageLayout::eShaderReadOnlyOptimal } };
 
@@ -201,15 +189,33 @@ void VulkanRenderer::createShadowMapImage() {
 		vk::WriteDescriptorSet{ this->globalDescriptorSet, 4, 0, vk::DescriptorType::eCombinedImageSampler, pointImageInfos },
 		vk::WriteDescriptorSet{ this->globalDescriptorSet, 5, 0, vk::DescriptorType::eCombinedImageSampler, directionalImageInfos },
 	};
+	this->device.updateDescriptorSets(writeDescriptorSets, {});
+}
 
-	std::array<std::vector<vk::DescriptorBufferInfo>, FRAMES_IN_FLIGHT> csmBufferInfos;
-
-	for (size_t i = 0; i < FRAMES_IN_FLIGHT; i++) {
-		csmBufferInfos[i] = { vk::DescriptorBufferInfo{ this->directionalShadowCascadeSplitDataBuffers[i], 0, csmBufferSize } };
-		writeDescriptorSets.push_back(vk::WriteDescriptorSet{ this->perFrameInFlightDescriptorSets[i], 1, 0, vk::DescriptorType::eStorageBuffer, {}, csmBufferInfos[i] });
+void VulkanRenderer::destroyShadowMapTargets() {
+	if (this->_settings.pointShadowMapCount > 0) {
+		for (auto& fb : this->pointShadowMapFramebuffers)
+			this->device.destroyFramebuffer(fb);
+		this->pointShadowMapFramebuffers = {};
+		for (auto& iv : this->pointShadowMapFaceImageViews)
+			this->device.destroyImageView(iv);
+		this->pointShadowMapFaceImageViews = {};
+		this->device.destroyImageView(this->pointShadowMapCubeArrayImageView);
+
+		this->untrackAllocation(MemoryCategory::eShadowMaps, this->pointShadowMapsImageAllocation);
+		this->allocator.destroyImage(this->pointShadowMapsImage, this->pointShadowMapsImageAllocation);
 	}
 
-	this->device.updateDescriptorSets(writeDescriptorSets, {});
+	for (auto& fb : this->directionalShadowMapFramebuffers)
+		this->device.destroyFramebuffer(fb);
+	this->directionalShadowMapFramebuffers = {};
+	for (auto& iv : this->directionalShadowMapImageViews)
+		this->device.destroyImageView(iv);
+	this->directionalShadowMapImageViews = {};
+	this->device.destroyImageView(this->directionalShadowMapArrayImageView);
+
+	this->untrackAllocation(MemoryCategory::eShadowMaps, this->directionalCascadedShadowMapsImageAllocation);
+	this->allocator.destroyImage(this->directionalCascadedShadowMapsImage, this->directionalCascadedShadowMapsImageAllocation);
 }
 
 void VulkanRenderer::createStaticShadowMapImage() {
@@ -218,6 +224,7 @@ void VulkanRenderer::createStaticShadowMapImage() {
 			vk::ImageCreateInfo{ {}, vk::ImageType::e2D, this->depthAttachmentFormat, vk::Extent3D{this->_settings.pointShadowMapResolution, this->_settings.pointShadowMapResolution, 1}, 1, static_cast<uint32_t>(this->_settings.pointShadowMapCount * 6), vk::SampleCountFlagBits::e1, vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eTransferSrc, vk::SharingMode::eExclusive },
 			vma::AllocationCreateInfo{ {}, vma::MemoryUsage::eGpuOnly }
 		);
+		this->trackAllocation(MemoryCategory::eShadowMaps, this->pointStaticShadowMapsImageAllocation);
 
 		this->pointShadowMapFaceImageViews.reserve(this->_settings.pointShadowMapCount * 6);
 		this->pointShadowMapFramebuffers.reserve(this->_settings.pointShadowMapCount * 6);
@@ -233,23 +240,59 @@ void VulkanRenderer::createStaticShadowMapImage() {
 	}
 }
 
+void VulkanRenderer::destroyStaticShadowMapImage() {
+	for (auto& fb : this->staticPointShadowMapFramebuffers)
+		this->device.destroyFramebuffer(fb);
+	this->staticPointShadowMapFramebuffers = {};
+	for (auto& iv : this->staticPointShadowMapFaceImageViews)
+		this->device.destroyImageView(iv);
+	this->staticPointShadowMapFaceImageViews = {};
+
+	this->untrackAllocation(MemoryCategory::eShadowMaps, this->pointStaticShadowMapsImageAllocation);
+	this->allocator.destroyImage(this->staticPointShadowMapsImage, this->pointStaticShadowMapsImageAllocation);
+	this->staticPointShadowMapsImage = vk::Image{};
+	this->pointStaticShadowMapsImageAllocation = vma::Allocation{};
+}
+
+void VulkanRenderer::drawShadowCaster(const vk::CommandBuffer& cb, MeshPrimitive& mesh, const glm::mat4& viewproj, vk::Pipeline& boundPipeline) {
+	const vk::Pipeline pipeline = this->meshPipeline(MeshPipelineKind::eShadowMap, mesh.vertexLayout());
+	if (pipeline != boundPipeline) {
+		cb.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+		boundPipeline = pipeline;
+	}
+
+	const glm::mat4 model = mesh.node()->modelMatrix();
+	const glm::mat4 modelviewproj = viewproj * model;
+
+	const ShadowPushConstants pushConstants{ modelviewproj, glm::vec4{ mesh.positionOffset(), 0.0f }, glm::vec4{ mesh.positionScale(), 0.0f } };
+
+	cb.pushConstants<ShadowPushConstants>(this->shadowMapPipelineLayout, vk::ShaderStageFlagBits::eVertex, 0, pushConstants);
+
+	this->bindMeshVertexBuffers(cb, mesh);
+	// shadow views differ from the camera's, every instance is drawn
+	const uint32_t instanceCount = this->bindMeshInstances(cb, mesh, 0, nullptr);
+
+	if (mesh.isIndexed()) {
+		cb.bindIndexBuffer(this->bufferTable.at(mesh.indexBufferDescription().buffer), mesh.indexBufferDescription().offset, vkIndexTypeFromAttributeValueType(mesh.indexBufferDescription().indexType));
+		cb.drawIndexed(static_cast<uint32_t>(mesh.indexBufferDescription().count), instanceCount, 0, 0, 0);
+	}
+	else
+		cb.draw(static_cast<uint32_t>(mesh.vertexBufferDescription()[0].count), instanceCount, 0, 0);
+}
+
 void VulkanRenderer::renderShadowMaps(uint32_t frameIndex, const glm::vec3& cameraPos) {
 	vk::CommandBuffer& cb = this->shadowPassCommandBuffers[frameIndex];
 	cb.reset();
 	cb.begin(vk::CommandBufferBeginInfo{ vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
 
-	cb.bindVertexBuffers(0, this->vertexIndexBuffer, { 0 });
-	cb.bindIndexBuffer(this->vertexIndexBuffer, this->indexBufferOffset, vk::IndexType::eUint32);
-
-	cb.bindPipeline(vk::PipelineBindPoint::eGraphics, this->shadowMapPipeline);
-
 	this->recordPointShadowMapsCommands(cb, frameIndex, cameraPos);
 	this->recordDirectionalShadowMapsCommands(cb, frameIndex);
 
 	this->recordUpdateLightsBufferCommands(cb);
 
 	cb.end();
-	this->graphicsQueue.submit(vk::SubmitInfo{ {}, {}, cb, this->shadowPassFinishedSemaphores[frameIndex] });
+	std::lock_guard queueLock{ this->queueMutex };
+	this->submitFrameCommands(cb, {}, {}, this->shadowPassFinishedSemaphores[frameIndex]);
 }
 
 void VulkanRenderer::recordPointShadowMapsCommands(vk::CommandBuffer cb, uint32_t frameIndex, const glm::vec3& cameraPos) {
@@ -295,45 +338,51 @@ void VulkanRenderer::recordPointShadowMapsCommands(vk::CommandBuffer cb, uint32_
 		}
 	}
 
+	// the memory governor can drop the static cache, then every caster is drawn straight into the shadow maps each
+	// frame and there is nothing to blit or draw on top
+	const bool isCached = static_cast<bool>(this->staticPointShadowMapsImage);
+	std::vector<std::shared_ptr<MeshPrimitive>> uncachedCasters;
+	if (!isCached) {
+		uncachedCasters = this->staticMeshes;
+		if (this->_settings.dynamicShadowsEnabled)
+			uncachedCasters.insert(uncachedCasters.end(), this->dynamicMeshes.begin(), this->dynamicMeshes.end());
+	}
+	const std::vector<std::shared_ptr<MeshPrimitive>>& casters = isCached ? this->staticMeshes : uncachedCasters;
+	const vk::RenderPass renderPass = isCached ? this->staticShadowMapRenderPass : this->directionalShadowMapRenderPass;
+	const std::vector<vk::Framebuffer>& framebuffers = isCached ? this->staticPointShadowMapFramebuffers : this->pointShadowMapFramebuffers;
+
 	for (const auto& light : sortedPointLights) {
-		if (light->flags & PointLightFlagBits::eStaticShadowMapRendered)
+		if (isCached && (light->flags & PointLightFlagBits::eStaticShadowMapRendered))
 			continue;
 
 		const glm::vec3& cameraPos = light->point;
 
 		std::vector<std::shared_ptr<MeshPrimitive>> sortedMeshes;
-		for (const auto& el : iter::sorted(this->staticMeshes, [&cameraPos](const std::shared_ptr<MeshPrimitive>& a, const std::shared_ptr<MeshPrimitive>& b) { return glm::distance(a->barycenter(), cameraPos) < glm::distance(b->barycenter(), cameraPos); }))
+		for (const auto& el : iter::sorted(casters, [&cameraPos](const std::shared_ptr<MeshPrimitive>& a, const std::shared_ptr<MeshPrimitive>& b) { return glm::distance(a->barycenter(), cameraPos) < glm::distance(b->barycenter(), cameraPos); }))
 			sortedMeshes.push_back(el);
 
 		for (unsigned short j = 0; j < 6; j++) {
-			cb.beginRenderPass(vk::RenderPassBeginInfo{ this->staticShadowMapRenderPass, this->staticPointShadowMapFramebuffers[light->shadowMapIndex * 6 + j], vk::Rect2D{{0, 0}, {this->_settings.pointShadowMapResolution, this->_settings.pointShadowMapResolution}}, clearValues }, vk::SubpassContents::eInline);
+			cb.beginRenderPass(vk::RenderPassBeginInfo{ renderPass, framebuffers[light->shadowMapIndex * 6 + j], vk::Rect2D{{0, 0}, {this->_settings.pointShadowMapResolution, this->_settings.pointShadowMapResolution}}, clearValues }, vk::SubpassContents::eInline);
 
 			auto& pov = facePovs[j];
 			pov.setPosition(cameraPos);
 			glm::mat4 viewproj = pov.viewProjMatrix();
 
 			auto culledMeshes = iter::filter([this, &pov](const std::shared_ptr<MeshPrimitive> mesh) {
-				return !this->cullMesh(*mesh, pov);
+				return !this->shouldCullMesh(*mesh, *mesh->node(), pov);
 				}, sortedMeshes);
 
 
-			for (auto& mesh : culledMeshes) {
-				const glm::mat4 model = mesh->node->modelMatrix();
-				const glm::mat4 modelviewproj = viewproj * model;
-
-				std::vector<glm::mat4> pushConstants = { modelviewproj, model };
-
-				cb.pushConstants<glm::mat4x4>(this->shadowMapPipelineLayout, vk::ShaderStageFlagBits::eVertex, 0, pushConstants);
-
-				if (mesh->isIndexed)
-					cb.drawIndexed(static_cast<uint32_t>(mesh->indices.size()), 1, mesh->firstIndexOffset, 0, 0);
-				else
-					cb.draw(static_cast<uint32_t>(mesh->vertices.size()), 1, mesh->firstVertexOffset, 0);
-			}
+			vk::Pipeline boundPipeline{};
+			for (auto& mesh : culledMeshes)
+				this->drawShadowCaster(cb, *mesh, viewproj, boundPipeline);
 
 			cb.endRenderPass();
 		}
 
+		if (!isCached)
+			continue;
+
 		light->flags |= PointLightFlagBits::eStaticShadowMapRendered;
 
 		cb.pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlagBits::eByRegion, {}, {}, vk::ImageMemoryBarrier{ vk::AccessFlagBits::eShaderRead, vk::AccessFlagBits::eTransferWrite, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, this->pointShadowMapsImage, vk::ImageSubresourceRange{ vk::ImageAspectFlagBits::eDepth, 0, VK_REMAINING_MIP_LEVELS, static_cast<uint32_t>(light->shadowMapIndex * 6), 6 }});
@@ -341,6 +390,9 @@ void VulkanRenderer::recordPointShadowMapsCommands(vk::CommandBuffer cb, uint32_
 		cb.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, vk::DependencyFlagBits::eByRegion, {}, {}, vk::ImageMemoryBarrier{ vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, this->pointShadowMapsImage, vk::ImageSubresourceRange{ vk::ImageAspectFlagBits::eDepth, 0, VK_REMAINING_MIP_LEVELS, static_cast<uint32_t>(light->shadowMapIndex * 6), 6 } });
 	}
 
+	if (!isCached)
+		return;
+
 	for (const auto& light : sortedPointLights) {
 		const glm::vec3 cameraPos = light->point;
 
@@ -355,7 +407,7 @@ void VulkanRenderer::recordPointShadowMapsCommands(vk::CommandBuffer cb, uint32_
 			glm::mat4 viewproj = pov.viewProjMatrix();
 
 			auto culledMeshes = iter::filter([this, &pov](const std::shared_ptr<MeshPrimitive> mesh) {
-				return !this->cullMesh(*mesh, pov);
+				return !this->shouldCullMesh(*mesh, *mesh->node(), pov);
 				}, sortedMeshes);
 
 			uint32_t nonCulledMeshes = 0;
@@ -368,19 +420,9 @@ void VulkanRenderer::recordPointShadowMapsCommands(vk::CommandBuffer cb, uint32_
 				cb.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eEarlyFragmentTests, vk::DependencyFlagBits::eByRegion, {}, {}, vk::ImageMemoryBarrier{ vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eDepthStencilAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentWrite, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eDepthStencilAttachmentOptimal, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, this->pointShadowMapsImage, vk::ImageSubresourceRange{ vk::ImageAspectFlagBits::eDepth, 0, VK_REMAINING_MIP_LEVELS, static_cast<uint32_t>(light->shadowMapIndex * 6 + j), 1 } });
 
 				cb.beginRenderPass(vk::RenderPassBeginInfo{ this->shadowMapRenderPass, this->pointShadowMapFramebuffers[light->shadowMapIndex * 6 + j], vk::Rect2D{{0, 0}, {this->_settings.pointShadowMapResolution, this->_settings.pointShadowMapResolution}}, clearValues }, vk::SubpassContents::eInline);
-				for (auto& mesh : culledMeshes) {
-					const glm::mat4 model = mesh->node->modelMatrix();
-					const glm::mat4 modelviewproj = viewproj * model;
-
-					std::vector<glm::mat4> pushConstants = { modelviewproj, model };
-
-					cb.pushConstants<glm::mat4x4>(this->shadowMapPipelineLayout, vk::ShaderStageFlagBits::eVertex, 0, pushConstants);
-
-					if (mesh->isIndexed)
-						cb.drawIndexed(mesh->indices.size(), 1, mesh->firstIndexOffset, 0, 0);
-					else
-						cb.draw(mesh->vertices.size(), 1, mesh->firstVertexOffset, 0);
-				}
+				vk::Pipeline boundPipeline{};
+				for (auto& mesh : culledMeshes)
+					this->drawShadowCaster(cb, *mesh, viewproj, boundPipeline);
 				cb.endRenderPass();
 			}
 
@@ -426,7 +468,7 @@ void VulkanRenderer::recordDirectionalShadowMapsCommands(vk::CommandBuffer cb, u
 
 
 		auto culledMeshes = iter::filter([this, &splitPov](const std::shared_ptr<MeshPrimitive> mesh) {
-			return !this->cullMesh(*mesh, splitPov);
+			return !this->shouldCullMesh(*mesh, *mesh->node(), splitPov);
 			}, sortedMeshes);
 
 		uint32_t nonCulledMeshes = 0;
@@ -435,19 +477,9 @@ void VulkanRenderer::recordDirectionalShadowMapsCommands(vk::CommandBuffer cb, u
 
 		/*if (nonCulledMeshes > 0)*/ {
 			cb.beginRenderPass(vk::RenderPassBeginInfo{ this->directionalShadowMapRenderPass, this->directionalShadowMapFramebuffers[i], vk::Rect2D{ {0, 0}, {this->_settings.directionalShadowMapResolution, this->_settings.directionalShadowMapResolution}}, clearValues }, vk::SubpassContents::eInline);
-			for (auto& mesh : culledMeshes) {
-				const glm::mat4 model = mesh->node->modelMatrix();
-				const glm::mat4 modelviewproj = viewproj * model;
-
-				std::vector<glm::mat4> pushConstants = { modelviewproj, model };
-
-				cb.pushConstants<glm::mat4x4>(this->shadowMapPipelineLayout, vk::ShaderStageFlagBits::eVertex, 0, pushConstants);
-
-				if (mesh->isIndexed)
-					cb.drawIndexed(static_cast<uint32_t>(mesh->indices.size()), 1, mesh->firstIndexOffset, 0, 0);
-				else
-					cb.draw(static_cast<uint32_t>(mesh->vertices.size()), 1, mesh->firstVertexOffset, 0);
-			}
+			vk::Pipeline boundPipeline{};
+			for (auto& mesh : culledMeshes)
+				this->drawShadowCaster(cb, *mesh, viewproj, boundPipeline);
 			cb.endRenderPass();
 		}
 	}
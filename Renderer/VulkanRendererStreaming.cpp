@@ -0,0 +1,316 @@
+#include "VulkanRenderer.h"
+
+#include <algorithm>
+#include <unordered_set>
+#include <stdexcept>
+
+void VulkanRenderer::createMaterialResources() {
+	std::vector<vk::DescriptorPoolSize> poolSizes = {
+		vk::DescriptorPoolSize{ vk::DescriptorType::eUniformBuffer, 2 * MAX_MATERIAL_DESCRIPTOR_SETS },
+		vk::DescriptorPoolSize{ vk::DescriptorType::eCombinedImageSampler, 5 * MAX_MATERIAL_DESCRIPTOR_SETS },
+	};
+	this->materialDescriptorPool = this->device.createDescriptorPool(vk::DescriptorPoolCreateInfo{ vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet, MAX_MATERIAL_DESCRIPTOR_SETS, poolSizes });
+
+	// drawn in place of textures a material doesn't have or is still waiting on
+	const std::array<byte, 4> white = { 0xff, 0xff, 0xff, 0xff };
+	const std::array<byte, 4> black = { 0x00, 0x00, 0x00, 0xff };
+	const std::array<byte, 4> flatNormal = { 0x80, 0x80, 0xff, 0xff };
+	this->whiteTexture = this->makeTexture(this->loadImage(white.data(), white.size(), 1, 1, ImageFormat::eR8G8B8A8Unorm), Sampler{});
+	this->blackTexture = this->makeTexture(this->loadImage(black.data(), black.size(), 1, 1, ImageFormat::eR8G8B8A8Unorm), Sampler{});
+	this->flatNormalTexture = this->makeTexture(this->loadImage(flatNormal.data(), flatNormal.size(), 1, 1, ImageFormat::eR8G8B8A8Unorm), Sampler{});
+}
+
+void VulkanRenderer::destroyMaterialResources() {
+	for (const auto& [material, entry] : this->materialTable) {
+		this->untrackAllocation(MemoryCategory::eBuffers, entry.uniformBufferAllocation);
+		this->allocator.destroyBuffer(entry.uniformBuffer, entry.uniformBufferAllocation);
+	}
+	this->materialTable = {};
+	this->retiredMaterialDescriptorSets = {};
+	this->retiredMaterials = {};
+	this->device.destroyDescriptorPool(this->materialDescriptorPool);
+}
+
+vk::DescriptorSet VulkanRenderer::makeMaterialDescriptorSet(const MaterialEntry& material, const MaterialTextures& textures) {
+	// a texture the material has but which hasn't landed yet must not show up as full emission
+	auto textureOrPlaceholder = [](Texture texture, int32_t sceneTexture, Texture missing, Texture pending) {
+		if (texture.isValid())
+			return texture;
+		return sceneTexture > -1 ? pending : missing;
+	};
+	const std::array<Texture, 5> boundTextures = {
+		textureOrPlaceholder(textures.baseColor, material.data.baseColorTexture, this->whiteTexture, this->whiteTexture),
+		textureOrPlaceholder(textures.normal, material.data.normalTexture, this->flatNormalTexture, this->flatNormalTexture),
+		textureOrPlaceholder(textures.metallicRoughness, material.data.metallicRoughnessTexture, this->whiteTexture, this->whiteTexture),
+		textureOrPlaceholder(textures.occlusion, material.data.occlusionTexture, this->whiteTexture, this->whiteTexture),
+		textureOrPlaceholder(textures.emissive, material.data.emissiveTexture, this->whiteTexture, this->blackTexture),
+	};
+
+	vk::DescriptorSet descriptorSet = this->device.allocateDescriptorSets(vk::DescriptorSetAllocateInfo{ this->materialDescriptorPool, this->pbrDescriptorSetLayout })[0];
+
+	std::array<vk::DescriptorImageInfo, 5> imageInfos;
+	for (size_t i = 0; i < boundTextures.size(); i++)
+		imageInfos[i] = vk::DescriptorImageInfo{ this->textureSamplerTable.at(boundTextures[i]), this->textureImageViewTable.at(boundTextures[i]), vk::ImageLayout::eShaderReadOnlyOptimal };
+	std::vector<vk::DescriptorBufferInfo> materialBufferInfos = { vk::DescriptorBufferInfo{ material.uniformBuffer, 0, sizeof(MaterialShaderData) } };
+	std::vector<vk::DescriptorBufferInfo> alphaBufferInfos = { vk::DescriptorBufferInfo{ material.uniformBuffer, material.alphaOffset, sizeof(AlphaShaderData) } };
+
+	std::vector<vk::WriteDescriptorSet> writeDescriptorSets = {
+		vk::WriteDescriptorSet{ descriptorSet, 0, 0, vk::DescriptorType::eUniformBuffer, {}, materialBufferInfos },
+		vk::WriteDescriptorSet{ descriptorSet, 1, 0, 1, vk::DescriptorType::eCombinedImageSampler, &imageInfos[0] },
+		vk::WriteDescriptorSet{ descriptorSet, 2, 0, 1, vk::DescriptorType::eCombinedImageSampler, &imageInfos[1] },
+		vk::WriteDescriptorSet{ descriptorSet, 3, 0, 1, vk::DescriptorType::eCombinedImageSampler, &imageInfos[2] },
+		vk::WriteDescriptorSet{ descriptorSet, 4, 0, 1, vk::DescriptorType::eCombinedImageSampler, &imageInfos[3] },
+		vk::WriteDescriptorSet{ descriptorSet, 5, 0, 1, vk::DescriptorType::eCombinedImageSampler, &imageInfos[4] },
+		vk::WriteDescriptorSet{ descriptorSet, 6, 0, vk::DescriptorType::eUniformBuffer, {}, alphaBufferInfos },
+	};
+	this->device.updateDescriptorSets(writeDescriptorSets, {});
+	return descriptorSet;
+}
+
+Material VulkanRenderer::makeMaterial(const MaterialData& materialData, const MaterialTextures& textures) {
+	vk::DeviceSize minBufferAlignment = this->physicalDevice.getProperties().limits.minUniformBufferOffsetAlignment;
+	vk::DeviceSize alphaOffset = (sizeof(MaterialShaderData) / minBufferAlignment + (sizeof(MaterialShaderData) % minBufferAlignment ? 1 : 0)) * minBufferAlignment;
+	vk::DeviceSize bufferSize = alphaOffset + sizeof(AlphaShaderData);
+
+	// written once and never changed, so it can live in host visible memory without a staging copy
+	auto [uniformBuffer, uniformBufferAllocation] = this->allocator.createBuffer(vk::BufferCreateInfo{ {}, bufferSize, vk::BufferUsageFlagBits::eUniformBuffer, vk::SharingMode::eExclusive }, vma::AllocationCreateInfo{ {}, vma::MemoryUsage::eCpuToGpu, vk::MemoryPropertyFlagBits::eHostCoherent });
+	this->trackAllocation(MemoryCategory::eBuffers, uniformBufferAllocation);
+	byte* data = reinterpret_cast<byte*>(this->allocator.mapMemory(uniformBufferAllocation));
+	*reinterpret_cast<MaterialShaderData*>(data) = MaterialShaderData{ materialData.baseColorFactor, glm::vec4{ materialData.emissiveFactor, 0.0f }, materialData.normalScale, materialData.metallicFactor, materialData.roughnessFactor, materialData.occlusionStrength };
+	*reinterpret_cast<AlphaShaderData*>(data + alphaOffset) = AlphaShaderData{ materialData.alphaMode, materialData.alphaCutoff };
+	this->allocator.unmapMemory(uniformBufferAllocation);
+
+	MaterialEntry entry{ materialData, uniformBuffer, uniformBufferAllocation, alphaOffset };
+	entry.textures = textures;
+
+	std::unique_lock lock{ this->materialMutex };
+	entry.descriptorSet = this->makeMaterialDescriptorSet(entry, textures);
+	this->materialTable.insert({ this->nextMaterialId, entry });
+	return this->nextMaterialId++;
+}
+
+void VulkanRenderer::updateMaterialTextures(Material material, const MaterialTextures& textures) {
+	std::unique_lock lock{ this->materialMutex };
+	MaterialEntry& entry = this->materialTable.at(material);
+	vk::DescriptorSet descriptorSet = this->makeMaterialDescriptorSet(entry, textures);
+	this->retiredMaterialDescriptorSets.push_back({ this->frameCount.load(), entry.descriptorSet });
+	entry.descriptorSet = descriptorSet;
+	entry.textures = textures;
+}
+
+void VulkanRenderer::setTextureImage(Texture texture, Image image) {
+	const vk::ImageView imageView = this->makeTextureImageView(image);
+
+	std::unique_lock lock{ this->materialMutex };
+	this->retiredImageViews.push_back({ this->frameCount.load(), this->textureImageViewTable.at(texture) });
+	this->textureImageViewTable.at(texture) = imageView;
+
+	// descriptor sets hold the view itself, so every material sampling the texture gets a new one
+	for (auto& [material, entry] : this->materialTable) {
+		const MaterialTextures& t = entry.textures;
+		if (entry.destroyed || (t.baseColor != texture && t.metallicRoughness != texture && t.normal != texture && t.emissive != texture && t.occlusion != texture))
+			continue;
+
+		vk::DescriptorSet descriptorSet = this->makeMaterialDescriptorSet(entry, entry.textures);
+		this->retiredMaterialDescriptorSets.push_back({ this->frameCount.load(), entry.descriptorSet });
+		entry.descriptorSet = descriptorSet;
+	}
+}
+
+uint32_t VulkanRenderer::imageMipLevels(Image image) {
+	std::shared_lock lock{ this->materialMutex };
+	return this->imageMipLevelsTable.at(image);
+}
+
+Image VulkanRenderer::beginCopyImageLevels(Image source, uint32_t firstLevel) {
+	vk::Image sourceImage;
+	vk::Format format;
+	vk::Extent2D sourceExtent;
+	uint32_t sourceMipLevels;
+	{
+		std::shared_lock lock{ this->materialMutex };
+		sourceImage = this->imageTable.at(source);
+		format = this->imageFormatTable.at(source);
+		sourceExtent = this->imageExtentTable.at(source);
+		sourceMipLevels = this->imageMipLevelsTable.at(source);
+	}
+	if (firstLevel >= sourceMipLevels)
+		throw std::runtime_error("Image doesn't have the level to copy from");
+
+	const uint32_t mipLevels = sourceMipLevels - firstLevel;
+	const uint32_t width = std::max(sourceExtent.width >> firstLevel, 1u);
+	const uint32_t height = std::max(sourceExtent.height >> firstLevel, 1u);
+
+	auto&& [image, imageAllocation] = allocator.createImage(
+		vk::ImageCreateInfo{ {}, vk::ImageType::e2D, format, vk::Extent3D{width, height, 1}, mipLevels, 1, vk::SampleCountFlagBits::e1, vk::ImageTiling::eOptimal, vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled, vk::SharingMode::eExclusive },
+		vma::AllocationCreateInfo{ {}, vma::MemoryUsage::eGpuOnly }
+	);
+	this->trackAllocation(MemoryCategory::eTextures, imageAllocation);
+
+	const vk::ImageSubresourceRange sourceRange{ vk::ImageAspectFlagBits::eColor, firstLevel, mipLevels, 0, 1 };
+	const vk::ImageSubresourceRange range{ vk::ImageAspectFlagBits::eColor, 0, mipLevels, 0, 1 };
+
+	// recorded on the graphics queue the frames sampling the source are submitted to, so the barriers order the copy
+	// after the frames before it and the frames after it after the copy
+	UploadStream& stream = this->uploadStream(UploadQueue::eGraphics);
+	vk::CommandBuffer cb = this->beginUpload(stream);
+	cb.pipelineBarrier(vk::PipelineStageFlagBits::eFragmentShader, vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, {
+		vk::ImageMemoryBarrier{ vk::AccessFlagBits::eShaderRead, vk::AccessFlagBits::eTransferRead, vk::ImageLayout::eShaderReadOnlyOptimal, vk::ImageLayout::eTransferSrcOptimal, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, sourceImage, sourceRange },
+		vk::ImageMemoryBarrier{ {}, vk::AccessFlagBits::eTransferWrite, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, image, range },
+	});
+
+	std::vector<vk::ImageCopy> copyRegions;
+	copyRegions.reserve(mipLevels);
+	for (uint32_t i = 0; i < mipLevels; i++) {
+		copyRegions.push_back(vk::ImageCopy{ vk::ImageSubresourceLayers{vk::ImageAspectFlagBits::eColor, firstLevel + i, 0, 1}, {0, 0, 0}, vk::ImageSubresourceLayers{vk::ImageAspectFlagBits::eColor, i, 0, 1}, {0, 0, 0}, {std::max(width >> i, 1u), std::max(height >> i, 1u), 1} });
+	}
+	cb.copyImage(sourceImage, vk::ImageLayout::eTransferSrcOptimal, image, vk::ImageLayout::eTransferDstOptimal, copyRegions);
+
+	cb.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eFragmentShader, {}, {}, {}, {
+		vk::ImageMemoryBarrier{ vk::AccessFlagBits::eTransferRead, vk::AccessFlagBits::eShaderRead, vk::ImageLayout::eTransferSrcOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, sourceImage, sourceRange },
+		vk::ImageMemoryBarrier{ vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eShaderRead, vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eShaderReadOnlyOptimal, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, image, range },
+	});
+	this->endUpload(stream);
+
+	// the render loop reaps retired images from the tables
+	std::unique_lock lock{ this->materialMutex };
+	imageTable.insert({ this->nextImageId, image });
+	imageAllocationTable.insert({ this->nextImageId, imageAllocation });
+	imageFormatTable.insert({ this->nextImageId, format });
+	imageExtentTable.insert({ this->nextImageId, vk::Extent2D{ width, height } });
+	imageMipLevelsTable.insert({ this->nextImageId, mipLevels });
+	return this->nextImageId++;
+}
+
+std::unordered_map<Texture, float> VulkanRenderer::textureScreenSizes() {
+	std::unordered_map<Material, float> materialScreenSizes;
+	{
+		std::lock_guard lock{ this->materialScreenSizesMutex };
+		materialScreenSizes = this->materialScreenSizes;
+	}
+
+	std::unordered_map<Texture, float> textureScreenSizes;
+	std::shared_lock lock{ this->materialMutex };
+	for (const auto& [material, screenSize] : materialScreenSizes) {
+		auto entry = this->materialTable.find(material);
+		if (entry == this->materialTable.end())
+			continue;
+
+		const MaterialTextures& t = entry->second.textures;
+		for (const Texture texture : { t.baseColor, t.metallicRoughness, t.normal, t.emissive, t.occlusion }) {
+			if (!texture.isValid())
+				continue;
+			float& textureScreenSize = textureScreenSizes[texture];
+			textureScreenSize = std::max(textureScreenSize, screenSize);
+		}
+	}
+	return textureScreenSizes;
+}
+
+void VulkanRenderer::destroyMaterial(Material material) {
+	std::unique_lock lock{ this->materialMutex };
+	this->materialTable.at(material).destroyed = true;
+	this->retiredMaterials.push_back({ this->frameCount.load(), material });
+}
+
+void VulkanRenderer::addPrimitive(std::shared_ptr<MeshPrimitive> primitive) {
+	std::lock_guard lock{ this->pendingMeshesMutex };
+	this->pendingMeshes.push_back(std::move(primitive));
+}
+
+void VulkanRenderer::removePrimitives(const std::vector<std::shared_ptr<MeshPrimitive>>& primitives) {
+	std::lock_guard lock{ this->pendingMeshesMutex };
+	this->removedMeshes.insert(this->removedMeshes.end(), primitives.begin(), primitives.end());
+}
+
+void VulkanRenderer::replaceScene(const std::vector<std::shared_ptr<Node>>& rootNodes, std::vector<std::shared_ptr<MeshPrimitive>> primitives) {
+	std::lock_guard lock{ this->pendingMeshesMutex };
+	this->pendingMeshes.clear();
+	this->removedMeshes.clear();
+	this->pendingScene = PendingScene{ rootNodes, std::move(primitives) };
+}
+
+// Called by the render loop before it starts recording a frame
+void VulkanRenderer::collectStreamedResources() {
+	const uint64_t frame = this->frameCount.load();
+
+	// freed here rather than on the next destroy call, so an unloaded scene gives its memory back right away
+	this->destroyRetiredTextures(false);
+	this->destroyRetiredBuffers(false);
+
+	std::unique_lock materialLock{ this->materialMutex };
+	// a set replaced during frame n may still be read by frames up to n, which are done once we're FRAMES_IN_FLIGHT frames past it
+	while (!this->retiredMaterialDescriptorSets.empty() && this->retiredMaterialDescriptorSets.front().first + FRAMES_IN_FLIGHT <= frame) {
+		this->device.freeDescriptorSets(this->materialDescriptorPool, this->retiredMaterialDescriptorSets.front().second);
+		this->retiredMaterialDescriptorSets.pop_front();
+	}
+	while (!this->retiredMaterials.empty() && this->retiredMaterials.front().first + FRAMES_IN_FLIGHT <= frame) {
+		const MaterialEntry& entry = this->materialTable.at(this->retiredMaterials.front().second);
+		this->device.freeDescriptorSets(this->materialDescriptorPool, entry.descriptorSet);
+		this->untrackAllocation(MemoryCategory::eBuffers, entry.uniformBufferAllocation);
+		this->allocator.destroyBuffer(entry.uniformBuffer, entry.uniformBufferAllocation);
+		this->materialTable.erase(this->retiredMaterials.front().second);
+		this->retiredMaterials.pop_front();
+	}
+
+	std::vector<std::shared_ptr<MeshPrimitive>> added;
+	std::unordered_set<const MeshPrimitive*> removed;
+	std::optional<PendingScene> scene;
+	{
+		std::lock_guard lock{ this->pendingMeshesMutex };
+		for (const auto& mesh : this->removedMeshes)
+			removed.insert(mesh.get());
+		this->removedMeshes.clear();
+		std::swap(scene, this->pendingScene);
+		if (scene)
+			this->rootNodes = std::move(scene->rootNodes);
+
+		// primitives whose buffers are still being uploaded wait for a later frame, unless they're going away anyway
+		std::shared_lock bufferLock{ this->vertexBufferMutex };
+		std::erase_if(this->pendingMeshes, [&](const std::shared_ptr<MeshPrimitive>& mesh) {
+			if (!removed.count(mesh.get()) && !this->isPrimitiveUploaded(*mesh))
+				return false;
+			added.push_back(mesh);
+			return true;
+		});
+	}
+
+	if (scene) {
+		this->opaqueMeshes.clear();
+		this->nonOpaqueMeshes.clear();
+		this->staticMeshes.clear();
+		this->dynamicMeshes.clear();
+		// the static shadow maps still hold the old scene
+		for (const auto& light : this->shadowCastingPointLights)
+			light->flags &= ~PointLightFlagBits::eStaticShadowMapRendered;
+		added.insert(added.begin(), scene->primitives.begin(), scene->primitives.end());
+	}
+
+	{
+		std::shared_lock bufferLock{ this->vertexBufferMutex };
+		for (auto& mesh : added)
+			this->addPrimitiveUploadWaits(*mesh);
+	}
+
+	for (auto& mesh : added) {
+		// alpha tested primitives are drawn with the blended ones
+		const MaterialEntry& material = this->materialTable.at(mesh->material());
+		if (material.data.alphaMode != AlphaMode::eOpaque)
+			this->nonOpaqueMeshes.push_back(mesh);
+		else
+			this->opaqueMeshes.push_back(mesh);
+
+		// static point shadow maps are only rendered once, so anything arriving later is drawn into the dynamic ones
+		this->dynamicMeshes.push_back(mesh);
+	}
+
+	if (removed.empty())
+		return;
+
+	// removals come after additions, so a primitive added and removed between two frames is never drawn
+	auto isRemoved = [&removed](const std::shared_ptr<MeshPrimitive>& mesh) { return removed.count(mesh.get()) > 0; };
+	std::erase_if(this->opaqueMeshes, isRemoved);
+	std::erase_if(this->nonOpaqueMeshes, isRemoved);
+	std::erase_if(this->staticMeshes, isRemoved);
+	std::erase_if(this->dynamicMeshes, isRemoved);
+}
@@ -0,0 +1,236 @@
+#include "VulkanRenderer.h"
+
+#include <cstring>
+#include <algorithm>
+
+namespace {
+	// keeps staged ranges aligned for any texel block size
+	constexpr size_t STAGING_ALIGNMENT = 16;
+}
+
+VulkanRenderer::UploadStream& VulkanRenderer::uploadStream(UploadQueue queue) {
+	std::lock_guard lock{ this->uploadContextsMutex };
+	std::unique_ptr<UploadContext>& context = this->uploadContexts[std::this_thread::get_id()];
+	if (!context && !this->idleUploadContexts.empty()) {
+		context = std::move(this->idleUploadContexts.back());
+		this->idleUploadContexts.pop_back();
+	}
+	if (!context) {
+		context = std::make_unique<UploadContext>();
+		const std::array<std::pair<vk::Queue, uint32_t>, 2> queues = { std::pair{ this->transferQueue, this->transferQueueFamilyIndex }, std::pair{ this->graphicsQueue, this->graphicsQueueFamilyIndex } };
+		for (size_t i = 0; i < queues.size(); i++) {
+			UploadStream& stream = context->streams[i];
+			stream.queue = queues[i].first;
+			stream.commandPool = this->device.createCommandPool(vk::CommandPoolCreateInfo{ vk::CommandPoolCreateFlagBits::eTransient, queues[i].second });
+
+			vk::SemaphoreTypeCreateInfo timelineCreateInfo{ vk::SemaphoreType::eTimeline, 0 };
+			vk::SemaphoreCreateInfo semaphoreCreateInfo{};
+			semaphoreCreateInfo.pNext = &timelineCreateInfo;
+			stream.timeline = this->device.createSemaphore(semaphoreCreateInfo);
+		}
+	}
+	// only the calling thread touches its context, the map just needs to stay consistent
+	return context->streams[static_cast<size_t>(queue)];
+}
+
+VulkanRenderer::StagingRange VulkanRenderer::stage(UploadStream& stream, const void* data, size_t size) {
+	if (size > UPLOAD_BATCH_SIZE) {
+		auto [stagingBuffer, stagingAllocation] = this->allocator.createBuffer(vk::BufferCreateInfo{ {}, size, vk::BufferUsageFlagBits::eTransferSrc, vk::SharingMode::eExclusive }, vma::AllocationCreateInfo{ vma::AllocationCreateFlagBits::eHostAccessSequentialWrite, vma::MemoryUsage::eAuto, vk::MemoryPropertyFlagBits::eHostCoherent });
+		this->trackAllocation(MemoryCategory::eBuffers, stagingAllocation);
+		std::memcpy(this->allocator.mapMemory(stagingAllocation), data, size);
+		this->allocator.unmapMemory(stagingAllocation);
+		stream.stagingBuffers.push_back({ stagingBuffer, stagingAllocation });
+		stream.stagingSize += size;
+		return StagingRange{ stagingBuffer, 0 };
+	}
+
+	if (!stream.ringBuffer) {
+		std::tie(stream.ringBuffer, stream.ringAllocation) = this->allocator.createBuffer(vk::BufferCreateInfo{ {}, STAGING_RING_SIZE, vk::BufferUsageFlagBits::eTransferSrc, vk::SharingMode::eExclusive }, vma::AllocationCreateInfo{ vma::AllocationCreateFlagBits::eHostAccessSequentialWrite, vma::MemoryUsage::eAuto, vk::MemoryPropertyFlagBits::eHostCoherent });
+		this->trackAllocation(MemoryCategory::eBuffers, stream.ringAllocation);
+		stream.ringData = reinterpret_cast<byte*>(this->allocator.mapMemory(stream.ringAllocation));
+	}
+
+	while (true) {
+		// a range that doesn't fit before the end of the ring starts over at the beginning, skipping the rest
+		size_t offset = (stream.ringHead + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+		if (offset + size > STAGING_RING_SIZE)
+			offset = 0;
+		const size_t taken = (offset >= stream.ringHead ? offset - stream.ringHead : STAGING_RING_SIZE - stream.ringHead) + size;
+
+		if (stream.ringUsed + taken <= STAGING_RING_SIZE) {
+			std::memcpy(stream.ringData + offset, data, size);
+			stream.ringHead = offset + size;
+			stream.ringUsed += taken;
+			stream.ringBatchBytes += taken;
+			stream.stagingSize += size;
+			return StagingRange{ stream.ringBuffer, offset };
+		}
+
+		// the ring is full, the oldest batch has to give its ranges back
+		if (stream.submitted.empty())
+			this->submitUploads(stream);
+		this->retireUploads(stream, stream.submitted.size() - 1);
+	}
+}
+
+vk::CommandBuffer VulkanRenderer::beginUpload(UploadStream& stream) {
+	if (!stream.commandBuffer) {
+		stream.commandBuffer = this->device.allocateCommandBuffers(vk::CommandBufferAllocateInfo{ stream.commandPool, vk::CommandBufferLevel::ePrimary, 1 })[0];
+		stream.commandBuffer.begin(vk::CommandBufferBeginInfo{ vk::CommandBufferUsageFlagBits::eOneTimeSubmit });
+	}
+	return stream.commandBuffer;
+}
+
+VulkanRenderer::UploadTicket VulkanRenderer::endUpload(UploadStream& stream) {
+	const UploadTicket ticket{ stream.timeline, stream.submittedValue + 1 };
+	if (stream.stagingSize >= UPLOAD_BATCH_SIZE)
+		this->submitUploads(stream);
+	return ticket;
+}
+
+void VulkanRenderer::submitUploads(UploadStream& stream) {
+	if (!stream.commandBuffer)
+		return;
+	MipGenerationResources mipGeneration{};
+	if (!stream.mipGenerationJobs.empty())
+		mipGeneration = this->recordMipGeneration(stream.commandBuffer, stream.mipGenerationJobs);
+	stream.commandBuffer.end();
+
+	const uint64_t value = stream.submittedValue + 1;
+	vk::TimelineSemaphoreSubmitInfo timelineSubmitInfo{ 0, nullptr, 1, &value };
+	vk::SubmitInfo submitInfo{ {}, {}, stream.commandBuffer, stream.timeline };
+	submitInfo.pNext = &timelineSubmitInfo;
+	{
+		std::lock_guard queueLock{ this->queueMutex };
+		stream.queue.submit(submitInfo);
+	}
+
+	stream.submittedValue = value;
+	stream.submitted.push_back(SubmittedUpload{ value, stream.commandBuffer, std::move(stream.stagingBuffers), stream.ringBatchBytes, std::move(mipGeneration) });
+	stream.commandBuffer = nullptr;
+	stream.stagingBuffers.clear();
+	stream.mipGenerationJobs.clear();
+	stream.stagingSize = 0;
+	stream.ringBatchBytes = 0;
+
+	// bound the staging memory held by batches in flight
+	this->retireUploads(stream, MAX_PENDING_UPLOADS);
+}
+
+void VulkanRenderer::retireUploads(UploadStream& stream, size_t maxPending) {
+	while (!stream.submitted.empty()) {
+		SubmittedUpload& upload = stream.submitted.front();
+		if (stream.submitted.size() > maxPending)
+			this->device.waitSemaphores(vk::SemaphoreWaitInfo{ {}, stream.timeline, upload.value }, UINT64_MAX);
+		else if (this->device.getSemaphoreCounterValue(stream.timeline) < upload.value)
+			break;
+
+		for (const auto& [stagingBuffer, stagingAllocation] : upload.stagingBuffers) {
+			this->untrackAllocation(MemoryCategory::eBuffers, stagingAllocation);
+			this->allocator.destroyBuffer(stagingBuffer, stagingAllocation);
+		}
+		this->destroyMipGenerationResources(upload.mipGeneration);
+		stream.ringUsed -= upload.ringBytes;
+		if (stream.ringUsed == 0)
+			stream.ringHead = 0;
+		this->device.freeCommandBuffers(stream.commandPool, upload.commandBuffer);
+		stream.submitted.pop_front();
+	}
+}
+
+void VulkanRenderer::flushUploads() {
+	this->submitUploads(this->uploadStream(UploadQueue::eTransfer));
+	this->submitUploads(this->uploadStream(UploadQueue::eGraphics));
+}
+
+void VulkanRenderer::finishUploads() {
+	for (const UploadQueue queue : { UploadQueue::eTransfer, UploadQueue::eGraphics }) {
+		UploadStream& stream = this->uploadStream(queue);
+		this->submitUploads(stream);
+		this->retireUploads(stream, 0);
+	}
+
+	// nothing is left in flight, the next thread to upload can take over the pools and rings
+	std::lock_guard lock{ this->uploadContextsMutex };
+	const auto context = this->uploadContexts.find(std::this_thread::get_id());
+	this->idleUploadContexts.push_back(std::move(context->second));
+	this->uploadContexts.erase(context);
+}
+
+bool VulkanRenderer::isUploadComplete(const UploadTicket& ticket) {
+	return !ticket.semaphore || this->device.getSemaphoreCounterValue(ticket.semaphore) >= ticket.value;
+}
+
+bool VulkanRenderer::isPrimitiveUploaded(MeshPrimitive& primitive) {
+	auto isBufferUploaded = [this](Buffer buffer) {
+		const auto ticket = this->bufferUploadTable.find(buffer);
+		return ticket == this->bufferUploadTable.end() || this->isUploadComplete(ticket->second);
+	};
+
+	for (const auto& attribute : primitive.vertexBufferDescription()) {
+		if (!isBufferUploaded(attribute.buffer))
+			return false;
+	}
+	if (primitive.isIndexed() && !isBufferUploaded(primitive.indexBufferDescription().buffer))
+		return false;
+	return !primitive.isInstanced() || isBufferUploaded(primitive.instances()->buffer);
+}
+
+void VulkanRenderer::addPrimitiveUploadWaits(MeshPrimitive& primitive) {
+	auto addWait = [this](Buffer buffer) {
+		const auto ticket = this->bufferUploadTable.find(buffer);
+		if (ticket == this->bufferUploadTable.end() || !ticket->second.semaphore)
+			return;
+		auto wait = std::find_if(this->frameUploadWaits.begin(), this->frameUploadWaits.end(), [&ticket](const auto& wait) { return wait.first == ticket->second.semaphore; });
+		if (wait == this->frameUploadWaits.end())
+			this->frameUploadWaits.push_back({ ticket->second.semaphore, ticket->second.value });
+		else
+			wait->second = std::max(wait->second, ticket->second.value);
+	};
+
+	for (const auto& attribute : primitive.vertexBufferDescription())
+		addWait(attribute.buffer);
+	if (primitive.isIndexed())
+		addWait(primitive.indexBufferDescription().buffer);
+	if (primitive.isInstanced())
+		addWait(primitive.instances()->buffer);
+}
+
+void VulkanRenderer::submitFrameCommands(vk::CommandBuffer cb, const std::vector<vk::Semaphore>& waitSemaphores, const std::vector<vk::PipelineStageFlags>& waitStages, vk::Semaphore signalSemaphore) {
+	std::vector<vk::Semaphore> semaphores = waitSemaphores;
+	std::vector<vk::PipelineStageFlags> stages = waitStages;
+	// binary semaphores ignore their value
+	std::vector<uint64_t> values(waitSemaphores.size(), 0);
+	for (const auto& [semaphore, value] : this->frameUploadWaits) {
+		semaphores.push_back(semaphore);
+		stages.push_back(vk::PipelineStageFlagBits::eVertexInput);
+		values.push_back(value);
+	}
+
+	vk::TimelineSemaphoreSubmitInfo timelineSubmitInfo{ static_cast<uint32_t>(values.size()), values.data(), 0, nullptr };
+	vk::SubmitInfo submitInfo{ semaphores, stages, cb, signalSemaphore };
+	submitInfo.pNext = &timelineSubmitInfo;
+	this->graphicsQueue.submit(submitInfo);
+}
+
+// Called once the render loop and every loading thread are done
+void VulkanRenderer::destroyUploadResources() {
+	for (auto& [thread, context] : this->uploadContexts)
+		this->idleUploadContexts.push_back(std::move(context));
+	for (const auto& context : this->idleUploadContexts) {
+		for (UploadStream& stream : context->streams) {
+			this->submitUploads(stream);
+			this->retireUploads(stream, 0);
+			if (stream.ringBuffer) {
+				this->untrackAllocation(MemoryCategory::eBuffers, stream.ringAllocation);
+				this->allocator.unmapMemory(stream.ringAllocation);
+				this->allocator.destroyBuffer(stream.ringBuffer, stream.ringAllocation);
+			}
+			this->device.destroyCommandPool(stream.commandPool);
+			this->device.destroySemaphore(stream.timeline);
+		}
+	}
+	this->uploadContexts = {};
+	this->idleUploadContexts = {};
+	this->bufferUploadTable = {};
+}
@@ -0,0 +1,222 @@
+#include "WorldPartition.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <tuple>
+#include <utility>
+
+#include <glm/common.hpp>
+#include <glm/gtx/transform.hpp>
+
+namespace {
+	constexpr size_t RANGE_ALIGNMENT = 16;
+
+	struct SourceRange {
+		uint32_t buffer;
+		size_t begin;
+		size_t end;
+		size_t packedOffset = 0;
+	};
+
+	size_t attributeRangeSize(const VertexAttributeDescription& attribute) {
+		const size_t elementSize = componentCountFromAttributeContainerType(attribute.containerType) * sizeFromAttributeValueType(attribute.valueType);
+		const size_t stride = attribute.stride > 0 ? static_cast<size_t>(attribute.stride) : elementSize;
+		return attribute.count > 0 ? (attribute.count - 1) * stride + elementSize : 0;
+	}
+
+	size_t indexRangeSize(const IndexBufferDescription& indices) {
+		return indices.count * sizeFromAttributeValueType(indices.indexType);
+	}
+
+	glm::mat4 localMatrix(const SceneNodeData& node) {
+		if (node.hasMatrix)
+			return node.matrix;
+		return glm::translate(node.translation) * glm::mat4_cast(node.rotation) * glm::scale(node.scale);
+	}
+
+	// Rest pose world matrices of the nodes reachable from the roots. Nodes reached twice keep the first path.
+	void collectWorldMatrices(const SceneData& scene, uint32_t nodeIndex, const glm::mat4& parent, std::vector<glm::mat4>& worldMatrices, std::vector<bool>& isReachable) {
+		if (isReachable[nodeIndex])
+			return;
+		isReachable[nodeIndex] = true;
+		worldMatrices[nodeIndex] = parent * localMatrix(scene.nodes[nodeIndex]);
+		for (const uint32_t child : scene.nodes[nodeIndex].children)
+			collectWorldMatrices(scene, child, worldMatrices[nodeIndex], worldMatrices, isReachable);
+	}
+
+	void growBounds(const glm::mat4& transform, const glm::vec3& bbMin, const glm::vec3& bbMax, glm::vec3& outMin, glm::vec3& outMax) {
+		for (uint32_t corner = 0; corner < 8; corner++) {
+			const glm::vec3 point{ corner & 1 ? bbMax.x : bbMin.x, corner & 2 ? bbMax.y : bbMin.y, corner & 4 ? bbMax.z : bbMin.z };
+			const glm::vec3 transformed = glm::vec3(transform * glm::vec4{ point, 1.0f });
+			outMin = glm::min(outMin, transformed);
+			outMax = glm::max(outMax, transformed);
+		}
+	}
+
+	std::pair<glm::vec3, glm::vec3> nodeBounds(const SceneData& scene, const SceneNodeData& node, const glm::mat4& worldMatrix) {
+		glm::vec3 bbMin{ std::numeric_limits<float>::max() };
+		glm::vec3 bbMax{ std::numeric_limits<float>::lowest() };
+		for (const auto& primitive : scene.meshes[node.mesh]) {
+			if (node.instances.empty())
+				growBounds(worldMatrix, glm::vec3(primitive.bbMin), glm::vec3(primitive.bbMax), bbMin, bbMax);
+			for (const glm::mat4& instance : node.instances)
+				growBounds(worldMatrix * instance, glm::vec3(primitive.bbMin), glm::vec3(primitive.bbMax), bbMin, bbMax);
+		}
+		return { bbMin, bbMax };
+	}
+}
+
+void partitionScene(SceneData& scene, float cellSize) {
+	std::vector<glm::mat4> worldMatrices(scene.nodes.size(), glm::mat4{ 1.0f });
+	std::vector<bool> isReachable(scene.nodes.size(), false);
+	for (const uint32_t root : scene.rootNodes)
+		collectWorldMatrices(scene, root, glm::mat4{ 1.0f }, worldMatrices, isReachable);
+
+	std::vector<bool> isGeometry(scene.buffers.size(), false);
+	for (const auto& primitives : scene.meshes) {
+		for (const auto& primitive : primitives) {
+			for (const auto& attribute : primitive.attributes)
+				isGeometry[static_cast<uint32_t>(attribute.buffer)] = true;
+			if (primitive.isIndexed)
+				isGeometry[static_cast<uint32_t>(primitive.indices.buffer)] = true;
+		}
+	}
+
+	std::map<std::pair<int32_t, int32_t>, uint32_t> cellIndices;
+	std::vector<SceneCellData> cells;
+	// the cell every mesh belongs to, copies made for other cells are appended to the scene's meshes
+	std::vector<int32_t> meshCells(scene.meshes.size(), -1);
+	std::map<std::pair<int32_t, uint32_t>, int32_t> meshCopies;
+
+	for (uint32_t nodeIndex = 0; nodeIndex < scene.nodes.size(); nodeIndex++) {
+		SceneNodeData& node = scene.nodes[nodeIndex];
+		if (!isReachable[nodeIndex] || node.mesh < 0 || scene.meshes[node.mesh].empty())
+			continue;
+
+		const auto [bbMin, bbMax] = nodeBounds(scene, node, worldMatrices[nodeIndex]);
+		const glm::vec3 center = (bbMin + bbMax) * 0.5f;
+		const std::pair<int32_t, int32_t> coordinate{ static_cast<int32_t>(std::floor(center.x / cellSize)), static_cast<int32_t>(std::floor(center.z / cellSize)) };
+
+		auto [cellIt, isNewCell] = cellIndices.insert({ coordinate, static_cast<uint32_t>(cells.size()) });
+		const uint32_t cellIndex = cellIt->second;
+		if (isNewCell)
+			cells.push_back(SceneCellData{ .coordinate = { coordinate.first, coordinate.second }, .bbMin = bbMin, .bbMax = bbMax });
+		SceneCellData& cell = cells[cellIndex];
+		cell.bbMin = glm::min(cell.bbMin, bbMin);
+		cell.bbMax = glm::max(cell.bbMax, bbMax);
+		cell.nodes.push_back(nodeIndex);
+
+		if (meshCells[node.mesh] < 0) {
+			meshCells[node.mesh] = static_cast<int32_t>(cellIndex);
+		}
+		else if (meshCells[node.mesh] != static_cast<int32_t>(cellIndex)) {
+			auto [copyIt, isNewCopy] = meshCopies.insert({ { node.mesh, cellIndex }, static_cast<int32_t>(scene.meshes.size()) });
+			if (isNewCopy) {
+				scene.meshes.push_back(scene.meshes[node.mesh]);
+				meshCells.push_back(static_cast<int32_t>(cellIndex));
+			}
+			node.mesh = copyIt->second;
+		}
+	}
+
+	std::vector<std::vector<uint32_t>> cellMeshes(cells.size());
+	for (uint32_t mesh = 0; mesh < scene.meshes.size(); mesh++) {
+		if (meshCells[mesh] < 0)
+			scene.meshes[mesh].clear();
+		else
+			cellMeshes[meshCells[mesh]].push_back(mesh);
+	}
+
+	const uint32_t cellBuffer = static_cast<uint32_t>(scene.buffers.size());
+	std::vector<byte> geometry;
+	for (uint32_t cellIndex = 0; cellIndex < cells.size(); cellIndex++) {
+		SceneCellData& cell = cells[cellIndex];
+
+		std::vector<SourceRange> ranges;
+		std::vector<bool> usesTexture(scene.textures.size(), false);
+		for (const uint32_t mesh : cellMeshes[cellIndex]) {
+			for (const auto& primitive : scene.meshes[mesh]) {
+				for (const auto& attribute : primitive.attributes)
+					ranges.push_back(SourceRange{ static_cast<uint32_t>(attribute.buffer), attribute.offset, attribute.offset + attributeRangeSize(attribute) });
+				if (primitive.isIndexed)
+					ranges.push_back(SourceRange{ static_cast<uint32_t>(primitive.indices.buffer), primitive.indices.offset, primitive.indices.offset + indexRangeSize(primitive.indices) });
+
+				if (primitive.material < 0)
+					continue;
+				const MaterialData& material = scene.materials[primitive.material];
+				for (const int32_t texture : { material.baseColorTexture, material.metallicRoughnessTexture, material.normalTexture, material.emissiveTexture, material.occlusionTexture }) {
+					if (texture > -1)
+						usesTexture[texture] = true;
+				}
+			}
+		}
+		for (uint32_t texture = 0; texture < usesTexture.size(); texture++) {
+			if (usesTexture[texture])
+				cell.textures.push_back(texture);
+		}
+
+		std::sort(ranges.begin(), ranges.end(), [](const SourceRange& a, const SourceRange& b) { return std::tie(a.buffer, a.begin) < std::tie(b.buffer, b.begin); });
+		std::vector<SourceRange> merged;
+		for (const auto& range : ranges) {
+			if (!merged.empty() && merged.back().buffer == range.buffer && range.begin <= merged.back().end)
+				merged.back().end = std::max(merged.back().end, range.end);
+			else
+				merged.push_back(range);
+		}
+
+		// the cell starts aligned, so ranges keep their alignment once the cell is uploaded on its own
+		cell.buffer = static_cast<int32_t>(cellBuffer);
+		cell.offset = (geometry.size() + RANGE_ALIGNMENT - 1) / RANGE_ALIGNMENT * RANGE_ALIGNMENT;
+		size_t packedSize = cell.offset;
+		for (auto& range : merged) {
+			range.packedOffset = (packedSize + RANGE_ALIGNMENT - 1) / RANGE_ALIGNMENT * RANGE_ALIGNMENT + range.begin % RANGE_ALIGNMENT;
+			packedSize = range.packedOffset + (range.end - range.begin);
+		}
+		geometry.resize(packedSize, 0);
+		for (const auto& range : merged)
+			std::memcpy(geometry.data() + range.packedOffset, scene.buffers[range.buffer].data() + range.begin, range.end - range.begin);
+		cell.size = packedSize - cell.offset;
+
+		auto packedOffset = [&merged](Buffer buffer, size_t offset) {
+			const auto range = std::upper_bound(merged.begin(), merged.end(), std::make_pair(static_cast<uint32_t>(buffer), offset), [](const std::pair<uint32_t, size_t>& key, const SourceRange& range) {
+				return key < std::make_pair(range.buffer, range.begin);
+			}) - 1;
+			return range->packedOffset + (offset - range->begin);
+		};
+
+		for (const uint32_t mesh : cellMeshes[cellIndex]) {
+			for (auto& primitive : scene.meshes[mesh]) {
+				for (auto& attribute : primitive.attributes) {
+					attribute.offset = packedOffset(attribute.buffer, attribute.offset);
+					attribute.buffer = Buffer{ cellBuffer };
+				}
+				if (primitive.isIndexed) {
+					primitive.indices.offset = packedOffset(primitive.indices.buffer, primitive.indices.offset);
+					primitive.indices.buffer = Buffer{ cellBuffer };
+				}
+			}
+		}
+	}
+
+	// buffer indices stay valid for the textures, the geometry they held moved to the cells
+	for (const auto& texture : scene.textures) {
+		if (texture.buffer > -1)
+			isGeometry[texture.buffer] = false;
+	}
+	for (size_t i = 0; i < isGeometry.size(); i++) {
+		if (isGeometry[i])
+			scene.buffers[i] = {};
+	}
+	std::erase_if(scene.ownedBuffers, [&scene](const std::vector<byte>& owned) {
+		return std::none_of(scene.buffers.begin(), scene.buffers.end(), [&owned](const std::span<const byte>& buffer) {
+			return !buffer.empty() && buffer.data() >= owned.data() && buffer.data() < owned.data() + owned.size();
+		});
+	});
+
+	scene.buffers.push_back(std::span<const byte>{ geometry });
+	scene.ownedBuffers.push_back(std::move(geometry));
+	scene.cells = std::move(cells);
+}
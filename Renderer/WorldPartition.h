@@ -0,0 +1,11 @@
+#pragma once
+
+#include "SceneData.h"
+
+// Buckets the mesh nodes of the scene into square cells of cellSize on the XZ plane, by the center of their world
+// space bounds in the rest pose, and fills SceneData::cells. The geometry of every cell is copied into one
+// contiguous range of a new buffer, so a cell is loaded with a single upload and unloaded without touching the
+// others. A mesh drawn by nodes in several cells is duplicated into each of them, meshes no node draws are emptied.
+//
+// Expects the geometry to be packed already, the buffers the primitives read from before are emptied.
+void partitionScene(SceneData& scene, float cellSize);
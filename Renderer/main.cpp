@@ -4,6 +4,15 @@
 #include <filesystem>
 #include <iostream>
 #include <set>
+#include <algorithm>
+#include <execution>
+#include <numeric>
+#include <map>
+#include <thread>
+#include <functional>
+#include <chrono>
+#include <atomic>
+#include <optional>
 
 #include <glm/glm.hpp>
 
@@ -25,260 +34,392 @@
 #include <cppitertools/imap.hpp>
 
 #include "Mesh.h"
+#include "MappedFile.h"
+#include "Ktx2.h"
+#include "AccessorView.h"
+#include "TextureImporter.h"
+#include "TextureRegistry.h"
+#include "SceneData.h"
+#include "SceneCache.h"
+#include "MeshOptimizer.h"
+#include "VertexQuantization.h"
+#include "GeometryPacking.h"
+#include "TangentGeneration.h"
+#include "VertexWelding.h"
+#include "GltfJsonReader.h"
+#include "ProcessMemory.h"
+#include "MeshoptDecoder.h"
+#include "AccessorKernels.h"
+#include "WorldPartition.h"
 
 typedef unsigned char byte;
 
 std::unique_ptr<VulkanRenderer> renderer = nullptr;
-
-template<uint32_t N> std::vector<glm::vec<N, float>> readAttribute(const tinygltf::Model& model, const tinygltf::Primitive& primitive, const char* attributeName) {
-	const auto& accessor = model.accessors[primitive.attributes.at(attributeName)];
-	const auto& bufferView = model.bufferViews[accessor.bufferView];
-	const auto& buffer = model.buffers[bufferView.buffer];
-	const byte* data = &buffer.data[bufferView.byteOffset + accessor.byteOffset];
-
-	std::vector<glm::vec<N, float>> values;
-	for (size_t i = 0; i < accessor.count; i++) {
-		const glm::vec<N, float>& p = *reinterpret_cast<const glm::vec<N, float>*>(&data[i * (bufferView.byteStride != 0 ? bufferView.byteStride : sizeof(float) * N)]);
-		values.push_back(p);
+std::unique_ptr<TextureRegistry> textureRegistry = nullptr;
+
+struct LoaderSettings {
+	bool sceneCacheEnabled = true;
+	std::string sceneCacheDirectory = "./cache";
+	// trades the zero-copy mapped read of cached buffers for smaller cache files and parallel decompression
+	bool sceneCacheCompression = false;
+	// indexes non-indexed primitives, merging vertices whose attributes are equal, or closer than weldEpsilon
+	bool weldVertices = true;
+	float weldEpsilon = 0.0f;
+	// computes MikkTSpace tangents for primitives that come without them, so normal maps work on every primitive
+	bool generateTangents = true;
+	// reorders triangles and vertices for the GPU caches and narrows indices to 16 bit where possible
+	bool optimizeMeshes = true;
+	// stores positions, normals, tangents and texture coordinates in compact integer and half formats
+	bool quantizeVertices = true;
+	// starts rendering right away and loads the scene on a separate thread, nearest primitives and textures first
+	bool streamingLoad = true;
+	// splits the scene into cells of worldCellSize on the XZ plane and only keeps the cells within worldLoadRadius of
+	// the camera resident, nearest first and up to worldGeometryBudget bytes of geometry, for scenes that don't fit
+	// in device memory. Needs streamingLoad.
+	bool worldStreaming = false;
+	float worldCellSize = 64.0f;
+	float worldLoadRadius = 192.0f;
+	// covers cell geometry only. Textures of resident cells are shared between cells and resized by the streamer, they
+	// are bounded by textureBudget instead.
+	size_t worldGeometryBudget = size_t{ 1 } << 30;
+	// uploads textures no larger than textureInitialSize and streams their larger levels in as they're seen up close,
+	// dropping levels of the least seen ones when they'd take more than textureBudget bytes
+	bool textureStreaming = true;
+	uint32_t textureInitialSize = 128;
+	size_t textureBudget = size_t{ 512 } << 20;
+	std::chrono::milliseconds textureStreamingInterval{ 100 };
+};
+
+LoaderSettings loaderSettings{};
+
+// Backing storage for the buffers of a glTF model. Buffers living in the .glb BIN chunk or in external .bin files
+// are memory mapped and their tinygltf::Buffer entries are left empty, so accessor data is only ever read from the
+// mapped pages. Data URIs are decoded into the tinygltf::Buffer and referenced in place.
+struct GltfSource {
+	std::vector<MappedFile> mappings;
+	std::vector<std::span<const byte>> buffers;
+	// bufferView index of images embedded in a buffer, -1 for images referenced by uri
+	std::vector<int> imageBufferViews;
+	// external buffer files that were mapped
+	std::vector<std::string> dependencies;
+	// bufferViews decoded from EXT_meshopt_compression, referenced by buffers appended after the file's own
+	std::vector<std::vector<byte>> decodedBuffers;
+};
+
+constexpr uint32_t GLB_MAGIC = 0x46546C67; // "glTF"
+constexpr uint32_t GLB_CHUNK_TYPE_JSON = 0x4E4F534A;
+constexpr uint32_t GLB_CHUNK_TYPE_BIN = 0x004E4942;
+
+std::string decodeUri(const std::string& uri) {
+	std::string decoded;
+	decoded.reserve(uri.size());
+	for (size_t i = 0; i < uri.size(); i++) {
+		if (uri[i] == '%' && i + 2 < uri.size() && std::isxdigit(static_cast<unsigned char>(uri[i + 1])) && std::isxdigit(static_cast<unsigned char>(uri[i + 2]))) {
+			decoded.push_back(static_cast<char>(std::stoi(uri.substr(i + 1, 2), nullptr, 16)));
+			i += 2;
+		}
+		else
+			decoded.push_back(uri[i]);
 	}
-	return values;
+	return decoded;
 }
 
-TextureInfo loadTexture(const char* path) {
-	int w, h, n;
-	float* d = stbi_loadf(path, &w, &h, &n, 4);
-	size_t len = sizeof(float) * w * h * 4;
-
-	std::vector<byte> data;
-	data.resize(len);
-	memcpy(data.data(), d, len);
-
-	stbi_image_free(d);
-
-	return TextureInfo{ data, static_cast<uint32_t>(w), static_cast<uint32_t>(h) };
+MeshoptMode meshoptModeFromString(const std::string& mode) {
+	if (mode == "ATTRIBUTES")
+		return MeshoptMode::eAttributes;
+	if (mode == "TRIANGLES")
+		return MeshoptMode::eTriangles;
+	if (mode == "INDICES")
+		return MeshoptMode::eIndices;
+	throw std::runtime_error("Unknown EXT_meshopt_compression mode " + mode);
 }
 
-std::vector<MeshPrimitive> makeMesh(tinygltf::Mesh gltfMesh, std::shared_ptr<Node> node, tinygltf::Model gltfModel, const std::string& gltfFilename) {
-	auto path = std::filesystem::path(gltfFilename).remove_filename();
+MeshoptFilter meshoptFilterFromString(const std::string& filter) {
+	if (filter == "NONE")
+		return MeshoptFilter::eNone;
+	if (filter == "OCTAHEDRAL")
+		return MeshoptFilter::eOctahedral;
+	if (filter == "QUATERNION")
+		return MeshoptFilter::eQuaternion;
+	if (filter == "EXPONENTIAL")
+		return MeshoptFilter::eExponential;
+	throw std::runtime_error("Unknown EXT_meshopt_compression filter " + filter);
+}
 
-	std::vector<MeshPrimitive> loadedMeshes;
-	for (auto& primitive : gltfMesh.primitives) {
-		MeshPrimitive loadedMesh{};
-		bool meshHasTangents = false;
+// Decodes the bufferViews compressed with EXT_meshopt_compression into one new buffer and points the views at it, so
+// accessors, the scene cache and the uploads all see plain data. Views are decoded in parallel.
+void decodeMeshoptBufferViews(tinygltf::Model& gltfModel, GltfSource& source) {
+	struct CompressedView {
+		int bufferView;
+		std::span<const byte> encoded;
+		size_t count;
+		size_t stride;
+		MeshoptMode mode;
+		MeshoptFilter filter;
+		size_t decodedOffset;
+	};
 
-		loadedMesh.node = node;
+	std::vector<CompressedView> views;
+	size_t decodedSize = 0;
+	for (int i = 0; i < static_cast<int>(gltfModel.bufferViews.size()); i++) {
+		const auto extension = gltfModel.bufferViews[i].extensions.find("EXT_meshopt_compression");
+		if (extension == gltfModel.bufferViews[i].extensions.end())
+			continue;
+
+		const tinygltf::Value& value = extension->second;
+		auto number = [&value](const char* name) { return value.Has(name) ? static_cast<size_t>(value.Get(name).GetNumberAsDouble()) : size_t{ 0 }; };
+
+		const size_t buffer = number("buffer");
+		const size_t offset = number("byteOffset");
+		const size_t length = number("byteLength");
+		if (buffer >= source.buffers.size() || offset + length > source.buffers[buffer].size())
+			throw std::runtime_error("EXT_meshopt_compression bufferView " + std::to_string(i) + " is out of its buffer's bounds");
+
+		CompressedView& view = views.emplace_back(CompressedView{
+			.bufferView = i,
+			.encoded = source.buffers[buffer].subspan(offset, length),
+			.count = number("count"),
+			.stride = number("byteStride"),
+			.mode = meshoptModeFromString(value.Get("mode").Get<std::string>()),
+			.filter = value.Has("filter") ? meshoptFilterFromString(value.Get("filter").Get<std::string>()) : MeshoptFilter::eNone,
+			});
+		// keep every view 16 byte aligned like the other vertex data we hand to the renderer
+		view.decodedOffset = (decodedSize + 15) & ~size_t{ 15 };
+		decodedSize = view.decodedOffset + view.count * view.stride;
+	}
 
-		std::vector<glm::vec3> positions = readAttribute<3>(gltfModel, primitive, "POSITION");
-		loadedMesh.vertices.reserve(positions.size());
-		for (glm::vec3& p : positions)
-			loadedMesh.vertices.push_back(Vertex{ p });
+	if (views.empty())
+		return;
 
-		if (primitive.attributes.count("NORMAL")) {
-			std::vector<glm::vec3> normals = readAttribute<3>(gltfModel, primitive, "NORMAL");
-			for (size_t i = 0; i < loadedMesh.vertices.size(); i++)
-				loadedMesh.vertices[i].normal = normals[i];
+	std::vector<byte>& decoded = source.decodedBuffers.emplace_back(decodedSize);
+	// exceptions can't leave a parallel algorithm, collect them and rethrow the first
+	std::vector<std::exception_ptr> errors(views.size());
+	std::for_each(std::execution::par, views.begin(), views.end(), [&](const CompressedView& view) {
+		try {
+			decodeMeshoptBufferView(std::span{ decoded }.subspan(view.decodedOffset, view.count * view.stride), view.encoded, view.count, view.stride, view.mode, view.filter);
 		}
-
-		if (primitive.attributes.count("TEXCOORD_0")) {
-			std::vector<glm::vec2> uvs = readAttribute<2>(gltfModel, primitive, "TEXCOORD_0");
-			for (size_t i = 0; i < loadedMesh.vertices.size(); i++)
-				loadedMesh.vertices[i].uv = uvs[i];
+		catch (...) {
+			errors[&view - views.data()] = std::current_exception();
 		}
+	});
+	for (const auto& error : errors) {
+		if (error)
+			std::rethrow_exception(error);
+	}
 
-		if (primitive.attributes.count("TANGENT")) {
-			meshHasTangents = true;
-			std::vector<glm::vec4> tangents = readAttribute<4>(gltfModel, primitive, "TANGENT");
-			for (size_t i = 0; i < loadedMesh.vertices.size(); i++) {
-				loadedMesh.vertices[i].tangent = glm::vec3{ tangents[i].x, tangents[i].y, tangents[i].z };
-				loadedMesh.vertices[i].bitangent = glm::cross(loadedMesh.vertices[i].normal, loadedMesh.vertices[i].tangent) * tangents[i].w;
-			}
+	const int decodedBuffer = static_cast<int>(gltfModel.buffers.size());
+	gltfModel.buffers.emplace_back();
+	source.buffers.push_back(std::span<const byte>{ decoded });
+
+	for (const auto& view : views) {
+		tinygltf::BufferView& bufferView = gltfModel.bufferViews[view.bufferView];
+		bufferView.buffer = decodedBuffer;
+		bufferView.byteOffset = view.decodedOffset;
+		bufferView.byteLength = view.count * view.stride;
+		bufferView.extensions.erase("EXT_meshopt_compression");
+	}
+}
+
+GltfSource loadGltfSource(const std::string& filename, tinygltf::Model& gltfModel) {
+	GltfSource source{};
+	const auto baseDir = std::filesystem::path(filename).parent_path();
+
+	MappedFile file{ filename };
+	std::span<const byte> jsonChunk = file.span();
+	std::span<const byte> binChunk{};
+
+	uint32_t magic = 0;
+	if (file.size() >= 12)
+		std::memcpy(&magic, file.data(), sizeof(uint32_t));
+
+	if (magic == GLB_MAGIC) {
+		uint32_t header[3];
+		std::memcpy(header, file.data(), sizeof(header));
+		if (header[1] != 2)
+			throw std::runtime_error("Unsupported GLB container version in " + filename);
+
+		const size_t length = std::min<size_t>(header[2], file.size());
+		jsonChunk = {};
+		for (size_t offset = sizeof(header); offset + 8 <= length;) {
+			uint32_t chunkHeader[2];
+			std::memcpy(chunkHeader, file.data() + offset, sizeof(chunkHeader));
+			offset += sizeof(chunkHeader);
+			if (offset + chunkHeader[0] > length)
+				throw std::runtime_error("Truncated GLB chunk in " + filename);
+
+			if (chunkHeader[1] == GLB_CHUNK_TYPE_JSON && jsonChunk.empty())
+				jsonChunk = file.span().subspan(offset, chunkHeader[0]);
+			else if (chunkHeader[1] == GLB_CHUNK_TYPE_BIN && binChunk.empty())
+				binChunk = file.span().subspan(offset, chunkHeader[0]);
+			offset += chunkHeader[0];
 		}
+	}
 
-		if (primitive.indices > -1) {
-			loadedMesh.isIndexed = true;
-
-			const auto& indicesAccessor = gltfModel.accessors[primitive.indices];
-			const auto& indicesBufferView = gltfModel.bufferViews[indicesAccessor.bufferView];
-			const auto& indicesBuffer = gltfModel.buffers[indicesBufferView.buffer];
-
-			loadedMesh.indices.reserve(indicesAccessor.count);
-			for (size_t i = 0; i < indicesAccessor.count; i++) {
-				uint32_t index;
-				const byte* p = &indicesBuffer.data[indicesBufferView.byteOffset + indicesAccessor.byteOffset];
-				switch (indicesAccessor.componentType) {
-				case TINYGLTF_COMPONENT_TYPE_BYTE:
-					index = reinterpret_cast<const int8_t*>(p)[i];
-					break;
-				case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
-					index = reinterpret_cast<const uint8_t*>(p)[i];
-					break;
-				case TINYGLTF_COMPONENT_TYPE_SHORT:
-					index = reinterpret_cast<const int16_t*>(p)[i];
-					break;
-				case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
-					index = reinterpret_cast<const uint16_t*>(p)[i];
-					break;
-				case TINYGLTF_COMPONENT_TYPE_INT:
-					index = reinterpret_cast<const int32_t*>(p)[i];
-					break;
-				case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
-					index = reinterpret_cast<const uint32_t*>(p)[i];
-					break;
-				}
-				loadedMesh.indices.push_back(index);
-			}
+	const auto parseStart = std::chrono::steady_clock::now();
+	std::vector<size_t> bufferByteLengths;
+	readGltfJson(jsonChunk, gltfModel, bufferByteLengths);
+	const auto parseTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - parseStart).count();
+	std::cout << "Read " << filename << " manifest in " << parseTime << " ms, peak resident memory " << peakResidentMemory() / (1 << 20) << " MiB" << std::endl;
+
+	source.buffers.resize(gltfModel.buffers.size());
+	for (size_t i = 0; i < gltfModel.buffers.size(); i++) {
+		tinygltf::Buffer& buffer = gltfModel.buffers[i];
+		const size_t byteLength = bufferByteLengths[i];
+
+		// EXT_meshopt_compression fallback buffers have no data, every view into them is decoded from another buffer
+		const auto meshopt = buffer.extensions.find("EXT_meshopt_compression");
+		if (meshopt != buffer.extensions.end() && meshopt->second.Has("fallback") && meshopt->second.Get("fallback").Get<bool>())
+			continue;
+
+		if (buffer.uri.empty()) {
+			if (binChunk.size() < byteLength)
+				throw std::runtime_error("GLB BIN chunk is smaller than its buffer in " + filename);
+			source.buffers[i] = binChunk.first(byteLength);
+		}
+		else if (buffer.uri.rfind("data:", 0) == 0) {
+			buffer.data = decodeDataUri(buffer.uri);
+			if (buffer.data.size() < byteLength)
+				throw std::runtime_error("Data URI is shorter than its buffer's byteLength in " + filename);
+			source.buffers[i] = std::span<const byte>{ buffer.data }.first(byteLength);
 		}
 		else {
-			loadedMesh.isIndexed = false;
+			const auto binPath = std::filesystem::absolute(baseDir / decodeUri(buffer.uri)).string();
+			MappedFile bin{ binPath };
+			if (bin.size() < byteLength)
+				throw std::runtime_error("Buffer file is smaller than its byteLength in " + filename);
+			source.buffers[i] = bin.span().first(byteLength);
+			source.mappings.push_back(std::move(bin));
+			source.dependencies.push_back(binPath);
 		}
+	}
 
-		if (primitive.material > -1) {
-			tinygltf::Material& material = gltfModel.materials[primitive.material];
-			if (material.pbrMetallicRoughness.baseColorTexture.index != -1) {
-				loadedMesh.albedoTexture = Texture((path / gltfModel.images[gltfModel.textures[material.pbrMetallicRoughness.baseColorTexture.index].source].uri).string(), vk::Format::eR8G8B8A8Srgb);
-			}
-
-			if (material.pbrMetallicRoughness.metallicRoughnessTexture.index != -1) {
-				loadedMesh.metalRoughnessTexture = Texture((path / gltfModel.images[gltfModel.textures[material.pbrMetallicRoughness.metallicRoughnessTexture.index].source].uri).string());
-			}
-
-			if (material.normalTexture.index != -1) {
-				loadedMesh.normalTexture = Texture((path / gltfModel.images[gltfModel.textures[material.normalTexture.index].source].uri).string());
-			}
-			else {
-				loadedMesh.normalTexture = Texture("./textures/clear_normal.png");
-			}
-
-			if (material.emissiveTexture.index != -1) {
-				loadedMesh.emissiveTexture = Texture((path / gltfModel.images[gltfModel.textures[material.emissiveTexture.index].source].uri).string());
-			}
+	source.imageBufferViews.reserve(gltfModel.images.size());
+	for (const auto& image : gltfModel.images)
+		source.imageBufferViews.push_back(image.uri.empty() ? image.bufferView : -1);
 
-			if (material.occlusionTexture.index != -1) {
-				loadedMesh.aoTexture = Texture((path / gltfModel.images[gltfModel.textures[material.occlusionTexture.index].source].uri).string());
-			}
+	decodeMeshoptBufferViews(gltfModel, source);
 
-			auto& bcf = material.pbrMetallicRoughness.baseColorFactor;
-			auto& ef = material.emissiveFactor;
-			loadedMesh.materialInfo = PBRInfo{ glm::vec4{bcf[0], bcf[1], bcf[2], bcf[3]}, glm::vec4{ef[0], ef[1], ef[2], 0.0f}, static_cast<float>(material.normalTexture.scale), static_cast<float>(material.pbrMetallicRoughness.metallicFactor), static_cast<float>(material.pbrMetallicRoughness.roughnessFactor), static_cast<float>(material.occlusionTexture.strength) };
+	if (!binChunk.empty())
+		source.mappings.push_back(std::move(file));
 
-			loadedMesh.alphaInfo.alphaMode = material.alphaMode == "MASK" ? AlphaMode::eMask : material.alphaMode == "BLEND" ? AlphaMode::eBlend : AlphaMode::eOpaque;
-			loadedMesh.alphaInfo.alphaCutoff = static_cast<float>(material.alphaCutoff);
-		}
-
-		if (!meshHasTangents)
-			loadedMesh.calculateTangents();
+	return source;
+}
 
-		loadedMesh.calculateBarycenter();
-		loadedMesh.calculateBoundingBox();
-		loadedMeshes.push_back(loadedMesh);
-	}
+const byte* accessorData(const tinygltf::Model& model, const GltfSource& source, const tinygltf::Accessor& accessor) {
+	const auto& bufferView = model.bufferViews[accessor.bufferView];
+	return source.buffers[bufferView.buffer].data() + bufferView.byteOffset + accessor.byteOffset;
+}
 
-	return loadedMeshes;
+template<typename T> AccessorView<T> readAccessor(const tinygltf::Model& model, const GltfSource& source, const int accessorIndex) {
+	const auto& accessor = model.accessors[accessorIndex];
+	const auto& bufferView = model.bufferViews[accessor.bufferView];
+	return AccessorView<T>{ accessorData(model, source, accessor), accessor.count, bufferView.byteStride };
 }
 
-std::tuple<std::shared_ptr<Node>, std::vector<MeshPrimitive>> makeNode(const int nodeIndex, const tinygltf::Model& gltfModel, const std::string& gltfFilename) {
+bool hasAttribute(const ScenePrimitiveData& primitive, const std::string& attributeName) {
+	return std::any_of(primitive.attributes.begin(), primitive.attributes.end(), [&](const VertexAttributeDescription& attribute) { return attribute.attributeName == attributeName; });
+}
 
-	auto& gltfNode = gltfModel.nodes[nodeIndex];
+TextureInfo loadTexture(const char* path) {
+	int w, h, n;
+	float* d = stbi_loadf(path, &w, &h, &n, 4);
+	size_t len = sizeof(float) * w * h * 4;
 
-	std::vector<MeshPrimitive> meshes{};
-	std::vector<std::shared_ptr<Node>> children{};
-	for (auto& childIndex : gltfNode.children) {
-		auto&& [childNode, childMeshes] = makeNode(childIndex, gltfModel, gltfFilename);
-		children.push_back(childNode);
-		for (auto& mesh : childMeshes) {
-			meshes.emplace_back(mesh);
-		}
-	}
+	std::vector<byte> data;
+	data.resize(len);
+	memcpy(data.data(), d, len);
 
-	std::shared_ptr<Node> node;
+	stbi_image_free(d);
 
-	if (!gltfNode.matrix.empty()) {
-		auto& m = gltfNode.matrix;
-		glm::mat4 modelMatrix{ m[0], m[1], m[2], m[3], m[4], m[5], m[6], m[7], m[8], m[9] ,m[10], m[11], m[12], m[13], m[14], m[15] };
+	return TextureInfo{ data, static_cast<uint32_t>(w), static_cast<uint32_t>(h) };
+}
 
-		node = std::make_shared<Node>(modelMatrix, children);
+// A single primitive of a node's mesh, queued by makeNode and decoded by decodePrimitives
+struct PrimitiveWorkItem {
+	std::shared_ptr<Node> node;
+	uint32_t nodeIndex;
+	int meshIndex;
+	int primitiveIndex;
+};
+
+// Points the primitive's attributes and indices at the uploaded copies of the scene buffers, like streamScene does
+// with its batches
+std::shared_ptr<MeshPrimitive> makePrimitive(const ScenePrimitiveData& scenePrimitive, const std::vector<Buffer>& loadedBuffers) {
+	if (!hasAttribute(scenePrimitive, "POSITION"))
+		throw std::runtime_error("Primitive has no POSITION attribute");
+
+	std::vector<VertexAttributeDescription> attributeDescriptions = scenePrimitive.attributes;
+	for (auto& attributeDescription : attributeDescriptions)
+		attributeDescription.buffer = loadedBuffers[static_cast<uint32_t>(attributeDescription.buffer)];
+
+	if (scenePrimitive.isIndexed) {
+		IndexBufferDescription indexBufferDescription = scenePrimitive.indices;
+		indexBufferDescription.buffer = loadedBuffers[static_cast<uint32_t>(indexBufferDescription.buffer)];
+		return std::make_shared<MeshPrimitive>(std::move(attributeDescriptions), std::move(indexBufferDescription), scenePrimitive.bbMin, scenePrimitive.bbMax, scenePrimitive.mode);
 	}
-	else {
-		glm::vec3 translation{ 0.0f }, rotation{ 0.0f }, scale{ 1.0f };
+	return std::make_shared<MeshPrimitive>(std::move(attributeDescriptions), scenePrimitive.bbMin, scenePrimitive.bbMax, scenePrimitive.mode);
+}
 
-		if (!gltfNode.translation.empty()) {
-			translation = glm::vec3{ gltfNode.translation[0], gltfNode.translation[1], gltfNode.translation[2] };
-		}
-		if (!gltfNode.rotation.empty()) {
-			rotation = glm::vec3{ gltfNode.rotation[0], gltfNode.rotation[1], gltfNode.rotation[2] };
+// Builds every queued primitive on the parallel algorithms thread pool. Each item writes only its own slot of the
+// result, so the returned order is the work list order no matter how the items were scheduled.
+std::vector<std::shared_ptr<MeshPrimitive>> decodePrimitives(const std::vector<PrimitiveWorkItem>& work, const SceneData& scene, const std::vector<Buffer>& loadedBuffers, const std::vector<Material>& materials, const Material defaultMaterial, const std::vector<std::shared_ptr<const MeshInstances>>& nodeInstances) {
+	std::vector<size_t> indices(work.size());
+	std::iota(indices.begin(), indices.end(), size_t{ 0 });
+
+	std::vector<std::shared_ptr<MeshPrimitive>> decoded(work.size());
+	// exceptions can't leave a parallel algorithm, collect them and rethrow the first
+	std::vector<std::exception_ptr> errors(work.size());
+	std::for_each(std::execution::par, indices.begin(), indices.end(), [&](const size_t i) {
+		try {
+			const PrimitiveWorkItem& item = work[i];
+			const ScenePrimitiveData& scenePrimitive = scene.meshes[item.meshIndex][item.primitiveIndex];
+			decoded[i] = makePrimitive(scenePrimitive, loadedBuffers);
+			decoded[i]->setNode(item.node);
+			decoded[i]->setInstances(nodeInstances[item.nodeIndex]);
+			decoded[i]->setMaterial(scenePrimitive.material > -1 ? materials[scenePrimitive.material] : defaultMaterial);
 		}
-		if (!gltfNode.scale.empty()) {
-			scale = glm::vec3{ gltfNode.scale[0], gltfNode.scale[1], gltfNode.scale[2] };
-		}
-
-		node = std::make_shared<Node>(translation, rotation, scale, children);
-	}
-
-
-	if (gltfNode.mesh > -1) {
-		for (auto& mesh : makeMesh(gltfModel.meshes[gltfNode.mesh], node, gltfModel, gltfFilename)) {
-			meshes.push_back(mesh);
+		catch (...) {
+			errors[i] = std::current_exception();
 		}
+	});
+	for (const auto& error : errors) {
+		if (error)
+			std::rethrow_exception(error);
 	}
 
-	for (auto& gltfAnimation : gltfModel.animations) {
-		for (auto& channel : gltfAnimation.channels) {
-			if (channel.target_node != nodeIndex)
-				continue;
-
-			auto& sampler = gltfAnimation.samplers[channel.sampler];
-
-			AnimationInterpolationCurve interpolationCurve =
-				sampler.interpolation == "CUBICSPLINE" ? AnimationInterpolationCurve::eCubicSpline :
-				sampler.interpolation == "STEP" ? AnimationInterpolationCurve::eStep :
-				AnimationInterpolationCurve::eLinear;
-			
-			const auto& keyframesAccessor = gltfModel.accessors[sampler.input];
-			const auto& keyframesBufferView = gltfModel.bufferViews[keyframesAccessor.bufferView];
-			const auto& keyframesBuffer = gltfModel.buffers[keyframesBufferView.buffer];
-			const byte* keyframesBufferData = &keyframesBuffer.data[keyframesBufferView.byteOffset + keyframesAccessor.byteOffset];
-
-			std::vector<float> keyframes;
-			for (size_t i = 0; i < keyframesAccessor.count; i++) {
-				auto& p = *reinterpret_cast<const float*>(&keyframesBufferData[i * (keyframesBufferView.byteStride != 0 ? keyframesBufferView.byteStride : sizeof(float))]);
-				keyframes.push_back(p);
-			}
+	return decoded;
+}
 
-			if (channel.target_path == "translation" || channel.target_path == "scale") {
-				const auto& valuesAccessor = gltfModel.accessors[sampler.output];
-				const auto& valuesBufferView = gltfModel.bufferViews[valuesAccessor.bufferView];
-				const auto& valuesBuffer = gltfModel.buffers[valuesBufferView.buffer];
-				const byte* valuesBufferData = &valuesBuffer.data[valuesBufferView.byteOffset + valuesAccessor.byteOffset];
+// Builds the node hierarchy and queues the node's primitives after its children's, the same order meshes were
+// returned in when they were decoded inline.
+std::shared_ptr<Node> makeNode(const uint32_t nodeIndex, const SceneData& scene, std::vector<PrimitiveWorkItem>& primitiveWork) {
+	const SceneNodeData& nodeData = scene.nodes[nodeIndex];
 
-				std::vector<glm::vec3> values;
-				for (size_t i = 0; i < keyframesAccessor.count; i++) {
-					auto& p = *reinterpret_cast<const glm::vec3*>(&valuesBufferData[i * (valuesBufferView.byteStride != 0 ? valuesBufferView.byteStride : sizeof(glm::vec3))]);
-					values.push_back(p);
-				}
-
-				if (channel.target_path == "translation")
-					node->setTranslationAnimation(Animation<glm::vec3>{keyframes, values, interpolationCurve, AnimationRepeatMode::eMirror});
-				else if(channel.target_path == "scale")
-					node->setScaleAnimation(Animation<glm::vec3>{keyframes, values, interpolationCurve, AnimationRepeatMode::eMirror});
-			}
-			else if (channel.target_path == "rotation") {
-				const auto& valuesAccessor = gltfModel.accessors[sampler.output];
-				const auto& valuesBufferView = gltfModel.bufferViews[valuesAccessor.bufferView];
-				const auto& valuesBuffer = gltfModel.buffers[valuesBufferView.buffer];
-				const byte* valuesBufferData = &valuesBuffer.data[valuesBufferView.byteOffset + valuesAccessor.byteOffset];
-
-				std::vector<glm::quat> values;
-				for (size_t i = 0; i < keyframesAccessor.count; i++) {
-					auto& p = *reinterpret_cast<const glm::quat*>(&valuesBufferData[i * (valuesBufferView.byteStride != 0 ? valuesBufferView.byteStride : sizeof(glm::quat))]);
-					values.push_back(p);
-				}
+	std::vector<std::shared_ptr<Node>> children{};
+	for (auto& childIndex : nodeData.children) {
+		children.push_back(makeNode(childIndex, scene, primitiveWork));
+	}
 
-				node->setRotationAnimation(Animation<glm::quat>{keyframes, values, interpolationCurve, AnimationRepeatMode::eMirror});
-			}
+	std::shared_ptr<Node> node;
+	if (nodeData.hasMatrix)
+		node = std::make_shared<Node>(nodeData.matrix, children);
+	else
+		node = std::make_shared<Node>(nodeData.translation, nodeData.rotation, nodeData.scale, children);
+
+	if (nodeData.mesh > -1) {
+		for (int i = 0; i < static_cast<int>(scene.meshes[nodeData.mesh].size()); i++) {
+			primitiveWork.push_back(PrimitiveWorkItem{ node, nodeIndex, nodeData.mesh, i });
 		}
 	}
 
-	return { node, meshes };
+	if (nodeData.translationAnimation)
+		node->setTranslationAnimation(Animation<glm::vec3>{nodeData.translationAnimation->keyframeTimes, nodeData.translationAnimation->keyframes, nodeData.translationAnimation->interpolation, AnimationRepeatMode::eMirror});
+	if (nodeData.rotationAnimation)
+		node->setRotationAnimation(Animation<glm::quat>{nodeData.rotationAnimation->keyframeTimes, nodeData.rotationAnimation->keyframes, nodeData.rotationAnimation->interpolation, AnimationRepeatMode::eMirror});
+	if (nodeData.scaleAnimation)
+		node->setScaleAnimation(Animation<glm::vec3>{nodeData.scaleAnimation->keyframeTimes, nodeData.scaleAnimation->keyframes, nodeData.scaleAnimation->interpolation, AnimationRepeatMode::eMirror});
+
+	return node;
 }
 
 constexpr AttributeValueType attributeValueTypeFromGltfComponentType(const int gltfType) {
@@ -338,50 +479,237 @@ constexpr MeshPrimitiveMode primitiveModeFromGltfMode(const int gltfMode) {
 	}
 }
 
-void openGltf(const std::string& filename) {
-	tinygltf::TinyGLTF gltfLoader;
-	tinygltf::Model gltfModel;
-	gltfLoader.LoadASCIIFromFile(&gltfModel, nullptr, nullptr, filename);
+Sampler samplerFromGltfSampler(const tinygltf::Sampler& gltfSampler) {
+	const auto wrapFromGltfWrap = [](const int gltfWrap) {
+		switch (gltfWrap) {
+		case TINYGLTF_TEXTURE_WRAP_CLAMP_TO_EDGE:
+			return SamplerWrap::eClampToEdge;
+		case TINYGLTF_TEXTURE_WRAP_MIRRORED_REPEAT:
+			return SamplerWrap::eMirror;
+		default:
+			return SamplerWrap::eRepeat;
+		}
+	};
 
-	std::vector<MeshPrimitive> loadedMeshes{};
-	std::vector<std::shared_ptr<Node>> rootNodes;
-	tinygltf::Scene& scene = gltfModel.scenes[gltfModel.defaultScene];
+	Sampler sampler{};
+	sampler.magFilter = gltfSampler.magFilter == TINYGLTF_TEXTURE_FILTER_NEAREST ? SamplerFilter::eNearest : SamplerFilter::eLinear;
+	sampler.minFilter = gltfSampler.minFilter == TINYGLTF_TEXTURE_FILTER_NEAREST || gltfSampler.minFilter == TINYGLTF_TEXTURE_FILTER_NEAREST_MIPMAP_NEAREST || gltfSampler.minFilter == TINYGLTF_TEXTURE_FILTER_NEAREST_MIPMAP_LINEAR ? SamplerFilter::eNearest : SamplerFilter::eLinear;
+	sampler.mipmapFilter = gltfSampler.minFilter == TINYGLTF_TEXTURE_FILTER_NEAREST_MIPMAP_NEAREST || gltfSampler.minFilter == TINYGLTF_TEXTURE_FILTER_LINEAR_MIPMAP_NEAREST ? SamplerFilter::eNearest : SamplerFilter::eLinear;
+	sampler.wrapU = wrapFromGltfWrap(gltfSampler.wrapS);
+	sampler.wrapV = wrapFromGltfWrap(gltfSampler.wrapT);
+	return sampler;
+}
 
-	std::vector<Buffer> loadedBuffers;
-	loadedBuffers.reserve(gltfModel.buffers.size());
+// Animation channels grouped by the node they target, built in one pass over every animation. Sampler accessors are
+// decoded the first time a channel needs them and shared by every other channel or sampler reading the same accessor.
+struct GltfAnimationIndex {
+	// per node, the (animation, channel) pairs targeting it
+	std::vector<std::vector<std::pair<int, int>>> channels;
+	std::unordered_map<int, std::shared_ptr<const std::vector<float>>> keyframeTimes;
+	std::unordered_map<int, std::shared_ptr<const std::vector<glm::vec3>>> vec3Values;
+	std::unordered_map<int, std::shared_ptr<const std::vector<glm::quat>>> quatValues;
+
+	explicit GltfAnimationIndex(const tinygltf::Model& gltfModel) : channels(gltfModel.nodes.size()) {
+		for (int i = 0; i < static_cast<int>(gltfModel.animations.size()); i++) {
+			const auto& gltfAnimation = gltfModel.animations[i];
+			for (int j = 0; j < static_cast<int>(gltfAnimation.channels.size()); j++) {
+				const int targetNode = gltfAnimation.channels[j].target_node;
+				if (targetNode > -1 && targetNode < static_cast<int>(this->channels.size()))
+					this->channels[targetNode].emplace_back(i, j);
+			}
+		}
+	}
 
-	for (const auto& gltfBuffer : gltfModel.buffers) {
-		loadedBuffers.push_back(renderer->loadBuffer(reinterpret_cast<const void*>(gltfBuffer.data.data()), gltfBuffer.data.size()));
+	template<typename T> std::shared_ptr<const std::vector<T>> decode(std::unordered_map<int, std::shared_ptr<const std::vector<T>>>& decoded, const tinygltf::Model& gltfModel, const GltfSource& source, int accessor) {
+		auto [entry, inserted] = decoded.try_emplace(accessor);
+		if (inserted) {
+			AccessorView<T> view = readAccessor<T>(gltfModel, source, accessor);
+			std::vector<T> values;
+			values.reserve(view.size());
+			for (size_t i = 0; i < view.size(); i++)
+				values.push_back(view[i]);
+			entry->second = std::make_shared<const std::vector<T>>(std::move(values));
+		}
+		return entry->second;
 	}
+};
+
+// Reads an accessor of up to four components as floats, undoing normalization. Missing components are 0, w is 1.
+std::vector<glm::vec4> decodeAccessor(const tinygltf::Model& gltfModel, const GltfSource& source, const int accessorIndex) {
+	const auto& accessor = gltfModel.accessors[accessorIndex];
+	const size_t stride = static_cast<size_t>(accessor.ByteStride(gltfModel.bufferViews[accessor.bufferView]));
+	const size_t componentCount = componentCountFromAttributeContainerType(attributeContainerTypeFromGltfType(accessor.type));
+
+	std::vector<glm::vec4> values(accessor.count, glm::vec4{ 0.0f, 0.0f, 0.0f, 1.0f });
+	selectAttributeGatherKernel(attributeValueTypeFromGltfComponentType(accessor.componentType))(accessorData(gltfModel, source, accessor), stride, accessor.count, componentCount, accessor.normalized, values.data());
+	return values;
+}
+
+// Instance transforms of EXT_mesh_gpu_instancing, empty if the node doesn't use it
+std::vector<glm::mat4> makeNodeInstances(const tinygltf::Node& gltfNode, const tinygltf::Model& gltfModel, const GltfSource& source) {
+	const auto extension = gltfNode.extensions.find("EXT_mesh_gpu_instancing");
+	if (extension == gltfNode.extensions.end() || !extension->second.Has("attributes"))
+		return {};
+
+	const tinygltf::Value& attributes = extension->second.Get("attributes");
+	auto attribute = [&](const char* name) {
+		return attributes.Has(name) ? decodeAccessor(gltfModel, source, attributes.Get(name).GetNumberAsInt()) : std::vector<glm::vec4>{};
+	};
+	const std::vector<glm::vec4> translations = attribute("TRANSLATION");
+	const std::vector<glm::vec4> rotations = attribute("ROTATION");
+	const std::vector<glm::vec4> scales = attribute("SCALE");
+
+	// the extension requires equal counts, the longest attribute wins if they aren't
+	const size_t count = std::max({ translations.size(), rotations.size(), scales.size() });
+	std::vector<glm::mat4> instances(count);
+	for (size_t i = 0; i < count; i++) {
+		const glm::vec3 translation = i < translations.size() ? glm::vec3(translations[i]) : glm::vec3{ 0.0f };
+		const glm::quat rotation = i < rotations.size() ? glm::quat{ rotations[i].w, rotations[i].x, rotations[i].y, rotations[i].z } : glm::quat{ 1.0f, 0.0f, 0.0f, 0.0f };
+		const glm::vec3 scale = i < scales.size() ? glm::vec3(scales[i]) : glm::vec3{ 1.0f };
+		instances[i] = glm::translate(translation) * glm::mat4_cast(glm::normalize(rotation)) * glm::scale(scale);
+	}
+	return instances;
+}
+
+SceneNodeData makeNodeData(const int nodeIndex, const tinygltf::Model& gltfModel, const GltfSource& source, GltfAnimationIndex& animations) {
+	auto& gltfNode = gltfModel.nodes[nodeIndex];
+
+	SceneNodeData nodeData{};
+	nodeData.mesh = gltfNode.mesh;
+	nodeData.children.assign(gltfNode.children.begin(), gltfNode.children.end());
+	nodeData.instances = makeNodeInstances(gltfNode, gltfModel, source);
+
+	if (!gltfNode.matrix.empty()) {
+		auto& m = gltfNode.matrix;
+		nodeData.hasMatrix = true;
+		nodeData.matrix = glm::mat4{ m[0], m[1], m[2], m[3], m[4], m[5], m[6], m[7], m[8], m[9] ,m[10], m[11], m[12], m[13], m[14], m[15] };
+	}
+	else {
+		if (!gltfNode.translation.empty()) {
+			nodeData.translation = glm::vec3{ gltfNode.translation[0], gltfNode.translation[1], gltfNode.translation[2] };
+		}
+		if (!gltfNode.rotation.empty()) {
+			nodeData.rotation = glm::quat{ static_cast<float>(gltfNode.rotation[3]), static_cast<float>(gltfNode.rotation[0]), static_cast<float>(gltfNode.rotation[1]), static_cast<float>(gltfNode.rotation[2]) };
+		}
+		if (!gltfNode.scale.empty()) {
+			nodeData.scale = glm::vec3{ gltfNode.scale[0], gltfNode.scale[1], gltfNode.scale[2] };
+		}
+	}
+
+	for (const auto& [animationIndex, channelIndex] : animations.channels[nodeIndex]) {
+		const auto& gltfAnimation = gltfModel.animations[animationIndex];
+		const auto& channel = gltfAnimation.channels[channelIndex];
+		const auto& sampler = gltfAnimation.samplers[channel.sampler];
+
+		AnimationInterpolationCurve interpolationCurve =
+			sampler.interpolation == "CUBICSPLINE" ? AnimationInterpolationCurve::eCubicSpline :
+			sampler.interpolation == "STEP" ? AnimationInterpolationCurve::eStep :
+			AnimationInterpolationCurve::eLinear;
+
+		const auto keyframes = animations.decode(animations.keyframeTimes, gltfModel, source, sampler.input);
+
+		if (channel.target_path == "translation" || channel.target_path == "scale") {
+			AnimationData<glm::vec3> animation{ keyframes, animations.decode(animations.vec3Values, gltfModel, source, sampler.output), interpolationCurve };
+
+			if (channel.target_path == "translation")
+				nodeData.translationAnimation = std::move(animation);
+			else
+				nodeData.scaleAnimation = std::move(animation);
+		}
+		else if (channel.target_path == "rotation") {
+			nodeData.rotationAnimation = AnimationData<glm::quat>{ keyframes, animations.decode(animations.quatValues, gltfModel, source, sampler.output), interpolationCurve };
+		}
+	}
+
+	return nodeData;
+}
+
+// Textures using KHR_texture_basisu point to a KTX2 image through the extension, which takes precedence over
+// the fallback image in source as long as it can be uploaded without transcoding
+int textureImageSource(const tinygltf::Model& gltfModel, const GltfSource& source, const std::filesystem::path& path, const tinygltf::Texture& gltfTexture) {
+	const auto basisu = gltfTexture.extensions.find("KHR_texture_basisu");
+	if (basisu == gltfTexture.extensions.end() || !basisu->second.Has("source"))
+		return gltfTexture.source;
+
+	const int imageIndex = basisu->second.Get("source").GetNumberAsInt();
+	if (gltfTexture.source == -1)
+		return imageIndex;
+
+	const int bufferViewIndex = source.imageBufferViews[imageIndex];
+	if (bufferViewIndex > -1) {
+		const auto& bufferView = gltfModel.bufferViews[bufferViewIndex];
+		if (isKtx2Uploadable(source.buffers[bufferView.buffer].subspan(bufferView.byteOffset, bufferView.byteLength)))
+			return imageIndex;
+		return gltfTexture.source;
+	}
+
+	try {
+		if (isKtx2Uploadable(MappedFile{ (path / decodeUri(gltfModel.images[imageIndex].uri)).string() }.span()))
+			return imageIndex;
+	}
+	catch (const std::exception&) {
+		// the fallback image loads instead
+	}
+	return gltfTexture.source;
+}
+
+MaterialData makeMaterialData(const tinygltf::Material& material) {
+	auto& bcf = material.pbrMetallicRoughness.baseColorFactor;
+	auto& ef = material.emissiveFactor;
+
+	MaterialData materialData{};
+	materialData.baseColorFactor = glm::vec4{ bcf[0], bcf[1], bcf[2], bcf[3] };
+	materialData.emissiveFactor = glm::vec3{ ef[0], ef[1], ef[2] };
+	materialData.normalScale = static_cast<float>(material.normalTexture.scale);
+	materialData.metallicFactor = static_cast<float>(material.pbrMetallicRoughness.metallicFactor);
+	materialData.roughnessFactor = static_cast<float>(material.pbrMetallicRoughness.roughnessFactor);
+	materialData.occlusionStrength = static_cast<float>(material.occlusionTexture.strength);
+	materialData.alphaMode = material.alphaMode == "MASK" ? AlphaMode::eMask : material.alphaMode == "BLEND" ? AlphaMode::eBlend : AlphaMode::eOpaque;
+	materialData.alphaCutoff = static_cast<float>(material.alphaCutoff);
+
+	materialData.baseColorTexture = material.pbrMetallicRoughness.baseColorTexture.index;
+	materialData.metallicRoughnessTexture = material.pbrMetallicRoughness.metallicRoughnessTexture.index;
+	materialData.normalTexture = material.normalTexture.index;
+	materialData.emissiveTexture = material.emissiveTexture.index;
+	materialData.occlusionTexture = material.occlusionTexture.index;
+	return materialData;
+}
 
-	std::vector<Mesh> meshes;
-	meshes.reserve(gltfModel.meshes.size());
+// Converts a glTF file into SceneData. Buffer descriptions reference buffers by their glTF index.
+SceneData loadGltfScene(const std::string& filename) {
+	tinygltf::Model gltfModel;
+	GltfSource source = loadGltfSource(filename, gltfModel);
+	const auto path = std::filesystem::path(filename).remove_filename();
+
+	SceneData scene{};
 
+	scene.meshes.reserve(gltfModel.meshes.size());
 	for (const auto& gltfMesh : gltfModel.meshes) {
-		std::vector<MeshPrimitive> primitives;
+		std::vector<ScenePrimitiveData>& primitives = scene.meshes.emplace_back();
 		primitives.reserve(gltfMesh.primitives.size());
 		for (const auto& gltfPrimitive : gltfMesh.primitives) {
-			std::vector<VertexAttributeDescription> attributeDescriptions;
-
-			glm::vec<3, double> bbMin{}, bbMax{};
+			ScenePrimitiveData& primitive = primitives.emplace_back();
+			primitive.mode = primitiveModeFromGltfMode(gltfPrimitive.mode);
+			primitive.material = gltfPrimitive.material;
 
 			for (const auto& [attributeName, accessorIndex] : gltfPrimitive.attributes) {
 				const auto& gltfAccessor = gltfModel.accessors[accessorIndex];
 				const auto& gltfBufferView = gltfModel.bufferViews[gltfAccessor.bufferView];
 
-				attributeDescriptions.emplace_back(VertexAttributeDescription{
+				primitive.attributes.emplace_back(VertexAttributeDescription{
 					.attributeName = attributeName,
-					.buffer = loadedBuffers[gltfBufferView.buffer],
+					.buffer = Buffer{ static_cast<uint32_t>(gltfBufferView.buffer) },
 					.offset = gltfBufferView.byteOffset + gltfAccessor.byteOffset,
 					.stride = gltfAccessor.ByteStride(gltfBufferView),
 					.count = gltfAccessor.count,
 					.containerType = attributeContainerTypeFromGltfType(gltfAccessor.type),
 					.valueType = attributeValueTypeFromGltfComponentType(gltfAccessor.componentType),
+					.normalized = gltfAccessor.normalized,
 					});
 				
 				if (attributeName == "POSITION") {
-					bbMin = glm::vec<3, double>(gltfAccessor.minValues[0], gltfAccessor.minValues[1], gltfAccessor.minValues[2]);
-					bbMax = glm::vec<3, double>(gltfAccessor.maxValues[0], gltfAccessor.maxValues[1], gltfAccessor.maxValues[2]);
+					primitive.bbMin = glm::vec<3, double>(gltfAccessor.minValues[0], gltfAccessor.minValues[1], gltfAccessor.minValues[2]);
+					primitive.bbMax = glm::vec<3, double>(gltfAccessor.maxValues[0], gltfAccessor.maxValues[1], gltfAccessor.maxValues[2]);
 				}
 			}
 
@@ -389,32 +717,646 @@ void openGltf(const std::string& filename) {
 				const auto& gltfAccessor = gltfModel.accessors[gltfPrimitive.indices];
 				const auto& gltfBufferView = gltfModel.bufferViews[gltfAccessor.bufferView];
 
-				IndexBufferDescription indexBufferDescription{
-					.buffer = loadedBuffers[gltfBufferView.buffer],
+				primitive.isIndexed = true;
+				primitive.indices = IndexBufferDescription{
+					.buffer = Buffer{ static_cast<uint32_t>(gltfBufferView.buffer) },
 					.offset = gltfBufferView.byteOffset + gltfAccessor.byteOffset,
 					.stride = gltfAccessor.ByteStride(gltfBufferView),
 					.count = gltfAccessor.count,
 					.indexType = attributeValueTypeFromGltfComponentType(gltfAccessor.componentType),
 				};
+			}
+		}
+	}
+
+	GltfAnimationIndex animations{ gltfModel };
+	scene.nodes.reserve(gltfModel.nodes.size());
+	for (int i = 0; i < static_cast<int>(gltfModel.nodes.size()); i++) {
+		scene.nodes.push_back(makeNodeData(i, gltfModel, source, animations));
+	}
+	const tinygltf::Scene& gltfScene = gltfModel.scenes[gltfModel.defaultScene > -1 ? gltfModel.defaultScene : 0];
+	scene.rootNodes.assign(gltfScene.nodes.begin(), gltfScene.nodes.end());
+
+	scene.materials.reserve(gltfModel.materials.size());
+	for (const auto& material : gltfModel.materials) {
+		scene.materials.push_back(makeMaterialData(material));
+	}
+
+	// base color textures are sampled as sRGB, everything else is linear data
+	std::vector<bool> isSrgb(gltfModel.textures.size(), false);
+	std::vector<float> alphaCutoffs(gltfModel.textures.size(), 0.0f);
+	for (const auto& material : scene.materials) {
+		if (material.baseColorTexture != -1) {
+			isSrgb[material.baseColorTexture] = true;
+			if (material.alphaMode == AlphaMode::eMask)
+				alphaCutoffs[material.baseColorTexture] = material.alphaCutoff;
+		}
+	}
+
+	scene.textures.reserve(gltfModel.textures.size());
+	for (size_t i = 0; i < gltfModel.textures.size(); i++) {
+		const auto& gltfTexture = gltfModel.textures[i];
+		SceneTextureData& texture = scene.textures.emplace_back();
+		texture.format = isSrgb[i] ? ImageFormat::eR8G8B8A8Srgb : ImageFormat::eR8G8B8A8Unorm;
+		texture.alphaCutoff = alphaCutoffs[i];
+		if (gltfTexture.sampler > -1)
+			texture.sampler = samplerFromGltfSampler(gltfModel.samplers[gltfTexture.sampler]);
+
+		const int imageIndex = textureImageSource(gltfModel, source, path, gltfTexture);
+		const int bufferViewIndex = source.imageBufferViews[imageIndex];
+		if (bufferViewIndex > -1) {
+			const auto& bufferView = gltfModel.bufferViews[bufferViewIndex];
+			texture.buffer = bufferView.buffer;
+			texture.offset = bufferView.byteOffset;
+			texture.size = bufferView.byteLength;
+		}
+		else
+			texture.path = (path / decodeUri(gltfModel.images[imageIndex].uri)).string();
+	}
+
+	// data URI buffers live in the tinygltf model, take them over before it goes away
+	scene.buffers = source.buffers;
+	for (size_t i = 0; i < scene.buffers.size(); i++) {
+		if (scene.buffers[i].data() == gltfModel.buffers[i].data.data())
+			scene.ownedBuffers.push_back(std::move(gltfModel.buffers[i].data));
+	}
+	for (auto& decoded : source.decodedBuffers)
+		scene.ownedBuffers.push_back(std::move(decoded));
+	scene.mappings = std::move(source.mappings);
+	scene.dependencies = std::move(source.dependencies);
+
+	return scene;
+}
+
+TextureImportRequest makeTextureImportRequest(const SceneData& scene, const SceneTextureData& texture) {
+	TextureImportRequest request{};
+	request.format = texture.format;
+	request.sampler = texture.sampler;
+	request.alphaCutoff = texture.alphaCutoff;
+	if (texture.buffer > -1)
+		request.data = scene.buffers[texture.buffer].subspan(texture.offset, texture.size);
+	else
+		request.path = texture.path;
+	return request;
+}
+
+// Imports every texture of the scene, in scene order
+std::vector<Texture> importTextures(const SceneData& scene) {
+	std::vector<TextureImportRequest> requests;
+	requests.reserve(scene.textures.size());
+	for (const auto& texture : scene.textures)
+		requests.push_back(makeTextureImportRequest(scene, texture));
+
+	return textureRegistry->acquire(requests);
+}
+
+// Uploads the instance transforms of every instanced node, null for the others
+std::vector<std::shared_ptr<const MeshInstances>> loadNodeInstances(const SceneData& scene) {
+	std::vector<std::shared_ptr<const MeshInstances>> nodeInstances(scene.nodes.size());
+	for (size_t i = 0; i < scene.nodes.size(); i++) {
+		const std::vector<glm::mat4>& transforms = scene.nodes[i].instances;
+		if (!transforms.empty())
+			nodeInstances[i] = std::make_shared<const MeshInstances>(MeshInstances{ transforms, renderer->loadBuffer(transforms.data(), transforms.size() * sizeof(glm::mat4)) });
+	}
+	return nodeInstances;
+}
+
+// Streamed geometry is uploaded in batches of about this size, so nearby primitives show up together without
+// waiting on one upload of the whole scene
+constexpr size_t STREAMING_BATCH_SIZE = 4 << 20;
+
+// Scene texture indices of the material, in MaterialTextures order
+std::array<int32_t, 5> materialTextureIndices(const MaterialData& material) {
+	return { material.baseColorTexture, material.metallicRoughnessTexture, material.normalTexture, material.emissiveTexture, material.occlusionTexture };
+}
+
+MaterialTextures materialTextures(const MaterialData& material, const std::vector<Texture>& textures) {
+	auto texture = [&textures](int32_t index) { return index > -1 ? textures[index] : Texture{}; };
+	return MaterialTextures{ texture(material.baseColorTexture), texture(material.metallicRoughnessTexture), texture(material.normalTexture), texture(material.emissiveTexture), texture(material.occlusionTexture) };
+}
+
+// The materials sampling each scene texture
+std::vector<std::vector<size_t>> textureMaterialIndices(const SceneData& scene) {
+	std::vector<std::vector<size_t>> textureMaterials(scene.textures.size());
+	for (size_t m = 0; m < scene.materials.size(); m++) {
+		for (const int32_t t : materialTextureIndices(scene.materials[m])) {
+			if (t > -1)
+				textureMaterials[t].push_back(m);
+		}
+	}
+	return textureMaterials;
+}
 
-				primitives.emplace_back(std::move(attributeDescriptions), std::move(indexBufferDescription), bbMin, bbMax, primitiveModeFromGltfMode(gltfPrimitive.mode));
+// Everything a streamed scene put on the renderer, given back when another scene replaces it
+struct SceneResources {
+	std::vector<std::shared_ptr<Node>> rootNodes;
+	std::vector<std::shared_ptr<MeshPrimitive>> primitives;
+	std::vector<Buffer> buffers;
+	std::vector<Material> materials;
+	std::vector<Texture> textures;
+};
+
+// The scene being drawn, only touched by the loader thread
+SceneResources activeScene{};
+
+// Hands the scene to the running renderer a piece at a time: the node hierarchy and the materials with placeholder
+// textures first, then the primitives and finally the textures, both ordered by distance to the viewpoint.
+// Only the byte ranges primitives actually reference are uploaded, and ranges shared by several primitives once.
+// What gets loaded is recorded in resources. In the background, nothing is handed to the renderer, the caller swaps
+// the scene in with replaceScene once everything is resident.
+void streamScene(const SceneData& scene, const glm::vec3& viewpoint, SceneResources& resources, bool isBackground = false) {
+	std::vector<PrimitiveWorkItem> primitiveWork{};
+	for (auto& nodeIndex : scene.rootNodes) {
+		resources.rootNodes.push_back(makeNode(nodeIndex, scene, primitiveWork));
+	}
+	if (!isBackground)
+		renderer->setRootNodes(resources.rootNodes);
+	const std::vector<std::shared_ptr<const MeshInstances>> nodeInstances = loadNodeInstances(scene);
+	for (const auto& instances : nodeInstances) {
+		if (instances)
+			resources.buffers.push_back(instances->buffer);
+	}
+
+	std::vector<Material> materials;
+	materials.reserve(scene.materials.size());
+	for (const auto& material : scene.materials)
+		materials.push_back(renderer->makeMaterial(material, MaterialTextures{}));
+	const Material defaultMaterial = renderer->makeMaterial(MaterialData{}, MaterialTextures{});
+	resources.materials = materials;
+	resources.materials.push_back(defaultMaterial);
+
+	std::vector<float> primitiveDistances(primitiveWork.size());
+	for (size_t i = 0; i < primitiveWork.size(); i++) {
+		const PrimitiveWorkItem& item = primitiveWork[i];
+		const ScenePrimitiveData& primitive = scene.meshes[item.meshIndex][item.primitiveIndex];
+		const glm::vec3 center = glm::vec3((primitive.bbMin + primitive.bbMax) * 0.5);
+		primitiveDistances[i] = glm::distance(glm::vec3(item.node->modelMatrix() * glm::vec4{ center, 1.0f }), viewpoint);
+	}
+	std::vector<size_t> primitiveOrder(primitiveWork.size());
+	std::iota(primitiveOrder.begin(), primitiveOrder.end(), size_t{ 0 });
+	std::stable_sort(primitiveOrder.begin(), primitiveOrder.end(), [&primitiveDistances](size_t a, size_t b) { return primitiveDistances[a] < primitiveDistances[b]; });
+
+	auto attributeRangeSize = [](const VertexAttributeDescription& attribute) {
+		const size_t elementSize = componentCountFromAttributeContainerType(attribute.containerType) * sizeFromAttributeValueType(attribute.valueType);
+		const size_t stride = attribute.stride > 0 ? static_cast<size_t>(attribute.stride) : elementSize;
+		return attribute.count > 0 ? (attribute.count - 1) * stride + elementSize : 0;
+	};
+
+	// the source ranges primitives read, overlapping ones merged per buffer like packSceneGeometry does, so the
+	// attributes of an interleaved bufferView are staged once. Ranges that only touch stay apart, so primitives
+	// packed next to each other still go out with their own batches.
+	struct SourceRange {
+		uint32_t buffer;
+		size_t begin;
+		size_t end;
+	};
+	std::vector<SourceRange> sourceRanges;
+	for (const PrimitiveWorkItem& item : primitiveWork) {
+		const ScenePrimitiveData& scenePrimitive = scene.meshes[item.meshIndex][item.primitiveIndex];
+		for (const auto& attribute : scenePrimitive.attributes)
+			sourceRanges.push_back(SourceRange{ static_cast<uint32_t>(attribute.buffer), attribute.offset, attribute.offset + attributeRangeSize(attribute) });
+		if (scenePrimitive.isIndexed)
+			sourceRanges.push_back(SourceRange{ static_cast<uint32_t>(scenePrimitive.indices.buffer), scenePrimitive.indices.offset, scenePrimitive.indices.offset + scenePrimitive.indices.count * sizeFromAttributeValueType(scenePrimitive.indices.indexType) });
+	}
+	std::sort(sourceRanges.begin(), sourceRanges.end(), [](const SourceRange& a, const SourceRange& b) { return std::tie(a.buffer, a.begin) < std::tie(b.buffer, b.begin); });
+	std::vector<SourceRange> mergedRanges;
+	for (const auto& range : sourceRanges) {
+		if (!mergedRanges.empty() && mergedRanges.back().buffer == range.buffer && range.begin < mergedRanges.back().end)
+			mergedRanges.back().end = std::max(mergedRanges.back().end, range.end);
+		else
+			mergedRanges.push_back(range);
+	}
+	auto findRange = [&mergedRanges](Buffer buffer, size_t offset) {
+		const auto range = std::upper_bound(mergedRanges.begin(), mergedRanges.end(), std::make_pair(static_cast<uint32_t>(buffer), offset), [](const std::pair<uint32_t, size_t>& key, const SourceRange& range) {
+			return key < std::make_pair(range.buffer, range.begin);
+		}) - 1;
+		return static_cast<size_t>(range - mergedRanges.begin());
+	};
+
+	// where a merged range ended up: the index of the batch it was uploaded with and its offset in that batch
+	std::vector<std::optional<std::pair<size_t, size_t>>> uploadedRanges(mergedRanges.size());
+	std::vector<Buffer> batchBuffers;
+	std::vector<byte> batch;
+	std::vector<size_t> batchPrimitives;
+
+	auto stageRange = [&](Buffer sourceBuffer, size_t offset) {
+		const size_t r = findRange(sourceBuffer, offset);
+		if (uploadedRanges[r])
+			return;
+
+		// lands at the offset modulo 16 it had in its source, so its attributes keep whatever alignment they had
+		const SourceRange& range = mergedRanges[r];
+		const size_t batchOffset = ((batch.size() + 15) & ~size_t{ 15 }) + range.begin % 16;
+		batch.resize(batchOffset + (range.end - range.begin));
+		std::memcpy(batch.data() + batchOffset, scene.buffers[range.buffer].data() + range.begin, range.end - range.begin);
+		uploadedRanges[r] = std::pair{ batchBuffers.size(), batchOffset };
+	};
+
+	// the batch buffer and offset a source offset was uploaded to
+	auto uploadedLocation = [&](Buffer sourceBuffer, size_t offset) {
+		const size_t r = findRange(sourceBuffer, offset);
+		const auto& [batchIndex, batchOffset] = *uploadedRanges[r];
+		return std::pair{ batchBuffers[batchIndex], batchOffset + (offset - mergedRanges[r].begin) };
+	};
+
+	auto flushBatch = [&]() {
+		if (batchPrimitives.empty())
+			return;
+
+		batchBuffers.push_back(renderer->loadBuffer(batch.data(), batch.size()));
+		resources.buffers.push_back(batchBuffers.back());
+
+		for (const size_t i : batchPrimitives) {
+			const PrimitiveWorkItem& item = primitiveWork[i];
+			const ScenePrimitiveData& scenePrimitive = scene.meshes[item.meshIndex][item.primitiveIndex];
+
+			std::vector<VertexAttributeDescription> attributeDescriptions = scenePrimitive.attributes;
+			for (auto& attributeDescription : attributeDescriptions)
+				std::tie(attributeDescription.buffer, attributeDescription.offset) = uploadedLocation(attributeDescription.buffer, attributeDescription.offset);
+
+			std::shared_ptr<MeshPrimitive> primitive;
+			if (scenePrimitive.isIndexed) {
+				IndexBufferDescription indexBufferDescription = scenePrimitive.indices;
+				std::tie(indexBufferDescription.buffer, indexBufferDescription.offset) = uploadedLocation(indexBufferDescription.buffer, indexBufferDescription.offset);
+
+				primitive = std::make_shared<MeshPrimitive>(std::move(attributeDescriptions), std::move(indexBufferDescription), scenePrimitive.bbMin, scenePrimitive.bbMax, scenePrimitive.mode);
 			}
 			else {
-				primitives.emplace_back(std::move(attributeDescriptions), bbMin, bbMax, primitiveModeFromGltfMode(gltfPrimitive.mode));
+				primitive = std::make_shared<MeshPrimitive>(std::move(attributeDescriptions), scenePrimitive.bbMin, scenePrimitive.bbMax, scenePrimitive.mode);
 			}
+			primitive->setNode(item.node);
+			primitive->setInstances(nodeInstances[item.nodeIndex]);
+			primitive->setMaterial(scenePrimitive.material > -1 ? materials[scenePrimitive.material] : defaultMaterial);
+			if (!isBackground)
+				renderer->addPrimitive(primitive);
+			resources.primitives.push_back(std::move(primitive));
 		}
-		meshes.emplace_back(std::move(primitives), std::make_shared<Node>());
+		// the renderer holds the primitives back until the batch has landed, without the loader waiting on it
+		renderer->flushUploads();
+
+		batch.clear();
+		batchPrimitives.clear();
+	};
+
+	for (const size_t i : primitiveOrder) {
+		const PrimitiveWorkItem& item = primitiveWork[i];
+		const ScenePrimitiveData& scenePrimitive = scene.meshes[item.meshIndex][item.primitiveIndex];
+
+		for (const auto& attribute : scenePrimitive.attributes)
+			stageRange(attribute.buffer, attribute.offset);
+		if (scenePrimitive.isIndexed)
+			stageRange(scenePrimitive.indices.buffer, scenePrimitive.indices.offset);
+
+		batchPrimitives.push_back(i);
+		if (batch.size() >= STREAMING_BATCH_SIZE)
+			flushBatch();
 	}
-	
-	for (auto& gltfNode : scene.nodes) {
-		auto [childNode, childMeshes] = makeNode(gltfNode, gltfModel, filename);
-		rootNodes.push_back(childNode);
-		for (auto& mesh : childMeshes) {
-			loadedMeshes.emplace_back(mesh);
+	flushBatch();
+
+	// a texture is as urgent as the nearest primitive sampling it, unused ones come last
+	std::vector<float> textureDistances(scene.textures.size(), std::numeric_limits<float>::infinity());
+	const std::vector<std::vector<size_t>> textureMaterials = textureMaterialIndices(scene);
+	for (size_t i = 0; i < primitiveWork.size(); i++) {
+		const PrimitiveWorkItem& item = primitiveWork[i];
+		const int32_t material = scene.meshes[item.meshIndex][item.primitiveIndex].material;
+		if (material < 0)
+			continue;
+		for (const int32_t t : materialTextureIndices(scene.materials[material])) {
+			if (t > -1)
+				textureDistances[t] = std::min(textureDistances[t], primitiveDistances[i]);
+		}
+	}
+	std::vector<size_t> textureOrder(scene.textures.size());
+	std::iota(textureOrder.begin(), textureOrder.end(), size_t{ 0 });
+	std::stable_sort(textureOrder.begin(), textureOrder.end(), [&textureDistances](size_t a, size_t b) { return textureDistances[a] < textureDistances[b]; });
+
+	std::vector<TextureImportRequest> requests;
+	requests.reserve(textureOrder.size());
+	for (const size_t t : textureOrder)
+		requests.push_back(makeTextureImportRequest(scene, scene.textures[t]));
+
+	std::vector<Texture> textures(scene.textures.size());
+	resources.textures = textureRegistry->acquire(requests, [&](size_t requestIndex, Texture texture) {
+		const size_t t = textureOrder[requestIndex];
+		textures[t] = texture;
+		for (const size_t m : textureMaterials[t])
+			renderer->updateMaterialTextures(materials[m], materialTextures(scene.materials[m], textures));
+	});
+}
+
+// Uploads the whole scene before handing it to the renderer, for when streaming is off. Primitives are built the way
+// streamScene builds them, on the parallel algorithms thread pool and added in work list order. What gets loaded is
+// recorded in resources.
+void instantiateScene(const SceneData& scene, SceneResources& resources) {
+	// after packSceneGeometry primitives only read the packed buffers, the ones only holding images stay on the CPU side
+	std::vector<bool> isGeometry(scene.buffers.size(), false);
+	for (const auto& scenePrimitives : scene.meshes) {
+		for (const auto& scenePrimitive : scenePrimitives) {
+			for (const auto& attribute : scenePrimitive.attributes)
+				isGeometry[static_cast<uint32_t>(attribute.buffer)] = true;
+			if (scenePrimitive.isIndexed)
+				isGeometry[static_cast<uint32_t>(scenePrimitive.indices.buffer)] = true;
+		}
+	}
+
+	std::vector<Buffer> loadedBuffers;
+	loadedBuffers.reserve(scene.buffers.size());
+
+	for (size_t i = 0; i < scene.buffers.size(); i++) {
+		if (!isGeometry[i] || scene.buffers[i].empty()) {
+			loadedBuffers.push_back(Buffer{});
+			continue;
 		}
+		loadedBuffers.push_back(renderer->loadBuffer(reinterpret_cast<const void*>(scene.buffers[i].data()), scene.buffers[i].size()));
+		resources.buffers.push_back(loadedBuffers.back());
+	}
+
+	std::vector<PrimitiveWorkItem> primitiveWork{};
+	for (auto& nodeIndex : scene.rootNodes) {
+		resources.rootNodes.push_back(makeNode(nodeIndex, scene, primitiveWork));
+	}
+	const std::vector<std::shared_ptr<const MeshInstances>> nodeInstances = loadNodeInstances(scene);
+	for (const auto& instances : nodeInstances) {
+		if (instances)
+			resources.buffers.push_back(instances->buffer);
+	}
+
+	resources.textures = importTextures(scene);
+	std::vector<Material> materials;
+	materials.reserve(scene.materials.size());
+	for (const auto& material : scene.materials)
+		materials.push_back(renderer->makeMaterial(material, materialTextures(material, resources.textures)));
+	const Material defaultMaterial = renderer->makeMaterial(MaterialData{}, MaterialTextures{});
+	resources.materials = materials;
+	resources.materials.push_back(defaultMaterial);
+
+	resources.primitives = decodePrimitives(primitiveWork, scene, loadedBuffers, materials, defaultMaterial, nodeInstances);
+	renderer->finishUploads();
+	renderer->setRootNodes(resources.rootNodes);
+	for (const auto& primitive : resources.primitives)
+		renderer->addPrimitive(primitive);
+}
+
+void releaseSceneResources(const SceneResources& resources) {
+	for (const Buffer buffer : resources.buffers)
+		renderer->destroyBuffer(buffer);
+	for (const Material material : resources.materials)
+		renderer->destroyMaterial(material);
+	for (const Texture texture : resources.textures)
+		textureRegistry->release(texture);
+}
+
+// Loads another scene while the active one keeps being drawn, swaps it in between two frames once it is fully
+// resident and gives back what the old one held, which the renderer destroys after its frames in flight. Runs on the
+// loader thread once the previous load returned.
+void switchScene(const std::string& filename, const glm::vec3& viewpoint) {
+	SceneResources resources{};
+	try {
+		openGltf(filename, [&](const SceneData& scene) { streamScene(scene, viewpoint, resources, true); });
+	}
+	catch (const std::exception&) {
+		releaseSceneResources(resources);
+		throw;
+	}
+
+	renderer->finishUploads();
+	renderer->replaceScene(resources.rootNodes, resources.primitives);
+	releaseSceneResources(activeScene);
+	activeScene = std::move(resources);
+}
+
+// How often streamWorld looks at the viewpoint when it has nothing to load or unload
+constexpr auto WORLD_STREAMING_INTERVAL = std::chrono::milliseconds(50);
+// cells are unloaded this far past the load radius, so moving along its edge doesn't load and unload the same cells
+constexpr float WORLD_UNLOAD_SLACK = 1.25f;
+
+// What a resident cell put on the renderer, given back when it is unloaded
+struct LoadedCell {
+	Buffer geometry;
+	std::vector<Buffer> instanceBuffers;
+	std::vector<std::shared_ptr<MeshPrimitive>> primitives;
+	std::vector<Texture> textures;
+};
+
+// Keeps the cells of a partitioned scene near the viewpoint resident until stop is set. Cells within the load radius
+// are loaded nearest first while their geometry fits the budget, making room by unloading resident cells farther
+// away, and cells that fall out of the radius are unloaded. One cell is loaded per pass so the order follows the
+// camera, and the render loop keeps drawing whatever is resident meanwhile. The node hierarchy and the materials
+// are small and stay resident, cells bring in the geometry and textures of their nodes.
+void streamWorld(const SceneData& scene, const std::atomic<glm::vec3>& viewpoint, const std::atomic<bool>& stop) {
+	std::vector<std::shared_ptr<Node>> rootNodes;
+	std::vector<PrimitiveWorkItem> primitiveWork{};
+	for (auto& nodeIndex : scene.rootNodes) {
+		rootNodes.push_back(makeNode(nodeIndex, scene, primitiveWork));
 	}
 	renderer->setRootNodes(rootNodes);
-	renderer->setMeshes(loadedMeshes);
+
+	std::vector<std::shared_ptr<Node>> nodes(scene.nodes.size());
+	for (const auto& item : primitiveWork)
+		nodes[item.nodeIndex] = item.node;
+
+	std::vector<Material> materials;
+	materials.reserve(scene.materials.size());
+	for (const auto& material : scene.materials)
+		materials.push_back(renderer->makeMaterial(material, MaterialTextures{}));
+	const Material defaultMaterial = renderer->makeMaterial(MaterialData{}, MaterialTextures{});
+
+	const std::vector<std::vector<size_t>> textureMaterials = textureMaterialIndices(scene);
+	std::vector<Texture> textures(scene.textures.size());
+	// resident cells sampling each texture
+	std::vector<uint32_t> textureUsers(scene.textures.size(), 0);
+
+	std::vector<std::optional<LoadedCell>> loadedCells(scene.cells.size());
+	// geometry bytes of the resident cells. An unloaded cell's buffers are freed by the render loop once no frame in
+	// flight reads them, a couple of frames after it leaves this count.
+	size_t residentSize = 0;
+
+	auto loadCell = [&](size_t cellIndex) {
+		const SceneCellData& cellData = scene.cells[cellIndex];
+		LoadedCell cell{};
+		cell.geometry = renderer->loadBuffer(scene.buffers[cellData.buffer].data() + cellData.offset, cellData.size);
+
+		for (const uint32_t nodeIndex : cellData.nodes) {
+			const SceneNodeData& nodeData = scene.nodes[nodeIndex];
+			std::shared_ptr<const MeshInstances> instances{};
+			if (!nodeData.instances.empty()) {
+				instances = std::make_shared<const MeshInstances>(MeshInstances{ nodeData.instances, renderer->loadBuffer(nodeData.instances.data(), nodeData.instances.size() * sizeof(glm::mat4)) });
+				cell.instanceBuffers.push_back(instances->buffer);
+			}
+
+			// the cell's range was uploaded on its own, so offsets move back by where it starts
+			for (const auto& scenePrimitive : scene.meshes[nodeData.mesh]) {
+				std::vector<VertexAttributeDescription> attributeDescriptions = scenePrimitive.attributes;
+				for (auto& attributeDescription : attributeDescriptions) {
+					attributeDescription.buffer = cell.geometry;
+					attributeDescription.offset -= cellData.offset;
+				}
+
+				std::shared_ptr<MeshPrimitive> primitive;
+				if (scenePrimitive.isIndexed) {
+					IndexBufferDescription indexBufferDescription = scenePrimitive.indices;
+					indexBufferDescription.buffer = cell.geometry;
+					indexBufferDescription.offset -= cellData.offset;
+
+					primitive = std::make_shared<MeshPrimitive>(std::move(attributeDescriptions), std::move(indexBufferDescription), scenePrimitive.bbMin, scenePrimitive.bbMax, scenePrimitive.mode);
+				}
+				else {
+					primitive = std::make_shared<MeshPrimitive>(std::move(attributeDescriptions), scenePrimitive.bbMin, scenePrimitive.bbMax, scenePrimitive.mode);
+				}
+				primitive->setNode(nodes[nodeIndex]);
+				primitive->setInstances(instances);
+				primitive->setMaterial(scenePrimitive.material > -1 ? materials[scenePrimitive.material] : defaultMaterial);
+				renderer->addPrimitive(primitive);
+				cell.primitives.push_back(std::move(primitive));
+			}
+		}
+		// the primitives show up once the cell's copies land, textures follow
+		renderer->flushUploads();
+
+		std::vector<TextureImportRequest> requests;
+		requests.reserve(cellData.textures.size());
+		for (const uint32_t t : cellData.textures) {
+			requests.push_back(makeTextureImportRequest(scene, scene.textures[t]));
+			textureUsers[t]++;
+		}
+		cell.textures = textureRegistry->acquire(requests, [&](size_t requestIndex, Texture texture) {
+			const uint32_t t = cellData.textures[requestIndex];
+			// already resident for another cell
+			if (textures[t] == texture)
+				return;
+			textures[t] = texture;
+			for (const size_t m : textureMaterials[t])
+				renderer->updateMaterialTextures(materials[m], materialTextures(scene.materials[m], textures));
+		});
+
+		residentSize += cellData.size;
+		loadedCells[cellIndex] = std::move(cell);
+	};
+
+	auto unloadCell = [&](size_t cellIndex) {
+		const SceneCellData& cellData = scene.cells[cellIndex];
+		LoadedCell& cell = *loadedCells[cellIndex];
+		renderer->removePrimitives(cell.primitives);
+		renderer->destroyBuffer(cell.geometry);
+		for (const Buffer buffer : cell.instanceBuffers)
+			renderer->destroyBuffer(buffer);
+
+		// materials stop sampling a texture before its last reference is given back
+		std::set<size_t> changedMaterials;
+		for (const uint32_t t : cellData.textures) {
+			if (--textureUsers[t] > 0)
+				continue;
+			textures[t] = Texture{};
+			changedMaterials.insert(textureMaterials[t].begin(), textureMaterials[t].end());
+		}
+		for (const size_t m : changedMaterials)
+			renderer->updateMaterialTextures(materials[m], materialTextures(scene.materials[m], textures));
+		for (const Texture texture : cell.textures)
+			textureRegistry->release(texture);
+
+		residentSize -= cellData.size;
+		loadedCells[cellIndex].reset();
+	};
+
+	std::vector<float> cellDistances(scene.cells.size());
+	std::vector<size_t> cellOrder(scene.cells.size());
+	while (!stop) {
+		const glm::vec3 position = viewpoint.load();
+		for (size_t c = 0; c < scene.cells.size(); c++)
+			cellDistances[c] = glm::distance(position, glm::clamp(position, scene.cells[c].bbMin, scene.cells[c].bbMax));
+		std::iota(cellOrder.begin(), cellOrder.end(), size_t{ 0 });
+		std::sort(cellOrder.begin(), cellOrder.end(), [&cellDistances](size_t a, size_t b) { return cellDistances[a] < cellDistances[b]; });
+
+		for (const size_t c : cellOrder) {
+			if (loadedCells[c] && cellDistances[c] > loaderSettings.worldLoadRadius * WORLD_UNLOAD_SLACK)
+				unloadCell(c);
+		}
+
+		bool isIdle = true;
+		for (const size_t c : cellOrder) {
+			if (cellDistances[c] > loaderSettings.worldLoadRadius)
+				break;
+			if (loadedCells[c])
+				continue;
+
+			// farther cells give way to nearer ones, but the nearest cell is always let in
+			for (auto farthest = cellOrder.rbegin(); residentSize > 0 && residentSize + scene.cells[c].size > loaderSettings.worldGeometryBudget && *farthest != c; ++farthest) {
+				if (loadedCells[*farthest])
+					unloadCell(*farthest);
+			}
+			if (residentSize > 0 && residentSize + scene.cells[c].size > loaderSettings.worldGeometryBudget)
+				break;
+
+			loadCell(c);
+			isIdle = false;
+			break;
+		}
+
+		if (isIdle)
+			std::this_thread::sleep_for(WORLD_STREAMING_INTERVAL);
+	}
+}
+
+// Loads the scene from its source and runs the import-time passes on it. Everything done here ends up in the cache.
+SceneData importGltfScene(const std::string& filename) {
+	SceneData scene = loadGltfScene(filename);
+	if (loaderSettings.weldVertices)
+		weldSceneMeshes(scene, loaderSettings.weldEpsilon);
+	if (loaderSettings.generateTangents)
+		generateSceneTangents(scene);
+	if (loaderSettings.optimizeMeshes)
+		optimizeSceneMeshes(scene);
+	if (loaderSettings.quantizeVertices)
+		quantizeSceneMeshes(scene);
+	padSceneVertexAttributes(scene);
+	packSceneGeometry(scene);
+	if (loaderSettings.worldStreaming)
+		partitionScene(scene, loaderSettings.worldCellSize);
+	return scene;
+}
+
+// Settings that change the processed scene are hashed into the key, so toggling them doesn't load stale entries.
+// They're appended field by field, struct padding never reaches the hash.
+uint64_t sceneCacheKey(const SceneCache& sceneCache, const std::string& filename) {
+	std::vector<byte> settings;
+	auto append = [&settings](const auto& value) {
+		const byte* p = reinterpret_cast<const byte*>(&value);
+		settings.insert(settings.end(), p, p + sizeof(value));
+	};
+	append(loaderSettings.weldVertices);
+	append(loaderSettings.weldEpsilon);
+	append(loaderSettings.generateTangents);
+	append(loaderSettings.optimizeMeshes);
+	append(loaderSettings.quantizeVertices);
+	append(loaderSettings.worldStreaming);
+	append(loaderSettings.worldCellSize);
+
+	return SceneCache::key(sceneCache.sourceHash(filename), settings);
+}
+
+// instantiate receives the scene once it is loaded, either from the cache or imported from the file
+void openGltf(const std::string& filename, const std::function<void(const SceneData&)>& instantiate) {
+	if (!loaderSettings.sceneCacheEnabled) {
+		instantiate(importGltfScene(filename));
+		return;
+	}
+
+	const SceneCache sceneCache{ loaderSettings.sceneCacheDirectory, loaderSettings.sceneCacheCompression };
+	const uint64_t sourceHash = sceneCacheKey(sceneCache, filename);
+
+	if (std::optional<SceneData> cachedScene = sceneCache.load(sourceHash)) {
+		instantiate(*cachedScene);
+		return;
+	}
+
+	SceneData scene = importGltfScene(filename);
+	try {
+		sceneCache.store(sourceHash, scene);
+	}
+	catch (const std::exception& e) {
+		std::cout << "Could not write scene cache: " << e.what() << std::endl;
+	}
+	instantiate(scene);
 }
 
 int main(size_t argc, const char* argv[]) {
@@ -430,15 +1372,18 @@ int main(size_t argc, const char* argv[]) {
 	window.set<vkfw::Attribute::eResizable>(false);
 
 	renderer = std::make_unique<VulkanRenderer>(window, RendererSettings{});
-
-	std::array<TextureInfo, 6> cubeFaces = {
-		loadTexture("./environment/px.png"),
-		loadTexture("./environment/nx.png"),
-		loadTexture("./environment/py.png"),
-		loadTexture("./environment/ny.png"),
-		loadTexture("./environment/pz.png"),
-		loadTexture("./environment/nz.png"),
+	textureRegistry = std::make_unique<TextureRegistry>(*renderer, TextureStreamingSettings{ loaderSettings.textureStreaming, loaderSettings.textureInitialSize, loaderSettings.textureBudget });
+
+	const std::array<const char*, 6> cubeFacePaths = {
+		"./environment/px.png",
+		"./environment/nx.png",
+		"./environment/py.png",
+		"./environment/ny.png",
+		"./environment/pz.png",
+		"./environment/nz.png",
 	};
+	std::array<TextureInfo, 6> cubeFaces;
+	std::transform(std::execution::par, cubeFacePaths.begin(), cubeFacePaths.end(), cubeFaces.begin(), loadTexture);
 	renderer->setEnvironmentMap(cubeFaces);
 
 	std::vector<PointLight> pointLights{ 
@@ -457,9 +1402,57 @@ int main(size_t argc, const char* argv[]) {
 	}*/
 	renderer->setLights(pointLights, directionalLight);
 
-	openGltf(argv[1]);
+	// every file on the command line is a scene, Tab switches to the next one in the background
+	const std::vector<std::string> sceneFiles(argv + 1, argv + argc);
+	size_t sceneFileIndex = 0;
+
+	std::thread loaderThread;
+	// the loader thread reads the camera position from here, the camera itself belongs to this thread
+	std::atomic<glm::vec3> viewpoint = renderer->camera().position();
+	std::atomic<bool> stopLoading = false;
+	std::atomic<bool> isLoading = false;
+	if (loaderSettings.streamingLoad) {
+		renderer->start();
+		isLoading = true;
+		loaderThread = std::thread([filename = sceneFiles[0], &viewpoint, &stopLoading, &isLoading]() {
+			try {
+				openGltf(filename, [&viewpoint, &stopLoading](const SceneData& scene) {
+					if (loaderSettings.worldStreaming)
+						streamWorld(scene, viewpoint, stopLoading);
+					else
+						streamScene(scene, viewpoint.load(), activeScene);
+				});
+			}
+			catch (const std::exception& e) {
+				std::cout << "Could not load " << filename << ": " << e.what() << std::endl;
+			}
+			// hands the upload pools and staging rings over to the next loader thread
+			renderer->finishUploads();
+			isLoading = false;
+		});
+	}
+	else {
+		openGltf(argv[1], [](const SceneData& scene) { instantiateScene(scene, activeScene); });
+		renderer->start();
+	}
 
-	renderer->start();
+	// follows what the last frame drew, loader threads wait for it between textures and the other way around
+	std::thread textureStreamerThread;
+	if (loaderSettings.textureStreaming) {
+		textureStreamerThread = std::thread([&stopLoading]() {
+			while (!stopLoading) {
+				try {
+					// under memory pressure textures only get what the renderer has left for them
+					textureRegistry->stream(renderer->textureScreenSizes(), renderer->memoryStatus().textureBudget);
+				}
+				catch (const std::exception& e) {
+					std::cout << "Could not stream textures: " << e.what() << std::endl;
+				}
+				std::this_thread::sleep_for(loaderSettings.textureStreamingInterval);
+			}
+			renderer->finishUploads();
+		});
+	}
 
 	double runningTime = 0.0;
 	auto frameTime = std::chrono::high_resolution_clock::now();
@@ -472,7 +1465,29 @@ int main(size_t argc, const char* argv[]) {
 	std::set<vkfw::Key> pressedKeys{};
 	std::set<vkfw::MouseButton> pressedMouseButtons{};
 
-	window.callbacks()->on_key = [&pressedKeys](vkfw::Window const&, vkfw::Key key, int32_t, vkfw::KeyAction action, vkfw::ModifierKeyFlags modifiers) {
+	// a streamed world keeps its loader busy, so there is nothing to switch from
+	auto switchToNextScene = [&]() {
+		if (!loaderSettings.streamingLoad || loaderSettings.worldStreaming || sceneFiles.size() < 2 || isLoading)
+			return;
+
+		sceneFileIndex = (sceneFileIndex + 1) % sceneFiles.size();
+		if (loaderThread.joinable())
+			loaderThread.join();
+		isLoading = true;
+		loaderThread = std::thread([filename = sceneFiles[sceneFileIndex], &viewpoint, &isLoading]() {
+			try {
+				switchScene(filename, viewpoint.load());
+			}
+			catch (const std::exception& e) {
+				std::cout << "Could not load " << filename << ": " << e.what() << std::endl;
+			}
+			// hands the upload pools and staging rings over to the next loader thread
+			renderer->finishUploads();
+			isLoading = false;
+		});
+	};
+
+	window.callbacks()->on_key = [&pressedKeys, &switchToNextScene](vkfw::Window const&, vkfw::Key key, int32_t, vkfw::KeyAction action, vkfw::ModifierKeyFlags modifiers) {
 		if (action == vkfw::KeyAction::ePress) {
 			pressedKeys.insert(key);
 		}
@@ -493,6 +1508,9 @@ int main(size_t argc, const char* argv[]) {
 			if (key == vkfw::Key::eRightBracket)
 				renderer->camera().setVFov(renderer->camera().vfov() - 1.0f);
 		}
+
+		if (action == vkfw::KeyAction::ePress && key == vkfw::Key::eTab)
+			switchToNextScene();
 	};
 
 	glm::vec2 lastCursorPos{ 0.0f, 0.0f };
@@ -552,6 +1570,14 @@ int main(size_t argc, const char* argv[]) {
 
 			renderer->camera().tilt(-tiltSpeed * cursorDelta);
 		}
+
+		viewpoint.store(renderer->camera().position());
 	}
+
+	stopLoading = true;
+	if (loaderThread.joinable())
+		loaderThread.join();
+	if (textureStreamerThread.joinable())
+		textureStreamerThread.join();
 	vkfw::terminate();
 }
\ No newline at end of file
@@ -1,10 +1,18 @@
 #version 450
 
+// set per vertex layout, see VulkanRenderer::createMeshPipeline
+layout(constant_id = 0) const bool octahedralNormals = false;
+layout(constant_id = 1) const bool octahedralTangents = false;
+layout(constant_id = 2) const bool hasTangents = true;
+
 layout(location = 0) in vec3 inPosition;
+// octahedral coordinates in xy when octahedralNormals is set
 layout(location = 1) in vec3 inNormal;
-layout(location = 2) in vec3 inTangent;
-layout(location = 3) in vec3 inBitangent;
-layout(location = 4) in vec2 inUv;
+// octahedral coordinates in xy and handedness in z when octahedralTangents is set, handedness in w otherwise
+layout(location = 2) in vec4 inTangent;
+layout(location = 3) in vec2 inUv;
+// transform of the instance relative to the node, identity for primitives that aren't instanced
+layout(location = 4) in mat4 inInstance;
 
 layout(location = 0) out vec3 outWorldSpacePosition;
 layout(location = 1) out vec3 outNormal;
@@ -14,8 +22,9 @@ layout(location = 4) out vec2 outUv;
 layout(location = 5) out vec3 outDirectionalLightSpaceCoords[5];
 
 layout(push_constant) uniform constants {
-    mat4 modelViewProj;
     mat4 model;
+    vec4 positionOffset;
+    vec4 positionScale;
 };
 
 layout(set=2, binding=0) uniform cameraData {
@@ -33,14 +42,35 @@ layout(set=2, binding=1) readonly buffer csmSplitsBuffer {
     CSMSplit csmSplits[];
 };
 
+vec3 decodeOctahedral(vec2 e) {
+    vec3 v = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+    if (v.z < 0.0f)
+        v.xy = (1.0f - abs(e.yx)) * vec2(e.x >= 0.0f ? 1.0f : -1.0f, e.y >= 0.0f ? 1.0f : -1.0f);
+    return normalize(v);
+}
+
 void main() {
-    gl_Position = modelViewProj * vec4(inPosition, 1.0f);
-    vec4 p = model * vec4(inPosition, 1.0f);
+    vec3 position = positionOffset.xyz + inPosition * positionScale.xyz;
+    vec3 normal = octahedralNormals ? decodeOctahedral(inNormal.xy) : inNormal;
+
+    vec4 tangent;
+    if (!hasTangents)
+        tangent = vec4(normalize(cross(abs(normal.x) > 0.9f ? vec3(0.0f, 1.0f, 0.0f) : vec3(1.0f, 0.0f, 0.0f), normal)), 1.0f);
+    else if (octahedralTangents)
+        tangent = vec4(decodeOctahedral(inTangent.xy), inTangent.z < 0.0f ? -1.0f : 1.0f);
+    else
+        tangent = inTangent;
+
+    mat4 instanceModel = model * inInstance;
+    vec4 p = instanceModel * vec4(position, 1.0f);
+    gl_Position = viewProjectionMatrix * p;
     outWorldSpacePosition = p.xyz/p.w;
     outUv = inUv;
-    outNormal = normalize((model * vec4(inNormal, 0.0f)).xyz);
-    outTangent = normalize((model * vec4(inTangent, 0.0f)).xyz);
-    outBitangent = normalize((model * vec4(inBitangent, 0.0f)).xyz);
+    // inverse transpose keeps the basis perpendicular to the surface under non-uniform scale
+    mat3 normalMatrix = transpose(inverse(mat3(instanceModel)));
+    outNormal = normalize(normalMatrix * normal);
+    outTangent = normalize(normalMatrix * tangent.xyz);
+    outBitangent = normalize(normalMatrix * (cross(normal, tangent.xyz) * tangent.w));
 
     for(int i = 0; i < csmSplits.length(); i++) {
         vec4 lsp = csmSplits[i].viewproj * vec4(outWorldSpacePosition, 1.0f);
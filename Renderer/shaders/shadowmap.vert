@@ -1,12 +1,14 @@
 #version 450
 
 layout(location = 0) in vec3 inPosition;
+layout(location = 4) in mat4 inInstance;
 
 layout(push_constant) uniform constants {
     mat4 modelViewProj;
-    mat4 model;
+    vec4 positionOffset;
+    vec4 positionScale;
 };
 
 void main() {  
-    gl_Position = modelViewProj * vec4(inPosition, 1.0f);
+    gl_Position = modelViewProj * inInstance * vec4(positionOffset.xyz + inPosition * positionScale.xyz, 1.0f);
 }
\ No newline at end of file
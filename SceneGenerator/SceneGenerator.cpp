@@ -0,0 +1,268 @@
+#include "SceneGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+namespace {
+	// Appends the data to the scene's only buffer as a new buffer view and returns the view's index
+	int appendBufferView(tinygltf::Model& model, const void* data, size_t size, int target) {
+		std::vector<unsigned char>& buffer = model.buffers[0].data;
+		const size_t offset = (buffer.size() + 3) & ~size_t{ 3 };
+		buffer.resize(offset + size);
+		std::memcpy(buffer.data() + offset, data, size);
+
+		tinygltf::BufferView view{};
+		view.buffer = 0;
+		view.byteOffset = offset;
+		view.byteLength = size;
+		view.target = target;
+		model.bufferViews.push_back(view);
+		return static_cast<int>(model.bufferViews.size() - 1);
+	}
+
+	template<typename T> int appendAccessor(tinygltf::Model& model, const std::vector<T>& values, int componentType, int type, int target) {
+		tinygltf::Accessor accessor{};
+		accessor.bufferView = appendBufferView(model, values.data(), values.size() * sizeof(T), target);
+		accessor.componentType = componentType;
+		accessor.type = type;
+		accessor.count = values.size();
+		model.accessors.push_back(accessor);
+		return static_cast<int>(model.accessors.size() - 1);
+	}
+
+	// A UV sphere of about the requested triangle count, with a vertex seam so the texture wraps
+	tinygltf::Primitive makeSphere(tinygltf::Model& model, uint32_t triangleCount, const glm::vec3& center, float radius) {
+		const uint32_t columns = std::max(3u, static_cast<uint32_t>(std::sqrt(static_cast<float>(triangleCount))));
+		const uint32_t rows = std::max(2u, triangleCount / (2 * columns) + 1);
+
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec3> normals;
+		std::vector<glm::vec2> texcoords;
+		for (uint32_t i = 0; i <= rows; i++) {
+			const float theta = glm::pi<float>() * i / rows;
+			for (uint32_t j = 0; j <= columns; j++) {
+				const float phi = glm::two_pi<float>() * j / columns;
+				const glm::vec3 normal{ std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi) };
+				positions.push_back(center + radius * normal);
+				normals.push_back(normal);
+				texcoords.push_back(glm::vec2{ static_cast<float>(j) / columns, static_cast<float>(i) / rows });
+			}
+		}
+
+		// the pole rows only get the one triangle of each quad that isn't degenerate
+		std::vector<uint32_t> indices;
+		auto vertex = [columns](uint32_t i, uint32_t j) { return i * (columns + 1) + j; };
+		for (uint32_t i = 0; i < rows; i++) {
+			for (uint32_t j = 0; j < columns; j++) {
+				if (i != rows - 1)
+					indices.insert(indices.end(), { vertex(i, j), vertex(i + 1, j + 1), vertex(i + 1, j) });
+				if (i != 0)
+					indices.insert(indices.end(), { vertex(i, j), vertex(i, j + 1), vertex(i + 1, j + 1) });
+			}
+		}
+
+		tinygltf::Primitive primitive{};
+		primitive.mode = TINYGLTF_MODE_TRIANGLES;
+
+		const int positionAccessor = appendAccessor(model, positions, TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC3, TINYGLTF_TARGET_ARRAY_BUFFER);
+		model.accessors[positionAccessor].minValues = { center.x - radius, center.y - radius, center.z - radius };
+		model.accessors[positionAccessor].maxValues = { center.x + radius, center.y + radius, center.z + radius };
+		primitive.attributes["POSITION"] = positionAccessor;
+		primitive.attributes["NORMAL"] = appendAccessor(model, normals, TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC3, TINYGLTF_TARGET_ARRAY_BUFFER);
+		primitive.attributes["TEXCOORD_0"] = appendAccessor(model, texcoords, TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC2, TINYGLTF_TARGET_ARRAY_BUFFER);
+
+		if (positions.size() <= UINT16_MAX) {
+			const std::vector<uint16_t> narrowIndices(indices.begin(), indices.end());
+			primitive.indices = appendAccessor(model, narrowIndices, TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT, TINYGLTF_TYPE_SCALAR, TINYGLTF_TARGET_ELEMENT_ARRAY_BUFFER);
+		}
+		else {
+			primitive.indices = appendAccessor(model, indices, TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT, TINYGLTF_TYPE_SCALAR, TINYGLTF_TARGET_ELEMENT_ARRAY_BUFFER);
+		}
+		return primitive;
+	}
+
+	// A checkerboard in the given color, so texture sampling and mip selection are visible
+	tinygltf::Image makeCheckerboard(uint32_t size, const glm::vec3& color) {
+		tinygltf::Image image{};
+		image.width = static_cast<int>(size);
+		image.height = static_cast<int>(size);
+		image.component = 4;
+		image.bits = 8;
+		image.pixel_type = TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE;
+		image.mimeType = "image/png";
+		image.image.resize(size_t{ size } * size * 4);
+
+		const uint32_t square = std::max(1u, size / 8);
+		for (uint32_t y = 0; y < size; y++) {
+			for (uint32_t x = 0; x < size; x++) {
+				const float shade = (x / square + y / square) % 2 ? 1.0f : 0.35f;
+				unsigned char* pixel = image.image.data() + (size_t{ y } * size + x) * 4;
+				pixel[0] = static_cast<unsigned char>(255.0f * color.r * shade);
+				pixel[1] = static_cast<unsigned char>(255.0f * color.g * shade);
+				pixel[2] = static_cast<unsigned char>(255.0f * color.b * shade);
+				pixel[3] = 255;
+			}
+		}
+		return image;
+	}
+}
+
+tinygltf::Model generateScene(const SceneGeneratorSettings& settings) {
+	std::mt19937 random{ settings.seed };
+	std::uniform_real_distribution<float> unit{ 0.0f, 1.0f };
+	auto randomColor = [&]() { return glm::vec3{ 0.2f + 0.8f * unit(random), 0.2f + 0.8f * unit(random), 0.2f + 0.8f * unit(random) }; };
+
+	tinygltf::Model model{};
+	model.asset.version = "2.0";
+	model.asset.generator = "SceneGenerator";
+	model.buffers.emplace_back();
+
+	const uint32_t textureCount = settings.textureCount;
+	for (uint32_t i = 0; i < textureCount; i++) {
+		tinygltf::Image image = makeCheckerboard(settings.textureSize, randomColor());
+		image.uri = "texture" + std::to_string(i) + ".png";
+		model.images.push_back(std::move(image));
+
+		tinygltf::Texture texture{};
+		texture.sampler = 0;
+		texture.source = static_cast<int>(i);
+		model.textures.push_back(texture);
+	}
+	if (textureCount > 0) {
+		tinygltf::Sampler sampler{};
+		sampler.magFilter = TINYGLTF_TEXTURE_FILTER_LINEAR;
+		sampler.minFilter = TINYGLTF_TEXTURE_FILTER_LINEAR_MIPMAP_LINEAR;
+		sampler.wrapS = TINYGLTF_TEXTURE_WRAP_REPEAT;
+		sampler.wrapT = TINYGLTF_TEXTURE_WRAP_REPEAT;
+		model.samplers.push_back(sampler);
+	}
+
+	const uint32_t materialCount = settings.materialCount > 0 ? settings.materialCount : std::max(1u, settings.meshCount * settings.primitivesPerMesh);
+	for (uint32_t i = 0; i < materialCount; i++) {
+		const bool isBlended = unit(random) < settings.blendFraction;
+		const glm::vec3 color = randomColor();
+
+		tinygltf::Material material{};
+		material.name = "material" + std::to_string(i);
+		material.pbrMetallicRoughness.baseColorFactor = { color.r, color.g, color.b, isBlended ? 0.5 : 1.0 };
+		material.pbrMetallicRoughness.metallicFactor = unit(random) < 0.3f ? 1.0 : 0.0;
+		material.pbrMetallicRoughness.roughnessFactor = 0.2 + 0.8 * unit(random);
+		if (textureCount > 0)
+			material.pbrMetallicRoughness.baseColorTexture.index = static_cast<int>(i % textureCount);
+		material.alphaMode = isBlended ? "BLEND" : "OPAQUE";
+		model.materials.push_back(material);
+	}
+
+	const uint32_t meshCount = std::max(1u, settings.meshCount);
+	for (uint32_t i = 0; i < meshCount; i++) {
+		tinygltf::Mesh mesh{};
+		mesh.name = "mesh" + std::to_string(i);
+		for (uint32_t p = 0; p < settings.primitivesPerMesh; p++) {
+			// primitives of a mesh sit side by side, each with its own bounds
+			tinygltf::Primitive primitive = makeSphere(model, settings.trianglesPerPrimitive, glm::vec3{ 1.2f * p, 0.5f, 0.0f }, 0.5f);
+			primitive.material = static_cast<int>((i * settings.primitivesPerMesh + p) % materialCount);
+			mesh.primitives.push_back(std::move(primitive));
+		}
+		model.meshes.push_back(std::move(mesh));
+	}
+
+	// the nodes of a level hang round robin from the nodes of the level above, near their parent
+	const uint32_t depth = std::clamp(settings.depth, 1u, std::max(1u, settings.nodeCount));
+	std::vector<std::vector<int>> levels(depth);
+	std::vector<glm::vec3> worldPositions;
+	worldPositions.reserve(settings.nodeCount);
+	model.nodes.reserve(settings.nodeCount + settings.pointLightCount);
+	for (uint32_t i = 0; i < settings.nodeCount; i++) {
+		const uint32_t level = static_cast<uint32_t>(uint64_t{ i } * depth / settings.nodeCount);
+		const int nodeIndex = static_cast<int>(model.nodes.size());
+
+		glm::vec3 parentPosition{ 0.0f };
+		glm::vec3 worldPosition{ (unit(random) - 0.5f) * settings.extent, 0.0f, (unit(random) - 0.5f) * settings.extent };
+		if (level > 0) {
+			const std::vector<int>& parents = levels[level - 1];
+			const int parent = parents[levels[level].size() % parents.size()];
+			model.nodes[parent].children.push_back(nodeIndex);
+			parentPosition = worldPositions[parent];
+
+			const float spread = std::ldexp(settings.extent, -static_cast<int>(level) - 1);
+			worldPosition = parentPosition + glm::vec3{ (unit(random) - 0.5f) * spread, 0.0f, (unit(random) - 0.5f) * spread };
+		}
+		worldPosition.y = 2.0f * unit(random);
+
+		tinygltf::Node node{};
+		node.mesh = static_cast<int>(i % meshCount);
+		const glm::vec3 translation = worldPosition - parentPosition;
+		node.translation = { translation.x, translation.y, translation.z };
+		model.nodes.push_back(std::move(node));
+		worldPositions.push_back(worldPosition);
+		levels[level].push_back(nodeIndex);
+	}
+
+	// every animated node is a channel of one animation, all sharing a full turn around Y over four seconds
+	std::vector<int> animatedNodes;
+	for (uint32_t i = 0; i < settings.nodeCount; i++) {
+		if (unit(random) < settings.animatedFraction)
+			animatedNodes.push_back(static_cast<int>(i));
+	}
+	if (!animatedNodes.empty()) {
+		const std::vector<float> times = { 0.0f, 1.0f, 2.0f, 3.0f, 4.0f };
+		std::vector<glm::vec4> rotations;
+		for (const float time : times) {
+			const glm::quat rotation = glm::angleAxis(glm::half_pi<float>() * time, glm::vec3{ 0.0f, 1.0f, 0.0f });
+			rotations.push_back(glm::vec4{ rotation.x, rotation.y, rotation.z, rotation.w });
+		}
+
+		tinygltf::AnimationSampler sampler{};
+		sampler.input = appendAccessor(model, times, TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_SCALAR, 0);
+		model.accessors[sampler.input].minValues = { times.front() };
+		model.accessors[sampler.input].maxValues = { times.back() };
+		sampler.output = appendAccessor(model, rotations, TINYGLTF_COMPONENT_TYPE_FLOAT, TINYGLTF_TYPE_VEC4, 0);
+		sampler.interpolation = "LINEAR";
+
+		tinygltf::Animation animation{};
+		animation.name = "spin";
+		animation.samplers.push_back(sampler);
+		for (const int node : animatedNodes) {
+			tinygltf::AnimationChannel channel{};
+			channel.sampler = 0;
+			channel.target_node = node;
+			channel.target_path = "rotation";
+			animation.channels.push_back(channel);
+		}
+		model.animations.push_back(std::move(animation));
+	}
+
+	tinygltf::Scene scene{};
+	scene.nodes = levels[0];
+
+	// KHR_lights_punctual point lights above the scene, each on a root node of its own
+	for (uint32_t i = 0; i < settings.pointLightCount; i++) {
+		const glm::vec3 color = randomColor();
+		tinygltf::Light light{};
+		light.type = "point";
+		light.color = { color.r, color.g, color.b };
+		light.intensity = 50.0 + 50.0 * unit(random);
+		model.lights.push_back(light);
+
+		tinygltf::Node node{};
+		node.name = "light" + std::to_string(i);
+		node.translation = { (unit(random) - 0.5f) * settings.extent, 3.0 + 2.0 * unit(random), (unit(random) - 0.5f) * settings.extent };
+		node.extensions["KHR_lights_punctual"] = tinygltf::Value{ tinygltf::Value::Object{ { "light", tinygltf::Value{ static_cast<int>(i) } } } };
+		scene.nodes.push_back(static_cast<int>(model.nodes.size()));
+		model.nodes.push_back(std::move(node));
+	}
+	if (settings.pointLightCount > 0)
+		model.extensionsUsed.push_back("KHR_lights_punctual");
+
+	model.scenes.push_back(std::move(scene));
+	model.defaultScene = 0;
+	return model;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+
+#include <tiny_gltf.h>
+
+struct SceneGeneratorSettings {
+	uint32_t nodeCount = 1000;
+	// levels of the node hierarchy, the nodes are spread evenly over them. 1 makes every node a root.
+	uint32_t depth = 3;
+	// distinct meshes, drawn by the nodes round robin
+	uint32_t meshCount = 16;
+	uint32_t primitivesPerMesh = 1;
+	// approximate, every primitive is a UV sphere
+	uint32_t trianglesPerPrimitive = 512;
+	// distinct materials, used by the primitives round robin. 0 gives every primitive of every mesh its own.
+	uint32_t materialCount = 8;
+	// distinct base color images, sampled by the materials round robin. 0 leaves the materials untextured.
+	uint32_t textureCount = 4;
+	uint32_t textureSize = 256;
+	uint32_t pointLightCount = 4;
+	// share of the nodes spinning around their Y axis, and of the materials that are alpha blended
+	float animatedFraction = 0.0f;
+	float blendFraction = 0.0f;
+	// side of the square on the XZ plane the nodes are scattered over
+	float extent = 100.0f;
+	uint32_t seed = 1;
+};
+
+// Builds a scene from the settings. The same settings always give the same scene. Images are decoded pixels, for
+// the writer to encode as PNG.
+tinygltf::Model generateScene(const SceneGeneratorSettings& settings);
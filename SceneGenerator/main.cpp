@@ -0,0 +1,93 @@
+#include <iostream>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <stdexcept>
+#include <string>
+
+#define TINYGLTF_IMPLEMENTATION
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#define STBI_MSC_SECURE_CRT
+#define TINYGLTF_USE_CPP14
+#include <tiny_gltf.h>
+
+#include "SceneGenerator.h"
+
+void printUsage() {
+	std::cout << "Usage: SceneGenerator <output.gltf|output.glb> [options]\n"
+		"  --nodes N            node count (1000)\n"
+		"  --depth N            levels of the node hierarchy (3)\n"
+		"  --meshes N           distinct meshes shared by the nodes (16)\n"
+		"  --primitives N       primitives per mesh (1)\n"
+		"  --triangles N        triangles per primitive (512)\n"
+		"  --materials N        distinct materials, 0 for one per primitive (8)\n"
+		"  --textures N         distinct textures, 0 for none (4)\n"
+		"  --texture-size N     texture width and height (256)\n"
+		"  --lights N           point lights (4)\n"
+		"  --animated F         share of animated nodes (0)\n"
+		"  --blend F            share of alpha blended materials (0)\n"
+		"  --extent F           side of the square the nodes are scattered over (100)\n"
+		"  --seed N             random seed (1)\n";
+}
+
+SceneGeneratorSettings parseSettings(int argc, const char* argv[]) {
+	SceneGeneratorSettings settings{};
+	auto count = [](uint32_t& value) { return [target = &value](const std::string& text) { *target = static_cast<uint32_t>(std::stoul(text)); }; };
+	auto fraction = [](float& value) { return [target = &value](const std::string& text) { *target = std::stof(text); }; };
+	const std::map<std::string, std::function<void(const std::string&)>> options = {
+		{ "--nodes", count(settings.nodeCount) },
+		{ "--depth", count(settings.depth) },
+		{ "--meshes", count(settings.meshCount) },
+		{ "--primitives", count(settings.primitivesPerMesh) },
+		{ "--triangles", count(settings.trianglesPerPrimitive) },
+		{ "--materials", count(settings.materialCount) },
+		{ "--textures", count(settings.textureCount) },
+		{ "--texture-size", count(settings.textureSize) },
+		{ "--lights", count(settings.pointLightCount) },
+		{ "--animated", fraction(settings.animatedFraction) },
+		{ "--blend", fraction(settings.blendFraction) },
+		{ "--extent", fraction(settings.extent) },
+		{ "--seed", count(settings.seed) },
+	};
+
+	for (int i = 2; i < argc; i += 2) {
+		const auto option = options.find(argv[i]);
+		if (option == options.end())
+			throw std::runtime_error(std::string{ "unknown option " } + argv[i]);
+		if (i + 1 >= argc)
+			throw std::runtime_error(std::string{ "missing value for " } + argv[i]);
+		option->second(argv[i + 1]);
+	}
+	return settings;
+}
+
+int main(int argc, const char* argv[]) {
+	if (argc < 2) {
+		printUsage();
+		return 1;
+	}
+
+	try {
+		const SceneGeneratorSettings settings = parseSettings(argc, argv);
+		tinygltf::Model model = generateScene(settings);
+
+		// a .glb carries everything in one file, a .gltf gets its buffer and images next to it
+		const std::filesystem::path output{ argv[1] };
+		const bool isBinary = output.extension() == ".glb";
+		if (!isBinary)
+			model.buffers[0].uri = output.stem().string() + ".bin";
+
+		tinygltf::TinyGLTF writer;
+		if (!writer.WriteGltfSceneToFile(&model, output.string(), isBinary, isBinary, !isBinary, isBinary))
+			throw std::runtime_error("could not write " + output.string());
+
+		std::cout << "Wrote " << output.string() << ": " << model.nodes.size() << " nodes, " << model.meshes.size() << " meshes, " << model.materials.size() << " materials, " << model.images.size() << " images" << std::endl;
+	}
+	catch (const std::exception& e) {
+		std::cout << e.what() << std::endl;
+		printUsage();
+		return 1;
+	}
+	return 0;
+}